@@ -38,6 +38,25 @@ struct _GstVaapiBlend
   VAContextID va_context;
 
   guint32 flags;
+
+  /* layers of the current composition, and one pipeline parameter
+   * buffer per layer, kept across frames */
+  GArray *layers;
+  GArray *va_params;
+
+  gboolean fast_copy;
+};
+
+typedef struct _GstVaapiBlendLayer GstVaapiBlendLayer;
+struct _GstVaapiBlendLayer
+{
+  VASurfaceID surface;
+  VARectangle src_rect;
+  VARectangle dst_rect;
+#if VA_CHECK_VERSION(1,1,0)
+  VABlendState blend_state;
+#endif
+  gdouble alpha;
 };
 
 typedef struct _GstVaapiBlendClass GstVaapiBlendClass;
@@ -110,6 +129,15 @@ gst_vaapi_blend_finalize (GObject * object)
 
   GST_VAAPI_DISPLAY_LOCK (blend->display);
 
+  if (blend->va_params) {
+    guint i;
+
+    for (i = 0; i < blend->va_params->len; i++) {
+      vaapi_destroy_buffer (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
+          &g_array_index (blend->va_params, VABufferID, i));
+    }
+  }
+
   if (blend->va_context != VA_INVALID_ID) {
     vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
         blend->va_context);
@@ -127,6 +155,14 @@ gst_vaapi_blend_finalize (GObject * object)
   gst_vaapi_display_replace (&blend->display, NULL);
 
 bail:
+  if (blend->layers) {
+    g_array_unref (blend->layers);
+    blend->layers = NULL;
+  }
+  if (blend->va_params) {
+    g_array_unref (blend->va_params);
+    blend->va_params = NULL;
+  }
   G_OBJECT_CLASS (gst_vaapi_blend_parent_class)->finalize (object);
 }
 
@@ -152,6 +188,9 @@ gst_vaapi_blend_init (GstVaapiBlend * blend)
   blend->va_config = VA_INVALID_ID;
   blend->va_context = VA_INVALID_ID;
   blend->flags = 0;
+  blend->layers = g_array_new (FALSE, TRUE, sizeof (GstVaapiBlendLayer));
+  blend->va_params = g_array_new (FALSE, FALSE, sizeof (VABufferID));
+  blend->fast_copy = TRUE;
 }
 
 static gboolean
@@ -214,78 +253,179 @@ gst_vaapi_blend_replace (GstVaapiBlend ** old_blend_ptr,
   gst_object_replace ((GstObject **) old_blend_ptr, GST_OBJECT (new_blend));
 }
 
+/**
+ * gst_vaapi_blend_set_fast_copy:
+ * @blend: a #GstVaapiBlend instance.
+ * @fast_copy: %TRUE to enable the fast path
+ *
+ * When enabled, and every layer of a composition is opaque and none
+ * of them overlaps another, the layers are submitted as plain scaled
+ * copies without any blend state. The result is the same, but drivers
+ * can use a cheaper copy engine. It is enabled by default.
+ **/
+void
+gst_vaapi_blend_set_fast_copy (GstVaapiBlend * blend, gboolean fast_copy)
+{
+  g_return_if_fail (blend != NULL);
+
+  blend->fast_copy = fast_copy;
+}
+
+static inline gboolean
+rect_overlaps (const VARectangle * a, const VARectangle * b)
+{
+  return a->x < b->x + b->width && b->x < a->x + a->width &&
+      a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+/* Returns %TRUE if all the layers are opaque and disjoint, so that the
+ * submission order and the destination contents don't matter */
 static gboolean
-gst_vaapi_blend_process_unlocked (GstVaapiBlend * blend,
-    GstVaapiSurface * output, GstVaapiBlendSurfaceNextFunc next,
+layers_are_opaque_tiles (GArray * layers)
+{
+  guint i, j;
+
+  for (i = 0; i < layers->len; i++) {
+    const GstVaapiBlendLayer *const layer =
+        &g_array_index (layers, GstVaapiBlendLayer, i);
+
+    if (layer->alpha < 1.0)
+      return FALSE;
+
+    for (j = 0; j < i; j++) {
+      if (rect_overlaps (&layer->dst_rect,
+              &g_array_index (layers, GstVaapiBlendLayer, j).dst_rect))
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+collect_layers (GstVaapiBlend * blend, GstVaapiBlendSurfaceNextFunc next,
     gpointer user_data)
 {
-  VAStatus va_status;
-  VADisplay va_display;
   GstVaapiBlendSurface *current;
 
-  va_display = GST_VAAPI_DISPLAY_VADISPLAY (blend->display);
-
-  va_status = vaBeginPicture (va_display, blend->va_context,
-      GST_VAAPI_SURFACE_ID (output));
-  if (!vaapi_check_status (va_status, "vaBeginPicture()"))
-    return FALSE;
+  g_array_set_size (blend->layers, 0);
 
   current = next (user_data);
   for (; current; current = next (user_data)) {
-    VAProcPipelineParameterBuffer *param = NULL;
-    VABufferID id = VA_INVALID_ID;
-    VARectangle src_rect = { 0, };
-    VARectangle dst_rect = { 0, };
-#if VA_CHECK_VERSION(1,1,0)
-    VABlendState blend_state;
-#endif
+    GstVaapiBlendLayer layer = { 0, };
 
     if (!current->surface)
       return FALSE;
 
+    layer.surface = GST_VAAPI_SURFACE_ID (current->surface);
+
     /* Build surface region (source) */
-    src_rect.width = GST_VAAPI_SURFACE_WIDTH (current->surface);
-    src_rect.height = GST_VAAPI_SURFACE_HEIGHT (current->surface);
+    layer.src_rect.width = GST_VAAPI_SURFACE_WIDTH (current->surface);
+    layer.src_rect.height = GST_VAAPI_SURFACE_HEIGHT (current->surface);
     if (current->crop) {
-      if ((current->crop->x + current->crop->width > src_rect.width) ||
-          (current->crop->y + current->crop->height > src_rect.height))
+      if ((current->crop->x + current->crop->width > layer.src_rect.width) ||
+          (current->crop->y + current->crop->height > layer.src_rect.height))
         return FALSE;
-      src_rect.x = current->crop->x;
-      src_rect.y = current->crop->y;
-      src_rect.width = current->crop->width;
-      src_rect.height = current->crop->height;
+      layer.src_rect.x = current->crop->x;
+      layer.src_rect.y = current->crop->y;
+      layer.src_rect.width = current->crop->width;
+      layer.src_rect.height = current->crop->height;
     }
 
     /* Build output region (target) */
-    dst_rect.x = current->target.x;
-    dst_rect.y = current->target.y;
-    dst_rect.width = current->target.width;
-    dst_rect.height = current->target.height;
+    layer.dst_rect.x = current->target.x;
+    layer.dst_rect.y = current->target.y;
+    layer.dst_rect.width = current->target.width;
+    layer.dst_rect.height = current->target.height;
+
+    layer.alpha = current->alpha;
+
+    g_array_append_val (blend->layers, layer);
+  }
+  return TRUE;
+}
+
+static gboolean
+ensure_param_buffers (GstVaapiBlend * blend, guint num_buffers)
+{
+  VADisplay va_display = GST_VAAPI_DISPLAY_VADISPLAY (blend->display);
+
+  while (blend->va_params->len < num_buffers) {
+    VABufferID id = VA_INVALID_ID;
 
     if (!vaapi_create_buffer (va_display, blend->va_context,
-            VAProcPipelineParameterBufferType, sizeof (*param), NULL, &id,
-            (gpointer *) & param))
+            VAProcPipelineParameterBufferType,
+            sizeof (VAProcPipelineParameterBuffer), NULL, &id, NULL))
+      return FALSE;
+    g_array_append_val (blend->va_params, id);
+  }
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_blend_process_unlocked (GstVaapiBlend * blend,
+    GstVaapiSurface * output, GstVaapiBlendSurfaceNextFunc next,
+    gpointer user_data)
+{
+  VAStatus va_status;
+  VADisplay va_display;
+  gboolean copy_only;
+  guint i, num_layers;
+
+  va_display = GST_VAAPI_DISPLAY_VADISPLAY (blend->display);
+
+  /* gather every layer first: their regions must stay at a fixed
+   * address until the whole batch is rendered */
+  if (!collect_layers (blend, next, user_data))
+    return FALSE;
+
+  num_layers = blend->layers->len;
+  if (!ensure_param_buffers (blend, num_layers))
+    return FALSE;
+
+  copy_only = blend->fast_copy && layers_are_opaque_tiles (blend->layers);
+  if (copy_only && num_layers > 0)
+    GST_LOG_OBJECT (blend, "%u opaque tiles, blending disabled", num_layers);
+
+  for (i = 0; i < num_layers; i++) {
+    GstVaapiBlendLayer *const layer =
+        &g_array_index (blend->layers, GstVaapiBlendLayer, i);
+    const VABufferID id = g_array_index (blend->va_params, VABufferID, i);
+    VAProcPipelineParameterBuffer *param;
+
+    param = vaapi_map_buffer (va_display, id);
+    if (!param)
       return FALSE;
 
     memset (param, 0, sizeof (*param));
 
-    param->surface = GST_VAAPI_SURFACE_ID (current->surface);
-    param->surface_region = &src_rect;
-    param->output_region = &dst_rect;
+    param->surface = layer->surface;
+    param->surface_region = &layer->src_rect;
+    param->output_region = &layer->dst_rect;
     param->output_background_color = 0xff000000;
 
 #if VA_CHECK_VERSION(1,1,0)
-    blend_state.flags = VA_BLEND_GLOBAL_ALPHA;
-    blend_state.global_alpha = current->alpha;
-    param->blend_state = &blend_state;
+    if (!copy_only) {
+      layer->blend_state.flags = VA_BLEND_GLOBAL_ALPHA;
+      layer->blend_state.global_alpha = layer->alpha;
+      param->blend_state = &layer->blend_state;
+    }
 #endif
 
     vaapi_unmap_buffer (va_display, id, NULL);
+  }
 
-    va_status = vaRenderPicture (va_display, blend->va_context, &id, 1);
-    vaapi_destroy_buffer (va_display, &id);
-    if (!vaapi_check_status (va_status, "vaRenderPicture()"))
+  va_status = vaBeginPicture (va_display, blend->va_context,
+      GST_VAAPI_SURFACE_ID (output));
+  if (!vaapi_check_status (va_status, "vaBeginPicture()"))
+    return FALSE;
+
+  if (num_layers > 0) {
+    va_status = vaRenderPicture (va_display, blend->va_context,
+        (VABufferID *) blend->va_params->data, num_layers);
+    if (!vaapi_check_status (va_status, "vaRenderPicture()")) {
+      vaEndPicture (va_display, blend->va_context);
       return FALSE;
+    }
   }
 
   va_status = vaEndPicture (va_display, blend->va_context);
@@ -54,6 +54,9 @@ void
 gst_vaapi_blend_replace (GstVaapiBlend ** old_blend_ptr,
     GstVaapiBlend * new_blend);
 
+void
+gst_vaapi_blend_set_fast_copy (GstVaapiBlend * blend, gboolean fast_copy);
+
 gboolean
 gst_vaapi_blend_process (GstVaapiBlend * blend, GstVaapiSurface * output,
     GstVaapiBlendSurfaceNextFunc next, gpointer user_data);
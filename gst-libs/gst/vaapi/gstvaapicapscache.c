@@ -0,0 +1,331 @@
+/*
+ *  gstvaapicapscache.c - Persistent cache of the VA driver capabilities
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Probing a VA driver (profiles, entrypoints, image formats, config
+ * attributes, surface limits) takes a noticeable time, and it is done
+ * again by every process opening a display. The results are kept in
+ * a key file under the user cache directory, one per device, as
+ * integer lists. The file is only trusted if it was written for the
+ * same device, driver vendor string, VA-API implementation (as
+ * reported by vaInitialize() at run time) and gstreamer-vaapi
+ * version; otherwise it is discarded and filled again from live
+ * queries. Set GST_VAAPI_DISABLE_CAPS_CACHE to always probe. */
+
+#include "sysdeps.h"
+#include "gstvaapicapscache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Bump whenever the layout of the cached values changes */
+#define CACHE_FORMAT_VERSION 2
+
+#define HEADER_GROUP "cache"
+
+struct _GstVaapiCapsCache
+{
+  GMutex lock;
+  gchar *filename;
+  gchar *device;
+  gchar *vendor;
+  gchar *va_version;
+  GKeyFile *keyfile;
+  guint loaded:1;
+  guint dirty:1;
+};
+
+static gchar *
+build_filename (const gchar * device)
+{
+  gchar *basename, *name, *filename;
+
+  basename = g_path_get_basename (device ? device : "default");
+  g_strcanon (basename, G_CSET_a_2_z G_CSET_A_2_Z G_CSET_DIGITS "-_.", '_');
+  name = g_strdup_printf ("vaapi-caps-%s.cache", basename);
+  filename = g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+      name, NULL);
+  g_free (name);
+  g_free (basename);
+  return filename;
+}
+
+static void
+write_header (GstVaapiCapsCache * cache)
+{
+  g_key_file_set_integer (cache->keyfile, HEADER_GROUP, "version",
+      CACHE_FORMAT_VERSION);
+  g_key_file_set_string (cache->keyfile, HEADER_GROUP, "package",
+      PACKAGE_VERSION);
+  g_key_file_set_string (cache->keyfile, HEADER_GROUP, "libva",
+      cache->va_version);
+  g_key_file_set_string (cache->keyfile, HEADER_GROUP, "device",
+      cache->device);
+  g_key_file_set_string (cache->keyfile, HEADER_GROUP, "vendor",
+      cache->vendor);
+}
+
+static gboolean
+header_has_string (GstVaapiCapsCache * cache, const gchar * key,
+    const gchar * value)
+{
+  gchar *str;
+  gboolean ret;
+
+  str = g_key_file_get_string (cache->keyfile, HEADER_GROUP, key, NULL);
+  ret = g_strcmp0 (str, value) == 0;
+  g_free (str);
+  return ret;
+}
+
+static gboolean
+header_matches (GstVaapiCapsCache * cache)
+{
+  return g_key_file_get_integer (cache->keyfile, HEADER_GROUP, "version",
+      NULL) == CACHE_FORMAT_VERSION
+      && header_has_string (cache, "package", PACKAGE_VERSION)
+      && header_has_string (cache, "libva", cache->va_version)
+      && header_has_string (cache, "device", cache->device)
+      && header_has_string (cache, "vendor", cache->vendor);
+}
+
+/* Loads the cache file on first use, or starts an empty one if it
+ * does not exist or was written for another driver */
+static void
+ensure_loaded (GstVaapiCapsCache * cache)
+{
+  GError *error = NULL;
+
+  if (cache->loaded)
+    return;
+  cache->loaded = TRUE;
+
+  if (!g_key_file_load_from_file (cache->keyfile, cache->filename,
+          G_KEY_FILE_NONE, &error)) {
+    GST_DEBUG ("no capability cache %s: %s", cache->filename, error->message);
+    g_clear_error (&error);
+    goto reset;
+  }
+  if (!header_matches (cache)) {
+    GST_INFO ("capability cache %s does not match the driver, probing",
+        cache->filename);
+    goto reset;
+  }
+
+  GST_INFO ("using capability cache %s", cache->filename);
+  return;
+
+reset:
+  g_key_file_free (cache->keyfile);
+  cache->keyfile = g_key_file_new ();
+  write_header (cache);
+}
+
+/**
+ * gst_vaapi_caps_cache_new:
+ * @device: the name of the device or display the driver runs on
+ * @vendor: the VA driver vendor string
+ * @va_version: the VA-API version of the loaded libva
+ *
+ * Creates the capability cache for the driver identified by @device,
+ * @vendor and @va_version. Nothing is read until the first lookup.
+ *
+ * Return value: the newly allocated cache, or %NULL if caching is
+ *   disabled
+ */
+GstVaapiCapsCache *
+gst_vaapi_caps_cache_new (const gchar * device, const gchar * vendor,
+    const gchar * va_version)
+{
+  GstVaapiCapsCache *cache;
+
+  if (g_getenv ("GST_VAAPI_DISABLE_CAPS_CACHE"))
+    return NULL;
+
+  cache = g_slice_new0 (GstVaapiCapsCache);
+  g_mutex_init (&cache->lock);
+  cache->filename = build_filename (device);
+  cache->device = g_strdup (device ? device : "");
+  cache->vendor = g_strdup (vendor ? vendor : "");
+  cache->va_version = g_strdup (va_version ? va_version : "");
+  cache->keyfile = g_key_file_new ();
+  return cache;
+}
+
+/**
+ * gst_vaapi_caps_cache_free:
+ * @cache: a #GstVaapiCapsCache, or %NULL
+ *
+ * Writes the new entries of @cache to disk, and frees it.
+ */
+void
+gst_vaapi_caps_cache_free (GstVaapiCapsCache * cache)
+{
+  if (!cache)
+    return;
+
+  gst_vaapi_caps_cache_save (cache);
+
+  g_key_file_free (cache->keyfile);
+  g_free (cache->va_version);
+  g_free (cache->vendor);
+  g_free (cache->device);
+  g_free (cache->filename);
+  g_mutex_clear (&cache->lock);
+  g_slice_free (GstVaapiCapsCache, cache);
+}
+
+/**
+ * gst_vaapi_caps_cache_lookup:
+ * @cache: a #GstVaapiCapsCache, or %NULL
+ * @group: the kind of capability
+ * @key: the capability
+ * @values_ptr: (out) (transfer full): return location for the values
+ * @length_ptr: (out): return location for the number of values
+ *
+ * Looks up a capability previously stored with
+ * gst_vaapi_caps_cache_store(). The values shall be freed with
+ * g_free(). An empty list is a valid entry.
+ *
+ * Return value: %TRUE if the capability was found
+ */
+gboolean
+gst_vaapi_caps_cache_lookup (GstVaapiCapsCache * cache, const gchar * group,
+    const gchar * key, gint ** values_ptr, gsize * length_ptr)
+{
+  GError *error = NULL;
+  gchar *str;
+  gint *values;
+  gsize length = 0;
+  gboolean found = FALSE;
+
+  g_return_val_if_fail (group != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (values_ptr != NULL, FALSE);
+  g_return_val_if_fail (length_ptr != NULL, FALSE);
+
+  if (!cache)
+    return FALSE;
+
+  g_mutex_lock (&cache->lock);
+  ensure_loaded (cache);
+  str = g_key_file_get_value (cache->keyfile, group, key, NULL);
+  if (!str)
+    goto done;
+
+  if (*str == '\0') {
+    values = NULL;
+  } else {
+    values = g_key_file_get_integer_list (cache->keyfile, group, key,
+        &length, &error);
+    if (!values) {
+      GST_DEBUG ("invalid cache entry %s/%s: %s", group, key, error->message);
+      g_clear_error (&error);
+      goto done;
+    }
+  }
+
+  *values_ptr = values;
+  *length_ptr = length;
+  found = TRUE;
+
+done:
+  g_mutex_unlock (&cache->lock);
+  g_free (str);
+  return found;
+}
+
+/**
+ * gst_vaapi_caps_cache_store:
+ * @cache: a #GstVaapiCapsCache, or %NULL
+ * @group: the kind of capability
+ * @key: the capability
+ * @values: (array length=length): the values of the capability
+ * @length: the number of @values
+ *
+ * Records a capability probed from the driver. It is written to disk
+ * by gst_vaapi_caps_cache_save().
+ */
+void
+gst_vaapi_caps_cache_store (GstVaapiCapsCache * cache, const gchar * group,
+    const gchar * key, const gint * values, gsize length)
+{
+  g_return_if_fail (group != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (values != NULL || length == 0);
+
+  if (!cache)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  ensure_loaded (cache);
+  if (length > 0) {
+    g_key_file_set_integer_list (cache->keyfile, group, key, (gint *) values,
+        length);
+  } else {
+    g_key_file_set_value (cache->keyfile, group, key, "");
+  }
+  cache->dirty = TRUE;
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * gst_vaapi_caps_cache_save:
+ * @cache: a #GstVaapiCapsCache, or %NULL
+ *
+ * Writes @cache to disk, if new capabilities were stored. Concurrent
+ * writers are harmless since the file is replaced atomically.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_caps_cache_save (GstVaapiCapsCache * cache)
+{
+  GError *error = NULL;
+  gchar *dirname, *data;
+  gsize length;
+  gboolean success = TRUE;
+
+  if (!cache)
+    return TRUE;
+
+  g_mutex_lock (&cache->lock);
+  if (!cache->dirty)
+    goto done;
+
+  dirname = g_path_get_dirname (cache->filename);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  data = g_key_file_to_data (cache->keyfile, &length, NULL);
+  success = g_file_set_contents (cache->filename, data, length, &error);
+  g_free (data);
+  if (!success) {
+    GST_DEBUG ("failed to write capability cache %s: %s", cache->filename,
+        error->message);
+    g_clear_error (&error);
+    goto done;
+  }
+
+  GST_DEBUG ("wrote capability cache %s", cache->filename);
+  cache->dirty = FALSE;
+
+done:
+  g_mutex_unlock (&cache->lock);
+  return success;
+}
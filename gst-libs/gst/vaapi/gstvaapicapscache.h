@@ -0,0 +1,54 @@
+/*
+ *  gstvaapicapscache.h - Persistent cache of the VA driver capabilities
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CAPS_CACHE_H
+#define GST_VAAPI_CAPS_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiCapsCache GstVaapiCapsCache;
+
+G_GNUC_INTERNAL
+GstVaapiCapsCache *
+gst_vaapi_caps_cache_new (const gchar * device, const gchar * vendor,
+    const gchar * va_version);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_caps_cache_free (GstVaapiCapsCache * cache);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_caps_cache_lookup (GstVaapiCapsCache * cache, const gchar * group,
+    const gchar * key, gint ** values_ptr, gsize * length_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_caps_cache_store (GstVaapiCapsCache * cache, const gchar * group,
+    const gchar * key, const gint * values, gsize length);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_caps_cache_save (GstVaapiCapsCache * cache);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CAPS_CACHE_H */
@@ -24,6 +24,7 @@
 #include "sysdeps.h"
 #include "gstvaapicodedbuffer.h"
 #include "gstvaapicodedbuffer_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiencoder_priv.h"
 #include "gstvaapiutils.h"
 
@@ -38,16 +39,23 @@ coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
   VABufferID buf_id;
   gboolean success;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  /* Released along with the buffer, even if its creation fails */
+  if (!gst_vaapi_display_reserve_memory (display, buf_size))
+    return FALSE;
+  buf->memory_size = buf_size;
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   success = vaapi_create_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CONTEXT_ID (context), VAEncCodedBufferType, buf_size,
       NULL, &buf_id, NULL);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!success)
     return FALSE;
 
-  GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
+  GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT ", %u bytes",
+      GST_VAAPI_ID_ARGS (buf_id), buf_size);
   GST_VAAPI_CODED_BUFFER_ID (buf) = buf_id;
+  buf->buf_size = buf_size;
   return TRUE;
 }
 
@@ -61,12 +69,14 @@ coded_buffer_free (GstVaapiCodedBuffer * buf)
   GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
 
   if (buf_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     vaapi_destroy_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display), &buf_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     GST_VAAPI_CODED_BUFFER_ID (buf) = VA_INVALID_ID;
   }
 
+  if (buf->memory_size)
+    gst_vaapi_display_release_memory (display, buf->memory_size);
   gst_vaapi_display_replace (&GST_VAAPI_CODED_BUFFER_DISPLAY (buf), NULL);
 
   g_slice_free1 (sizeof (GstVaapiCodedBuffer), buf);
@@ -80,11 +90,11 @@ coded_buffer_map (GstVaapiCodedBuffer * buf)
   if (buf->segment_list)
     return TRUE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   buf->segment_list =
       vaapi_map_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CODED_BUFFER_ID (buf));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   return buf->segment_list != NULL;
 }
 
@@ -96,10 +106,10 @@ coded_buffer_unmap (GstVaapiCodedBuffer * buf)
   if (!buf->segment_list)
     return;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   vaapi_unmap_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CODED_BUFFER_ID (buf), (void **) &buf->segment_list);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
 }
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstVaapiCodedBuffer, gst_vaapi_coded_buffer);
@@ -136,6 +146,8 @@ gst_vaapi_coded_buffer_new (GstVaapiContext * context, guint buf_size)
 
   GST_VAAPI_CODED_BUFFER_DISPLAY (buf) = gst_object_ref (display);
   GST_VAAPI_CODED_BUFFER_ID (buf) = VA_INVALID_ID;
+  buf->memory_size = 0;
+  buf->buf_size = 0;
   buf->segment_list = NULL;
 
   if (!coded_buffer_create (buf, buf_size, context))
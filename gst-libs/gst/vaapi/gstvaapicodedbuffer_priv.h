@@ -43,6 +43,8 @@ struct _GstVaapiCodedBuffer
   GstMiniObject         mini_object;
   GstVaapiDisplay      *display;
   GstVaapiID            object_id;
+  guint64               memory_size;
+  guint                 buf_size;
 
   /*< public >*/
   VACodedBufferSegment *segment_list;
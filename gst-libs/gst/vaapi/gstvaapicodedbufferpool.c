@@ -29,6 +29,34 @@
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
+/* Number of coded frames the buffer size is derived from */
+#define CODED_SIZE_HISTORY 256
+
+/* Coded frames needed before the buffers are sized from the history,
+   and then how often the size is updated */
+#define CODED_SIZE_MIN_HISTORY 64
+#define CODED_SIZE_UPDATE_INTERVAL 16
+
+/* The buffers fit all the intra frames of the history, and this
+   percentile of the other frames, plus some headroom */
+#define CODED_SIZE_PERCENTILE 99
+#define CODED_SIZE_MARGIN 50
+
+#define CODED_SIZE_ALIGN 4096
+
+/* The buffers never get smaller than this fraction of the worst case
+   size, nor than the last intra frame, nor than a buffer that already
+   overflowed. Long GOPs, or intra refresh, may not have any intra
+   frame left in the history, while the next one, or a scene change,
+   still needs as much room */
+#define CODED_SIZE_MIN_DIVISOR 8
+
+typedef struct
+{
+  guint size;
+  gboolean is_intra;
+} GstVaapiCodedSize;
+
 /**
  * GstVaapiCodedBufferPool:
  *
@@ -41,6 +69,14 @@ struct _GstVaapiCodedBufferPool
 
   GstVaapiContext *context;
   gsize buf_size;
+
+  /* protected by the parent pool mutex */
+  gsize alloc_size;
+  gsize min_size;
+  guint last_intra_size;
+  GstVaapiCodedSize sizes[CODED_SIZE_HISTORY];
+  guint num_sizes;
+  guint next_size;
 };
 
 static void
@@ -49,6 +85,11 @@ coded_buffer_pool_init (GstVaapiCodedBufferPool * pool,
 {
   pool->context = gst_vaapi_context_ref (context);
   pool->buf_size = buf_size;
+  pool->alloc_size = buf_size;
+  pool->min_size = 0;
+  pool->last_intra_size = 0;
+  pool->num_sizes = 0;
+  pool->next_size = 0;
 }
 
 static void
@@ -63,8 +104,89 @@ static gpointer
 coded_buffer_pool_alloc_object (GstVaapiVideoPool * base_pool)
 {
   GstVaapiCodedBufferPool *const pool = GST_VAAPI_CODED_BUFFER_POOL (base_pool);
+  gsize buf_size;
+
+  g_mutex_lock (&base_pool->mutex);
+  buf_size = pool->alloc_size;
+  g_mutex_unlock (&base_pool->mutex);
+
+  return gst_vaapi_coded_buffer_new (pool->context, buf_size);
+}
 
-  return gst_vaapi_coded_buffer_new (pool->context, pool->buf_size);
+static gint
+compare_coded_sizes (gconstpointer a, gconstpointer b)
+{
+  const guint size1 = *(const guint *) a;
+  const guint size2 = *(const guint *) b;
+
+  return (size1 > size2) - (size1 < size2);
+}
+
+/* Derives the size of the buffers from the coded sizes history */
+static gsize
+coded_buffer_pool_compute_size_unlocked (GstVaapiCodedBufferPool * pool)
+{
+  guint sizes[CODED_SIZE_HISTORY];
+  guint i, num_sizes = 0;
+  gsize size = pool->last_intra_size;
+
+  for (i = 0; i < pool->num_sizes; i++) {
+    const GstVaapiCodedSize *const coded_size = &pool->sizes[i];
+    if (coded_size->is_intra)
+      size = MAX (size, coded_size->size);
+    else
+      sizes[num_sizes++] = coded_size->size;
+  }
+
+  if (num_sizes > 0) {
+    qsort (sizes, num_sizes, sizeof (guint), compare_coded_sizes);
+    size = MAX (size, sizes[(num_sizes - 1) * CODED_SIZE_PERCENTILE / 100]);
+  }
+
+  size += size * CODED_SIZE_MARGIN / 100;
+  size = MAX (size, pool->buf_size / CODED_SIZE_MIN_DIVISOR);
+  size = MAX (size, pool->min_size);
+  size = GST_ROUND_UP_N (size, CODED_SIZE_ALIGN);
+  return CLAMP (size, CODED_SIZE_ALIGN, pool->buf_size);
+}
+
+/* Removes the free buffers not matching the current allocation size,
+   which shall be unreferenced out of the pool lock */
+static GList *
+coded_buffer_pool_remove_stale_unlocked (GstVaapiCodedBufferPool * pool)
+{
+  GQueue *const free_objects = &GST_VAAPI_VIDEO_POOL (pool)->free_objects;
+  GList *elem, *next, *objects = NULL;
+
+  for (elem = free_objects->head; elem != NULL; elem = next) {
+    GstVaapiCodedBuffer *const buf = elem->data;
+
+    next = elem->next;
+    if (buf->buf_size == pool->alloc_size)
+      continue;
+    objects = g_list_prepend (objects, buf);
+    g_queue_delete_link (free_objects, elem);
+  }
+  return objects;
+}
+
+/* Updates the size of the buffers allocated from now on. It shrinks
+   only for a significant saving, so that the buffers are not
+   reallocated on every small variation of the coded sizes */
+static GList *
+coded_buffer_pool_update_size_unlocked (GstVaapiCodedBufferPool * pool,
+    gsize size)
+{
+  if (size == pool->alloc_size)
+    return NULL;
+  if (size < pool->alloc_size && size > pool->alloc_size * 3 / 4)
+    return NULL;
+
+  GST_DEBUG ("coded buffer size %" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT
+      " bytes (max %" G_GSIZE_FORMAT ")", pool->alloc_size, size,
+      pool->buf_size);
+  pool->alloc_size = size;
+  return coded_buffer_pool_remove_stale_unlocked (pool);
 }
 
 static inline const GstVaapiMiniObjectClass *
@@ -119,7 +241,9 @@ gst_vaapi_coded_buffer_pool_new (GstVaapiEncoder * encoder, gsize buf_size)
  * @pool: a #GstVaapiCodedBufferPool
  *
  * Determines the maximum size of each #GstVaapiCodedBuffer held in
- * the @pool.
+ * the @pool. The buffers are allocated with a smaller size once the
+ * actual coded sizes are known, see
+ * gst_vaapi_coded_buffer_pool_add_coded_size().
  *
  * Return value: size of a #GstVaapiCodedBuffer in @pool
  */
@@ -130,3 +254,189 @@ gst_vaapi_coded_buffer_pool_get_buffer_size (GstVaapiCodedBufferPool * pool)
 
   return pool->buf_size;
 }
+
+/**
+ * gst_vaapi_coded_buffer_pool_add_coded_size:
+ * @pool: a #GstVaapiCodedBufferPool
+ * @size: the size of a coded frame, in bytes
+ * @is_intra: whether the frame is intra coded
+ *
+ * Records the size of a frame coded into a buffer of @pool. The
+ * buffers allocated afterwards fit the coded sizes recorded so far,
+ * rather than the worst case size the @pool was created with.
+ */
+void
+gst_vaapi_coded_buffer_pool_add_coded_size (GstVaapiCodedBufferPool * pool,
+    gsize size, gboolean is_intra)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  GstVaapiCodedSize *coded_size;
+  GList *objects = NULL;
+
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&base_pool->mutex);
+  coded_size = &pool->sizes[pool->next_size];
+  coded_size->size = MIN (size, G_MAXUINT);
+  coded_size->is_intra = is_intra;
+  if (is_intra)
+    pool->last_intra_size = coded_size->size;
+  pool->next_size = (pool->next_size + 1) % CODED_SIZE_HISTORY;
+  if (pool->num_sizes < CODED_SIZE_HISTORY)
+    pool->num_sizes++;
+
+  if (pool->num_sizes >= CODED_SIZE_MIN_HISTORY &&
+      pool->next_size % CODED_SIZE_UPDATE_INTERVAL == 0) {
+    objects = coded_buffer_pool_update_size_unlocked (pool,
+        coded_buffer_pool_compute_size_unlocked (pool));
+  }
+  g_mutex_unlock (&base_pool->mutex);
+
+  g_list_free_full (objects, (GDestroyNotify) gst_mini_object_unref);
+}
+
+/**
+ * gst_vaapi_coded_buffer_pool_add_overflow:
+ * @pool: a #GstVaapiCodedBufferPool
+ * @buf_size: the size of the buffer the frame did not fit in, in bytes
+ *
+ * Records that a frame did not fit in a buffer of @pool. The buffers
+ * get back to the maximum size, and the coded sizes history starts
+ * over. The buffers are never sized to @buf_size, or less, again.
+ */
+void
+gst_vaapi_coded_buffer_pool_add_overflow (GstVaapiCodedBufferPool * pool,
+    gsize buf_size)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  GList *objects;
+
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&base_pool->mutex);
+  pool->min_size = MAX (pool->min_size, buf_size + 1);
+  pool->num_sizes = 0;
+  pool->next_size = 0;
+  pool->last_intra_size = 0;
+  objects = coded_buffer_pool_update_size_unlocked (pool, pool->buf_size);
+  g_mutex_unlock (&base_pool->mutex);
+
+  g_list_free_full (objects, (GDestroyNotify) gst_mini_object_unref);
+}
+
+/**
+ * gst_vaapi_coded_buffer_pool_put_buffer:
+ * @pool: a #GstVaapiCodedBufferPool
+ * @buf: a #GstVaapiCodedBuffer obtained from @pool
+ *
+ * Pushes @buf back into @pool, or releases it if it does not match
+ * the size of the buffers allocated from now on.
+ */
+void
+gst_vaapi_coded_buffer_pool_put_buffer (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  gboolean is_stale;
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (buf != NULL);
+
+  g_mutex_lock (&base_pool->mutex);
+  is_stale = buf->buf_size != pool->alloc_size;
+  g_mutex_unlock (&base_pool->mutex);
+
+  if (is_stale)
+    gst_vaapi_video_pool_remove_object (base_pool, buf);
+  else
+    gst_vaapi_video_pool_put_object (base_pool, buf);
+}
+
+/**
+ * gst_vaapi_coded_buffer_pool_grow_buffer:
+ * @pool: a #GstVaapiCodedBufferPool
+ * @buf: a #GstVaapiCodedBuffer obtained from @pool
+ *
+ * Replaces @buf with a new buffer of the maximum size, typically for
+ * a frame that did not fit in @buf. @buf is released, as through
+ * gst_vaapi_video_pool_remove_object(), and the new buffer is handed
+ * out in its place, as through gst_vaapi_video_pool_get_object().
+ *
+ * Return value: the new #GstVaapiCodedBuffer, or %NULL if @buf
+ *   already has the maximum size or if the allocation failed
+ */
+GstVaapiCodedBuffer *
+gst_vaapi_coded_buffer_pool_grow_buffer (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  GstVaapiCodedBuffer *new_buf;
+  GList *elem;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (buf != NULL, NULL);
+
+  if (buf->buf_size >= pool->buf_size)
+    return NULL;
+
+  new_buf = gst_vaapi_coded_buffer_new (pool->context, pool->buf_size);
+  if (!new_buf)
+    return NULL;
+
+  /* Swap the buffers in place, so that the capacity of the pool is
+     never exceeded, nor a waiting encoder woken up, in between */
+  g_mutex_lock (&base_pool->mutex);
+  elem = g_list_find (base_pool->used_objects, buf);
+  if (elem)
+    elem->data = new_buf;
+  g_mutex_unlock (&base_pool->mutex);
+
+  if (!elem) {
+    gst_vaapi_coded_buffer_unref (new_buf);
+    return NULL;
+  }
+
+  /* Drop the references held by the pool and handed out for @buf */
+  gst_vaapi_coded_buffer_unref (buf);
+  gst_vaapi_coded_buffer_unref (buf);
+  return (GstVaapiCodedBuffer *)
+      gst_mini_object_ref (GST_MINI_OBJECT_CAST (new_buf));
+}
+
+static guint64
+get_memory_saved (GstVaapiCodedBufferPool * pool, GList * objects)
+{
+  guint64 memory_saved = 0;
+  GList *elem;
+
+  for (elem = objects; elem != NULL; elem = elem->next) {
+    GstVaapiCodedBuffer *const buf = elem->data;
+    if (buf->buf_size < pool->buf_size)
+      memory_saved += pool->buf_size - buf->buf_size;
+  }
+  return memory_saved;
+}
+
+/**
+ * gst_vaapi_coded_buffer_pool_get_memory_saved:
+ * @pool: a #GstVaapiCodedBufferPool
+ *
+ * Determines the memory saved by the buffers currently allocated in
+ * @pool, compared to buffers of the maximum size.
+ *
+ * Return value: the memory saved, in bytes
+ */
+guint64
+gst_vaapi_coded_buffer_pool_get_memory_saved (GstVaapiCodedBufferPool * pool)
+{
+  GstVaapiVideoPool *const base_pool = GST_VAAPI_VIDEO_POOL (pool);
+  guint64 memory_saved;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&base_pool->mutex);
+  memory_saved = get_memory_saved (pool, base_pool->free_objects.head) +
+      get_memory_saved (pool, base_pool->used_objects);
+  g_mutex_unlock (&base_pool->mutex);
+  return memory_saved;
+}
@@ -40,6 +40,29 @@ gst_vaapi_coded_buffer_pool_new (struct _GstVaapiEncoder * encoder,
 gsize
 gst_vaapi_coded_buffer_pool_get_buffer_size (GstVaapiCodedBufferPool * pool);
 
+guint64
+gst_vaapi_coded_buffer_pool_get_memory_saved (GstVaapiCodedBufferPool * pool);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_pool_add_coded_size (GstVaapiCodedBufferPool * pool,
+    gsize size, gboolean is_intra);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_pool_add_overflow (GstVaapiCodedBufferPool * pool,
+    gsize buf_size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_coded_buffer_pool_put_buffer (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf);
+
+G_GNUC_INTERNAL
+GstVaapiCodedBuffer *
+gst_vaapi_coded_buffer_pool_grow_buffer (GstVaapiCodedBufferPool * pool,
+    GstVaapiCodedBuffer * buf);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_POOL_H */
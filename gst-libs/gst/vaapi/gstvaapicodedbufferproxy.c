@@ -23,6 +23,7 @@
 #include "sysdeps.h"
 #include "gstvaapicodedbufferproxy.h"
 #include "gstvaapicodedbufferproxy_priv.h"
+#include "gstvaapicodedbufferpool.h"
 #include "gstvaapivideopool_priv.h"
 
 #define DEBUG 1
@@ -44,7 +45,8 @@ coded_buffer_proxy_finalize (GstVaapiCodedBufferProxy * proxy)
 {
   if (proxy->buffer) {
     if (proxy->pool)
-      gst_vaapi_video_pool_put_object (proxy->pool, proxy->buffer);
+      gst_vaapi_coded_buffer_pool_put_buffer (GST_VAAPI_CODED_BUFFER_POOL
+          (proxy->pool), proxy->buffer);
     gst_vaapi_coded_buffer_unref (proxy->buffer);
     proxy->buffer = NULL;
   }
@@ -93,6 +95,17 @@ gst_vaapi_coded_buffer_proxy_new_from_pool (GstVaapiCodedBufferPool * pool)
 
   proxy->destroy_func = NULL;
   proxy->user_data_destroy = NULL;
+  proxy->stats.picture_type = GST_VAAPI_PICTURE_TYPE_NONE;
+  proxy->stats.average_qp = -1;
+  proxy->stats.coded_size = 0;
+  proxy->stats.encode_time = GST_CLOCK_TIME_NONE;
+  proxy->stats.sync_time = GST_CLOCK_TIME_NONE;
+  proxy->stats.reorder_delay = GST_CLOCK_TIME_NONE;
+  proxy->stats.vbv_status = GST_VAAPI_VBV_STATUS_NONE;
+  proxy->stats.vbv_fullness = 0;
+  proxy->stats.vbv_size = 0;
+  proxy->stats.overflow = FALSE;
+  proxy->stats.reencoded = FALSE;
   proxy->pool = gst_vaapi_video_pool_ref (GST_VAAPI_VIDEO_POOL (pool));
   proxy->buffer = gst_vaapi_video_pool_get_object (proxy->pool);
   if (!proxy->buffer)
@@ -254,3 +267,21 @@ gst_vaapi_coded_buffer_proxy_set_user_data (GstVaapiCodedBufferProxy * proxy,
 
   coded_buffer_proxy_set_user_data (proxy, user_data, destroy_func);
 }
+
+/**
+ * gst_vaapi_coded_buffer_proxy_get_stats:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Gets the statistics the encoder collected while producing the
+ * coded buffer. They are complete once the buffer was returned by
+ * gst_vaapi_encoder_get_buffer_with_timeout().
+ *
+ * Return value: (transfer none): the #GstVaapiCodedBufferStats of @proxy
+ */
+const GstVaapiCodedBufferStats *
+gst_vaapi_coded_buffer_proxy_get_stats (GstVaapiCodedBufferProxy * proxy)
+{
+  g_return_val_if_fail (proxy != NULL, NULL);
+
+  return &proxy->stats;
+}
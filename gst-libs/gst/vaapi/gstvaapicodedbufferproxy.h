@@ -23,11 +23,71 @@
 #ifndef GST_VAAPI_CODED_BUFFER_PROXY_H
 #define GST_VAAPI_CODED_BUFFER_PROXY_H
 
+#include <gst/vaapi/gstvaapitypes.h>
 #include <gst/vaapi/gstvaapicodedbuffer.h>
 #include <gst/vaapi/gstvaapicodedbufferpool.h>
 
 G_BEGIN_DECLS
 
+typedef struct _GstVaapiCodedBufferStats GstVaapiCodedBufferStats;
+
+/**
+ * GstVaapiVBVStatus:
+ * @GST_VAAPI_VBV_STATUS_NONE: the buffering model is not checked
+ * @GST_VAAPI_VBV_STATUS_OK: the frame complies with the buffering model
+ * @GST_VAAPI_VBV_STATUS_UNDERFLOW: the frame was too large to be
+ *   decoded in time
+ * @GST_VAAPI_VBV_STATUS_OVERFLOW: the frames were too small to keep
+ *   up with a constant bitrate
+ *
+ * The outcome of the video buffering verifier for a coded frame.
+ */
+typedef enum
+{
+  GST_VAAPI_VBV_STATUS_NONE = 0,
+  GST_VAAPI_VBV_STATUS_OK,
+  GST_VAAPI_VBV_STATUS_UNDERFLOW,
+  GST_VAAPI_VBV_STATUS_OVERFLOW,
+} GstVaapiVBVStatus;
+
+/**
+ * GstVaapiCodedBufferStats:
+ * @picture_type: the #GstVaapiPictureType the frame was coded as
+ * @average_qp: the average QP of the picture, or -1 if the driver
+ *   does not report it
+ * @coded_size: the size of the coded frame, in bytes
+ * @encode_time: time elapsed from the frame submission to the encoder
+ *   until the end of its VA picture submission (vaEndPicture)
+ * @sync_time: time spent waiting for the hardware to complete
+ * @reorder_delay: time the frame was held by the encoder, for
+ *   reordering, before being submitted to the hardware
+ * @vbv_status: the #GstVaapiVBVStatus of the frame
+ * @vbv_fullness: the simulated buffer fullness after the frame, in bits
+ * @vbv_size: the simulated buffer size, in bits
+ * @overflow: whether the frame did not fit in the coded buffer, and
+ *   was truncated by the driver. Such a frame is not decodable, nor
+ *   are the frames referencing it up to the next intra frame
+ * @reencoded: whether the frame did not fit in the coded buffer at
+ *   first, and was encoded again into a coded buffer of the maximum
+ *   size
+ *
+ * Statistics about how the frame held by the coded buffer was encoded.
+ */
+struct _GstVaapiCodedBufferStats
+{
+  GstVaapiPictureType picture_type;
+  gint average_qp;
+  gsize coded_size;
+  GstClockTime encode_time;
+  GstClockTime sync_time;
+  GstClockTime reorder_delay;
+  GstVaapiVBVStatus vbv_status;
+  guint64 vbv_fullness;
+  guint64 vbv_size;
+  gboolean overflow;
+  gboolean reencoded;
+};
+
 /**
  * GST_VAAPI_CODED_BUFFER_PROXY_BUFFER:
  * @proxy: a #GstVaapiCodedBufferProxy
@@ -77,6 +137,9 @@ void
 gst_vaapi_coded_buffer_proxy_set_user_data (GstVaapiCodedBufferProxy * proxy,
     gpointer user_data, GDestroyNotify destroy_func);
 
+const GstVaapiCodedBufferStats *
+gst_vaapi_coded_buffer_proxy_get_stats (GstVaapiCodedBufferProxy * proxy);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PROXY_H */
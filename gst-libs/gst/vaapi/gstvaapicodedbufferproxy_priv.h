@@ -42,6 +42,7 @@ struct _GstVaapiCodedBufferProxy
   gpointer              destroy_data;
   GDestroyNotify        user_data_destroy;
   gpointer              user_data;
+  GstVaapiCodedBufferStats stats;
 };
 
 /**
@@ -65,6 +66,15 @@ struct _GstVaapiCodedBufferProxy
 #define GST_VAAPI_CODED_BUFFER_PROXY_BUFFER_SIZE(proxy) \
   GST_VAAPI_CODED_BUFFER_SIZE(GST_VAAPI_CODED_BUFFER_PROXY_BUFFER(proxy))
 
+/**
+ * GST_VAAPI_CODED_BUFFER_PROXY_STATS:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Macro that evaluates to the #GstVaapiCodedBufferStats of @proxy.
+ */
+#define GST_VAAPI_CODED_BUFFER_PROXY_STATS(proxy) \
+  (&GST_VAAPI_CODED_BUFFER_PROXY(proxy)->stats)
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PROXY_PRIV_H */
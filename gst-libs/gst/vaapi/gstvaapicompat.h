@@ -30,9 +30,11 @@
 #if VA_CHECK_VERSION(1,0,0)
 #define VA_ROI_RC_QP_DELTA_SUPPORT(x) x->bits.roi_rc_qp_delta_support
 #define VA_ENC_PACKED_HEADER_H264_SEI VAEncPackedHeaderRawData
+#define VA_ENC_PACKED_HEADER_HEVC_SEI VAEncPackedHeaderRawData
 #else
 #define VA_ROI_RC_QP_DELTA_SUPPORT(x) x->bits.roi_rc_qp_delat_support
 #define VA_ENC_PACKED_HEADER_H264_SEI VAEncPackedHeaderH264_SEI
+#define VA_ENC_PACKED_HEADER_HEVC_SEI VAEncPackedHeaderHEVC_SEI
 #endif
 
 #include <va/va_compat.h>
@@ -158,20 +158,20 @@ context_destroy (GstVaapiContext * context)
   GST_DEBUG ("context 0x%08x / config 0x%08x", context_id, context->va_config);
 
   if (context_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
         context_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyContext()"))
       GST_WARNING ("failed to destroy context 0x%08x", context_id);
     GST_VAAPI_CONTEXT_ID (context) = VA_INVALID_ID;
   }
 
   if (context->va_config != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
         context->va_config);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyConfig()"))
       GST_WARNING ("failed to destroy config 0x%08x", context->va_config);
     context->va_config = VA_INVALID_ID;
@@ -183,25 +183,54 @@ context_destroy (GstVaapiContext * context)
   }
 }
 
+/* In max-resolution mode, the surfaces are kept as long as the
+   pictures fit in them */
+static gboolean
+context_surfaces_fit (GstVaapiContext * context)
+{
+  const GstVaapiContextInfo *const cip = &context->info;
+
+  if (!context->max_width && !context->max_height)
+    return FALSE;
+  if (!context->surfaces)
+    return FALSE;
+  return cip->width <= context->surface_width
+      && cip->height <= context->surface_height;
+}
+
 static gboolean
 context_ensure_surfaces (GstVaapiContext * context)
 {
   GstVaapiDisplay *display = GST_VAAPI_CONTEXT_DISPLAY (context);
   const GstVaapiContextInfo *const cip = &context->info;
   const guint num_surfaces = cip->ref_frames + SCRATCH_SURFACES_COUNT;
+  const guint width = context->surface_width;
+  const guint height = context->surface_height;
   GstVaapiSurface *surface;
   GstVideoFormat format;
-  guint i, capacity;
+  guint i;
+
+  /* Decoders take their surfaces from the pool, which grows as
+     needed, since downstream may hold any number of them. Only the
+     DPB, and the surfaces expected to be held downstream, are
+     pre-allocated, in the background, so that the first picture does
+     not wait for all of them */
+  if (cip->usage == GST_VAAPI_CONTEXT_USAGE_DECODE) {
+    gst_vaapi_video_pool_set_capacity (context->surfaces_pool, 0);
+    gst_vaapi_video_pool_reserve_async (context->surfaces_pool,
+        num_surfaces + context->num_extra_surfaces);
+    return TRUE;
+  }
 
   ensure_preferred_format (context);
   format = context->preferred_format;
   for (i = context->surfaces->len; i < num_surfaces; i++) {
     if (format != GST_VIDEO_FORMAT_UNKNOWN) {
-      surface = gst_vaapi_surface_new_with_format (display, format, cip->width,
-          cip->height, 0);
+      surface = gst_vaapi_surface_new_with_format (display, format, width,
+          height, 0);
     } else {
-      surface = gst_vaapi_surface_new (display, cip->chroma_type, cip->width,
-          cip->height);
+      surface = gst_vaapi_surface_new (display, cip->chroma_type, width,
+          height);
     }
     if (!surface)
       return FALSE;
@@ -210,8 +239,7 @@ context_ensure_surfaces (GstVaapiContext * context)
       return FALSE;
   }
 
-  capacity = cip->usage == GST_VAAPI_CONTEXT_USAGE_DECODE ? 0 : num_surfaces;
-  gst_vaapi_video_pool_set_capacity (context->surfaces_pool, capacity);
+  gst_vaapi_video_pool_set_capacity (context->surfaces_pool, num_surfaces);
   return TRUE;
 }
 
@@ -231,9 +259,20 @@ context_create_surfaces (GstVaapiContext * context)
   }
 
   if (!context->surfaces_pool) {
-    context->surfaces_pool =
-        gst_vaapi_surface_pool_new_with_chroma_type (display, cip->chroma_type,
-        cip->width, cip->height, 0);
+    context->surface_width = MAX (cip->width, context->max_width);
+    context->surface_height = MAX (cip->height, context->max_height);
+
+    ensure_preferred_format (context);
+    if (context->preferred_format != GST_VIDEO_FORMAT_UNKNOWN) {
+      context->surfaces_pool = gst_vaapi_surface_pool_new (display,
+          context->preferred_format, context->surface_width,
+          context->surface_height, 0);
+    } else {
+      context->surfaces_pool =
+          gst_vaapi_surface_pool_new_with_chroma_type (display,
+          cip->chroma_type, context->surface_width, context->surface_height,
+          0);
+    }
 
     if (!context->surfaces_pool)
       return FALSE;
@@ -283,11 +322,12 @@ context_create (GstVaapiContext * context)
     num_surfaces = surfaces->len;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      context->va_config, cip->width, cip->height, VA_PROGRESSIVE,
+      context->va_config, context->surface_width, context->surface_height,
+      VA_PROGRESSIVE,
       surfaces_data, num_surfaces, &context_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateContext()"))
     goto cleanup;
 
@@ -414,11 +454,11 @@ config_create (GstVaapiContext * context)
       break;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
       context->va_profile, context->va_entrypoint, attribs, attrib_index,
       &context->va_config);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateConfig()"))
     goto cleanup;
 
@@ -470,6 +510,11 @@ gst_vaapi_context_init (GstVaapiContext * context,
 
   context->va_config = VA_INVALID_ID;
   context->reset_on_resize = TRUE;
+  context->max_width = 0;
+  context->max_height = 0;
+  context->surface_width = 0;
+  context->surface_height = 0;
+  context->num_extra_surfaces = 0;
 
   context->attribs = NULL;
   context->preferred_format = GST_VIDEO_FORMAT_UNKNOWN;
@@ -573,7 +618,12 @@ gst_vaapi_context_reset (GstVaapiContext * context,
   if (cip->width != new_cip->width || cip->height != new_cip->height) {
     cip->width = new_cip->width;
     cip->height = new_cip->height;
-    reset_surfaces = TRUE;
+    if (context_surfaces_fit (context)) {
+      GST_DEBUG ("keeping %ux%u surfaces for %ux%u pictures",
+          context->surface_width, context->surface_height, cip->width,
+          cip->height);
+    } else
+      reset_surfaces = TRUE;
   }
 
   if (cip->profile != new_cip->profile ||
@@ -690,6 +740,50 @@ gst_vaapi_context_reset_on_resize (GstVaapiContext * context,
   context->reset_on_resize = reset_on_resize;
 }
 
+/**
+ * gst_vaapi_context_set_max_resolution:
+ * @context: a #GstVaapiContext
+ * @max_width: the largest expected picture width, or 0
+ * @max_height: the largest expected picture height, or 0
+ *
+ * Sets the size the surfaces of @context are allocated for, at least,
+ * from their next allocation on. Then, as long as the pictures fit in
+ * the surfaces, a size change keeps them and the VA context, and the
+ * pictures are decoded in the top-left corner of the surfaces.
+ */
+void
+gst_vaapi_context_set_max_resolution (GstVaapiContext * context,
+    guint max_width, guint max_height)
+{
+  g_return_if_fail (context != NULL);
+
+  context->max_width = max_width;
+  context->max_height = max_height;
+}
+
+/**
+ * gst_vaapi_context_set_num_extra_surfaces:
+ * @context: a #GstVaapiContext
+ * @num_surfaces: the number of surfaces held outside of the DPB
+ *
+ * Sets the number of decoded surfaces that are expected to be held
+ * downstream, e.g. the minimum number of buffers of the downstream
+ * pool. They are pre-allocated along with the DPB, in the background.
+ */
+void
+gst_vaapi_context_set_num_extra_surfaces (GstVaapiContext * context,
+    guint num_surfaces)
+{
+  g_return_if_fail (context != NULL);
+
+  if (context->num_extra_surfaces == num_surfaces)
+    return;
+  context->num_extra_surfaces = num_surfaces;
+
+  if (context->surfaces_pool)
+    context_ensure_surfaces (context);
+}
+
 /**
  * gst_vaapi_context_get_surface_formats:
  * @context: a #GstVaapiContext
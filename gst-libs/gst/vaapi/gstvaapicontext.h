@@ -60,6 +60,8 @@ typedef enum {
  * @packed_headers: notify encoder that packed headers are submitted (mask).
  * @roi_capability: if encoder supports regions-of-interest.
  * @roi_num_supported: The number of regions-of-interest supported.
+ * @qp_block_size: size of the blocks of a QP buffer, 0 if per-block
+ *   QP is not supported.
  *
  * Extra configuration for encoding.
  */
@@ -69,6 +71,7 @@ struct _GstVaapiConfigInfoEncoder
   guint packed_headers;
   gboolean roi_capability;
   guint roi_num_supported;
+  guint qp_block_size;
 };
 
 /**
@@ -112,6 +115,11 @@ struct _GstVaapiContext
   GPtrArray *surfaces;
   GstVaapiVideoPool *surfaces_pool;
   gboolean reset_on_resize;
+  guint max_width;
+  guint max_height;
+  guint surface_width;
+  guint surface_height;
+  guint num_extra_surfaces;
   GstVaapiConfigSurfaceAttributes *attribs;
   GstVideoFormat preferred_format;
 };
@@ -146,6 +154,16 @@ void
 gst_vaapi_context_reset_on_resize (GstVaapiContext * context,
     gboolean reset_on_resize);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_set_max_resolution (GstVaapiContext * context,
+    guint max_width, guint max_height);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_context_set_num_extra_surfaces (GstVaapiContext * context,
+    guint num_surfaces);
+
 G_GNUC_INTERNAL
 GArray *
 gst_vaapi_context_get_surface_formats (GstVaapiContext * context);
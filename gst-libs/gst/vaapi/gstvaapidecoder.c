@@ -967,6 +967,38 @@ gst_vaapi_decoder_set_multiview_mode (GstVaapiDecoder * decoder,
   }
 }
 
+/* Lowers the max-resolution to the largest surfaces the decoder
+   configuration supports, so that asking for more than the driver can
+   allocate doesn't break the decoding of streams it can decode */
+static void
+clamp_max_resolution (GstVaapiDecoder * decoder)
+{
+  gint max_width = 0, max_height = 0;
+  GArray *formats;
+
+  if (!decoder->max_width && !decoder->max_height)
+    return;
+
+  formats = gst_vaapi_decoder_get_surface_attributes (decoder, NULL, NULL,
+      &max_width, &max_height, NULL);
+  if (!formats)
+    return;
+  g_array_unref (formats);
+
+  if (max_width > 0 && decoder->max_width > max_width) {
+    GST_WARNING ("max-width %u exceeds the driver limit, lowering it to %d",
+        decoder->max_width, max_width);
+    decoder->max_width = max_width;
+  }
+  if (max_height > 0 && decoder->max_height > max_height) {
+    GST_WARNING ("max-height %u exceeds the driver limit, lowering it to %d",
+        decoder->max_height, max_height);
+    decoder->max_height = max_height;
+  }
+  gst_vaapi_context_set_max_resolution (decoder->context, decoder->max_width,
+      decoder->max_height);
+}
+
 gboolean
 gst_vaapi_decoder_ensure_context (GstVaapiDecoder * decoder,
     GstVaapiContextInfo * cip)
@@ -977,15 +1009,91 @@ gst_vaapi_decoder_ensure_context (GstVaapiDecoder * decoder,
   if (decoder->context) {
     if (!gst_vaapi_context_reset (decoder->context, cip))
       return FALSE;
+  } else if (cip->width > 0 && cip->height > 0
+      && (decoder->max_width || decoder->max_height)) {
+    GstVaapiContextInfo max_info = *cip;
+
+    /* Create the config alone first, to get the surface size limits
+       before allocating anything */
+    max_info.width = 0;
+    max_info.height = 0;
+    decoder->context = gst_vaapi_context_new (decoder->display, &max_info);
+    if (!decoder->context)
+      return FALSE;
+    clamp_max_resolution (decoder);
+
+    /* Allocate the context for the largest size right away, and
+       shrink the pictures in it */
+    max_info.width = MAX (cip->width, decoder->max_width);
+    max_info.height = MAX (cip->height, decoder->max_height);
+    if (!gst_vaapi_context_reset (decoder->context, &max_info))
+      return FALSE;
+    if (!gst_vaapi_context_reset (decoder->context, cip))
+      return FALSE;
   } else {
     decoder->context = gst_vaapi_context_new (decoder->display, cip);
     if (!decoder->context)
       return FALSE;
+    clamp_max_resolution (decoder);
   }
+  gst_vaapi_context_set_num_extra_surfaces (decoder->context,
+      decoder->num_extra_surfaces);
   decoder->va_context = gst_vaapi_context_get_id (decoder->context);
   return TRUE;
 }
 
+/**
+ * gst_vaapi_decoder_set_num_extra_surfaces:
+ * @decoder: a #GstVaapiDecoder
+ * @num_surfaces: the number of decoded surfaces held downstream
+ *
+ * Sets the number of decoded surfaces that downstream holds at once,
+ * e.g. the minimum number of buffers of its pool. They are
+ * pre-allocated in the background along with the DPB, whose size is
+ * given by the bitstream, so that the first pictures do not stall on
+ * surface allocations.
+ */
+void
+gst_vaapi_decoder_set_num_extra_surfaces (GstVaapiDecoder * decoder,
+    guint num_surfaces)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->num_extra_surfaces = num_surfaces;
+  if (decoder->context)
+    gst_vaapi_context_set_num_extra_surfaces (decoder->context, num_surfaces);
+}
+
+/**
+ * gst_vaapi_decoder_set_max_resolution:
+ * @decoder: a #GstVaapiDecoder
+ * @max_width: the largest expected picture width, or 0
+ * @max_height: the largest expected picture height, or 0
+ *
+ * Allocates the surfaces of @decoder for pictures up to @max_width x
+ * @max_height, whatever the size of the current stream. A resolution
+ * change within that size, e.g. an adaptive streaming switch, then
+ * keeps the VA context and the surfaces instead of reallocating them:
+ * the smaller pictures are decoded in the top-left corner of the
+ * surfaces, and output with a crop rectangle.
+ *
+ * The size is lowered to the largest surfaces the driver supports
+ * for the stream, once its decoder configuration is known.
+ *
+ * This shall be called before the first picture is decoded.
+ */
+void
+gst_vaapi_decoder_set_max_resolution (GstVaapiDecoder * decoder,
+    guint max_width, guint max_height)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->max_width = max_width;
+  decoder->max_height = max_height;
+  if (decoder->context)
+    clamp_max_resolution (decoder);
+}
+
 void
 gst_vaapi_decoder_push_frame (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * frame)
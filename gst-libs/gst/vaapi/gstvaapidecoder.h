@@ -141,6 +141,14 @@ gst_vaapi_decoder_get_surface_attributes (GstVaapiDecoder * decoder,
     gint * min_width, gint * min_height, gint * max_width, gint * max_height,
     guint * mem_types);
 
+void
+gst_vaapi_decoder_set_max_resolution (GstVaapiDecoder * decoder,
+    guint max_width, guint max_height);
+
+void
+gst_vaapi_decoder_set_num_extra_surfaces (GstVaapiDecoder * decoder,
+    guint num_surfaces);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDecoder, gst_object_unref)
 
 G_END_DECLS
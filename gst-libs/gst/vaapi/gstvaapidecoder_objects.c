@@ -141,14 +141,26 @@ gst_vaapi_picture_create (GstVaapiPicture * picture,
       picture->crop_rect = parent_picture->crop_rect;
     }
   } else {
+    GstVaapiContext *const context = GET_CONTEXT (picture);
+
     picture->type = GST_VAAPI_PICTURE_TYPE_NONE;
     picture->pts = GST_CLOCK_TIME_NONE;
 
-    picture->proxy =
-        gst_vaapi_context_get_surface_proxy (GET_CONTEXT (picture));
+    picture->proxy = gst_vaapi_context_get_surface_proxy (context);
     if (!picture->proxy)
       return FALSE;
 
+    /* The surface may be larger than the picture in max-resolution
+       mode. Codecs with their own cropping override this */
+    if (context->surface_width > context->info.width
+        || context->surface_height > context->info.height) {
+      picture->has_crop_rect = TRUE;
+      picture->crop_rect.x = 0;
+      picture->crop_rect.y = 0;
+      picture->crop_rect.width = context->info.width;
+      picture->crop_rect.height = context->info.height;
+    }
+
     picture->structure = GST_VAAPI_PICTURE_STRUCTURE_FRAME;
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_FF);
   }
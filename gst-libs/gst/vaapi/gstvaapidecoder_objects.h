@@ -25,6 +25,7 @@
 #ifndef GST_VAAPI_DECODER_OBJECTS_H
 #define GST_VAAPI_DECODER_OBJECTS_H
 
+#include <gst/vaapi/gstvaapitypes.h>
 #include <gst/vaapi/gstvaapicodec_objects.h>
 
 G_BEGIN_DECLS
@@ -45,18 +46,6 @@ typedef struct _GstVaapiSlice           GstVaapiSlice;
 #define GST_VAAPI_IS_PICTURE(obj) \
   (GST_VAAPI_PICTURE (obj) != NULL)
 
-typedef enum
-{
-  GST_VAAPI_PICTURE_TYPE_NONE = 0,      // Undefined
-  GST_VAAPI_PICTURE_TYPE_I,             // Intra
-  GST_VAAPI_PICTURE_TYPE_P,             // Predicted
-  GST_VAAPI_PICTURE_TYPE_B,             // Bi-directional predicted
-  GST_VAAPI_PICTURE_TYPE_S,             // S(GMC)-VOP (MPEG-4)
-  GST_VAAPI_PICTURE_TYPE_SI,            // Switching Intra
-  GST_VAAPI_PICTURE_TYPE_SP,            // Switching Predicted
-  GST_VAAPI_PICTURE_TYPE_BI,            // BI type (VC-1)
-} GstVaapiPictureType;
-
 /**
  * GstVaapiPictureFlags:
  * @GST_VAAPI_PICTURE_FLAG_SKIPPED: skipped frame
@@ -193,6 +193,9 @@ struct _GstVaapiDecoder
   VADisplay va_display;
   GstVaapiContext *context;
   VAContextID va_context;
+  guint max_width;
+  guint max_height;
+  guint num_extra_surfaces;
   GstVaapiCodec codec;
   GstVideoCodecState *codec_state;
   GAsyncQueue *buffers;
@@ -33,6 +33,7 @@
 #include "gstvaapidisplay.h"
 #include "gstvaapitexturemap.h"
 #include "gstvaapidisplay_priv.h"
+#include "gstvaapivideopool_priv.h"
 #include "gstvaapiworkarounds.h"
 
 /* Debug category for all vaapi libs */
@@ -55,7 +56,10 @@ typedef struct _GstVaapiProfileConfig GstVaapiProfileConfig;
 struct _GstVaapiProfileConfig
 {
   GstVaapiProfile profile;
+  VAProfile va_profile;         /* VA profile to query entrypoints from */
   guint32 entrypoints;          /* bits map of GstVaapiEntrypoint */
+  guint32 entrypoints_mask;     /* entrypoints the profile may expose */
+  guint probed:1;
 };
 
 typedef struct _GstVaapiProperty GstVaapiProperty;
@@ -78,6 +82,12 @@ struct _GstVaapiFormatInfo
 
 #define ENTRY_POINT_FLAG(entry) (1U << G_PASTE(GST_VAAPI_ENTRYPOINT_, entry))
 
+#define DECODE_ENTRY_POINTS \
+  (ENTRY_POINT_FLAG (VLD) | ENTRY_POINT_FLAG (IDCT) | ENTRY_POINT_FLAG (MOCO))
+#define ENCODE_ENTRY_POINTS \
+  (ENTRY_POINT_FLAG (SLICE_ENCODE) | ENTRY_POINT_FLAG (PICTURE_ENCODE) | \
+   ENTRY_POINT_FLAG (SLICE_ENCODE_LP))
+
 enum
 {
   PROP_RENDER_MODE = 1,
@@ -105,6 +115,10 @@ get_color_balance (GstVaapiDisplay * display, guint prop_id, gfloat * v);
 static gboolean
 set_color_balance (GstVaapiDisplay * display, guint prop_id, gfloat v);
 
+static gboolean
+query_config_entrypoints (GstVaapiDisplay * display, VAProfile profile,
+    VAEntrypoint * entrypoints, gint * n_ptr);
+
 /* GstVaapiDisplayType enumerations */
 GType
 gst_vaapi_display_type_get_type (void)
@@ -260,29 +274,10 @@ compare_rgb_formats (gconstpointer a, gconstpointer b)
       (gint) gst_vaapi_video_format_get_score (fmt2));
 }
 
-/* Check if configs array contains profile at entrypoint */
-static inline gboolean
-find_config (GPtrArray * configs, GstVaapiProfile profile,
-    GstVaapiEntrypoint entrypoint)
-{
-  GstVaapiProfileConfig *config;
-  guint i;
-
-  if (!configs)
-    return FALSE;
-
-  for (i = 0; i < configs->len; i++) {
-    config = g_ptr_array_index (configs, i);
-    if (config->profile == profile
-        && (config->entrypoints & (1U << entrypoint)))
-      return TRUE;
-  }
-  return FALSE;
-}
-
-/* HACK: append H.263 Baseline profile if MPEG-4:2 Simple profile is supported */
+/* HACK: append H.263 Baseline profile if MPEG-4:2 Simple profile is
+ * supported. Its entrypoints are the VLD ones of the MPEG-4 profile */
 static void
-append_h263_config (GArray * configs, GPtrArray * decoders)
+append_h263_config (GArray * configs)
 {
   GstVaapiProfileConfig *config, tmp_config;
   GstVaapiProfileConfig *mpeg4_simple_config = NULL;
@@ -292,11 +287,8 @@ append_h263_config (GArray * configs, GPtrArray * decoders)
   if (!WORKAROUND_H263_BASELINE_DECODE_PROFILE)
     return;
 
-  if (!decoders)
-    return;
-
-  for (i = 0; i < decoders->len; i++) {
-    config = g_ptr_array_index (decoders, i);
+  for (i = 0; i < configs->len; i++) {
+    config = &g_array_index (configs, GstVaapiProfileConfig, i);
     if (config->profile == GST_VAAPI_PROFILE_MPEG4_SIMPLE)
       mpeg4_simple_config = config;
     else if (config->profile == GST_VAAPI_PROFILE_H263_BASELINE)
@@ -306,10 +298,8 @@ append_h263_config (GArray * configs, GPtrArray * decoders)
   if (mpeg4_simple_config && !h263_baseline_config) {
     tmp_config = *mpeg4_simple_config;
     tmp_config.profile = GST_VAAPI_PROFILE_H263_BASELINE;
-    tmp_config.entrypoints = ENTRY_POINT_FLAG (VLD);
+    tmp_config.entrypoints_mask = ENTRY_POINT_FLAG (VLD);
     g_array_append_val (configs, tmp_config);
-    g_ptr_array_add (decoders, &g_array_index (configs,
-            GstVaapiProfileConfig, configs->len - 1));
   }
 }
 
@@ -324,49 +314,103 @@ compare_profiles (gconstpointer a, gconstpointer b)
   return config1->profile - config2->profile;
 }
 
-/* Convert configs array to profiles as GstCaps */
+/* Query the entrypoints of the profile, the first time it is used */
+static void
+ensure_config_entrypoints (GstVaapiDisplay * display,
+    GstVaapiProfileConfig * config)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  VAEntrypoint *entrypoints;
+  gint i, num_entrypoints;
+
+  if (config->probed)
+    return;
+  config->probed = TRUE;
+
+  entrypoints = g_new (VAEntrypoint, vaMaxNumEntrypoints (priv->display));
+  if (query_config_entrypoints (display, config->va_profile, entrypoints,
+          &num_entrypoints)) {
+    for (i = 0; i < num_entrypoints; i++)
+      config->entrypoints |= (1U << gst_vaapi_entrypoint (entrypoints[i]));
+    config->entrypoints &= config->entrypoints_mask;
+  }
+  g_free (entrypoints);
+}
+
+/* Check if profile is supported at entrypoint, for the given usage */
+static gboolean
+find_config (GstVaapiDisplay * display, GstVaapiProfile profile,
+    GstVaapiEntrypoint entrypoint, guint32 usage_mask)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GstVaapiProfileConfig *config;
+  gboolean found = FALSE;
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  config = g_hash_table_lookup (priv->configs_map, GINT_TO_POINTER (profile));
+  if (config) {
+    ensure_config_entrypoints (display, config);
+    found = (config->entrypoints & usage_mask)
+        && (config->entrypoints & (1U << entrypoint));
+  }
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return found;
+}
+
+/* Convert configs array to profiles as GstCaps. Only the profiles of
+   the requested codec are probed */
 static GArray *
-get_profiles (GPtrArray * configs, GstVaapiCodec codec)
+get_profiles (GstVaapiDisplay * display, guint32 usage_mask,
+    GstVaapiCodec codec)
 {
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   GstVaapiProfileConfig *config;
   GArray *out_profiles;
   guint i;
 
-  if (!configs)
-    return NULL;
-
   out_profiles = g_array_new (FALSE, FALSE, sizeof (GstVaapiProfile));
   if (!out_profiles)
     return NULL;
 
-  for (i = 0; i < configs->len; i++) {
-    config = g_ptr_array_index (configs, i);
-    if (!codec || (codec == gst_vaapi_profile_get_codec (config->profile)))
+  GST_VAAPI_DISPLAY_LOCK (display);
+  for (i = 0; i < priv->configs->len; i++) {
+    config = &g_array_index (priv->configs, GstVaapiProfileConfig, i);
+    if (codec && (codec != gst_vaapi_profile_get_codec (config->profile)))
+      continue;
+    ensure_config_entrypoints (display, config);
+    if (config->entrypoints & usage_mask)
       g_array_append_val (out_profiles, config->profile);
   }
+  GST_VAAPI_DISPLAY_UNLOCK (display);
   return out_profiles;
 }
 
-/* Find format info */
-static const GstVaapiFormatInfo *
-find_format_info (GArray * formats, GstVideoFormat format)
+/* Fill the format -> format info map. The first entry wins, as the
+   formats are sorted by preference */
+static void
+fill_formats_map (GHashTable * formats_map, GArray * formats)
 {
-  const GstVaapiFormatInfo *fip;
+  GstVaapiFormatInfo *fip;
   guint i;
 
-  for (i = 0; i < formats->len; i++) {
-    fip = &g_array_index (formats, GstVaapiFormatInfo, i);
-    if (fip->format == format)
-      return fip;
+  for (i = formats->len; i > 0; i--) {
+    fip = &g_array_index (formats, GstVaapiFormatInfo, i - 1);
+    g_hash_table_insert (formats_map, GINT_TO_POINTER (fip->format), fip);
   }
-  return NULL;
 }
 
-/* Check if formats array contains format */
+/* Find format info */
+static inline const GstVaapiFormatInfo *
+find_format_info (GHashTable * formats_map, GstVideoFormat format)
+{
+  return g_hash_table_lookup (formats_map, GINT_TO_POINTER (format));
+}
+
+/* Check if formats map contains format */
 static inline gboolean
-find_format (GArray * formats, GstVideoFormat format)
+find_format (GHashTable * formats_map, GstVideoFormat format)
 {
-  return find_format_info (formats, format) != NULL;
+  return find_format_info (formats_map, format) != NULL;
 }
 
 /* Convert formats array to GstCaps */
@@ -457,15 +501,167 @@ find_property_id (const gchar * name)
   return 0;
 }
 
-/* Initialize VA profiles (decoders, encoders) */
+/* Number of integers caching one VAImageFormat */
+#define IMAGE_FORMAT_N_VALUES 8
+
+static void
+image_format_to_values (const VAImageFormat * format, gint * values)
+{
+  values[0] = format->fourcc;
+  values[1] = format->byte_order;
+  values[2] = format->bits_per_pixel;
+  values[3] = format->depth;
+  values[4] = format->red_mask;
+  values[5] = format->green_mask;
+  values[6] = format->blue_mask;
+  values[7] = format->alpha_mask;
+}
+
+static void
+image_format_from_values (VAImageFormat * format, const gint * values)
+{
+  memset (format, 0, sizeof (*format));
+  format->fourcc = values[0];
+  format->byte_order = values[1];
+  format->bits_per_pixel = values[2];
+  format->depth = values[3];
+  format->red_mask = values[4];
+  format->green_mask = values[5];
+  format->blue_mask = values[6];
+  format->alpha_mask = values[7];
+}
+
+/* The query_*() helpers below answer from the capability cache when
+ * possible, and record the live answers into it otherwise */
+
+static gboolean
+query_config_profiles (GstVaapiDisplay * display, VAProfile * profiles,
+    gint * n_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const gint max_profiles = vaMaxNumProfiles (priv->display);
+  VAStatus status;
+  gint *values;
+  gsize i, n;
+
+  if (gst_vaapi_caps_cache_lookup (priv->caps_cache, "profiles", "all",
+          &values, &n)) {
+    n = MIN (n, max_profiles);
+    for (i = 0; i < n; i++)
+      profiles[i] = values[i];
+    g_free (values);
+    *n_ptr = n;
+    return TRUE;
+  }
+
+  status = vaQueryConfigProfiles (priv->display, profiles, n_ptr);
+  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+    return FALSE;
+
+  values = g_new (gint, *n_ptr);
+  for (i = 0; i < *n_ptr; i++)
+    values[i] = profiles[i];
+  gst_vaapi_caps_cache_store (priv->caps_cache, "profiles", "all", values,
+      *n_ptr);
+  g_free (values);
+  return TRUE;
+}
+
+static gboolean
+query_config_entrypoints (GstVaapiDisplay * display, VAProfile profile,
+    VAEntrypoint * entrypoints, gint * n_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const gint max_entrypoints = vaMaxNumEntrypoints (priv->display);
+  VAStatus status;
+  gchar key[16];
+  gint *values;
+  gsize i, n;
+
+  g_snprintf (key, sizeof (key), "%d", profile);
+  if (gst_vaapi_caps_cache_lookup (priv->caps_cache, "entrypoints", key,
+          &values, &n)) {
+    n = MIN (n, max_entrypoints);
+    for (i = 0; i < n; i++)
+      entrypoints[i] = values[i];
+    g_free (values);
+    *n_ptr = n;
+    return TRUE;
+  }
+
+  status = vaQueryConfigEntrypoints (priv->display, profile, entrypoints,
+      n_ptr);
+  if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+    return FALSE;
+
+  values = g_new (gint, *n_ptr);
+  for (i = 0; i < *n_ptr; i++)
+    values[i] = entrypoints[i];
+  gst_vaapi_caps_cache_store (priv->caps_cache, "entrypoints", key, values,
+      *n_ptr);
+  g_free (values);
+  return TRUE;
+}
+
+/* @flags may be NULL for image formats */
+static gboolean
+query_formats (GstVaapiDisplay * display, const gchar * key,
+    VAImageFormat * formats, guint * flags, gint max_formats, gint * n_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const gsize stride = IMAGE_FORMAT_N_VALUES + (flags ? 1 : 0);
+  VAStatus status;
+  gint *values;
+  gsize i, n;
+
+  if (gst_vaapi_caps_cache_lookup (priv->caps_cache, "formats", key,
+          &values, &n)) {
+    n = MIN (n / stride, max_formats);
+    for (i = 0; i < n; i++) {
+      image_format_from_values (&formats[i], &values[i * stride]);
+      if (flags)
+        flags[i] = values[i * stride + IMAGE_FORMAT_N_VALUES];
+    }
+    g_free (values);
+    *n_ptr = n;
+    return TRUE;
+  }
+
+  if (flags) {
+    guint num_formats = 0;
+
+    status = vaQuerySubpictureFormats (priv->display, formats, flags,
+        &num_formats);
+    if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
+      return FALSE;
+    *n_ptr = num_formats;
+  } else {
+    status = vaQueryImageFormats (priv->display, formats, n_ptr);
+    if (!vaapi_check_status (status, "vaQueryImageFormats()"))
+      return FALSE;
+  }
+
+  values = g_new (gint, *n_ptr * stride);
+  for (i = 0; i < *n_ptr; i++) {
+    image_format_to_values (&formats[i], &values[i * stride]);
+    if (flags)
+      values[i * stride + IMAGE_FORMAT_N_VALUES] = flags[i];
+  }
+  gst_vaapi_caps_cache_store (priv->caps_cache, "formats", key, values,
+      *n_ptr * stride);
+  g_free (values);
+  return TRUE;
+}
+
+/* Initialize the list of VA profiles. Their entrypoints are only
+   queried when a profile is looked up */
 static gboolean
 ensure_profiles (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GstVaapiProfileConfig *config;
   VAProfile *profiles = NULL;
-  VAEntrypoint *entrypoints = NULL;
-  gint i, j, n, num_entrypoints;
-  VAStatus status;
+  gint i, n;
   gboolean success = FALSE;
 
   GST_VAAPI_DISPLAY_LOCK (display);
@@ -475,15 +671,11 @@ ensure_profiles (GstVaapiDisplay * display)
     return TRUE;
   }
 
-  priv->codecs = g_array_new (FALSE, FALSE, sizeof (GstVaapiProfileConfig));
-  if (!priv->codecs)
-    goto cleanup;
-
-  priv->decoders = g_ptr_array_new ();
-  if (!priv->decoders)
+  priv->configs = g_array_new (FALSE, FALSE, sizeof (GstVaapiProfileConfig));
+  if (!priv->configs)
     goto cleanup;
-  priv->encoders = g_ptr_array_new ();
-  if (!priv->encoders)
+  priv->configs_map = g_hash_table_new (NULL, NULL);
+  if (!priv->configs_map)
     goto cleanup;
   priv->has_profiles = TRUE;
 
@@ -491,13 +683,9 @@ ensure_profiles (GstVaapiDisplay * display)
   profiles = g_new (VAProfile, vaMaxNumProfiles (priv->display));
   if (!profiles)
     goto cleanup;
-  entrypoints = g_new (VAEntrypoint, vaMaxNumEntrypoints (priv->display));
-  if (!entrypoints)
-    goto cleanup;
 
   n = 0;
-  status = vaQueryConfigProfiles (priv->display, profiles, &n);
-  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+  if (!query_config_profiles (display, profiles, &n))
     goto cleanup;
 
   GST_DEBUG ("%d profiles", n);
@@ -508,59 +696,59 @@ ensure_profiles (GstVaapiDisplay * display)
   }
 
   for (i = 0; i < n; i++) {
-    GstVaapiProfileConfig config = { 0, };
-
-    config.profile = gst_vaapi_profile (profiles[i]);
-    if (!config.profile)
-      continue;
+    GstVaapiProfileConfig tmp_config = { 0, };
 
-    status = vaQueryConfigEntrypoints (priv->display,
-        profiles[i], entrypoints, &num_entrypoints);
-    if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+    tmp_config.profile = gst_vaapi_profile (profiles[i]);
+    if (!tmp_config.profile)
       continue;
-
-    for (j = 0; j < num_entrypoints; j++)
-      config.entrypoints |= (1U << gst_vaapi_entrypoint (entrypoints[j]));
-
-    priv->codecs = g_array_append_val (priv->codecs, config);
+    tmp_config.va_profile = profiles[i];
+    tmp_config.entrypoints_mask = DECODE_ENTRY_POINTS | ENCODE_ENTRY_POINTS;
+    g_array_append_val (priv->configs, tmp_config);
   }
 
-  for (i = 0; i < priv->codecs->len; i++) {
-    GstVaapiProfileConfig *cfg;
-
-    cfg = &g_array_index (priv->codecs, GstVaapiProfileConfig, i);
+  append_h263_config (priv->configs);
+  g_array_sort (priv->configs, compare_profiles);
 
-    if ((cfg->entrypoints & ENTRY_POINT_FLAG (VLD))
-        || (cfg->entrypoints & ENTRY_POINT_FLAG (IDCT))
-        || (cfg->entrypoints & ENTRY_POINT_FLAG (MOCO)))
-      g_ptr_array_add (priv->decoders, cfg);
-    if ((cfg->entrypoints & ENTRY_POINT_FLAG (SLICE_ENCODE))
-        || (cfg->entrypoints & ENTRY_POINT_FLAG (PICTURE_ENCODE))
-        || (cfg->entrypoints & ENTRY_POINT_FLAG (SLICE_ENCODE_LP)))
-      g_ptr_array_add (priv->encoders, cfg);
+  /* The array does not grow anymore, its elements can be referenced */
+  for (i = 0; i < priv->configs->len; i++) {
+    config = &g_array_index (priv->configs, GstVaapiProfileConfig, i);
+    g_hash_table_insert (priv->configs_map, GINT_TO_POINTER (config->profile),
+        config);
   }
+  success = TRUE;
 
-  append_h263_config (priv->codecs, priv->decoders);
+cleanup:
+  g_free (profiles);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return success;
+}
 
-  g_ptr_array_sort (priv->decoders, compare_profiles);
-  g_ptr_array_sort (priv->encoders, compare_profiles);
+/* Initialize video processing support */
+static gboolean
+ensure_vpp (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  VAEntrypoint *entrypoints;
+  gint i, num_entrypoints;
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  if (priv->has_vpp_probed)
+    goto done;
+  priv->has_vpp_probed = TRUE;
 
-  /* Video processing API */
-  status = vaQueryConfigEntrypoints (priv->display, VAProfileNone,
-      entrypoints, &num_entrypoints);
-  if (vaapi_check_status (status, "vaQueryEntrypoints() [VAProfileNone]")) {
-    for (j = 0; j < num_entrypoints; j++) {
-      if (entrypoints[j] == VAEntrypointVideoProc)
+  entrypoints = g_new (VAEntrypoint, vaMaxNumEntrypoints (priv->display));
+  if (query_config_entrypoints (display, VAProfileNone, entrypoints,
+          &num_entrypoints)) {
+    for (i = 0; i < num_entrypoints; i++) {
+      if (entrypoints[i] == VAEntrypointVideoProc)
         priv->has_vpp = TRUE;
     }
   }
-  success = TRUE;
-
-cleanup:
-  g_free (profiles);
   g_free (entrypoints);
+
+done:
   GST_VAAPI_DISPLAY_UNLOCK (display);
-  return success;
+  return TRUE;
 }
 
 /* Initialize VA display attributes */
@@ -652,7 +840,6 @@ ensure_image_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
-  VAStatus status;
   gint i, n, max_images;
   gboolean success = FALSE;
 
@@ -665,6 +852,9 @@ ensure_image_formats (GstVaapiDisplay * display)
   priv->image_formats = g_array_new (FALSE, FALSE, sizeof (GstVaapiFormatInfo));
   if (!priv->image_formats)
     goto cleanup;
+  priv->image_formats_map = g_hash_table_new (NULL, NULL);
+  if (!priv->image_formats_map)
+    goto cleanup;
 
   /* VA image formats */
   max_images = vaMaxNumImageFormats (priv->display);
@@ -673,8 +863,7 @@ ensure_image_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryImageFormats (priv->display, formats, &n);
-  if (!vaapi_check_status (status, "vaQueryImageFormats()"))
+  if (!query_formats (display, "image", formats, NULL, max_images, &n))
     goto cleanup;
 
   /* XXX(victor): Force RGBA in i965 display formats.
@@ -711,6 +900,7 @@ ensure_image_formats (GstVaapiDisplay * display)
 
   append_formats (priv->image_formats, formats, NULL, n);
   g_array_sort (priv->image_formats, compare_yuv_formats);
+  fill_formats_map (priv->image_formats_map, priv->image_formats);
   success = TRUE;
 
 cleanup:
@@ -726,8 +916,8 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
   unsigned int *flags = NULL;
-  VAStatus status;
   guint i, n;
+  gint num_formats;
   gboolean success = FALSE;
 
   GST_VAAPI_DISPLAY_LOCK (display);
@@ -740,6 +930,9 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
       g_array_new (FALSE, FALSE, sizeof (GstVaapiFormatInfo));
   if (!priv->subpicture_formats)
     goto cleanup;
+  priv->subpicture_formats_map = g_hash_table_new (NULL, NULL);
+  if (!priv->subpicture_formats_map)
+    goto cleanup;
 
   /* VA subpicture formats */
   n = vaMaxNumSubpictureFormats (priv->display);
@@ -750,10 +943,9 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   if (!flags)
     goto cleanup;
 
-  n = 0;
-  status = vaQuerySubpictureFormats (priv->display, formats, flags, &n);
-  if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
+  if (!query_formats (display, "subpicture", formats, flags, n, &num_formats))
     goto cleanup;
+  n = num_formats;
 
   GST_DEBUG ("%d subpicture formats", n);
   for (i = 0; i < n; i++) {
@@ -763,6 +955,7 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
 
   append_formats (priv->subpicture_formats, formats, flags, n);
   g_array_sort (priv->subpicture_formats, compare_rgb_formats);
+  fill_formats_map (priv->subpicture_formats_map, priv->subpicture_formats);
   success = TRUE;
 
 cleanup:
@@ -902,12 +1095,14 @@ gst_vaapi_display_destroy (GstVaapiDisplay * display)
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   GstVaapiDisplayClass *klass = GST_VAAPI_DISPLAY_GET_CLASS (display);
 
-  g_clear_pointer (&priv->decoders, g_ptr_array_unref);
-  g_clear_pointer (&priv->encoders, g_ptr_array_unref);
-  g_clear_pointer (&priv->codecs, g_array_unref);
+  g_clear_pointer (&priv->configs_map, g_hash_table_unref);
+  g_clear_pointer (&priv->configs, g_array_unref);
+  g_clear_pointer (&priv->image_formats_map, g_hash_table_unref);
   g_clear_pointer (&priv->image_formats, g_array_unref);
+  g_clear_pointer (&priv->subpicture_formats_map, g_hash_table_unref);
   g_clear_pointer (&priv->subpicture_formats, g_array_unref);
   g_clear_pointer (&priv->properties, g_array_unref);
+  g_clear_pointer (&priv->caps_cache, gst_vaapi_caps_cache_free);
 
   if (priv->display) {
     if (!priv->parent)
@@ -969,14 +1164,44 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
     return FALSE;
 
   if (!priv->parent) {
-    if (!vaapi_initialize (priv->display))
+    if (!vaapi_initialize (priv->display, &priv->va_major_version,
+            &priv->va_minor_version))
       return FALSE;
+  } else {
+    GstVaapiDisplayPrivate *const parent_priv =
+        GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+
+    priv->va_major_version = parent_priv->va_major_version;
+    priv->va_minor_version = parent_priv->va_minor_version;
   }
 
+  /* libva is thread-safe, but Xlib based backends share the native
+     connection with the application and need the display lock for
+     every VA call. GST_VAAPI_DISPLAY_SERIALIZE forces it everywhere */
+  if (priv->parent) {
+    priv->va_thread_safe =
+        GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA (priv->parent);
+  } else {
+    priv->va_thread_safe = !klass->serialize_va
+        && !g_getenv ("GST_VAAPI_DISPLAY_SERIALIZE");
+  }
+  GST_INFO_OBJECT (display, "VA calls %s the display lock",
+      priv->va_thread_safe ? "skip" : "take");
+
   GST_INFO_OBJECT (display, "new display addr=%p", display);
   g_free (priv->display_name);
   priv->display_name = g_strdup (info.display_name);
 
+  /* Without a name, the device the driver runs on is unknown */
+  if (priv->display_name && ensure_vendor_string (display)) {
+    gchar *va_version = g_strdup_printf ("%d.%d", priv->va_major_version,
+        priv->va_minor_version);
+
+    priv->caps_cache = gst_vaapi_caps_cache_new (priv->display_name,
+        priv->vendor_string, va_version);
+    g_free (va_version);
+  }
+
   set_driver_quirks (display);
 
   if (!ensure_image_formats (display)) {
@@ -1012,12 +1237,20 @@ gst_vaapi_display_init (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv =
       gst_vaapi_display_get_instance_private (display);
+  const gchar *budget;
 
   display->priv = priv;
   priv->par_n = 1;
   priv->par_d = 1;
 
   g_rec_mutex_init (&priv->mutex);
+  g_mutex_init (&priv->memory_lock);
+  g_cond_init (&priv->memory_cond);
+
+  /* in MiB */
+  budget = g_getenv ("GST_VAAPI_MEMORY_BUDGET");
+  if (budget)
+    priv->memory_budget = g_ascii_strtoull (budget, NULL, 10) << 20;
 }
 
 static gboolean
@@ -1144,6 +1377,9 @@ gst_vaapi_display_finalize (GObject * object)
 
   gst_vaapi_display_destroy (display);
   g_rec_mutex_clear (&priv->mutex);
+  g_mutex_clear (&priv->memory_lock);
+  g_cond_clear (&priv->memory_cond);
+  g_list_free (priv->video_pools);
 
   G_OBJECT_CLASS (gst_vaapi_display_parent_class)->finalize (object);
 }
@@ -1546,7 +1782,7 @@ gst_vaapi_display_has_video_processing (GstVaapiDisplay * display)
 {
   g_return_val_if_fail (display != NULL, FALSE);
 
-  if (!ensure_profiles (display))
+  if (!ensure_vpp (display))
     return FALSE;
   return GST_VAAPI_DISPLAY_GET_PRIVATE (display)->has_vpp;
 }
@@ -1569,7 +1805,7 @@ gst_vaapi_display_get_decode_profiles (GstVaapiDisplay * display)
 
   if (!ensure_profiles (display))
     return NULL;
-  return get_profiles (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->decoders, 0);
+  return get_profiles (display, DECODE_ENTRY_POINTS, 0);
 }
 
 /**
@@ -1591,8 +1827,7 @@ gst_vaapi_display_has_decoder (GstVaapiDisplay * display,
 
   if (!ensure_profiles (display))
     return FALSE;
-  return find_config (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->decoders,
-      profile, entrypoint);
+  return find_config (display, profile, entrypoint, DECODE_ENTRY_POINTS);
 }
 
 /**
@@ -1613,7 +1848,7 @@ gst_vaapi_display_get_encode_profiles (GstVaapiDisplay * display)
 
   if (!ensure_profiles (display))
     return NULL;
-  return get_profiles (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->encoders, 0);
+  return get_profiles (display, ENCODE_ENTRY_POINTS, 0);
 }
 
 /**
@@ -1637,8 +1872,7 @@ gst_vaapi_display_get_encode_profiles_by_codec (GstVaapiDisplay * display,
 
   if (!ensure_profiles (display))
     return NULL;
-  return get_profiles (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->encoders,
-      codec);
+  return get_profiles (display, ENCODE_ENTRY_POINTS, codec);
 }
 
 /**
@@ -1660,8 +1894,7 @@ gst_vaapi_display_has_encoder (GstVaapiDisplay * display,
 
   if (!ensure_profiles (display))
     return FALSE;
-  return find_config (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->encoders,
-      profile, entrypoint);
+  return find_config (display, profile, entrypoint, ENCODE_ENTRY_POINTS);
 }
 
 /**
@@ -1717,7 +1950,7 @@ gst_vaapi_display_has_image_format (GstVaapiDisplay * display,
 
   if (!ensure_image_formats (display))
     return FALSE;
-  if (find_format (priv->image_formats, format))
+  if (find_format (priv->image_formats_map, format))
     return TRUE;
 
   /* XXX: try subpicture formats since some drivers could report a
@@ -1726,7 +1959,7 @@ gst_vaapi_display_has_image_format (GstVaapiDisplay * display,
    */
   if (!ensure_subpicture_formats (display))
     return FALSE;
-  return find_format (priv->subpicture_formats, format);
+  return find_format (priv->subpicture_formats_map, format);
 }
 
 /**
@@ -1784,7 +2017,7 @@ gst_vaapi_display_has_subpicture_format (GstVaapiDisplay * display,
   if (!ensure_subpicture_formats (display))
     return FALSE;
 
-  fip = find_format_info (priv->subpicture_formats, format);
+  fip = find_format_info (priv->subpicture_formats_map, format);
   if (!fip)
     return FALSE;
 
@@ -2169,3 +2402,359 @@ gst_vaapi_display_has_driver_quirks (GstVaapiDisplay * display, guint quirks)
 
   return (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->driver_quirks & quirks);
 }
+
+/* ------------------------------------------------------------------------- */
+/* --- Memory accounting                                                  --- */
+/* ------------------------------------------------------------------------- */
+
+G_DEFINE_QUARK (gst-vaapi-display-error-quark, gst_vaapi_display_error);
+
+/* The error of the last allocation that failed in this thread */
+static GPrivate allocation_error =
+G_PRIVATE_INIT ((GDestroyNotify) g_error_free);
+
+/* Child displays share the VA display, and so the memory, of their
+   parent */
+static GstVaapiDisplayPrivate *
+get_memory_private (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  return priv;
+}
+
+static inline gboolean
+memory_fits (GstVaapiDisplayPrivate * priv, guint64 size)
+{
+  return priv->memory_budget == 0
+      || priv->memory_usage + size <= priv->memory_budget;
+}
+
+/* Takes the spare objects of all the video pools, beyond their
+   reserved size. They are to be released without the memory lock */
+static GList *
+trim_video_pools (GstVaapiDisplayPrivate * priv)
+{
+  GList *l, *objects = NULL;
+
+  for (l = priv->video_pools; l; l = l->next)
+    objects = g_list_concat (gst_vaapi_video_pool_trim (l->data), objects);
+  return objects;
+}
+
+/**
+ * gst_vaapi_display_reserve_memory:
+ * @display: a #GstVaapiDisplay
+ * @size: the memory of the VA object about to be allocated, in bytes
+ *
+ * Accounts for @size more bytes of VA memory on @display. If this
+ * would exceed the memory budget, the idle video pools are trimmed
+ * first. If it still would, nothing is accounted and the error is
+ * left for gst_vaapi_display_take_allocation_error(). Any error left
+ * by a previous call in the calling thread is cleared first.
+ *
+ * Return value: %TRUE if the allocation fits in the budget
+ */
+gboolean
+gst_vaapi_display_reserve_memory (GstVaapiDisplay * display, guint64 size)
+{
+  GstVaapiDisplayPrivate *const priv = get_memory_private (display);
+  GList *objects;
+  guint64 usage, budget;
+  gboolean success;
+
+  /* a new allocation attempt: drop the error of the previous one */
+  g_private_replace (&allocation_error, NULL);
+
+  g_mutex_lock (&priv->memory_lock);
+  success = memory_fits (priv, size);
+  if (!success) {
+    objects = trim_video_pools (priv);
+    if (objects) {
+      g_mutex_unlock (&priv->memory_lock);
+      GST_DEBUG_OBJECT (display, "trimming %u spare objects",
+          g_list_length (objects));
+      g_list_free_full (objects, (GDestroyNotify) gst_mini_object_unref);
+      g_mutex_lock (&priv->memory_lock);
+      success = memory_fits (priv, size);
+    }
+  }
+  if (success)
+    priv->memory_usage += size;
+  usage = priv->memory_usage;
+  budget = priv->memory_budget;
+  g_mutex_unlock (&priv->memory_lock);
+
+  if (!success) {
+    GST_WARNING_OBJECT (display, "allocation of %" G_GUINT64_FORMAT
+        " bytes exceeds the memory budget (%" G_GUINT64_FORMAT " of %"
+        G_GUINT64_FORMAT " bytes in use)", size, usage, budget);
+    g_private_replace (&allocation_error,
+        g_error_new (GST_VAAPI_DISPLAY_ERROR,
+            GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED,
+            "allocation of %" G_GUINT64_FORMAT " bytes exceeds the memory "
+            "budget (%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+            " bytes in use)", size, usage, budget));
+  }
+  return success;
+}
+
+/**
+ * gst_vaapi_display_release_memory:
+ * @display: a #GstVaapiDisplay
+ * @size: the memory of the VA object just destroyed, in bytes
+ *
+ * Accounts for @size less bytes of VA memory on @display, and wakes
+ * up gst_vaapi_display_wait_for_memory().
+ */
+void
+gst_vaapi_display_release_memory (GstVaapiDisplay * display, guint64 size)
+{
+  GstVaapiDisplayPrivate *const priv = get_memory_private (display);
+
+  g_mutex_lock (&priv->memory_lock);
+  priv->memory_usage -= MIN (size, priv->memory_usage);
+  g_cond_broadcast (&priv->memory_cond);
+  g_mutex_unlock (&priv->memory_lock);
+}
+
+/**
+ * gst_vaapi_display_add_video_pool:
+ * @display: a #GstVaapiDisplay
+ * @pool: a #GstVaapiVideoPool
+ *
+ * Registers @pool to be trimmed when the memory budget of @display
+ * is exceeded. The @pool is not referenced, it shall be removed with
+ * gst_vaapi_display_remove_video_pool() before it is destroyed.
+ */
+void
+gst_vaapi_display_add_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool)
+{
+  GstVaapiDisplayPrivate *const priv = get_memory_private (display);
+
+  g_mutex_lock (&priv->memory_lock);
+  priv->video_pools = g_list_prepend (priv->video_pools, pool);
+  g_mutex_unlock (&priv->memory_lock);
+}
+
+/**
+ * gst_vaapi_display_remove_video_pool:
+ * @display: a #GstVaapiDisplay
+ * @pool: a #GstVaapiVideoPool
+ *
+ * Unregisters @pool, added with gst_vaapi_display_add_video_pool().
+ */
+void
+gst_vaapi_display_remove_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool)
+{
+  GstVaapiDisplayPrivate *const priv = get_memory_private (display);
+
+  g_mutex_lock (&priv->memory_lock);
+  priv->video_pools = g_list_remove (priv->video_pools, pool);
+  g_mutex_unlock (&priv->memory_lock);
+}
+
+/* Takes a reference to @pool, unless it is already being finalized */
+static gboolean
+video_pool_try_ref (GstVaapiVideoPool * pool)
+{
+  GstVaapiMiniObject *const object = GST_VAAPI_MINI_OBJECT (pool);
+  gint ref_count;
+
+  do {
+    ref_count = g_atomic_int_get (&object->ref_count);
+    if (ref_count == 0)
+      return FALSE;
+  } while (!g_atomic_int_compare_and_exchange (&object->ref_count, ref_count,
+          ref_count + 1));
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_display_share_video_pool:
+ * @display: a #GstVaapiDisplay
+ * @pool: a #GstVaapiVideoPool, with no objects yet
+ * @match: a function telling whether two pools allocate the same objects
+ *
+ * Looks for a shared video pool of @display that @match considers
+ * equal to @pool. If there is none, @pool becomes the one shared
+ * with the next callers, until it is destroyed.
+ *
+ * Return value: (transfer full): the shared #GstVaapiVideoPool
+ */
+GstVaapiVideoPool *
+gst_vaapi_display_share_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool, GEqualFunc match)
+{
+  GstVaapiDisplayPrivate *const priv = get_memory_private (display);
+  GstVaapiVideoPool *shared_pool = NULL;
+  GList *l;
+
+  g_mutex_lock (&priv->memory_lock);
+  for (l = priv->video_pools; l; l = l->next) {
+    GstVaapiVideoPool *const candidate = l->data;
+
+    if (candidate->shared && match (candidate, pool)
+        && video_pool_try_ref (candidate)) {
+      shared_pool = candidate;
+      break;
+    }
+  }
+  if (!shared_pool) {
+    pool->shared = TRUE;
+    shared_pool = gst_vaapi_video_pool_ref (pool);
+  }
+  g_mutex_unlock (&priv->memory_lock);
+
+  GST_DEBUG_OBJECT (display, "%s shared video pool %p",
+      shared_pool == pool ? "new" : "reusing", shared_pool);
+  return shared_pool;
+}
+
+/**
+ * gst_vaapi_display_get_memory_budget:
+ * @display: a #GstVaapiDisplay
+ *
+ * Returns the maximum memory of the VA surfaces, images and coded
+ * buffers allocated on @display. It defaults to the value of the
+ * GST_VAAPI_MEMORY_BUDGET environment variable, in MiB.
+ *
+ * This function is thread safe.
+ *
+ * Return value: the memory budget in bytes, or 0 if there is none
+ */
+guint64
+gst_vaapi_display_get_memory_budget (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+  guint64 budget;
+
+  g_return_val_if_fail (display != NULL, 0);
+
+  priv = get_memory_private (display);
+  g_mutex_lock (&priv->memory_lock);
+  budget = priv->memory_budget;
+  g_mutex_unlock (&priv->memory_lock);
+  return budget;
+}
+
+/**
+ * gst_vaapi_display_set_memory_budget:
+ * @display: a #GstVaapiDisplay
+ * @budget: the memory budget in bytes, or 0 for none
+ *
+ * Sets the maximum memory of the VA surfaces, images and coded
+ * buffers allocated on @display. Once reached, the spare objects of
+ * the video pools are released to make room for new allocations, and
+ * the allocations that still do not fit fail with
+ * %GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED.
+ *
+ * This function is thread safe.
+ */
+void
+gst_vaapi_display_set_memory_budget (GstVaapiDisplay * display,
+    guint64 budget)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_if_fail (display != NULL);
+
+  priv = get_memory_private (display);
+  g_mutex_lock (&priv->memory_lock);
+  priv->memory_budget = budget;
+  g_cond_broadcast (&priv->memory_cond);
+  g_mutex_unlock (&priv->memory_lock);
+}
+
+/**
+ * gst_vaapi_display_get_memory_usage:
+ * @display: a #GstVaapiDisplay
+ *
+ * Returns the estimated memory of the VA surfaces, images and coded
+ * buffers currently allocated on @display.
+ *
+ * This function is thread safe.
+ *
+ * Return value: the memory usage in bytes
+ */
+guint64
+gst_vaapi_display_get_memory_usage (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+  guint64 usage;
+
+  g_return_val_if_fail (display != NULL, 0);
+
+  priv = get_memory_private (display);
+  g_mutex_lock (&priv->memory_lock);
+  usage = priv->memory_usage;
+  g_mutex_unlock (&priv->memory_lock);
+  return usage;
+}
+
+/**
+ * gst_vaapi_display_wait_for_memory:
+ * @display: a #GstVaapiDisplay
+ * @size: the memory needed, in bytes
+ * @timeout: the maximum time to wait, or %GST_CLOCK_TIME_NONE
+ *
+ * Waits until @size bytes fit in the memory budget of @display. This
+ * is meant to turn %GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED into
+ * backpressure, until other users of @display release their objects.
+ *
+ * This function is thread safe.
+ *
+ * Return value: %TRUE if @size bytes fit in the budget, %FALSE if
+ *   @timeout expired
+ */
+gboolean
+gst_vaapi_display_wait_for_memory (GstVaapiDisplay * display, guint64 size,
+    GstClockTime timeout)
+{
+  GstVaapiDisplayPrivate *priv;
+  gint64 end_time = 0;
+  gboolean success;
+
+  g_return_val_if_fail (display != NULL, FALSE);
+
+  if (GST_CLOCK_TIME_IS_VALID (timeout))
+    end_time = g_get_monotonic_time () + GST_TIME_AS_USECONDS (timeout);
+
+  priv = get_memory_private (display);
+  g_mutex_lock (&priv->memory_lock);
+  while (!(success = memory_fits (priv, size))) {
+    if (!GST_CLOCK_TIME_IS_VALID (timeout))
+      g_cond_wait (&priv->memory_cond, &priv->memory_lock);
+    else if (!g_cond_wait_until (&priv->memory_cond, &priv->memory_lock,
+            end_time))
+      break;
+  }
+  g_mutex_unlock (&priv->memory_lock);
+  return success;
+}
+
+/**
+ * gst_vaapi_display_take_allocation_error:
+ *
+ * Allocation functions, such as gst_vaapi_surface_new(), return
+ * %NULL on error. This returns the reason of the last one in the
+ * calling thread, if it failed because of the memory budget, and
+ * clears it. The reason is reset at the start of each allocation, so
+ * a stale error is never returned for a later allocation that failed
+ * for another reason.
+ *
+ * Return value: (transfer full): a #GError in the
+ *   %GST_VAAPI_DISPLAY_ERROR domain, or %NULL
+ */
+GError *
+gst_vaapi_display_take_allocation_error (void)
+{
+  GError *const error = g_private_get (&allocation_error);
+
+  g_private_set (&allocation_error, NULL);
+  return error;
+}
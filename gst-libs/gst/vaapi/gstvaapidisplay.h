@@ -294,6 +294,46 @@ gst_vaapi_display_reset_texture_map (GstVaapiDisplay * display);
 gboolean
 gst_vaapi_display_has_driver_quirks (GstVaapiDisplay * display, guint quirks);
 
+/**
+ * GST_VAAPI_DISPLAY_ERROR:
+ *
+ * Error domain for the allocations of VA objects on a #GstVaapiDisplay.
+ */
+#define GST_VAAPI_DISPLAY_ERROR (gst_vaapi_display_error_quark ())
+
+/**
+ * GstVaapiDisplayError:
+ * @GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED: the allocation would
+ *   exceed the memory budget of the display, even after trimming the
+ *   idle video pools
+ *
+ * Errors of the allocations of VA objects.
+ */
+typedef enum
+{
+  GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED,
+} GstVaapiDisplayError;
+
+GQuark
+gst_vaapi_display_error_quark (void);
+
+guint64
+gst_vaapi_display_get_memory_budget (GstVaapiDisplay * display);
+
+void
+gst_vaapi_display_set_memory_budget (GstVaapiDisplay * display,
+    guint64 budget);
+
+guint64
+gst_vaapi_display_get_memory_usage (GstVaapiDisplay * display);
+
+gboolean
+gst_vaapi_display_wait_for_memory (GstVaapiDisplay * display, guint64 size,
+    GstClockTime timeout);
+
+GError *
+gst_vaapi_display_take_allocation_error (void);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDisplay, gst_object_unref)
 
 G_END_DECLS
@@ -64,7 +64,7 @@ supports_vaapi (int fd)
   if (!va_dpy)
     return FALSE;
 
-  ret = vaapi_initialize (va_dpy);
+  ret = vaapi_initialize (va_dpy, NULL, NULL);
   vaTerminate (va_dpy);
   return ret;
 }
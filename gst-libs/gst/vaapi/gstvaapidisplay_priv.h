@@ -30,6 +30,8 @@
 #include <gst/vaapi/gstvaapitexture.h>
 #include <gst/vaapi/gstvaapitexturemap.h>
 #include "gstvaapiminiobject.h"
+#include "gstvaapicapscache.h"
+#include "gstvaapivideopool.h"
 
 G_BEGIN_DECLS
 
@@ -96,6 +98,52 @@ typedef enum _GstVaapiDisplayInitType           GstVaapiDisplayInitType;
 #define GST_VAAPI_DISPLAY_VADISPLAY_TYPE(display) \
   (GST_VAAPI_DISPLAY_GET_CLASS (display)->display_type)
 
+/**
+ * GST_VAAPI_DISPLAY_CAPS_CACHE:
+ * @display: a #GstVaapiDisplay
+ *
+ * Macro that evaluates to the #GstVaapiCapsCache of @display, or
+ * %NULL if the driver capabilities are not cached.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_CAPS_CACHE(display) \
+  (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->caps_cache)
+
+/**
+ * GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA:
+ * @display: a #GstVaapiDisplay
+ *
+ * Returns whether VA calls on @display can be made concurrently from
+ * several threads, without holding the display lock.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA(display) \
+  (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->va_thread_safe)
+
+/**
+ * GST_VAAPI_DISPLAY_VA_LOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Locks @display around VA calls that libva allows from several
+ * threads. This is a no-op unless the display needs every VA call to
+ * be serialized, see GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA().
+ */
+#define GST_VAAPI_DISPLAY_VA_LOCK(display) G_STMT_START {       \
+    if (!GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA (display))        \
+      GST_VAAPI_DISPLAY_LOCK (display);                         \
+  } G_STMT_END
+
+/**
+ * GST_VAAPI_DISPLAY_VA_UNLOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Unlocks @display after GST_VAAPI_DISPLAY_VA_LOCK().
+ */
+#define GST_VAAPI_DISPLAY_VA_UNLOCK(display) G_STMT_START {     \
+    if (!GST_VAAPI_DISPLAY_HAS_THREAD_SAFE_VA (display))        \
+      GST_VAAPI_DISPLAY_UNLOCK (display);                       \
+  } G_STMT_END
+
 /**
  * GST_VAAPI_DISPLAY_HAS_VPP:
  * @display: a @GstVaapiDisplay
@@ -120,15 +168,26 @@ struct _GstVaapiDisplayPrivate
   guint height_mm;
   guint par_n;
   guint par_d;
-  GPtrArray *decoders; /* ref element in codecs */
-  GPtrArray *encoders; /* ref element in codecs */
-  GArray *codecs;
+  GArray *configs;                      /* sorted by profile */
+  GHashTable *configs_map;              /* profile -> ref element in configs */
   GArray *image_formats;
+  GHashTable *image_formats_map;        /* ref element in image_formats */
   GArray *subpicture_formats;
+  GHashTable *subpicture_formats_map;   /* ref element in subpicture_formats */
   GArray *properties;
   gchar *vendor_string;
+  gint va_major_version;
+  gint va_minor_version;
+  GstVaapiCapsCache *caps_cache;
+  GMutex memory_lock;
+  GCond memory_cond;
+  guint64 memory_usage;
+  guint64 memory_budget;                /* 0 for no budget */
+  GList *video_pools;                   /* not referenced */
   guint use_foreign_display:1;
+  guint va_thread_safe:1;
   guint has_vpp:1;
+  guint has_vpp_probed:1;
   guint has_profiles:1;
   guint got_scrres:1;
   guint driver_quirks;
@@ -173,6 +232,9 @@ struct _GstVaapiDisplayClass
 
   /*< protected >*/
   guint display_type;
+  /* the VA backend shares the native connection with the application,
+     so that every VA call must hold the display lock */
+  gboolean serialize_va;
 
   /*< public >*/
   void                (*init)            (GstVaapiDisplay * display);
@@ -206,6 +268,29 @@ GstVaapiDisplay *
 gst_vaapi_display_config (GstVaapiDisplay * display,
     GstVaapiDisplayInitType init_type, gpointer init_value);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_reserve_memory (GstVaapiDisplay * display, guint64 size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_release_memory (GstVaapiDisplay * display, guint64 size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_add_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_remove_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool);
+
+G_GNUC_INTERNAL
+GstVaapiVideoPool *
+gst_vaapi_display_share_video_pool (GstVaapiDisplay * display,
+    GstVaapiVideoPool * pool, GEqualFunc match);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DISPLAY_PRIV_H */
@@ -296,6 +296,7 @@ gst_vaapi_display_x11_class_init (GstVaapiDisplayX11Class * klass)
   GstVaapiDisplayClass *const dpy_class = GST_VAAPI_DISPLAY_CLASS (klass);
 
   dpy_class->display_type = GST_VAAPI_DISPLAY_TYPE_X11;
+  dpy_class->serialize_va = TRUE;
   dpy_class->bind_display = gst_vaapi_display_x11_bind_display;
   dpy_class->open_display = gst_vaapi_display_x11_open_display;
   dpy_class->close_display = gst_vaapi_display_x11_close_display;
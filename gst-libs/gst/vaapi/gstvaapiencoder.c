@@ -25,11 +25,13 @@
 #include "gstvaapicompat.h"
 #include "gstvaapiencoder.h"
 #include "gstvaapiencoder_priv.h"
+#include "gstvaapicodedbufferproxy_priv.h"
 #include "gstvaapicontext.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 #include "gstvaapiutils_core.h"
 #include "gstvaapivalue.h"
+#include "gstvaapiqpmapmeta.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -54,6 +56,42 @@ gst_vaapi_encoder_ensure_param_quality_level (GstVaapiEncoder * encoder,
   return TRUE;
 }
 
+/* Steers the driver rate control away from the VBV limits, around
+ * the QP of the last output frames */
+static void
+apply_vbv_qp_offset (GstVaapiEncoder * encoder,
+    VAEncMiscParameterRateControl * rate_control)
+{
+  gint offset, qp;
+
+  offset = g_atomic_int_get (&encoder->vbv_qp_offset);
+  if (offset == 0)
+    return;
+
+  qp = g_atomic_int_get (&encoder->vbv_ref_qp);
+  if (qp <= 0)
+    qp = rate_control->initial_qp;
+  if (qp <= 0)
+    return;
+
+  if (offset > 0) {
+    rate_control->min_qp = MAX (rate_control->min_qp, qp + offset);
+#if VA_CHECK_VERSION(1,1,0)
+    if (rate_control->max_qp > 0)
+      rate_control->min_qp = MIN (rate_control->min_qp, rate_control->max_qp);
+#endif
+  } else {
+#if VA_CHECK_VERSION(1,1,0)
+    qp = MAX (qp + offset, (gint) MAX (rate_control->min_qp, 1));
+    if (rate_control->max_qp == 0 || rate_control->max_qp > qp)
+      rate_control->max_qp = qp;
+#endif
+  }
+
+  GST_LOG ("VBV feedback: QP offset %d, min QP %u", offset,
+      rate_control->min_qp);
+}
+
 gboolean
 gst_vaapi_encoder_ensure_param_control_rate (GstVaapiEncoder * encoder,
     GstVaapiEncPicture * picture)
@@ -78,6 +116,8 @@ gst_vaapi_encoder_ensure_param_control_rate (GstVaapiEncoder * encoder,
     return FALSE;
   memcpy (misc->data, &GST_VAAPI_ENCODER_VA_RATE_CONTROL (encoder),
       sizeof (VAEncMiscParameterRateControl));
+  if (encoder->vbv_qp_feedback)
+    apply_vbv_qp_offset (encoder, misc->data);
   gst_vaapi_enc_picture_add_misc_param (picture, misc);
   gst_vaapi_codec_object_replace (&misc, NULL);
 
@@ -220,6 +260,360 @@ gst_vaapi_encoder_ensure_param_roi_regions (GstVaapiEncoder * encoder,
   return TRUE;
 }
 
+/* Delta QP applied to the refreshed stripe when the driver cannot do
+ * rolling intra refresh by itself. This only shapes the QP: intra
+ * macroblocks are not forced, so the stream keeps its regular IDR
+ * frames and no recovery point is signalled */
+#define INTRA_REFRESH_FALLBACK_DELTA_QP (-8)
+
+gboolean
+gst_vaapi_encoder_ensure_param_intra_refresh (GstVaapiEncoder * encoder,
+    GstVaapiEncPicture * picture, guint position)
+{
+  GstVaapiEncMiscParam *misc;
+  guint start, size;
+
+  if (encoder->intra_refresh == GST_VAAPI_ENCODER_INTRA_REFRESH_NONE)
+    return TRUE;
+
+  /* intra pictures are already fully refreshed */
+  if (picture->type == GST_VAAPI_PICTURE_TYPE_I)
+    return TRUE;
+
+  start = (position % encoder->intra_refresh_period) *
+      encoder->intra_refresh_size;
+  if (start >= encoder->intra_refresh_units)
+    return TRUE;
+  size = MIN (encoder->intra_refresh_size,
+      encoder->intra_refresh_units - start);
+
+  if (encoder->intra_refresh_native) {
+#if VA_CHECK_VERSION(1,0,0)
+    VAEncMiscParameterRIR *rir;
+
+    misc = gst_vaapi_enc_misc_param_new (encoder, VAEncMiscParameterTypeRIR,
+        sizeof (VAEncMiscParameterRIR));
+    if (!misc)
+      return FALSE;
+
+    rir = misc->data;
+    rir->rir_flags.bits.enable_rir_column =
+        (encoder->intra_refresh == GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN);
+    rir->rir_flags.bits.enable_rir_row =
+        (encoder->intra_refresh == GST_VAAPI_ENCODER_INTRA_REFRESH_ROW);
+    rir->intra_insertion_location = start;
+    rir->intra_insert_size = size;
+    rir->qp_delta_for_inserted_intra = 0;
+
+    gst_vaapi_enc_picture_add_misc_param (picture, misc);
+    gst_vaapi_codec_object_replace (&misc, NULL);
+#endif
+  } else {
+#if VA_CHECK_VERSION(0,39,1)
+    const GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
+    VAEncMiscParameterBufferROI *roi_param;
+    VAEncROI *region_roi;
+    GstBuffer *input;
+    guint block = encoder->intra_refresh_block;
+
+    /* upstream regions of interest and QP maps take precedence over
+     * the stripe */
+    input = picture->frame ? picture->frame->input_buffer : NULL;
+    if (input && (gst_buffer_get_n_meta (input,
+                GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE) > 0
+            || gst_buffer_get_custom_meta (input,
+                GST_VAAPI_QP_MAP_META_NAME)))
+      return TRUE;
+
+    misc = gst_vaapi_enc_misc_param_new (encoder, VAEncMiscParameterTypeROI,
+        sizeof (VAEncMiscParameterBufferROI) + sizeof (VAEncROI));
+    if (!misc)
+      return FALSE;
+
+    region_roi =
+        (VAEncROI *) ((guint8 *) misc->param +
+        sizeof (VAEncMiscParameterBuffer) +
+        sizeof (VAEncMiscParameterBufferROI));
+
+    roi_param = misc->data;
+    roi_param->num_roi = 1;
+    roi_param->roi = region_roi;
+    roi_param->roi_flags.bits.roi_value_is_qp_delta = 1;
+    roi_param->max_delta_qp = 10;
+    roi_param->min_delta_qp = -10;
+
+    if (encoder->intra_refresh == GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN) {
+      region_roi->roi_rectangle.x = start * block;
+      region_roi->roi_rectangle.y = 0;
+      region_roi->roi_rectangle.width = size * block;
+      region_roi->roi_rectangle.height = GST_VIDEO_INFO_HEIGHT (vip);
+    } else {
+      region_roi->roi_rectangle.x = 0;
+      region_roi->roi_rectangle.y = start * block;
+      region_roi->roi_rectangle.width = GST_VIDEO_INFO_WIDTH (vip);
+      region_roi->roi_rectangle.height = size * block;
+    }
+    region_roi->roi_value = INTRA_REFRESH_FALLBACK_DELTA_QP;
+
+    gst_vaapi_enc_picture_add_misc_param (picture, misc);
+    gst_vaapi_codec_object_replace (&misc, NULL);
+#endif
+  }
+
+  GST_LOG ("intra refresh of %s %u-%u", encoder->intra_refresh ==
+      GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN ? "columns" : "rows", start,
+      start + size - 1);
+  return TRUE;
+}
+
+#if VA_CHECK_VERSION(0,39,1)
+/* Limits of the delta QP of the regions built from a QP map */
+#define QP_MAP_ROI_MAX_DELTA_QP 10
+
+typedef struct
+{
+  guint x0, x1;                 /* columns, in blocks */
+  guint y0, y1;                 /* rows, in blocks */
+  gint value;
+} QPMapRegion;
+
+static gint
+qp_map_region_compare (gconstpointer a, gconstpointer b)
+{
+  const QPMapRegion *const ra = a;
+  const QPMapRegion *const rb = b;
+  const guint wa = ABS (ra->value) * (ra->x1 - ra->x0) * (ra->y1 - ra->y0);
+  const guint wb = ABS (rb->value) * (rb->x1 - rb->x0) * (rb->y1 - rb->y0);
+
+  /* strongest and largest offsets first */
+  return (wa < wb) - (wa > wb);
+}
+
+/* Resamples a row of the QP map on the encoder blocks */
+static void
+qp_map_get_row (const GstVaapiQPMap * map, guint width, guint height,
+    guint block_size, guint row, guint width_in_blocks, gint * values)
+{
+  guint i;
+
+  for (i = 0; i < width_in_blocks; i++) {
+    values[i] = gst_vaapi_qp_map_get_block_delta_qp (map, width, height,
+        i * block_size, row * block_size, block_size, block_size);
+  }
+}
+
+/* Converts the QP map into regions of interest: runs of blocks with the
+ * same delta QP are merged within a row, then with an identical run of
+ * the row above. Every block is resampled once. The most significant
+ * regions are kept if the driver doesn't support that many. */
+static gboolean
+ensure_param_qp_map_roi (GstVaapiEncoder * encoder,
+    GstVaapiEncPicture * picture, const GstVaapiQPMap * map,
+    guint block_size)
+{
+  GstVaapiContextInfo *const cip = &encoder->context_info;
+  const GstVaapiConfigInfoEncoder *const config = &cip->config.encoder;
+  const guint width = GST_VAAPI_ENCODER_WIDTH (encoder);
+  const guint height = GST_VAAPI_ENCODER_HEIGHT (encoder);
+  const guint width_in_blocks = (width + block_size - 1) / block_size;
+  const guint height_in_blocks = (height + block_size - 1) / block_size;
+  VAEncMiscParameterBufferROI *roi_param;
+  GstVaapiEncMiscParam *misc;
+  VAEncROI *region_roi;
+  GArray *regions;
+  QPMapRegion *region;
+  gint *values, *above, *current, *tmp;
+  guint i, j, k, num_roi;
+  gint value, r;
+
+  if (!config->roi_capability)
+    return TRUE;
+
+  /* upstream regions of interest take precedence over the map */
+  if (gst_buffer_get_n_meta (picture->frame->input_buffer,
+          GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE) > 0) {
+    GST_LOG ("ignoring QP map since the buffer has regions of interest");
+    return TRUE;
+  }
+
+  /* the resampled row, then the index of the region ending on the row
+   * above and on the current row, by starting column */
+  values = g_new (gint, 3 * width_in_blocks);
+  above = values + width_in_blocks;
+  current = above + width_in_blocks;
+  for (i = 0; i < width_in_blocks; i++)
+    above[i] = -1;
+
+  regions = g_array_new (FALSE, FALSE, sizeof (QPMapRegion));
+  for (j = 0; j < height_in_blocks; j++) {
+    qp_map_get_row (map, width, height, block_size, j, width_in_blocks,
+        values);
+    for (i = 0; i < width_in_blocks; i++) {
+      values[i] = CLAMP (values[i], -QP_MAP_ROI_MAX_DELTA_QP,
+          QP_MAP_ROI_MAX_DELTA_QP);
+      current[i] = -1;
+    }
+
+    for (i = 0; i < width_in_blocks; i = k) {
+      value = values[i];
+
+      /* extend the run over the blocks with the same offset */
+      for (k = i + 1; k < width_in_blocks && values[k] == value; k++);
+      if (value == 0)
+        continue;
+
+      /* grow an identical run of the row above, if any */
+      r = above[i];
+      if (r >= 0) {
+        region = &g_array_index (regions, QPMapRegion, r);
+        if (region->x1 == k && region->value == value)
+          region->y1 = j + 1;
+        else
+          r = -1;
+      }
+      if (r < 0) {
+        QPMapRegion run = { i, k, j, j + 1, value };
+
+        g_array_append_val (regions, run);
+        r = regions->len - 1;
+      }
+      current[i] = r;
+    }
+
+    tmp = above;
+    above = current;
+    current = tmp;
+  }
+  g_free (values);
+
+  if (regions->len == 0)
+    goto done;
+
+  num_roi = regions->len;
+  if (num_roi > config->roi_num_supported) {
+    GST_LOG ("QP map split into %u regions, keeping %u", num_roi,
+        config->roi_num_supported);
+    g_array_sort (regions, qp_map_region_compare);
+    num_roi = config->roi_num_supported;
+  }
+
+  misc = gst_vaapi_enc_misc_param_new (encoder, VAEncMiscParameterTypeROI,
+      sizeof (VAEncMiscParameterBufferROI) + num_roi * sizeof (VAEncROI));
+  if (!misc)
+    goto error_create_misc;
+
+  region_roi =
+      (VAEncROI *) ((guint8 *) misc->param + sizeof (VAEncMiscParameterBuffer) +
+      sizeof (VAEncMiscParameterBufferROI));
+
+  roi_param = misc->data;
+  roi_param->num_roi = num_roi;
+  roi_param->roi = region_roi;
+  roi_param->roi_flags.bits.roi_value_is_qp_delta = 1;
+  roi_param->max_delta_qp = QP_MAP_ROI_MAX_DELTA_QP;
+  roi_param->min_delta_qp = -QP_MAP_ROI_MAX_DELTA_QP;
+
+  for (i = 0; i < num_roi; i++) {
+    region = &g_array_index (regions, QPMapRegion, i);
+    region_roi[i].roi_rectangle.x = region->x0 * block_size;
+    region_roi[i].roi_rectangle.y = region->y0 * block_size;
+    region_roi[i].roi_rectangle.width =
+        MIN (region->x1 * block_size, width) - region->x0 * block_size;
+    region_roi[i].roi_rectangle.height =
+        MIN (region->y1 * block_size, height) - region->y0 * block_size;
+    region_roi[i].roi_value = region->value;
+  }
+
+  gst_vaapi_enc_picture_add_misc_param (picture, misc);
+  gst_vaapi_codec_object_replace (&misc, NULL);
+
+done:
+  g_array_unref (regions);
+  return TRUE;
+
+  /* ERRORS */
+error_create_misc:
+  {
+    g_array_unref (regions);
+    return FALSE;
+  }
+}
+#endif
+
+/**
+ * gst_vaapi_encoder_ensure_param_qp_map:
+ * @encoder: a #GstVaapiEncoder
+ * @picture: the #GstVaapiEncPicture being encoded
+ * @block_size: the codec block size (macroblock or CTU), in pixels
+ * @qp: the quantizer of the picture
+ * @min_qp: the minimal quantizer value
+ * @max_qp: the maximal quantizer value
+ *
+ * Applies the delta QP map of the input buffer, if any, see
+ * #GstVaapiQPMap. With
+ * CQP rate control and a driver supporting per-block QP, a QP buffer
+ * holding @qp plus the delta of every block is submitted. Otherwise
+ * the map is approximated by regions of interest of @block_size
+ * granularity.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gst_vaapi_encoder_ensure_param_qp_map (GstVaapiEncoder * encoder,
+    GstVaapiEncPicture * picture, guint block_size, gint qp, gint min_qp,
+    gint max_qp)
+{
+  GstVaapiContextInfo *const cip = &encoder->context_info;
+  const GstVaapiConfigInfoEncoder *const config = &cip->config.encoder;
+  GstVaapiQPMap map;
+
+  if (!picture->frame || !picture->frame->input_buffer)
+    return TRUE;
+
+  if (!gst_buffer_get_vaapi_qp_map (picture->frame->input_buffer, &map))
+    return TRUE;
+
+#if VA_CHECK_VERSION(1,0,0)
+  if (config->qp_block_size > 0 &&
+      GST_VAAPI_ENCODER_RATE_CONTROL (encoder) == GST_VAAPI_RATECONTROL_CQP) {
+    const guint width = GST_VAAPI_ENCODER_WIDTH (encoder);
+    const guint height = GST_VAAPI_ENCODER_HEIGHT (encoder);
+    const guint size = config->qp_block_size;
+    const guint width_in_blocks = (width + size - 1) / size;
+    const guint height_in_blocks = (height + size - 1) / size;
+    const guint pitch = width_in_blocks * sizeof (VAEncQPBufferH264);
+    GstVaapiEncQPBuffer *qp_buffer;
+    VAEncQPBufferH264 *row;
+    gint *values;
+    guint i, j;
+
+    qp_buffer = gst_vaapi_enc_qp_buffer_new (encoder,
+        pitch * height_in_blocks);
+    if (!qp_buffer)
+      return FALSE;
+
+    values = g_new (gint, width_in_blocks);
+    for (j = 0; j < height_in_blocks; j++) {
+      qp_map_get_row (&map, width, height, size, j, width_in_blocks, values);
+      row = (VAEncQPBufferH264 *) ((guint8 *) qp_buffer->param + j * pitch);
+      for (i = 0; i < width_in_blocks; i++)
+        row[i].qp = CLAMP (qp + values[i], min_qp, max_qp);
+    }
+    g_free (values);
+
+    gst_vaapi_codec_object_replace (&picture->qp_buffer, qp_buffer);
+    gst_vaapi_codec_object_replace (&qp_buffer, NULL);
+    return TRUE;
+  }
+#endif
+
+#if VA_CHECK_VERSION(0,39,1)
+  return ensure_param_qp_map_roi (encoder, picture, &map, block_size);
+#else
+  return TRUE;
+#endif
+}
+
 /**
  * gst_vaapi_encoder_replace:
  * @old_encoder_ptr: a pointer to a #GstVaapiEncoder
@@ -282,11 +676,20 @@ _surface_proxy_released_notify (GstVaapiEncoder * encoder)
   g_mutex_unlock (&encoder->mutex);
 }
 
+/* A surface released by the subclass, while the pictures submitted
+   up to seqnum may still reference it */
+typedef struct
+{
+  GstVaapiSurfaceProxy *proxy;
+  guint32 seqnum;
+} GstVaapiEncoderReleasedSurface;
+
 /* Creates a new VA surface object proxy, backed from a pool and
    useful to allocate reconstructed surfaces */
 GstVaapiSurfaceProxy *
 gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
 {
+  GstVaapiEncoderReleasedSurface *released;
   GstVaapiSurfaceProxy *proxy;
 
   g_return_val_if_fail (encoder->context != NULL, NULL);
@@ -297,6 +700,19 @@ gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
     if (proxy)
       break;
 
+    /* Take back the oldest surface kept for re-encoding, rather than
+       waiting for the output thread, which may not run. The pictures
+       that could reference it are then no longer re-encoded */
+    released = g_queue_pop_head (&encoder->released_surfaces);
+    if (released) {
+      encoder->reclaimed_seqnum = released->seqnum;
+      g_mutex_unlock (&encoder->mutex);
+      gst_vaapi_surface_proxy_unref (released->proxy);
+      g_slice_free (GstVaapiEncoderReleasedSurface, released);
+      g_mutex_lock (&encoder->mutex);
+      continue;
+    }
+
     /* Wait for a free surface proxy to become available */
     g_cond_wait (&encoder->surface_free, &encoder->mutex);
   }
@@ -307,6 +723,53 @@ gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
   return proxy;
 }
 
+/* Releases a surface the subclass no longer references. It is only
+   pushed back to the pool once the pictures submitted so far are
+   synced, since they may still be encoded again, and reference it */
+void
+gst_vaapi_encoder_release_surface (GstVaapiEncoder * encoder,
+    GstVaapiSurfaceProxy * proxy)
+{
+  GstVaapiEncoderReleasedSurface *released;
+
+  g_mutex_lock (&encoder->mutex);
+  if (encoder->num_synced == encoder->num_submitted) {
+    g_mutex_unlock (&encoder->mutex);
+    gst_vaapi_surface_proxy_unref (proxy);
+    return;
+  }
+
+  released = g_slice_new (GstVaapiEncoderReleasedSurface);
+  released->proxy = proxy;
+  released->seqnum = encoder->num_submitted;
+  g_queue_push_tail (&encoder->released_surfaces, released);
+  g_mutex_unlock (&encoder->mutex);
+}
+
+/* Records that the oldest submitted picture is synced, and releases
+   the surfaces only the pictures synced so far could reference */
+static void
+gst_vaapi_encoder_picture_synced (GstVaapiEncoder * encoder)
+{
+  GstVaapiEncoderReleasedSurface *released;
+  GQueue proxies = G_QUEUE_INIT;
+  GstVaapiSurfaceProxy *proxy;
+
+  g_mutex_lock (&encoder->mutex);
+  encoder->num_synced++;
+  while ((released = g_queue_peek_head (&encoder->released_surfaces))) {
+    if ((gint32) (encoder->num_synced - released->seqnum) < 0)
+      break;
+    g_queue_pop_head (&encoder->released_surfaces);
+    g_queue_push_tail (&proxies, released->proxy);
+    g_slice_free (GstVaapiEncoderReleasedSurface, released);
+  }
+  g_mutex_unlock (&encoder->mutex);
+
+  while ((proxy = g_queue_pop_head (&proxies)))
+    gst_vaapi_surface_proxy_unref (proxy);
+}
+
 /* Create a coded buffer proxy where the picture is going to be
  * decoded, the subclass encode vmethod is called and, if it doesn't
  * fail, the coded buffer is pushed into the async queue */
@@ -316,15 +779,28 @@ gst_vaapi_encoder_encode_and_queue (GstVaapiEncoder * encoder,
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  GstVaapiCodedBufferStats *stats;
   GstVaapiEncoderStatus status;
+  gint64 start_time, end_time;
 
   codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder);
   if (!codedbuf_proxy)
     goto error_create_coded_buffer;
 
+  g_mutex_lock (&encoder->mutex);
+  encoder->num_submitted++;
+  g_mutex_unlock (&encoder->mutex);
+
+  start_time = g_get_monotonic_time ();
   status = klass->encode (encoder, picture, codedbuf_proxy);
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     goto error_encode;
+  end_time = g_get_monotonic_time ();
+
+  stats = GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy);
+  stats->picture_type = picture->type;
+  stats->reorder_delay = (start_time - picture->queued_time) * GST_USECOND;
+  stats->encode_time = (end_time - picture->queued_time) * GST_USECOND;
 
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
       picture, (GDestroyNotify) gst_vaapi_mini_object_unref);
@@ -342,6 +818,9 @@ error_create_coded_buffer:
 error_encode:
   {
     GST_ERROR ("failed to encode frame (status = %d)", status);
+    g_mutex_lock (&encoder->mutex);
+    encoder->num_submitted--;
+    g_mutex_unlock (&encoder->mutex);
     gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
     return status;
   }
@@ -365,6 +844,13 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
   GstVaapiEncoderStatus status;
   GstVaapiEncPicture *picture;
 
+  /* A truncated, or re-encoded, frame is referenced by the following
+     ones, which no longer match it, so the stream only recovers from
+     the next keyframe */
+  if (frame && g_atomic_int_compare_and_exchange (&encoder->codedbuf_overflow,
+          TRUE, FALSE))
+    GST_VIDEO_CODEC_FRAME_SET_FORCE_KEYFRAME (frame);
+
   for (;;) {
     picture = NULL;
     status = klass->reordering (encoder, frame, &picture);
@@ -395,6 +881,158 @@ error_encode:
   }
 }
 
+/* Fills in the statistics only known once the coded buffer is ready */
+static void
+coded_buffer_proxy_update_stats (GstVaapiCodedBufferProxy * codedbuf_proxy)
+{
+  GstVaapiCodedBufferStats *const stats =
+      GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy);
+  GstVaapiCodedBuffer *const buf =
+      GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy);
+  VACodedBufferSegment *segment;
+  guint qp;
+
+  if (!gst_vaapi_coded_buffer_map (buf, &segment))
+    return;
+
+  /* Drivers not reporting the average QP leave the field to zero */
+  if (segment) {
+    qp = segment->status & VA_CODED_BUF_STATUS_PICTURE_AVE_QP_MASK;
+    if (qp > 0)
+      stats->average_qp = qp;
+  }
+
+  stats->coded_size = 0;
+  for (; segment != NULL; segment = segment->next) {
+    stats->coded_size += segment->size;
+    if (segment->status & VA_CODED_BUF_STATUS_SLICE_OVERFLOW_MASK)
+      stats->overflow = TRUE;
+  }
+
+  gst_vaapi_coded_buffer_unmap (buf);
+}
+
+/* Feeds the coded size back to the pool, so that it sizes the next
+ * buffers from the actual coded sizes rather than the worst case */
+static void
+gst_vaapi_encoder_update_coded_buffer_size (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy)
+{
+  const GstVaapiCodedBufferStats *const stats =
+      GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy);
+  GstVaapiCodedBufferPool *const pool =
+      GST_VAAPI_CODED_BUFFER_POOL (codedbuf_proxy->pool);
+
+  if (!pool)
+    return;
+
+  if (!stats->overflow) {
+    gst_vaapi_coded_buffer_pool_add_coded_size (pool, stats->coded_size,
+        stats->picture_type == GST_VAAPI_PICTURE_TYPE_I);
+    return;
+  }
+
+  GST_WARNING ("coded frame truncated (%" G_GSIZE_FORMAT " bytes), "
+      "forcing a keyframe", stats->coded_size);
+  g_atomic_int_set (&encoder->codedbuf_overflow, TRUE);
+}
+
+/* Encodes the picture again, into a coded buffer of the maximum size,
+ * when its coded frame did not fit in the coded buffer. The frame is
+ * left truncated if it cannot be re-encoded, and FALSE is only
+ * returned on error */
+static gboolean
+gst_vaapi_encoder_reencode (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstVaapiEncPicture * picture)
+{
+  GstVaapiCodedBufferStats *const stats =
+      GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy);
+  GstVaapiCodedBufferPool *const pool =
+      GST_VAAPI_CODED_BUFFER_POOL (codedbuf_proxy->pool);
+  GstVaapiCodedBuffer *buf;
+  gboolean has_surfaces, has_next;
+  guint32 seqnum;
+
+  if (!pool)
+    return TRUE;
+
+  GST_INFO ("coded buffer overflow (%" G_GSIZE_FORMAT " bytes)",
+      stats->coded_size);
+  gst_vaapi_coded_buffer_pool_add_overflow (pool,
+      codedbuf_proxy->buffer->buf_size);
+
+  g_mutex_lock (&encoder->mutex);
+  seqnum = encoder->num_synced + 1;
+  has_surfaces = (gint32) (seqnum - encoder->reclaimed_seqnum) > 0;
+  has_next = encoder->num_submitted != seqnum;
+  g_mutex_unlock (&encoder->mutex);
+  if (!has_surfaces)
+    return TRUE;
+
+  buf = gst_vaapi_coded_buffer_pool_grow_buffer (pool, codedbuf_proxy->buffer);
+  if (!buf)
+    return TRUE;
+  gst_vaapi_coded_buffer_unref (codedbuf_proxy->buffer);
+  codedbuf_proxy->buffer = buf;
+  gst_mini_object_ref (GST_MINI_OBJECT_CAST (buf));
+
+  if (!gst_vaapi_enc_picture_reencode (picture, buf))
+    return FALSE;
+  if (!gst_vaapi_surface_sync (picture->surface))
+    return FALSE;
+
+  stats->overflow = FALSE;
+  stats->reencoded = TRUE;
+  coded_buffer_proxy_update_stats (codedbuf_proxy);
+
+  /* The pictures submitted meanwhile were predicted from the first
+     reconstruction of the picture, which the rate control likely
+     coded differently */
+  if (has_next &&
+      GST_VAAPI_ENCODER_RATE_CONTROL (encoder) != GST_VAAPI_RATECONTROL_CQP)
+    g_atomic_int_set (&encoder->codedbuf_overflow, TRUE);
+  return TRUE;
+}
+
+/* Runs the coded frame through the buffering model described by the
+ * HRD parameters the driver was given */
+static void
+gst_vaapi_encoder_check_vbv (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferStats * stats)
+{
+  GstVaapiEncoderVBV *const vbv = &encoder->vbv;
+  const VAEncMiscParameterHRD *const hrd = &GST_VAAPI_ENCODER_VA_HRD (encoder);
+
+  if (!encoder->vbv_check)
+    return;
+  if (GST_VAAPI_ENCODER_RATE_CONTROL (encoder) != GST_VAAPI_RATECONTROL_CBR &&
+      GST_VAAPI_ENCODER_RATE_CONTROL (encoder) != GST_VAAPI_RATECONTROL_VBR)
+    return;
+
+  if (g_atomic_int_compare_and_exchange (&encoder->vbv_reset, TRUE, FALSE)) {
+    gst_vaapi_encoder_vbv_init (vbv, hrd->buffer_size,
+        hrd->initial_buffer_fullness,
+        GST_VAAPI_ENCODER_VA_RATE_CONTROL (encoder).bits_per_second,
+        GST_VAAPI_ENCODER_FPS_N (encoder), GST_VAAPI_ENCODER_FPS_D (encoder),
+        GST_VAAPI_ENCODER_RATE_CONTROL (encoder) == GST_VAAPI_RATECONTROL_CBR);
+  }
+
+  stats->vbv_status = gst_vaapi_encoder_vbv_add_frame (vbv,
+      (guint64) stats->coded_size * 8);
+  if (stats->vbv_status == GST_VAAPI_VBV_STATUS_NONE)
+    return;
+
+  stats->vbv_fullness = vbv->fullness;
+  stats->vbv_size = vbv->size;
+
+  if (encoder->vbv_qp_feedback) {
+    if (stats->average_qp > 0)
+      g_atomic_int_set (&encoder->vbv_ref_qp, stats->average_qp);
+    g_atomic_int_set (&encoder->vbv_qp_offset,
+        gst_vaapi_encoder_vbv_get_qp_offset (vbv));
+  }
+}
+
 /**
  * gst_vaapi_encoder_get_buffer_with_timeout:
  * @encoder: a #GstVaapiEncoder
@@ -419,6 +1057,7 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
 {
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gint64 sync_time;
 
   codedbuf_proxy = g_async_queue_timeout_pop (encoder->codedbuf_queue, timeout);
   if (!codedbuf_proxy)
@@ -426,8 +1065,22 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
 
   /* Wait for completion of all operations and report any error that occurred */
   picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
+  sync_time = g_get_monotonic_time ();
   if (!gst_vaapi_surface_sync (picture->surface))
     goto error_invalid_buffer;
+  sync_time = g_get_monotonic_time () - sync_time;
+
+  GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy)->sync_time =
+      sync_time * GST_USECOND;
+  coded_buffer_proxy_update_stats (codedbuf_proxy);
+  if (GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy)->overflow &&
+      !gst_vaapi_encoder_reencode (encoder, codedbuf_proxy, picture))
+    goto error_invalid_buffer;
+  gst_vaapi_encoder_picture_synced (encoder);
+
+  gst_vaapi_encoder_update_coded_buffer_size (encoder, codedbuf_proxy);
+  gst_vaapi_encoder_check_vbv (encoder,
+      GST_VAAPI_CODED_BUFFER_PROXY_STATS (codedbuf_proxy));
 
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
       gst_video_codec_frame_ref (picture->frame),
@@ -442,6 +1095,7 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
 error_invalid_buffer:
   {
     GST_ERROR ("failed to encode the frame");
+    gst_vaapi_encoder_picture_synced (encoder);
     gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
     return GST_VAAPI_ENCODER_STATUS_ERROR_INVALID_SURFACE;
   }
@@ -609,15 +1263,19 @@ get_packed_headers (GstVaapiEncoder * encoder)
       GST_VAAPI_ENCODER_GET_CLASS (encoder)->class_data;
   guint value;
 
-  if (encoder->got_packed_headers)
-    return encoder->packed_headers;
+  if (!encoder->got_packed_headers) {
+    if (!get_config_attribute (encoder, VAConfigAttribEncPackedHeaders,
+            &value))
+      value = 0;
+    GST_INFO ("supported packed headers: 0x%08x", value);
 
-  if (!get_config_attribute (encoder, VAConfigAttribEncPackedHeaders, &value))
-    value = 0;
-  GST_INFO ("supported packed headers: 0x%08x", value);
+    encoder->got_packed_headers = TRUE;
+    encoder->supported_packed_headers = cdata->packed_headers & value;
+  }
 
-  encoder->got_packed_headers = TRUE;
-  encoder->packed_headers = cdata->packed_headers & value;
+  /* only request what the derived encoder needs for this configuration */
+  encoder->packed_headers =
+      encoder->supported_packed_headers & ~encoder->unused_packed_headers;
 
   return encoder->packed_headers;
 }
@@ -653,6 +1311,23 @@ get_roi_capability (GstVaapiEncoder * encoder, guint * num_roi_supported)
 #endif
 }
 
+/* Determines the size of the blocks of a QP buffer, if supported */
+static guint
+get_qp_block_size (GstVaapiEncoder * encoder)
+{
+#if VA_CHECK_VERSION(1,0,0)
+  guint value;
+
+  if (!get_config_attribute (encoder, VAConfigAttribQPBlockSize, &value))
+    return 0;
+
+  GST_INFO ("Support for per-block QP - block size: %u", value);
+  return value;
+#else
+  return 0;
+#endif
+}
+
 static inline gboolean
 is_chroma_type_supported (GstVaapiEncoder * encoder)
 {
@@ -741,6 +1416,7 @@ set_context_info (GstVaapiEncoder * encoder)
   config->packed_headers = get_packed_headers (encoder);
   config->roi_capability =
       get_roi_capability (encoder, &config->roi_num_supported);
+  config->qp_block_size = get_qp_block_size (encoder);
 
   return TRUE;
 
@@ -814,6 +1490,10 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     return status;
 
+  /* The HRD parameters may have changed */
+  g_atomic_int_set (&encoder->vbv_reset, TRUE);
+  g_atomic_int_set (&encoder->vbv_qp_offset, 0);
+
   if (!gst_vaapi_encoder_ensure_context (encoder))
     goto error_reset_context;
 
@@ -847,13 +1527,15 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
 
   codedbuf_size = encoder->codedbuf_pool ?
       gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
-      (encoder)) : 0;
+      (encoder->codedbuf_pool)) : 0;
   if (codedbuf_size != encoder->codedbuf_size) {
     pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
     if (!pool)
       goto error_alloc_codedbuf_pool;
     gst_vaapi_video_pool_set_capacity (pool, 5);
+    g_mutex_lock (&encoder->mutex);
     gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, pool);
+    g_mutex_unlock (&encoder->mutex);
     gst_vaapi_video_pool_unref (pool);
   }
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
@@ -1188,6 +1870,10 @@ G_DEFINE_ABSTRACT_TYPE (GstVaapiEncoder, gst_vaapi_encoder, GST_TYPE_OBJECT);
  * @ENCODER_PROP_DEFAULT_ROI_VALUE: The default delta qp to apply
  *   to each region of interest.
  * @ENCODER_PROP_TRELLIS: Use trellis quantization method (gboolean).
+ * @ENCODER_PROP_VBV_CHECK: Check the output against the HRD buffering
+ *   model (gboolean).
+ * @ENCODER_PROP_VBV_QP_FEEDBACK: Correct the rate control when the
+ *   output gets close to the HRD buffering limits (gboolean).
  *
  * The set of configurable properties for the encoder.
  */
@@ -1200,6 +1886,8 @@ enum
   ENCODER_PROP_QUALITY_LEVEL,
   ENCODER_PROP_DEFAULT_ROI_VALUE,
   ENCODER_PROP_TRELLIS,
+  ENCODER_PROP_VBV_CHECK,
+  ENCODER_PROP_VBV_QP_FEEDBACK,
   ENCODER_N_PROPERTIES
 };
 
@@ -1246,6 +1934,12 @@ gst_vaapi_encoder_set_property (GObject * object, guint prop_id,
       status =
           gst_vaapi_encoder_set_trellis (encoder, g_value_get_boolean (value));
       break;
+    case ENCODER_PROP_VBV_CHECK:
+      encoder->vbv_check = g_value_get_boolean (value);
+      break;
+    case ENCODER_PROP_VBV_QP_FEEDBACK:
+      encoder->vbv_qp_feedback = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1284,6 +1978,12 @@ gst_vaapi_encoder_get_property (GObject * object, guint prop_id,
     case ENCODER_PROP_TRELLIS:
       g_value_set_boolean (value, encoder->trellis);
       break;
+    case ENCODER_PROP_VBV_CHECK:
+      g_value_set_boolean (value, encoder->vbv_check);
+      break;
+    case ENCODER_PROP_VBV_QP_FEEDBACK:
+      g_value_set_boolean (value, encoder->vbv_qp_feedback);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1300,6 +2000,8 @@ gst_vaapi_encoder_init (GstVaapiEncoder * encoder)
   g_mutex_init (&encoder->mutex);
   g_cond_init (&encoder->surface_free);
   g_cond_init (&encoder->codedbuf_free);
+  g_mutex_init (&encoder->submit_mutex);
+  g_queue_init (&encoder->released_surfaces);
 
   encoder->codedbuf_queue = g_async_queue_new_full ((GDestroyNotify)
       gst_vaapi_coded_buffer_proxy_unref);
@@ -1310,6 +2012,12 @@ static void
 gst_vaapi_encoder_finalize (GObject * object)
 {
   GstVaapiEncoder *encoder = GST_VAAPI_ENCODER (object);
+  GstVaapiEncoderReleasedSurface *released;
+
+  while ((released = g_queue_pop_head (&encoder->released_surfaces))) {
+    gst_vaapi_surface_proxy_unref (released->proxy);
+    g_slice_free (GstVaapiEncoderReleasedSurface, released);
+  }
 
   if (encoder->context)
     gst_vaapi_context_unref (encoder->context);
@@ -1329,6 +2037,7 @@ gst_vaapi_encoder_finalize (GObject * object)
   }
   g_cond_clear (&encoder->surface_free);
   g_cond_clear (&encoder->codedbuf_free);
+  g_mutex_clear (&encoder->submit_mutex);
   g_mutex_clear (&encoder->mutex);
 
   G_OBJECT_CLASS (gst_vaapi_encoder_parent_class)->finalize (object);
@@ -1442,6 +2151,36 @@ gst_vaapi_encoder_class_init (GstVaapiEncoderClass * klass)
       FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoder:vbv-check:
+   *
+   * Runs the coded frames through a model of the decoder buffer, as
+   * described by the HRD parameters, and reports the buffer fullness
+   * and any underflow or overflow in the coded buffer statistics.
+   * This is only available when rate-control is CBR or VBR.
+   */
+  properties[ENCODER_PROP_VBV_CHECK] =
+      g_param_spec_boolean ("vbv-check",
+      "VBV Check",
+      "Check the output conformance against the HRD buffer model",
+      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
+  /**
+   * GstVaapiEncoder:vbv-qp-feedback:
+   *
+   * When vbv-check is enabled, constrains the QP range of the next
+   * frames whenever the modelled buffer gets close to an underflow
+   * or, for CBR, to an overflow.
+   */
+  properties[ENCODER_PROP_VBV_QP_FEEDBACK] =
+      g_param_spec_boolean ("vbv-qp-feedback",
+      "VBV QP Feedback",
+      "Correct the rate control when the HRD buffer model gets "
+      "close to its limits",
+      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_N_PROPERTIES,
       properties);
 }
@@ -1717,6 +2456,114 @@ gst_vaapi_encoder_ensure_tile_support (GstVaapiEncoder * encoder,
   return tile > 0;
 }
 
+/**
+ * gst_vaapi_encoder_ensure_intra_refresh:
+ * @encoder: a #GstVaapiEncoder
+ * @profile: a #GstVaapiProfile
+ * @entrypoint: a #GstVaapiEntrypoint
+ * @mode: the requested #GstVaapiEncoderIntraRefresh mode
+ * @period: the number of frames of a complete refresh cycle
+ * @block_size: the size of a macroblock (or CTU) in pixels
+ * @width_in_blocks: the picture width in macroblocks (or CTUs)
+ * @height_in_blocks: the picture height in macroblocks (or CTUs)
+ *
+ * This function will query VAConfigAttribEncIntraRefresh to check
+ * whether the driver can insert the rolling intra stripes by itself
+ * (VAEncMiscParameterRIR). Otherwise, and if the driver supports
+ * regions of interest with QP delta, the refreshed stripe is encoded
+ * with a lower QP as a fallback. In that case only the QP is shaped,
+ * intra macroblocks are not forced, and the derived encoders must
+ * keep their regular IDR frames (see
+ * GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE()).
+ *
+ * We need to pass the @profile and the @entrypoint, because at the
+ * moment the encoder base class, still doesn't have them assigned,
+ * and this function is meant to be called by the derived classes
+ * while they are configured.
+ *
+ * Returns: %TRUE if the @mode can be honored, %FALSE otherwise. In
+ *   that case intra refresh is disabled.
+ **/
+gboolean
+gst_vaapi_encoder_ensure_intra_refresh (GstVaapiEncoder * encoder,
+    GstVaapiProfile profile, GstVaapiEntrypoint entrypoint,
+    GstVaapiEncoderIntraRefresh mode, guint period, guint block_size,
+    guint width_in_blocks, guint height_in_blocks)
+{
+  VAProfile va_profile;
+  VAEntrypoint va_entrypoint;
+  gboolean native = FALSE;
+  guint num_units, value;
+
+  encoder->intra_refresh = GST_VAAPI_ENCODER_INTRA_REFRESH_NONE;
+  encoder->intra_refresh_native = FALSE;
+
+  if (mode == GST_VAAPI_ENCODER_INTRA_REFRESH_NONE)
+    return TRUE;
+
+  num_units = (mode == GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN) ?
+      width_in_blocks : height_in_blocks;
+  if (num_units == 0 || block_size == 0)
+    return FALSE;
+
+  va_profile = gst_vaapi_profile_get_va_profile (profile);
+  va_entrypoint = gst_vaapi_entrypoint_get_va_entrypoint (entrypoint);
+
+#if VA_CHECK_VERSION(1,0,0)
+  if (gst_vaapi_get_config_attribute (encoder->display, va_profile,
+          va_entrypoint, VAConfigAttribEncIntraRefresh, &value)) {
+    const guint needed = (mode == GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN) ?
+        VA_ENC_INTRA_REFRESH_ROLLING_COLUMN : VA_ENC_INTRA_REFRESH_ROLLING_ROW;
+    native = (value & needed) != 0;
+  }
+#endif
+
+  if (!native) {
+#if VA_CHECK_VERSION(0,39,1)
+    VAConfigAttribValEncROI *roi_config;
+
+    if (!gst_vaapi_get_config_attribute (encoder->display, va_profile,
+            va_entrypoint, VAConfigAttribEncROI, &value))
+      goto error_unsupported;
+
+    roi_config = (VAConfigAttribValEncROI *) & value;
+    if (roi_config->bits.num_roi_regions == 0)
+      goto error_unsupported;
+    if ((GST_VAAPI_ENCODER_RATE_CONTROL (encoder) != GST_VAAPI_RATECONTROL_CQP)
+        && (VA_ROI_RC_QP_DELTA_SUPPORT (roi_config) == 0))
+      goto error_unsupported;
+
+    GST_INFO ("rolling intra refresh is not supported by the driver,"
+        " using QP delta regions instead");
+#else
+    goto error_unsupported;
+#endif
+  }
+
+  /* a refresh cycle cannot be longer than the number of stripes */
+  period = CLAMP (period, 1, num_units);
+
+  encoder->intra_refresh = mode;
+  encoder->intra_refresh_period = period;
+  encoder->intra_refresh_units = num_units;
+  encoder->intra_refresh_size = (num_units + period - 1) / period;
+  encoder->intra_refresh_block = block_size;
+  encoder->intra_refresh_native = native;
+
+  GST_INFO ("intra refresh of %u %s per frame over %u frames",
+      encoder->intra_refresh_size,
+      mode == GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN ? "columns" : "rows",
+      period);
+  return TRUE;
+
+  /* ERRORS */
+error_unsupported:
+  {
+    GST_WARNING ("intra refresh is not supported, using periodic key frames");
+    return FALSE;
+  }
+}
+
 GstVaapiProfile
 gst_vaapi_encoder_get_profile (GstVaapiEncoder * encoder)
 {
@@ -1725,6 +2572,37 @@ gst_vaapi_encoder_get_profile (GstVaapiEncoder * encoder)
   return encoder->profile;
 }
 
+/**
+ * gst_vaapi_encoder_get_coded_buffer_memory_saved:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Determines the memory saved by sizing the coded buffers from the
+ * actual coded frame sizes, rather than the worst case size.
+ *
+ * Return value: the memory saved by the coded buffers currently
+ *   allocated, in bytes
+ */
+guint64
+gst_vaapi_encoder_get_coded_buffer_memory_saved (GstVaapiEncoder * encoder)
+{
+  GstVaapiVideoPool *pool = NULL;
+  guint64 memory_saved = 0;
+
+  g_return_val_if_fail (encoder, 0);
+
+  g_mutex_lock (&encoder->mutex);
+  if (encoder->codedbuf_pool)
+    pool = gst_vaapi_video_pool_ref (encoder->codedbuf_pool);
+  g_mutex_unlock (&encoder->mutex);
+
+  if (pool) {
+    memory_saved = gst_vaapi_coded_buffer_pool_get_memory_saved
+        (GST_VAAPI_CODED_BUFFER_POOL (pool));
+    gst_vaapi_video_pool_unref (pool);
+  }
+  return memory_saved;
+}
+
 /* Get the entrypoint based on the tune option. */
 /**
  * gst_vaapi_encoder_get_entrypoint:
@@ -1867,3 +2745,25 @@ gst_vaapi_encoder_mbbrc_get_type (void)
   }
   return g_type;
 }
+
+/** Returns a GType for the #GstVaapiEncoderIntraRefresh set */
+GType
+gst_vaapi_encoder_intra_refresh_get_type (void)
+{
+  static volatile gsize g_type = 0;
+
+  if (g_once_init_enter (&g_type)) {
+    static const GEnumValue encoder_intra_refresh_values[] = {
+      {GST_VAAPI_ENCODER_INTRA_REFRESH_NONE, "None", "none"},
+      {GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN, "Rolling columns", "column"},
+      {GST_VAAPI_ENCODER_INTRA_REFRESH_ROW, "Rolling rows", "row"},
+      {0, NULL, NULL},
+    };
+
+    GType type =
+        g_enum_register_static (g_intern_static_string
+        ("GstVaapiEncoderIntraRefresh"), encoder_intra_refresh_values);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
@@ -125,12 +125,38 @@ typedef enum {
   GST_VAAPI_ENCODER_MBBRC_OFF = 2,
 } GstVaapiEncoderMbbrc;
 
+/**
+ * GstVaapiEncoderIntraRefresh:
+ * @GST_VAAPI_ENCODER_INTRA_REFRESH_NONE: no intra refresh, only
+ *   periodic key frames
+ * @GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN: rolling intra refresh of
+ *   columns of macroblocks (or CTUs)
+ * @GST_VAAPI_ENCODER_INTRA_REFRESH_ROW: rolling intra refresh of rows
+ *   of macroblocks (or CTUs)
+ *
+ * Values for the gradual decoder refresh mode. When enabled, only the
+ * first frame is an IDR frame and the following frames refresh a
+ * stripe of the picture with intra blocks, so that a whole picture
+ * is refreshed every intra refresh period.
+ *
+ * This property values are only available for H264 and H265 (HEVC)
+ * encoders.
+ **/
+typedef enum {
+  GST_VAAPI_ENCODER_INTRA_REFRESH_NONE = 0,
+  GST_VAAPI_ENCODER_INTRA_REFRESH_COLUMN = 1,
+  GST_VAAPI_ENCODER_INTRA_REFRESH_ROW = 2,
+} GstVaapiEncoderIntraRefresh;
+
 GType
 gst_vaapi_encoder_tune_get_type (void) G_GNUC_CONST;
 
 GType
 gst_vaapi_encoder_mbbrc_get_type (void) G_GNUC_CONST;
 
+GType
+gst_vaapi_encoder_intra_refresh_get_type (void) G_GNUC_CONST;
+
 void
 gst_vaapi_encoder_replace (GstVaapiEncoder ** old_encoder_ptr,
     GstVaapiEncoder * new_encoder);
@@ -188,6 +214,9 @@ gst_vaapi_encoder_get_surface_attributes (GstVaapiEncoder * encoder,
 GstVaapiProfile
 gst_vaapi_encoder_get_profile (GstVaapiEncoder * encoder);
 
+guint64
+gst_vaapi_encoder_get_coded_buffer_memory_saved (GstVaapiEncoder * encoder);
+
 GstVaapiEntrypoint
 gst_vaapi_encoder_get_entrypoint (GstVaapiEncoder * encoder,
     GstVaapiProfile profile);
@@ -49,6 +49,16 @@
 #define MIN_TEMPORAL_LEVELS 1
 #define MAX_TEMPORAL_LEVELS 4
 
+/* Define the maximum number of long-term reference frames */
+#define MAX_LONG_TERM_REFS 8
+
+/* Define the maximum number of reference frames (max_num_ref_frames) */
+#define MAX_REF_FRAMES 16
+
+/* One unmarking per short-term reference, plus setting the maximum
+ * long-term index and marking the current picture */
+#define MAX_MMCO_OPS 18
+
 /* Supported set of VA rate controls, within this implementation */
 #define SUPPORTED_RATECONTROLS                          \
   (GST_VAAPI_RATECONTROL_MASK (CQP)  |                  \
@@ -145,7 +155,8 @@ typedef enum
 {
   GST_VAAPI_H264_SEI_UNKNOWN = 0,
   GST_VAAPI_H264_SEI_BUF_PERIOD = (1 << 0),
-  GST_VAAPI_H264_SEI_PIC_TIMING = (1 << 1)
+  GST_VAAPI_H264_SEI_PIC_TIMING = (1 << 1),
+  GST_VAAPI_H264_SEI_RECOVERY_POINT = (1 << 2)
 } GstVaapiH264SeiPayloadType;
 
 typedef struct
@@ -154,8 +165,27 @@ typedef struct
   guint poc;
   guint frame_num;
   guint temporal_id;
+  gboolean is_long_term;
+  guint long_term_frame_idx;
 } GstVaapiEncoderH264Ref;
 
+/* memory_management_control_operation values (7.4.3.3) */
+typedef enum
+{
+  GST_VAAPI_H264_MMCO_END = 0,
+  GST_VAAPI_H264_MMCO_UNMARK_SHORT_TERM = 1,
+  GST_VAAPI_H264_MMCO_SET_MAX_LONG_TERM_IDX = 4,
+  GST_VAAPI_H264_MMCO_MARK_CURRENT_LONG_TERM = 6
+} GstVaapiH264MmcoType;
+
+typedef struct
+{
+  GstVaapiH264MmcoType op;
+  guint value;
+  /* short-term reference released by GST_VAAPI_H264_MMCO_UNMARK_SHORT_TERM */
+  GstVaapiEncoderH264Ref *ref;
+} GstVaapiEncoderH264Mmco;
+
 typedef enum
 {
   GST_VAAPI_ENC_H264_REORD_NONE = 0,
@@ -798,6 +828,21 @@ struct _GstVaapiEncoderH264
   /* Complance mode */
   GstVaapiEncoderH264ComplianceMode compliance_mode;
   guint min_cr;                 // Minimum Compression Ratio (A.3.1)
+
+  /* Intra refresh */
+  GstVaapiEncoderIntraRefresh intra_refresh;
+  guint intra_refresh_period;
+  guint intra_refresh_pos;      /* position in the current refresh cycle */
+
+  /* Long-term references */
+  guint num_ltr_frames;
+  gint ltr_mark_pending;        /* index requested to mark, protected by object lock */
+  gint ltr_use_pending;         /* index requested to use, protected by object lock */
+  gint ltr_mark_idx;            /* long_term_frame_idx of the current picture */
+  GstVaapiEncoderH264Ref *ltr_use_ref;  /* only reference of the current picture */
+  gboolean ltr_max_idx_set;     /* MaxLongTermFrameIdx signalled since last IDR */
+  GstVaapiEncoderH264Mmco mmco[MAX_MMCO_OPS];
+  guint num_mmco;
 };
 
 /* Write a SEI buffering period payload */
@@ -890,6 +935,34 @@ bs_error:
   }
 }
 
+/* Write a SEI recovery point payload */
+static gboolean
+bs_write_sei_recovery_point (GstBitWriter * bs,
+    GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture)
+{
+  GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
+
+  /* recovery_frame_cnt: the picture is correct in content once the
+   * whole refresh cycle has been decoded */
+  WRITE_UE (bs, base_encoder->intra_refresh_period - 1);
+  /* exact_match_flag: motion vectors are not constrained to the
+   * already refreshed area */
+  WRITE_UINT32 (bs, 0, 1);
+  /* broken_link_flag */
+  WRITE_UINT32 (bs, 0, 1);
+  /* changing_slice_group_idc */
+  WRITE_UINT32 (bs, 0, 2);
+
+  return TRUE;
+
+  /* ERRORS */
+bs_error:
+  {
+    GST_WARNING ("failed to write Recovery Point SEI message");
+    return FALSE;
+  }
+}
+
 /* Write a Slice NAL unit */
 static gboolean
 bs_write_slice (GstBitWriter * bs,
@@ -903,6 +976,7 @@ bs_write_slice (GstBitWriter * bs,
   guint32 no_output_of_prior_pics_flag = 0;
   guint32 long_term_reference_flag = 0;
   guint32 adaptive_ref_pic_marking_mode_flag = 0;
+  guint i;
 
   /* first_mb_in_slice */
   WRITE_UE (bs, slice_param->macroblock_address);
@@ -950,17 +1024,27 @@ bs_write_slice (GstBitWriter * bs,
   }
 
   if ((slice_param->slice_type != 2) && (slice_param->slice_type != 4)) {
-    if ((encoder->prediction_type != GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT)
+    if (encoder->ltr_use_ref)
+      ref_pic_list_modification_flag_l0 = 1;
+    else if ((encoder->prediction_type !=
+            GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT)
         && (encoder->abs_diff_pic_num_list0 > 1))
       ref_pic_list_modification_flag_l0 = 1;
 
     WRITE_UINT32 (bs, ref_pic_list_modification_flag_l0, 1);
 
     if (ref_pic_list_modification_flag_l0) {
-      /*modification_of_pic_num_idc */
-      WRITE_UE (bs, 0);
-      /* abs_diff_pic_num_minus1 */
-      WRITE_UE (bs, encoder->abs_diff_pic_num_list0 - 1);
+      if (encoder->ltr_use_ref) {
+        /*modification_of_pic_num_idc */
+        WRITE_UE (bs, 2);
+        /* long_term_pic_num */
+        WRITE_UE (bs, encoder->ltr_use_ref->long_term_frame_idx);
+      } else {
+        /*modification_of_pic_num_idc */
+        WRITE_UE (bs, 0);
+        /* abs_diff_pic_num_minus1 */
+        WRITE_UE (bs, encoder->abs_diff_pic_num_list0 - 1);
+      }
       /*modification_of_pic_num_idc */
       WRITE_UE (bs, 3);
     }
@@ -1002,9 +1086,22 @@ bs_write_slice (GstBitWriter * bs,
       /* long_term_reference_flag = 0 */
       WRITE_UINT32 (bs, long_term_reference_flag, 1);
     } else {
-      /* only sliding_window reference picture marking mode is supported */
-      /* adpative_ref_pic_marking_mode_flag = 0 */
+      /* adaptive marking is only used for long-term references,
+       * otherwise the sliding window process applies */
+      adaptive_ref_pic_marking_mode_flag = encoder->num_mmco > 0;
       WRITE_UINT32 (bs, adaptive_ref_pic_marking_mode_flag, 1);
+
+      if (adaptive_ref_pic_marking_mode_flag) {
+        for (i = 0; i < encoder->num_mmco; i++) {
+          /* memory_management_control_operation */
+          WRITE_UE (bs, encoder->mmco[i].op);
+          /* difference_of_pic_nums_minus1, max_long_term_frame_idx_plus1
+           * or long_term_frame_idx */
+          WRITE_UE (bs, encoder->mmco[i].value);
+        }
+        /* memory_management_control_operation */
+        WRITE_UE (bs, GST_VAAPI_H264_MMCO_END);
+      }
     }
   }
 
@@ -1651,19 +1748,23 @@ add_packed_sei_header (GstVaapiEncoderH264 * encoder,
     GstVaapiEncPicture * picture, GstVaapiH264SeiPayloadType payloadtype)
 {
   GstVaapiEncPackedHeader *packed_sei;
-  GstBitWriter bs, bs_buf_period, bs_pic_timing;
+  GstBitWriter bs, bs_buf_period, bs_pic_timing, bs_recovery_point;
   VAEncPackedHeaderParameterBuffer packed_sei_param = { 0 };
   guint32 data_bit_size;
   guint8 buf_period_payload_size = 0, pic_timing_payload_size = 0;
+  guint8 recovery_point_payload_size = 0;
   guint8 *data, *buf_period_payload = NULL, *pic_timing_payload = NULL;
-  gboolean need_buf_period, need_pic_timing;
+  guint8 *recovery_point_payload = NULL;
+  gboolean need_buf_period, need_pic_timing, need_recovery_point;
 
   gst_bit_writer_init_with_size (&bs_buf_period, 128, FALSE);
   gst_bit_writer_init_with_size (&bs_pic_timing, 128, FALSE);
+  gst_bit_writer_init_with_size (&bs_recovery_point, 128, FALSE);
   gst_bit_writer_init_with_size (&bs, 128, FALSE);
 
   need_buf_period = GST_VAAPI_H264_SEI_BUF_PERIOD & payloadtype;
   need_pic_timing = GST_VAAPI_H264_SEI_PIC_TIMING & payloadtype;
+  need_recovery_point = GST_VAAPI_H264_SEI_RECOVERY_POINT & payloadtype;
 
   if (need_buf_period) {
     /* Write a Buffering Period SEI message */
@@ -1686,6 +1787,17 @@ add_packed_sei_header (GstVaapiEncoderH264 * encoder,
     pic_timing_payload = GST_BIT_WRITER_DATA (&bs_pic_timing);
   }
 
+  if (need_recovery_point) {
+    /* Write a Recovery Point SEI message */
+    bs_write_sei_recovery_point (&bs_recovery_point, encoder, picture);
+    /* Write byte alignment bits */
+    if (GST_BIT_WRITER_BIT_SIZE (&bs_recovery_point) % 8 != 0)
+      bs_write_trailing_bits (&bs_recovery_point);
+    recovery_point_payload_size =
+        (GST_BIT_WRITER_BIT_SIZE (&bs_recovery_point)) / 8;
+    recovery_point_payload = GST_BIT_WRITER_DATA (&bs_recovery_point);
+  }
+
   /* Write the SEI message */
   WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
   bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_NONE, GST_H264_NAL_SEI);
@@ -1704,6 +1816,14 @@ add_packed_sei_header (GstVaapiEncoderH264 * encoder,
     gst_bit_writer_put_bytes (&bs, pic_timing_payload, pic_timing_payload_size);
   }
 
+  if (need_recovery_point) {
+    WRITE_UINT32 (&bs, GST_H264_SEI_RECOVERY_POINT, 8);
+    WRITE_UINT32 (&bs, recovery_point_payload_size, 8);
+    /* Add recovery point sei message */
+    gst_bit_writer_put_bytes (&bs, recovery_point_payload,
+        recovery_point_payload_size);
+  }
+
   /* rbsp_trailing_bits */
   bs_write_trailing_bits (&bs);
 
@@ -1725,6 +1845,7 @@ add_packed_sei_header (GstVaapiEncoderH264 * encoder,
 
   gst_bit_writer_reset (&bs_buf_period);
   gst_bit_writer_reset (&bs_pic_timing);
+  gst_bit_writer_reset (&bs_recovery_point);
   gst_bit_writer_reset (&bs);
   return TRUE;
 
@@ -1734,6 +1855,7 @@ bs_error:
     GST_WARNING ("failed to write SEI NAL unit");
     gst_bit_writer_reset (&bs_buf_period);
     gst_bit_writer_reset (&bs_pic_timing);
+    gst_bit_writer_reset (&bs_recovery_point);
     gst_bit_writer_reset (&bs);
     return FALSE;
   }
@@ -1904,13 +2026,49 @@ reference_pic_create (GstVaapiEncoderH264 * encoder,
   return ref;
 }
 
+/* Looks up the long-term reference assigned to @long_term_frame_idx */
+static GstVaapiEncoderH264Ref *
+reference_list_find_long_term (GQueue * ref_list, guint long_term_frame_idx)
+{
+  GstVaapiEncoderH264Ref *ref;
+  GList *iter;
+
+  for (iter = g_queue_peek_head_link (ref_list); iter;
+      iter = g_list_next (iter)) {
+    ref = (GstVaapiEncoderH264Ref *) iter->data;
+    if (ref->is_long_term && ref->long_term_frame_idx == long_term_frame_idx)
+      return ref;
+  }
+  return NULL;
+}
+
+/* Removes the oldest short-term reference, as the sliding window
+ * marking process does (8.2.5.3) */
+static GstVaapiEncoderH264Ref *
+reference_list_pop_short_term (GQueue * ref_list)
+{
+  GstVaapiEncoderH264Ref *ref;
+  GList *iter;
+
+  for (iter = g_queue_peek_head_link (ref_list); iter;
+      iter = g_list_next (iter)) {
+    ref = (GstVaapiEncoderH264Ref *) iter->data;
+    if (!ref->is_long_term) {
+      g_queue_delete_link (ref_list, iter);
+      return ref;
+    }
+  }
+  return NULL;
+}
+
 static gboolean
 reference_list_update (GstVaapiEncoderH264 * encoder,
     GstVaapiEncPicture * picture, GstVaapiSurfaceProxy * surface)
 {
-  GstVaapiEncoderH264Ref *ref;
+  GstVaapiEncoderH264Ref *ref, *old_ref;
   GstVaapiH264ViewRefPool *const ref_pool =
       &encoder->ref_pools[encoder->view_idx];
+  guint i;
 
   if (encoder->prediction_type == GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT
       && GST_VAAPI_PICTURE_TYPE_B == picture->type) {
@@ -1920,17 +2078,195 @@ reference_list_update (GstVaapiEncoderH264 * encoder,
   if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture)) {
     while (!g_queue_is_empty (&ref_pool->ref_list))
       reference_pic_free (encoder, g_queue_pop_head (&ref_pool->ref_list));
+  } else if (encoder->num_mmco > 0) {
+    /* adaptive marking: the sliding window is not applied */
+    for (i = 0; i < encoder->num_mmco; i++) {
+      if (encoder->mmco[i].op != GST_VAAPI_H264_MMCO_UNMARK_SHORT_TERM)
+        continue;
+      g_queue_remove (&ref_pool->ref_list, encoder->mmco[i].ref);
+      reference_pic_free (encoder, encoder->mmco[i].ref);
+      encoder->mmco[i].ref = NULL;
+    }
   } else if (g_queue_get_length (&ref_pool->ref_list) >=
       ref_pool->max_ref_frames) {
-    reference_pic_free (encoder, g_queue_pop_head (&ref_pool->ref_list));
+    reference_pic_free (encoder,
+        reference_list_pop_short_term (&ref_pool->ref_list));
   }
   ref = reference_pic_create (encoder, picture, surface);
+  if (encoder->ltr_mark_idx >= 0) {
+    /* marking replaces any frame holding the same long-term index */
+    old_ref = reference_list_find_long_term (&ref_pool->ref_list,
+        encoder->ltr_mark_idx);
+    if (old_ref) {
+      g_queue_remove (&ref_pool->ref_list, old_ref);
+      reference_pic_free (encoder, old_ref);
+    }
+    ref->is_long_term = TRUE;
+    ref->long_term_frame_idx = encoder->ltr_mark_idx;
+    GST_DEBUG ("frame_num %u marked as long-term reference %u",
+        ref->frame_num, ref->long_term_frame_idx);
+  }
   g_queue_push_tail (&ref_pool->ref_list, ref);
   g_assert (g_queue_get_length (&ref_pool->ref_list) <=
       ref_pool->max_ref_frames);
   return TRUE;
 }
 
+static void
+add_mmco (GstVaapiEncoderH264 * encoder, GstVaapiH264MmcoType op,
+    guint value, GstVaapiEncoderH264Ref * ref)
+{
+  GstVaapiEncoderH264Mmco *mmco;
+
+  g_assert (encoder->num_mmco < MAX_MMCO_OPS);
+  mmco = &encoder->mmco[encoder->num_mmco++];
+  mmco->op = op;
+  mmco->value = value;
+  mmco->ref = ref;
+}
+
+static void
+add_mmco_unmark_short_term (GstVaapiEncoderH264 * encoder,
+    GstVaapiEncPicture * picture, GstVaapiEncoderH264Ref * ref)
+{
+  guint diff;
+
+  /* picNumX = CurrPicNum - (difference_of_pic_nums_minus1 + 1) */
+  diff = (picture->frame_num + encoder->max_frame_num - ref->frame_num) %
+      encoder->max_frame_num;
+  g_assert (diff > 0);
+  add_mmco (encoder, GST_VAAPI_H264_MMCO_UNMARK_SHORT_TERM, diff - 1, ref);
+}
+
+/* Takes the pending long-term reference requests into account for the
+ * current picture and derives the memory management operations that
+ * keep the decoder marking in sync with the reference pool */
+static gboolean
+ensure_long_term_refs (GstVaapiEncoderH264 * encoder,
+    GstVaapiEncPicture * picture)
+{
+  GstVaapiH264ViewRefPool *const ref_pool =
+      &encoder->ref_pools[encoder->view_idx];
+  GstVaapiEncoderH264Ref *ref;
+  GList *iter;
+  gint mark_idx, use_idx;
+  guint num_short_term = 0, num_long_term = 0;
+
+  encoder->ltr_mark_idx = -1;
+  encoder->ltr_use_ref = NULL;
+  encoder->num_mmco = 0;
+
+  if (encoder->num_ltr_frames == 0)
+    return TRUE;
+
+  /* IDR pictures flush every reference: a mark request is deferred to
+   * the next picture while a use request is void. Otherwise, a use
+   * request waits for the next P picture */
+  GST_OBJECT_LOCK (encoder);
+  mark_idx = encoder->ltr_mark_pending;
+  use_idx = encoder->ltr_use_pending;
+  if (!GST_VAAPI_ENC_PICTURE_IS_IDR (picture))
+    encoder->ltr_mark_pending = -1;
+  if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture) ||
+      picture->type == GST_VAAPI_PICTURE_TYPE_P)
+    encoder->ltr_use_pending = -1;
+  GST_OBJECT_UNLOCK (encoder);
+
+  if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture)) {
+    if (use_idx >= 0)
+      GST_DEBUG ("dropping long-term reference %d use request on IDR",
+          use_idx);
+    encoder->ltr_max_idx_set = FALSE;
+    return TRUE;
+  }
+  if (use_idx >= 0 && picture->type != GST_VAAPI_PICTURE_TYPE_P) {
+    GST_DEBUG ("deferring long-term reference %d use request to the next "
+        "P picture", use_idx);
+    use_idx = -1;
+  }
+  if (mark_idx < 0 && use_idx < 0)
+    return TRUE;
+
+  /* marking operations live in the slice header */
+  if (!(GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
+          VA_ENC_PACKED_HEADER_SLICE))
+    goto error_unsupported;
+
+  if (mark_idx >= (gint) encoder->num_ltr_frames) {
+    GST_WARNING ("long-term reference index %d out of range", mark_idx);
+    mark_idx = -1;
+  }
+
+  if (use_idx >= 0) {
+    encoder->ltr_use_ref =
+        reference_list_find_long_term (&ref_pool->ref_list, use_idx);
+    if (!encoder->ltr_use_ref)
+      GST_WARNING ("no long-term reference with index %d", use_idx);
+  }
+
+  if (mark_idx < 0 && !encoder->ltr_use_ref)
+    return TRUE;
+
+  for (iter = g_queue_peek_head_link (&ref_pool->ref_list); iter;
+      iter = g_list_next (iter)) {
+    ref = (GstVaapiEncoderH264Ref *) iter->data;
+    if (ref->is_long_term)
+      num_long_term++;
+    else
+      num_short_term++;
+  }
+
+  /* a picture predicted from a long-term reference is a recovery
+   * point: drop the short-term references that could be corrupted */
+  if (encoder->ltr_use_ref) {
+    for (iter = g_queue_peek_head_link (&ref_pool->ref_list); iter;
+        iter = g_list_next (iter)) {
+      ref = (GstVaapiEncoderH264Ref *) iter->data;
+      if (!ref->is_long_term)
+        add_mmco_unmark_short_term (encoder, picture, ref);
+    }
+    num_short_term = 0;
+  }
+
+  if (mark_idx >= 0 &&
+      reference_list_find_long_term (&ref_pool->ref_list, mark_idx))
+    num_long_term--;
+
+  /* the sliding window doesn't apply in adaptive marking mode, so
+   * release the oldest short-term references to make room */
+  iter = g_queue_peek_head_link (&ref_pool->ref_list);
+  while (num_short_term + num_long_term + 1 > ref_pool->max_ref_frames) {
+    g_assert (iter);
+    ref = (GstVaapiEncoderH264Ref *) iter->data;
+    if (!ref->is_long_term) {
+      add_mmco_unmark_short_term (encoder, picture, ref);
+      num_short_term--;
+    }
+    iter = g_list_next (iter);
+  }
+
+  if (mark_idx >= 0) {
+    if (!encoder->ltr_max_idx_set) {
+      add_mmco (encoder, GST_VAAPI_H264_MMCO_SET_MAX_LONG_TERM_IDX,
+          encoder->num_ltr_frames, NULL);
+      encoder->ltr_max_idx_set = TRUE;
+    }
+    add_mmco (encoder, GST_VAAPI_H264_MMCO_MARK_CURRENT_LONG_TERM,
+        mark_idx, NULL);
+    encoder->ltr_mark_idx = mark_idx;
+  }
+
+  return TRUE;
+
+  /* ERRORS */
+error_unsupported:
+  {
+    GST_WARNING ("long-term references require packed slice headers, "
+        "ignoring request");
+    return TRUE;
+  }
+}
+
 /* update reflist0 for hierarchical-p and hierarchical-b encode */
 static void
 reflist0_init_hierarchical (GstVaapiEncoderH264 * encoder,
@@ -2034,6 +2370,42 @@ reference_list_init_hierarchical (GstVaapiEncoderH264 * encoder,
   return TRUE;
 }
 
+/* update reflist0 when long-term references are enabled, thus P-only
+ * encode: short-term references come first by descending PicNum, then
+ * long-term references by ascending LongTermPicNum (8.2.4.2.1) */
+static gboolean
+reference_list_init_long_term (GstVaapiEncoderH264 * encoder,
+    GstVaapiEncPicture * picture, GQueue * ref_list,
+    GstVaapiEncoderH264Ref ** reflist_0, guint * reflist_0_count)
+{
+  GstVaapiEncoderH264Ref *tmp;
+  GList *iter;
+  guint count = 0, i;
+
+  /* predict from the requested long-term reference only */
+  if (encoder->ltr_use_ref) {
+    reflist_0[0] = encoder->ltr_use_ref;
+    *reflist_0_count = 1;
+    return TRUE;
+  }
+
+  iter = g_queue_peek_tail_link (ref_list);
+  for (; iter; iter = g_list_previous (iter)) {
+    tmp = (GstVaapiEncoderH264Ref *) iter->data;
+    if (!tmp->is_long_term)
+      reflist_0[count++] = tmp;
+  }
+  for (i = 0; i < encoder->num_ltr_frames; i++) {
+    tmp = reference_list_find_long_term (ref_list, i);
+    if (tmp)
+      reflist_0[count++] = tmp;
+  }
+
+  g_assert (count != 0);
+  *reflist_0_count = count;
+  return TRUE;
+}
+
 static gboolean
 reference_list_init (GstVaapiEncoderH264 * encoder,
     GstVaapiEncPicture * picture,
@@ -2052,6 +2424,11 @@ reference_list_init (GstVaapiEncoderH264 * encoder,
   if (picture->type == GST_VAAPI_PICTURE_TYPE_I)
     return TRUE;
 
+  if (encoder->num_ltr_frames > 0) {
+    return reference_list_init_long_term (encoder, picture,
+        &ref_pool->ref_list, reflist_0, reflist_0_count);
+  }
+
   /* reference picture handling for hierarchial encode */
   if (encoder->prediction_type != GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT) {
     return reference_list_init_hierarchical (encoder, picture,
@@ -2107,6 +2484,12 @@ fill_sequence (GstVaapiEncoderH264 * encoder, GstVaapiEncSequence * sequence)
   seq_param->level_idc = encoder->level_idc;
   seq_param->intra_period = GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder);
   seq_param->intra_idr_period = GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder);
+  /* only the first picture is an intra picture with native intra
+   * refresh; the QP shaping fallback keeps the regular GOP */
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder)) {
+    seq_param->intra_period = 0;
+    seq_param->intra_idr_period = 0;
+  }
   seq_param->ip_period = encoder->ip_period;
   seq_param->bits_per_second = encoder->bitrate_bits;
 
@@ -2218,9 +2601,16 @@ fill_picture (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
       pic_param->ReferenceFrames[i].picture_id =
           GST_VAAPI_SURFACE_PROXY_SURFACE_ID (ref_pic->pic);
       pic_param->ReferenceFrames[i].TopFieldOrderCnt = ref_pic->poc;
-      pic_param->ReferenceFrames[i].flags |=
-          VA_PICTURE_H264_SHORT_TERM_REFERENCE;
-      pic_param->ReferenceFrames[i].frame_idx = ref_pic->frame_num;
+      if (ref_pic->is_long_term) {
+        pic_param->ReferenceFrames[i].flags |=
+            VA_PICTURE_H264_LONG_TERM_REFERENCE;
+        pic_param->ReferenceFrames[i].frame_idx =
+            ref_pic->long_term_frame_idx;
+      } else {
+        pic_param->ReferenceFrames[i].flags |=
+            VA_PICTURE_H264_SHORT_TERM_REFERENCE;
+        pic_param->ReferenceFrames[i].frame_idx = ref_pic->frame_num;
+      }
       ++i;
     }
     g_assert (i <= 16 && i <= ref_pool->max_ref_frames);
@@ -2330,9 +2720,17 @@ add_slice_headers (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
             GST_VAAPI_SURFACE_PROXY_SURFACE_ID (reflist_0[i_ref]->pic);
         slice_param->RefPicList0[i_ref].TopFieldOrderCnt =
             reflist_0[i_ref]->poc;
-        slice_param->RefPicList0[i_ref].flags |=
-            VA_PICTURE_H264_SHORT_TERM_REFERENCE;
-        slice_param->RefPicList0[i_ref].frame_idx = reflist_0[i_ref]->frame_num;
+        if (reflist_0[i_ref]->is_long_term) {
+          slice_param->RefPicList0[i_ref].flags |=
+              VA_PICTURE_H264_LONG_TERM_REFERENCE;
+          slice_param->RefPicList0[i_ref].frame_idx =
+              reflist_0[i_ref]->long_term_frame_idx;
+        } else {
+          slice_param->RefPicList0[i_ref].flags |=
+              VA_PICTURE_H264_SHORT_TERM_REFERENCE;
+          slice_param->RefPicList0[i_ref].frame_idx =
+              reflist_0[i_ref]->frame_num;
+        }
       }
     }
     for (; i_ref < G_N_ELEMENTS (slice_param->RefPicList0); ++i_ref) {
@@ -2549,6 +2947,8 @@ static gboolean
 ensure_misc_params (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture)
 {
   GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
+  guint payloadtype = GST_VAAPI_H264_SEI_UNKNOWN;
+  gint qp;
 
   if (!gst_vaapi_encoder_ensure_param_control_rate (base_encoder, picture))
     return FALSE;
@@ -2556,28 +2956,51 @@ ensure_misc_params (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture)
   if (GST_VAAPI_ENCODER_RATE_CONTROL (encoder) == GST_VAAPI_RATECONTROL_CBR ||
       GST_VAAPI_ENCODER_RATE_CONTROL (encoder) == GST_VAAPI_RATECONTROL_VBR) {
     if (!encoder->view_idx) {
-      if ((GST_VAAPI_ENC_PICTURE_IS_IDR (picture)) &&
-          (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
-              VA_ENC_PACKED_HEADER_MISC) &&
-          !add_packed_sei_header (encoder, picture,
-              GST_VAAPI_H264_SEI_BUF_PERIOD | GST_VAAPI_H264_SEI_PIC_TIMING))
-        goto error_create_packed_sei_hdr;
-
-      else if (!GST_VAAPI_ENC_PICTURE_IS_IDR (picture) &&
-          (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
-              VA_ENC_PACKED_HEADER_MISC) &&
-          !add_packed_sei_header (encoder, picture,
-              GST_VAAPI_H264_SEI_PIC_TIMING))
-        goto error_create_packed_sei_hdr;
+      if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture))
+        payloadtype |= GST_VAAPI_H264_SEI_BUF_PERIOD;
+      payloadtype |= GST_VAAPI_H264_SEI_PIC_TIMING;
     }
   }
 
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH (encoder) !=
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE) {
+    if (picture->type == GST_VAAPI_PICTURE_TYPE_I) {
+      encoder->intra_refresh_pos = 0;
+    } else {
+      /* signal the start of each refresh cycle as a random access
+       * point, which only holds if the driver refreshes the picture */
+      if (encoder->intra_refresh_pos == 0 &&
+          GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder))
+        payloadtype |= GST_VAAPI_H264_SEI_RECOVERY_POINT;
+      if (!gst_vaapi_encoder_ensure_param_intra_refresh (base_encoder,
+              picture, encoder->intra_refresh_pos))
+        return FALSE;
+      encoder->intra_refresh_pos = (encoder->intra_refresh_pos + 1) %
+          base_encoder->intra_refresh_period;
+    }
+  }
+
+  if (payloadtype != GST_VAAPI_H264_SEI_UNKNOWN &&
+      (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
+          VA_ENC_PACKED_HEADER_MISC) &&
+      !add_packed_sei_header (encoder, picture, payloadtype))
+    goto error_create_packed_sei_hdr;
+
   if (!gst_vaapi_encoder_ensure_param_trellis (base_encoder, picture))
     return FALSE;
 
   if (!gst_vaapi_encoder_ensure_param_roi_regions (base_encoder, picture))
     return FALSE;
 
+  qp = encoder->qp_i;
+  if (picture->type == GST_VAAPI_PICTURE_TYPE_P)
+    qp += (gint) encoder->qp_ip;
+  else if (picture->type == GST_VAAPI_PICTURE_TYPE_B)
+    qp += (gint) encoder->qp_ib;
+  if (!gst_vaapi_encoder_ensure_param_qp_map (base_encoder, picture, 16, qp,
+          encoder->min_qp, encoder->max_qp))
+    return FALSE;
+
   if (!gst_vaapi_encoder_ensure_param_quality_level (base_encoder, picture))
     return FALSE;
 
@@ -2760,7 +3183,7 @@ ensure_profile_and_level (GstVaapiEncoderH264 * encoder)
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 }
 
-static void
+static GstVaapiEncoderStatus
 reset_properties (GstVaapiEncoderH264 * encoder)
 {
   GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
@@ -2789,6 +3212,27 @@ reset_properties (GstVaapiEncoderH264 * encoder)
   gst_vaapi_encoder_ensure_max_num_ref_frames (base_encoder, encoder->profile,
       encoder->entrypoint);
 
+  /* Intra refresh is not compatible with MVC */
+  gst_vaapi_encoder_ensure_intra_refresh (base_encoder, encoder->profile,
+      encoder->entrypoint, encoder->is_mvc ?
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE : encoder->intra_refresh,
+      encoder->intra_refresh_period, 16, encoder->mb_width,
+      encoder->mb_height);
+  encoder->intra_refresh_pos = 0;
+
+  /* The refresh stripes are spread over consecutive reference frames,
+   * so neither B-frames nor hierarchical prediction can be used */
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH (encoder) !=
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE) {
+    if (encoder->num_bframes > 0 || encoder->temporal_levels > 1 ||
+        encoder->prediction_type != GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT)
+      GST_WARNING ("Disabling b-frames and temporal scalability since "
+          "intra refresh is enabled");
+    encoder->num_bframes = 0;
+    encoder->temporal_levels = 1;
+    encoder->prediction_type = GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT;
+  }
+
   if (base_encoder->max_num_ref_frames_1 < 1 && encoder->num_bframes > 0) {
     GST_WARNING ("Disabling b-frame since the driver doesn't support it");
     encoder->num_bframes = 0;
@@ -2869,6 +3313,36 @@ reset_properties (GstVaapiEncoderH264 * encoder)
         (1 + encoder->num_bframes) : 0;
   }
 
+  /* Long-term references are only handled for low-delay P-only
+   * encoding, where every picture but the IDR is marked through the
+   * slice header */
+  if (encoder->num_ltr_frames > 0 && (encoder->num_bframes > 0
+          || encoder->is_mvc
+          || encoder->prediction_type !=
+          GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT)) {
+    GST_WARNING ("Disabling long-term references since b-frames, MVC or "
+        "temporal scalability are enabled");
+    encoder->num_ltr_frames = 0;
+  }
+  encoder->ltr_max_idx_set = FALSE;
+
+  /* Long-term references are appended to the short-term ones in the
+   * reference list 0, whose size the driver bounds */
+  if (encoder->num_ltr_frames > 0) {
+    const guint max_ref_frames =
+        MIN (base_encoder->max_num_ref_frames_0, MAX_REF_FRAMES);
+
+    if (encoder->num_ltr_frames + 1 > max_ref_frames)
+      goto error_too_many_ltr_frames;
+
+    if (encoder->num_ref_frames + encoder->num_ltr_frames > max_ref_frames) {
+      encoder->num_ref_frames = max_ref_frames - encoder->num_ltr_frames;
+      GST_INFO ("Lowering the number of reference frames to %d, to fit %d "
+          "long-term references", encoder->num_ref_frames,
+          encoder->num_ltr_frames);
+    }
+  }
+
   for (i = 0; i < encoder->num_views; i++) {
     GstVaapiH264ViewRefPool *const ref_pool = &encoder->ref_pools[i];
     GstVaapiH264ViewReorderPool *const reorder_pool =
@@ -2877,8 +3351,9 @@ reset_properties (GstVaapiEncoderH264 * encoder)
     if (encoder->prediction_type == GST_VAAPI_ENCODER_H264_PREDICTION_DEFAULT) {
       ref_pool->max_reflist0_count = encoder->num_ref_frames;
       ref_pool->max_reflist1_count = encoder->num_bframes > 0;
+      /* long-term references take extra room in the DPB */
       ref_pool->max_ref_frames = ref_pool->max_reflist0_count
-          + ref_pool->max_reflist1_count;
+          + ref_pool->max_reflist1_count + encoder->num_ltr_frames;
     } else {
       guint d;
 
@@ -2903,6 +3378,16 @@ reset_properties (GstVaapiEncoderH264 * encoder)
 
     reorder_pool->frame_index = 0;
   }
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_too_many_ltr_frames:
+  {
+    GST_ERROR ("the driver supports %d reference frames, which cannot fit "
+        "%d long-term references and a short-term one",
+        base_encoder->max_num_ref_frames_0, encoder->num_ltr_frames);
+    return GST_VAAPI_ENCODER_STATUS_ERROR_INVALID_PARAMETER;
+  }
 }
 
 static GstVaapiEncoderStatus
@@ -2921,6 +3406,8 @@ gst_vaapi_encoder_h264_encode (GstVaapiEncoder * base_encoder,
     goto error;
   if (!ensure_misc_params (encoder, picture))
     goto error;
+  if (!ensure_long_term_refs (encoder, picture))
+    goto error;
   if (!ensure_picture (encoder, picture, codedbuf, reconstruct))
     goto error;
   if (!ensure_slices (encoder, picture))
@@ -3165,7 +3652,7 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
   GstVaapiEncoderH264 *const encoder = GST_VAAPI_ENCODER_H264 (base_encoder);
   GstVaapiH264ViewReorderPool *reorder_pool = NULL;
   GstVaapiEncPicture *picture;
-  gboolean is_idr = FALSE;
+  gboolean is_idr = FALSE, is_intra_refresh;
 
   *output = NULL;
 
@@ -3218,13 +3705,19 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
   picture->temporal_id = (encoder->temporal_levels == 1) ? 1 :
       get_temporal_id (encoder, reorder_pool->frame_index);
 
-  is_idr = (reorder_pool->frame_index == 0 ||
-      reorder_pool->frame_index >= encoder->idr_period);
+  /* with native intra refresh, only the first frame (or a forced key
+   * frame) is an IDR frame: the GOP is infinite. The QP shaping
+   * fallback does not force intra macroblocks, so it keeps the
+   * regular IDR and key frames */
+  is_intra_refresh = GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder);
+
+  is_idr = (reorder_pool->frame_index == 0 || (!is_intra_refresh &&
+          reorder_pool->frame_index >= encoder->idr_period));
 
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
-      (reorder_pool->frame_index %
-          GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder)) == 0) {
+      (!is_intra_refresh && (reorder_pool->frame_index %
+              GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder)) == 0)) {
     ++reorder_pool->frame_index;
 
     /* b frame enabled,  check queue of reorder_frame_list */
@@ -3385,7 +3878,10 @@ gst_vaapi_encoder_h264_reconfigure (GstVaapiEncoder * base_encoder)
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     return status;
 
-  reset_properties (encoder);
+  status = reset_properties (encoder);
+  if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+    return status;
+
   ensure_control_rate_params (encoder);
   return set_context_info (base_encoder);
 }
@@ -3437,6 +3933,10 @@ gst_vaapi_encoder_h264_init (GstVaapiEncoderH264 * encoder)
 
   encoder->compliance_mode = GST_VAAPI_ENCODER_H264_COMPLIANCE_MODE_STRICT;
   encoder->min_cr = 1;
+
+  encoder->ltr_mark_pending = -1;
+  encoder->ltr_use_pending = -1;
+  encoder->ltr_mark_idx = -1;
 }
 
 static void
@@ -3558,6 +4058,12 @@ get_view_ids (GstVaapiEncoderH264 * const encoder, GValue * value)
  * @ENCODER_H264_PROP_PREDICTION_TYPE: Reference picture selection modes
  * @ENCODER_H264_PROP_MAX_QP: Maximal quantizer value (uint).
  * @ENCODER_H264_PROP_QUALITY_FACTOR: Factor for ICQ/QVBR bitrate control mode.
+ * @ENCODER_H264_PROP_INTRA_REFRESH: Gradual decoder refresh mode
+ *   (#GstVaapiEncoderIntraRefresh).
+ * @ENCODER_H264_PROP_INTRA_REFRESH_PERIOD: Number of frames of an
+ *   intra refresh cycle (uint).
+ * @ENCODER_H264_PROP_NUM_LTR_FRAMES: Number of long-term reference
+ *   frames (uint).
  *
  * The set of H.264 encoder specific configurable properties.
  */
@@ -3584,6 +4090,9 @@ enum
   ENCODER_H264_PROP_PREDICTION_TYPE,
   ENCODER_H264_PROP_MAX_QP,
   ENCODER_H264_PROP_QUALITY_FACTOR,
+  ENCODER_H264_PROP_INTRA_REFRESH,
+  ENCODER_H264_PROP_INTRA_REFRESH_PERIOD,
+  ENCODER_H264_PROP_NUM_LTR_FRAMES,
   ENCODER_H264_N_PROPERTIES
 };
 
@@ -3667,6 +4176,15 @@ gst_vaapi_encoder_h264_set_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       encoder->quality_factor = g_value_get_uint (value);
       break;
+    case ENCODER_H264_PROP_INTRA_REFRESH:
+      encoder->intra_refresh = g_value_get_enum (value);
+      break;
+    case ENCODER_H264_PROP_INTRA_REFRESH_PERIOD:
+      encoder->intra_refresh_period = g_value_get_uint (value);
+      break;
+    case ENCODER_H264_PROP_NUM_LTR_FRAMES:
+      encoder->num_ltr_frames = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3743,6 +4261,15 @@ gst_vaapi_encoder_h264_get_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       g_value_set_uint (value, encoder->quality_factor);
       break;
+    case ENCODER_H264_PROP_INTRA_REFRESH:
+      g_value_set_enum (value, encoder->intra_refresh);
+      break;
+    case ENCODER_H264_PROP_INTRA_REFRESH_PERIOD:
+      g_value_set_uint (value, encoder->intra_refresh_period);
+      break;
+    case ENCODER_H264_PROP_NUM_LTR_FRAMES:
+      g_value_set_uint (value, encoder->num_ltr_frames);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -4043,10 +4570,67 @@ gst_vaapi_encoder_h264_class_init (GstVaapiEncoderH264Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH264:intra-refresh:
+   *
+   * Refresh the picture with rolling columns or rows of intra
+   * macroblocks instead of periodic IDR frames, which keeps the size
+   * of the encoded frames nearly constant. Only the first frame is an
+   * IDR frame and a recovery point SEI is inserted at the start of
+   * each refresh cycle.
+   *
+   * If the driver cannot do rolling intra refresh, the refreshed
+   * stripe is only encoded with a lower QP: the regular IDR frames
+   * are kept and no recovery point SEI is inserted.
+   */
+  properties[ENCODER_H264_PROP_INTRA_REFRESH] =
+      g_param_spec_enum ("intra-refresh",
+      "Intra Refresh",
+      "Gradual decoder refresh mode replacing periodic key frames",
+      GST_VAAPI_TYPE_ENCODER_INTRA_REFRESH,
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
+  /**
+   * GstVaapiEncoderH264:intra-refresh-period:
+   *
+   * The number of frames needed to refresh the whole picture when
+   * intra refresh is enabled.
+   */
+  properties[ENCODER_H264_PROP_INTRA_REFRESH_PERIOD] =
+      g_param_spec_uint ("intra-refresh-period",
+      "Intra Refresh Period",
+      "Number of frames of an intra refresh cycle",
+      1, 1024, 30,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
+  /**
+   * GstVaapiEncoderH264:long-term-refs:
+   *
+   * The number of long-term reference frames kept besides the
+   * short-term ones. Frames are marked and used as long-term
+   * references on request, either through
+   * gst_vaapi_encoder_h264_mark_long_term_ref() and
+   * gst_vaapi_encoder_h264_use_long_term_ref() or through the
+   * upstream event handled by the element. Only available for
+   * low-delay P-only encoding (no b-frames, no temporal scalability
+   * and no MVC).
+   */
+  properties[ENCODER_H264_PROP_NUM_LTR_FRAMES] =
+      g_param_spec_uint ("long-term-refs",
+      "Long-term References",
+      "Number of long-term reference frames (0: disabled)",
+      0, MAX_LONG_TERM_REFS, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H264_N_PROPERTIES,
       properties);
 
   gst_type_mark_as_plugin_api (GST_VAAPI_TYPE_ENCODER_MBBRC, 0);
+  gst_type_mark_as_plugin_api (GST_VAAPI_TYPE_ENCODER_INTRA_REFRESH, 0);
   gst_type_mark_as_plugin_api (gst_vaapi_encoder_h264_prediction_type (), 0);
   gst_type_mark_as_plugin_api (g_class_data.rate_control_get_type (), 0);
   gst_type_mark_as_plugin_api (g_class_data.encoder_tune_get_type (), 0);
@@ -4148,3 +4732,81 @@ gst_vaapi_encoder_h264_supports_avc (GstVaapiEncoderH264 * encoder)
           (VA_ENC_PACKED_HEADER_SEQUENCE | VA_ENC_PACKED_HEADER_PICTURE)) ==
       (VA_ENC_PACKED_HEADER_SEQUENCE | VA_ENC_PACKED_HEADER_PICTURE));
 }
+
+/**
+ * gst_vaapi_encoder_h264_mark_long_term_ref:
+ * @encoder: a #GstVaapiEncoderH264
+ * @long_term_frame_idx: the long-term index to assign
+ *
+ * Requests the next encoded reference picture to be marked as a
+ * long-term reference with @long_term_frame_idx, replacing the frame
+ * previously holding that index. If the next picture is an IDR, the
+ * request is postponed to the following one.
+ *
+ * This function is thread safe and can be called while encoding.
+ *
+ * Return value: %TRUE on success, %FALSE if @long_term_frame_idx is
+ *   not less than the #GstVaapiEncoderH264:long-term-refs property
+ */
+gboolean
+gst_vaapi_encoder_h264_mark_long_term_ref (GstVaapiEncoderH264 * encoder,
+    guint long_term_frame_idx)
+{
+  g_return_val_if_fail (encoder != NULL, FALSE);
+
+  GST_OBJECT_LOCK (encoder);
+  if (long_term_frame_idx >= encoder->num_ltr_frames)
+    goto error_invalid_index;
+  encoder->ltr_mark_pending = long_term_frame_idx;
+  GST_OBJECT_UNLOCK (encoder);
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_index:
+  {
+    GST_OBJECT_UNLOCK (encoder);
+    GST_WARNING ("invalid long-term reference index %u",
+        long_term_frame_idx);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_encoder_h264_use_long_term_ref:
+ * @encoder: a #GstVaapiEncoderH264
+ * @long_term_frame_idx: the long-term index to predict from
+ *
+ * Requests the next encoded P picture to be predicted from the
+ * long-term reference @long_term_frame_idx only. Every short-term
+ * reference is released at the same time, so that the following
+ * pictures don't depend on frames that the receiver may have lost.
+ * This is typically used as a cheaper alternative to an IDR for
+ * error recovery in real-time communication.
+ *
+ * This function is thread safe and can be called while encoding.
+ *
+ * Return value: %TRUE on success, %FALSE if @long_term_frame_idx is
+ *   not less than the #GstVaapiEncoderH264:long-term-refs property
+ */
+gboolean
+gst_vaapi_encoder_h264_use_long_term_ref (GstVaapiEncoderH264 * encoder,
+    guint long_term_frame_idx)
+{
+  g_return_val_if_fail (encoder != NULL, FALSE);
+
+  GST_OBJECT_LOCK (encoder);
+  if (long_term_frame_idx >= encoder->num_ltr_frames)
+    goto error_invalid_index;
+  encoder->ltr_use_pending = long_term_frame_idx;
+  GST_OBJECT_UNLOCK (encoder);
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_index:
+  {
+    GST_OBJECT_UNLOCK (encoder);
+    GST_WARNING ("invalid long-term reference index %u",
+        long_term_frame_idx);
+    return FALSE;
+  }
+}
@@ -56,6 +56,14 @@ gst_vaapi_encoder_h264_get_profile_and_level (GstVaapiEncoderH264 * encoder,
 gboolean
 gst_vaapi_encoder_h264_supports_avc (GstVaapiEncoderH264 * encoder);
 
+gboolean
+gst_vaapi_encoder_h264_mark_long_term_ref (GstVaapiEncoderH264 * encoder,
+    guint long_term_frame_idx);
+
+gboolean
+gst_vaapi_encoder_h264_use_long_term_ref (GstVaapiEncoderH264 * encoder,
+    guint long_term_frame_idx);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiEncoderH264, gst_object_unref)
 
 G_END_DECLS
@@ -53,7 +53,13 @@
 #define SUPPORTED_PACKED_HEADERS                \
   (VA_ENC_PACKED_HEADER_SEQUENCE |              \
    VA_ENC_PACKED_HEADER_PICTURE  |              \
-   VA_ENC_PACKED_HEADER_SLICE)
+   VA_ENC_PACKED_HEADER_SLICE    |              \
+   SEI_PACKED_HEADERS)
+
+/* Set of VA packed headers only needed to insert SEI messages */
+#define SEI_PACKED_HEADERS                      \
+  (VA_ENC_PACKED_HEADER_RAW_DATA |              \
+   VA_ENC_PACKED_HEADER_MISC)
 
 typedef struct
 {
@@ -160,6 +166,11 @@ struct _GstVaapiEncoderH265
   guint first_slice_segment_in_pic_flag:1;
   guint sps_temporal_mvp_enabled_flag:1;
   guint sample_adaptive_offset_enabled_flag:1;
+
+  /* Intra refresh */
+  GstVaapiEncoderIntraRefresh intra_refresh;
+  guint intra_refresh_period;
+  guint intra_refresh_pos;      /* position in the current refresh cycle */
 };
 
 static inline gboolean
@@ -1467,6 +1478,94 @@ bs_error:
   }
 }
 
+/* Write a SEI recovery point payload */
+static gboolean
+bs_write_sei_recovery_point (GstBitWriter * bs,
+    GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture)
+{
+  GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
+
+  /* recovery_poc_cnt: the picture is correct in content once the
+   * whole refresh cycle has been decoded */
+  WRITE_SE (bs, base_encoder->intra_refresh_period - 1);
+  /* exact_match_flag: motion vectors are not constrained to the
+   * already refreshed area */
+  WRITE_UINT32 (bs, 0, 1);
+  /* broken_link_flag */
+  WRITE_UINT32 (bs, 0, 1);
+
+  return TRUE;
+
+  /* ERRORS */
+bs_error:
+  {
+    GST_WARNING ("failed to write Recovery Point SEI message");
+    return FALSE;
+  }
+}
+
+/* Adds a recovery point SEI message to the list of packed headers to
+   pass down as-is to the encoder */
+static gboolean
+add_packed_sei_recovery_point (GstVaapiEncoderH265 * encoder,
+    GstVaapiEncPicture * picture)
+{
+  GstVaapiEncPackedHeader *packed_sei;
+  GstBitWriter bs, bs_recovery_point;
+  VAEncPackedHeaderParameterBuffer packed_sei_param = { 0 };
+  guint32 data_bit_size;
+  guint8 payload_size;
+  guint8 *data;
+
+  gst_bit_writer_init_with_size (&bs_recovery_point, 128, FALSE);
+  gst_bit_writer_init_with_size (&bs, 128, FALSE);
+
+  if (!bs_write_sei_recovery_point (&bs_recovery_point, encoder, picture))
+    goto bs_error;
+  /* Write byte alignment bits */
+  if (GST_BIT_WRITER_BIT_SIZE (&bs_recovery_point) % 8 != 0)
+    bs_write_trailing_bits (&bs_recovery_point);
+  payload_size = GST_BIT_WRITER_BIT_SIZE (&bs_recovery_point) / 8;
+
+  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
+  bs_write_nal_header (&bs, GST_H265_NAL_PREFIX_SEI);
+  WRITE_UINT32 (&bs, GST_H265_SEI_RECOVERY_POINT, 8);
+  WRITE_UINT32 (&bs, payload_size, 8);
+  gst_bit_writer_put_bytes (&bs, GST_BIT_WRITER_DATA (&bs_recovery_point),
+      payload_size);
+  /* rbsp_trailing_bits */
+  bs_write_trailing_bits (&bs);
+
+  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
+  data = GST_BIT_WRITER_DATA (&bs);
+
+  packed_sei_param.type = VA_ENC_PACKED_HEADER_HEVC_SEI;
+  packed_sei_param.bit_length = data_bit_size;
+  packed_sei_param.has_emulation_bytes = 0;
+
+  packed_sei = gst_vaapi_enc_packed_header_new (GST_VAAPI_ENCODER (encoder),
+      &packed_sei_param, sizeof (packed_sei_param),
+      data, (data_bit_size + 7) / 8);
+  g_assert (packed_sei);
+
+  gst_vaapi_enc_picture_add_packed_header (picture, packed_sei);
+  gst_vaapi_codec_object_replace (&packed_sei, NULL);
+
+  gst_bit_writer_reset (&bs_recovery_point);
+  gst_bit_writer_reset (&bs);
+  return TRUE;
+
+  /* ERRORS */
+bs_error:
+  {
+    GST_WARNING ("failed to write SEI NAL unit");
+    gst_bit_writer_reset (&bs_recovery_point);
+    gst_bit_writer_reset (&bs);
+    return FALSE;
+  }
+}
+
 static gboolean
 get_nal_unit_type (GstVaapiEncPicture * picture, guint8 * nal_unit_type)
 {
@@ -1661,6 +1760,13 @@ fill_sequence (GstVaapiEncoderH265 * encoder, GstVaapiEncSequence * sequence)
   seq_param->intra_idr_period = encoder->idr_period;
   seq_param->ip_period = seq_param->intra_period > 1 ?
       (1 + encoder->num_bframes) : 0;
+  /* only the first picture is an intra picture with native intra
+   * refresh; the QP shaping fallback keeps the regular GOP */
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder)) {
+    seq_param->intra_period = 0;
+    seq_param->intra_idr_period = 0;
+    seq_param->ip_period = 1;
+  }
   seq_param->bits_per_second = encoder->bitrate_bits;
 
   seq_param->pic_width_in_luma_samples = encoder->luma_width;
@@ -2139,14 +2245,53 @@ static gboolean
 ensure_misc_params (GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture)
 {
   GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
+  gint qp;
 
   if (!gst_vaapi_encoder_ensure_param_control_rate (base_encoder, picture))
     return FALSE;
+
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH (encoder) !=
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE) {
+    if (picture->type == GST_VAAPI_PICTURE_TYPE_I) {
+      encoder->intra_refresh_pos = 0;
+    } else {
+      /* signal the start of each refresh cycle as a random access
+       * point, which only holds if the driver refreshes the picture */
+      if (encoder->intra_refresh_pos == 0 &&
+          GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder) &&
+          (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
+              VA_ENC_PACKED_HEADER_MISC) &&
+          !add_packed_sei_recovery_point (encoder, picture))
+        goto error_create_packed_sei_hdr;
+      if (!gst_vaapi_encoder_ensure_param_intra_refresh (base_encoder,
+              picture, encoder->intra_refresh_pos))
+        return FALSE;
+      encoder->intra_refresh_pos = (encoder->intra_refresh_pos + 1) %
+          base_encoder->intra_refresh_period;
+    }
+  }
+
   if (!gst_vaapi_encoder_ensure_param_roi_regions (base_encoder, picture))
     return FALSE;
+
+  qp = encoder->qp_i;
+  if (picture->type == GST_VAAPI_PICTURE_TYPE_P)
+    qp += (gint) encoder->qp_ip;
+  else if (picture->type == GST_VAAPI_PICTURE_TYPE_B)
+    qp += (gint) encoder->qp_ib;
+  if (!gst_vaapi_encoder_ensure_param_qp_map (base_encoder, picture, 32, qp,
+          encoder->min_qp, encoder->max_qp))
+    return FALSE;
   if (!gst_vaapi_encoder_ensure_param_quality_level (base_encoder, picture))
     return FALSE;
   return TRUE;
+
+  /* ERRORS */
+error_create_packed_sei_hdr:
+  {
+    GST_ERROR ("failed to create packed SEI header");
+    return FALSE;
+  }
 }
 
 /* Generates and submits PPS header accordingly into the bitstream */
@@ -2369,6 +2514,26 @@ reset_properties (GstVaapiEncoderH265 * encoder)
   if (!check_ref_list (encoder))
     return GST_VAAPI_ENCODER_STATUS_ERROR_UNKNOWN;
 
+  gst_vaapi_encoder_ensure_intra_refresh (base_encoder, encoder->profile,
+      encoder->entrypoint, encoder->intra_refresh,
+      encoder->intra_refresh_period,
+      encoder->entrypoint == GST_VAAPI_ENTRYPOINT_SLICE_ENCODE_LP ? 64 : 32,
+      encoder->ctu_width, encoder->ctu_height);
+  encoder->intra_refresh_pos = 0;
+
+  /* SEI messages are only inserted for the native intra refresh
+   * recovery points, so don't request those packed headers otherwise */
+  base_encoder->unused_packed_headers =
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder) ? 0 : SEI_PACKED_HEADERS;
+
+  /* The refresh stripes are spread over consecutive reference frames,
+   * so B-frames cannot be used */
+  if (GST_VAAPI_ENCODER_INTRA_REFRESH (encoder) !=
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE && encoder->num_bframes > 0) {
+    GST_WARNING ("Disabling b-frames since intra refresh is enabled");
+    encoder->num_bframes = 0;
+  }
+
   if (base_encoder->max_num_ref_frames_1 < 1 && encoder->num_bframes > 0) {
     GST_WARNING ("Disabling b-frame since the driver doesn't support it");
     encoder->num_bframes = 0;
@@ -2973,7 +3138,7 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
   GstVaapiEncoderH265 *const encoder = GST_VAAPI_ENCODER_H265 (base_encoder);
   GstVaapiH265ReorderPool *reorder_pool = NULL;
   GstVaapiEncPicture *picture;
-  gboolean is_idr = FALSE;
+  gboolean is_idr = FALSE, is_intra_refresh;
 
   *output = NULL;
 
@@ -3007,13 +3172,19 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
   picture->poc = ((reorder_pool->cur_present_index * 1) %
       encoder->max_pic_order_cnt);
 
-  is_idr = (reorder_pool->frame_index == 0 ||
-      reorder_pool->frame_index >= encoder->idr_period);
+  /* with native intra refresh, only the first frame (or a forced key
+   * frame) is an IDR frame: the GOP is infinite. The QP shaping
+   * fallback does not force intra macroblocks, so it keeps the
+   * regular IDR and key frames */
+  is_intra_refresh = GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE (encoder);
+
+  is_idr = (reorder_pool->frame_index == 0 || (!is_intra_refresh &&
+          reorder_pool->frame_index >= encoder->idr_period));
 
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
-      (reorder_pool->frame_index %
-          GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder)) == 0) {
+      (!is_intra_refresh && (reorder_pool->frame_index %
+              GST_VAAPI_ENCODER_KEYFRAME_PERIOD (encoder)) == 0)) {
     ++reorder_pool->frame_index;
 
     /* b frame enabled,  check queue of reorder_frame_list */
@@ -3276,6 +3447,10 @@ gst_vaapi_encoder_h265_finalize (GObject * object)
  * @ENCODER_H265_PROP_QP_IB: Difference of QP between I and B frame.
  * @ENCODER_H265_PROP_LOW_DELAY_B: use low delay b feature.
  * @ENCODER_H265_PROP_MAX_QP: Maximal quantizer value (uint).
+ * @ENCODER_H265_PROP_INTRA_REFRESH: Gradual decoder refresh mode
+ *   (#GstVaapiEncoderIntraRefresh).
+ * @ENCODER_H265_PROP_INTRA_REFRESH_PERIOD: Number of frames of an
+ *   intra refresh cycle (uint).
  *
  * The set of H.265 encoder specific configurable properties.
  */
@@ -3299,6 +3474,8 @@ enum
   ENCODER_H265_PROP_QUALITY_FACTOR,
   ENCODER_H265_PROP_NUM_TILE_COLS,
   ENCODER_H265_PROP_NUM_TILE_ROWS,
+  ENCODER_H265_PROP_INTRA_REFRESH,
+  ENCODER_H265_PROP_INTRA_REFRESH_PERIOD,
   ENCODER_H265_N_PROPERTIES
 };
 
@@ -3377,6 +3554,12 @@ gst_vaapi_encoder_h265_set_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       encoder->num_tile_rows = g_value_get_uint (value);
       break;
+    case ENCODER_H265_PROP_INTRA_REFRESH:
+      encoder->intra_refresh = g_value_get_enum (value);
+      break;
+    case ENCODER_H265_PROP_INTRA_REFRESH_PERIOD:
+      encoder->intra_refresh_period = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3440,6 +3623,12 @@ gst_vaapi_encoder_h265_get_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       g_value_set_uint (value, encoder->num_tile_rows);
       break;
+    case ENCODER_H265_PROP_INTRA_REFRESH:
+      g_value_set_enum (value, encoder->intra_refresh);
+      break;
+    case ENCODER_H265_PROP_INTRA_REFRESH_PERIOD:
+      g_value_set_uint (value, encoder->intra_refresh_period);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3674,9 +3863,47 @@ gst_vaapi_encoder_h265_class_init (GstVaapiEncoderH265Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH265:intra-refresh:
+   *
+   * Refresh the picture with rolling columns or rows of intra CTUs
+   * instead of periodic IDR frames, which keeps the size of the
+   * encoded frames nearly constant. Only the first frame is an IDR
+   * frame and a recovery point SEI is inserted at the start of each
+   * refresh cycle.
+   *
+   * If the driver cannot do rolling intra refresh, the refreshed
+   * stripe is only encoded with a lower QP: the regular IDR frames
+   * are kept and no recovery point SEI is inserted.
+   */
+  properties[ENCODER_H265_PROP_INTRA_REFRESH] =
+      g_param_spec_enum ("intra-refresh",
+      "Intra Refresh",
+      "Gradual decoder refresh mode replacing periodic key frames",
+      GST_VAAPI_TYPE_ENCODER_INTRA_REFRESH,
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
+  /**
+   * GstVaapiEncoderH265:intra-refresh-period:
+   *
+   * The number of frames needed to refresh the whole picture when
+   * intra refresh is enabled.
+   */
+  properties[ENCODER_H265_PROP_INTRA_REFRESH_PERIOD] =
+      g_param_spec_uint ("intra-refresh-period",
+      "Intra Refresh Period",
+      "Number of frames of an intra refresh cycle",
+      1, 1024, 30,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H265_N_PROPERTIES,
       properties);
 
+  gst_type_mark_as_plugin_api (GST_VAAPI_TYPE_ENCODER_INTRA_REFRESH, 0);
+
   gst_type_mark_as_plugin_api (g_class_data.rate_control_get_type (), 0);
   gst_type_mark_as_plugin_api (g_class_data.encoder_tune_get_type (), 0);
 }
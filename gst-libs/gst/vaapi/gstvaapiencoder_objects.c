@@ -23,6 +23,7 @@
 #include "sysdeps.h"
 #include "gstvaapiencoder_objects.h"
 #include "gstvaapiencoder_priv.h"
+#include "gstvaapicodedbuffer_priv.h"
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
@@ -285,6 +286,51 @@ gst_vaapi_enc_q_matrix_new (GstVaapiEncoder * encoder,
   return GST_VAAPI_ENC_Q_MATRIX_CAST (object);
 }
 
+/* ------------------------------------------------------------------------- */
+/* --- Per-block QP                                                      --- */
+/* ------------------------------------------------------------------------- */
+
+#if VA_CHECK_VERSION(1,0,0)
+GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncQPBuffer, gst_vaapi_enc_qp_buffer);
+
+void
+gst_vaapi_enc_qp_buffer_destroy (GstVaapiEncQPBuffer * qp_buffer)
+{
+  vaapi_destroy_buffer (GET_VA_DISPLAY (qp_buffer), &qp_buffer->param_id);
+  qp_buffer->param = NULL;
+}
+
+gboolean
+gst_vaapi_enc_qp_buffer_create (GstVaapiEncQPBuffer * qp_buffer,
+    const GstVaapiCodecObjectConstructorArgs * args)
+{
+  qp_buffer->param_id = VA_INVALID_ID;
+  return vaapi_create_buffer (GET_VA_DISPLAY (qp_buffer),
+      GET_VA_CONTEXT (qp_buffer), VAEncQPBufferType, args->param_size, NULL,
+      &qp_buffer->param_id, &qp_buffer->param);
+}
+
+/* @size is the size of the whole grid of VAEncQPBufferH264 values, as
+ * laid out by the caller */
+GstVaapiEncQPBuffer *
+gst_vaapi_enc_qp_buffer_new (GstVaapiEncoder * encoder, guint size)
+{
+  GstVaapiCodecObject *object;
+
+  object = gst_vaapi_codec_object_new (&GstVaapiEncQPBufferClass,
+      GST_VAAPI_CODEC_BASE (encoder), NULL, size, NULL, 0, 0);
+  if (!object)
+    return NULL;
+  return GST_VAAPI_ENC_QP_BUFFER_CAST (object);
+}
+#else
+GstVaapiEncQPBuffer *
+gst_vaapi_enc_qp_buffer_new (GstVaapiEncoder * encoder, guint size)
+{
+  return NULL;
+}
+#endif
+
 /* ------------------------------------------------------------------------- */
 /* --- JPEG Huffman Tables                                               --- */
 /* ------------------------------------------------------------------------- */
@@ -346,6 +392,7 @@ gst_vaapi_enc_picture_destroy (GstVaapiEncPicture * picture)
 
   gst_vaapi_codec_object_replace (&picture->q_matrix, NULL);
   gst_vaapi_codec_object_replace (&picture->huf_table, NULL);
+  gst_vaapi_codec_object_replace (&picture->qp_buffer, NULL);
 
   gst_vaapi_codec_object_replace (&picture->sequence, NULL);
 
@@ -385,6 +432,7 @@ gst_vaapi_enc_picture_create (GstVaapiEncPicture * picture,
   picture->pts = GST_CLOCK_TIME_NONE;
   picture->frame_num = 0;
   picture->poc = 0;
+  picture->queued_time = g_get_monotonic_time ();
 
   picture->param_id = VA_INVALID_ID;
   picture->param_size = args->param_size;
@@ -417,15 +465,24 @@ gst_vaapi_enc_picture_create (GstVaapiEncPicture * picture,
 
 GstVaapiEncPicture *
 gst_vaapi_enc_picture_new (GstVaapiEncoder * encoder,
-    gconstpointer param, guint param_size, GstVideoCodecFrame * frame)
+    gconstpointer param, guint param_size, guint coded_buf_offset,
+    GstVideoCodecFrame * frame)
 {
   GstVaapiCodecObject *object;
+  GstVaapiEncPicture *picture;
 
   g_return_val_if_fail (frame != NULL, NULL);
+  g_return_val_if_fail (coded_buf_offset + sizeof (VABufferID) <= param_size,
+      NULL);
 
   object = gst_vaapi_codec_object_new (&GstVaapiEncPictureClass,
       GST_VAAPI_CODEC_BASE (encoder), param, param_size, frame, 0, 0);
-  return GST_VAAPI_ENC_PICTURE (object);
+  if (!object)
+    return NULL;
+
+  picture = GST_VAAPI_ENC_PICTURE (object);
+  picture->coded_buf_offset = coded_buf_offset;
+  return picture;
 }
 
 void
@@ -479,34 +536,35 @@ gst_vaapi_enc_slice_add_packed_header (GstVaapiEncSlice * slice,
   g_ptr_array_add (slice->packed_headers, gst_vaapi_codec_object_ref (header));
 }
 
+/* The VA buffers are kept until the objects are destroyed, so that
+   the picture can be submitted again, see
+   gst_vaapi_enc_picture_reencode() */
 static gboolean
 do_encode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
 {
   VAStatus status;
 
-  vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
+  if (*buf_ptr)
+    vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
   status = vaRenderPicture (dpy, ctx, buf_id, 1);
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
-
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
   return TRUE;
 }
 
-gboolean
-gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
+static gboolean
+enc_picture_encode_unlocked (GstVaapiEncPicture * picture)
 {
   GstVaapiEncSequence *sequence;
   GstVaapiEncQMatrix *q_matrix;
   GstVaapiEncHuffmanTable *huf_table;
+  GstVaapiEncQPBuffer *qp_buffer;
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
   guint i;
 
-  g_return_val_if_fail (picture != NULL, FALSE);
   g_return_val_if_fail (picture->surface_id != VA_INVALID_SURFACE, FALSE);
 
   va_display = GET_VA_DISPLAY (picture);
@@ -550,6 +608,12 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   if (!do_encode (va_display, va_context, &picture->param_id, &picture->param))
     return FALSE;
 
+  /* Submit per-block QP */
+  qp_buffer = picture->qp_buffer;
+  if (qp_buffer && !do_encode (va_display, va_context,
+          &qp_buffer->param_id, &qp_buffer->param))
+    return FALSE;
+
   /* Submit Misc Params */
   for (i = 0; i < picture->misc_params->len; i++) {
     GstVaapiEncMiscParam *const misc =
@@ -581,3 +645,53 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
     return FALSE;
   return TRUE;
 }
+
+gboolean
+gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
+{
+  GstVaapiEncoder *encoder;
+  gboolean success;
+
+  g_return_val_if_fail (picture != NULL, FALSE);
+
+  /* The output thread may submit a picture again while the next ones
+     are being submitted */
+  encoder = GET_ENCODER (picture);
+  g_mutex_lock (&encoder->submit_mutex);
+  success = enc_picture_encode_unlocked (picture);
+  g_mutex_unlock (&encoder->submit_mutex);
+  return success;
+}
+
+/**
+ * gst_vaapi_enc_picture_reencode:
+ * @picture: a #GstVaapiEncPicture already submitted
+ * @codedbuf: the #GstVaapiCodedBuffer to encode @picture into
+ *
+ * Submits @picture again, with the same parameters, but to
+ * @codedbuf. This is used when the coded frame did not fit in the
+ * coded buffer it was first submitted to. The reference and
+ * reconstructed surfaces of @picture shall still be available.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_enc_picture_reencode (GstVaapiEncPicture * picture,
+    GstVaapiCodedBuffer * codedbuf)
+{
+  guint8 *param;
+
+  g_return_val_if_fail (picture != NULL, FALSE);
+  g_return_val_if_fail (codedbuf != NULL, FALSE);
+  g_return_val_if_fail (picture->param_id != VA_INVALID_ID, FALSE);
+
+  param = vaapi_map_buffer (GET_VA_DISPLAY (picture), picture->param_id);
+  if (!param)
+    return FALSE;
+
+  *(VABufferID *) (param + picture->coded_buf_offset) =
+      GST_VAAPI_CODED_BUFFER_ID (codedbuf);
+  picture->param = param;
+
+  return gst_vaapi_enc_picture_encode (picture);
+}
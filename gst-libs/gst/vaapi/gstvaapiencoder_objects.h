@@ -35,6 +35,7 @@ typedef struct _GstVaapiEncMiscParam GstVaapiEncMiscParam;
 typedef struct _GstVaapiEncSlice GstVaapiEncSlice;
 typedef struct _GstVaapiEncQMatrix GstVaapiEncQMatrix;
 typedef struct _GstVaapiEncHuffmanTable GstVaapiEncHuffmanTable;
+typedef struct _GstVaapiEncQPBuffer GstVaapiEncQPBuffer;
 typedef struct _GstVaapiEncPackedHeader GstVaapiEncPackedHeader;
 
 /* ------------------------------------------------------------------------- */
@@ -183,6 +184,34 @@ GstVaapiEncQMatrix *
 gst_vaapi_enc_q_matrix_new (GstVaapiEncoder * encoder, gconstpointer param,
     guint param_size);
 
+/* ------------------------------------------------------------------------- */
+/* --- Per-block QP                                                      --- */
+/* ------------------------------------------------------------------------- */
+
+#define GST_VAAPI_ENC_QP_BUFFER_CAST(obj) \
+  ((GstVaapiEncQPBuffer *) (obj))
+
+/**
+ * GstVaapiEncQPBuffer:
+ * @param: the mapped QP values
+ *
+ * A #GstVaapiCodecObject holding the QP value of every block of the
+ * picture, as packed rows of VAEncQPBufferH264.
+ */
+struct _GstVaapiEncQPBuffer
+{
+  /*< private >*/
+  GstVaapiCodecObject parent_instance;
+  VABufferID param_id;
+
+  /*< public >*/
+  gpointer param;
+};
+
+G_GNUC_INTERNAL
+GstVaapiEncQPBuffer *
+gst_vaapi_enc_qp_buffer_new (GstVaapiEncoder * encoder, guint size);
+
 /* ------------------------------------------------------------------------- */
 /* --- JPEG Huffman Tables                                               --- */
 /* ------------------------------------------------------------------------- */
@@ -249,12 +278,16 @@ struct _GstVaapiEncPicture
   GstVaapiSurface *surface;
   VABufferID param_id;
   guint param_size;
+  guint coded_buf_offset;
 
   /* Additional data to pass down */
   GstVaapiEncSequence *sequence;
   GPtrArray *packed_headers;
   GPtrArray *misc_params;
 
+  /* Monotonic time (us) the frame was handed to the encoder */
+  gint64 queued_time;
+
   /*< public >*/
   GstVaapiPictureType type;
   VASurfaceID surface_id;
@@ -262,6 +295,7 @@ struct _GstVaapiEncPicture
   GPtrArray *slices;
   GstVaapiEncQMatrix *q_matrix;
   GstVaapiEncHuffmanTable *huf_table;
+  GstVaapiEncQPBuffer *qp_buffer;
   GstClockTime pts;
   guint frame_num;
   guint poc;
@@ -271,7 +305,8 @@ struct _GstVaapiEncPicture
 G_GNUC_INTERNAL
 GstVaapiEncPicture *
 gst_vaapi_enc_picture_new (GstVaapiEncoder * encoder,
-    gconstpointer param, guint param_size, GstVideoCodecFrame * frame);
+    gconstpointer param, guint param_size, guint coded_buf_offset,
+    GstVideoCodecFrame * frame);
 
 G_GNUC_INTERNAL
 void
@@ -302,6 +337,11 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_enc_picture_reencode (GstVaapiEncPicture * picture,
+    GstVaapiCodedBuffer * codedbuf);
+
 #define gst_vaapi_enc_picture_ref(picture) \
   gst_vaapi_codec_object_ref (picture)
 #define gst_vaapi_enc_picture_unref(picture) \
@@ -339,7 +379,9 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture);
 /* GstVaapiEncPicture  */
 #define GST_VAAPI_ENC_PICTURE_NEW(codec, encoder, frame)                \
   gst_vaapi_enc_picture_new (GST_VAAPI_ENCODER_CAST (encoder),          \
-      NULL, sizeof (G_PASTE (VAEncPictureParameterBuffer, codec)), frame)
+      NULL, sizeof (G_PASTE (VAEncPictureParameterBuffer, codec)),      \
+      G_STRUCT_OFFSET (G_PASTE (VAEncPictureParameterBuffer, codec),    \
+          coded_buf), frame)
 
 /* GstVaapiEncSlice */
 #define GST_VAAPI_ENC_SLICE_NEW(codec, encoder)                         \
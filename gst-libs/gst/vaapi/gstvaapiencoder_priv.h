@@ -26,6 +26,7 @@
 
 #include <gst/vaapi/gstvaapiencoder.h>
 #include <gst/vaapi/gstvaapiencoder_objects.h>
+#include <gst/vaapi/gstvaapiencoder_vbv.h>
 #include <gst/vaapi/gstvaapicontext.h>
 #include <gst/vaapi/gstvaapivideopool.h>
 #include <gst/video/gstvideoutils.h>
@@ -208,6 +209,34 @@ G_BEGIN_DECLS
 #define GST_VAAPI_ENCODER_VA_HRD(encoder) \
   (GST_VAAPI_ENCODER_CAST (encoder)->va_hrd)
 
+/**
+ * GST_VAAPI_ENCODER_INTRA_REFRESH:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Macro that evaluates to the active #GstVaapiEncoderIntraRefresh
+ * mode, which is %GST_VAAPI_ENCODER_INTRA_REFRESH_NONE if the driver
+ * cannot do it.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_ENCODER_INTRA_REFRESH
+#define GST_VAAPI_ENCODER_INTRA_REFRESH(encoder) \
+  (GST_VAAPI_ENCODER_CAST (encoder)->intra_refresh)
+
+/**
+ * GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Macro that evaluates to %TRUE if the active intra refresh is done
+ * by the driver. If it is only emulated through QP shaping, intra
+ * macroblocks are not forced and regular IDR frames are still needed.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE
+#define GST_VAAPI_ENCODER_INTRA_REFRESH_NATIVE(encoder) \
+  (GST_VAAPI_ENCODER_INTRA_REFRESH (encoder) != \
+      GST_VAAPI_ENCODER_INTRA_REFRESH_NONE && \
+      GST_VAAPI_ENCODER_CAST (encoder)->intra_refresh_native)
+
 /* Generate a mask for the supplied tuning option (internal) */
 #define GST_VAAPI_ENCODER_TUNE_MASK(TUNE) \
   (1U << G_PASTE (GST_VAAPI_ENCODER_TUNE_, TUNE))
@@ -218,6 +247,9 @@ G_BEGIN_DECLS
 #define GST_VAAPI_TYPE_ENCODER_MBBRC \
   (gst_vaapi_encoder_mbbrc_get_type ())
 
+#define GST_VAAPI_TYPE_ENCODER_INTRA_REFRESH \
+  (gst_vaapi_encoder_intra_refresh_get_type ())
+
 typedef struct _GstVaapiEncoderClass GstVaapiEncoderClass;
 typedef struct _GstVaapiEncoderClassData GstVaapiEncoderClassData;
 
@@ -232,6 +264,8 @@ struct _GstVaapiEncoder
   GstVaapiContextInfo context_info;
   GstVaapiEncoderTune tune;
   guint packed_headers;
+  guint supported_packed_headers;
+  guint unused_packed_headers;  /* not needed by the current config */
 
   VADisplay va_display;
   VAContextID va_context;
@@ -259,6 +293,19 @@ struct _GstVaapiEncoder
   GstVaapiVideoPool *codedbuf_pool;
   GAsyncQueue *codedbuf_queue;
   guint32 num_codedbuf_queued;
+  gint codedbuf_overflow;       /* atomic */
+
+  /* serializes the picture submissions, since a picture whose coded
+     frame overflowed is submitted again from the output thread */
+  GMutex submit_mutex;
+
+  /* surfaces released by the subclass, but kept until the pictures
+     possibly referencing them are synced, so that these pictures can
+     still be encoded again. Protected by the mutex */
+  GQueue released_surfaces;
+  guint32 num_submitted;
+  guint32 num_synced;
+  guint32 reclaimed_seqnum;     /* last picture that cannot be re-encoded */
 
   guint got_packed_headers:1;
   guint got_rate_control_mask:1;
@@ -272,6 +319,22 @@ struct _GstVaapiEncoder
 
   /* trellis quantization */
   gboolean trellis;
+
+  /* intra refresh (gradual decoder refresh) */
+  GstVaapiEncoderIntraRefresh intra_refresh;
+  guint intra_refresh_period;   /* frames per refresh cycle */
+  guint intra_refresh_units;    /* MB/CTU columns (or rows) per picture */
+  guint intra_refresh_size;     /* MB/CTU columns (or rows) per frame */
+  guint intra_refresh_block;    /* MB/CTU size in pixels */
+  gboolean intra_refresh_native; /* FALSE if the ROI fallback is used */
+
+  /* video buffering verifier, updated as coded buffers are output */
+  gboolean vbv_check;
+  gboolean vbv_qp_feedback;
+  GstVaapiEncoderVBV vbv;
+  gint vbv_reset;               /* atomic */
+  gint vbv_qp_offset;           /* atomic */
+  gint vbv_ref_qp;              /* atomic, last reported average QP */
 };
 
 struct _GstVaapiEncoderClassData
@@ -346,12 +409,10 @@ GstVaapiSurfaceProxy *
 gst_vaapi_encoder_create_surface (GstVaapiEncoder *
     encoder);
 
-static inline void
+G_GNUC_INTERNAL
+void
 gst_vaapi_encoder_release_surface (GstVaapiEncoder * encoder,
-    GstVaapiSurfaceProxy * proxy)
-{
-  gst_vaapi_surface_proxy_unref (proxy);
-}
+    GstVaapiSurfaceProxy * proxy);
 
 G_GNUC_INTERNAL
 gboolean
@@ -373,6 +434,17 @@ gboolean
 gst_vaapi_encoder_ensure_param_trellis (GstVaapiEncoder * encoder,
     GstVaapiEncPicture * picture);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_ensure_param_intra_refresh (GstVaapiEncoder * encoder,
+    GstVaapiEncPicture * picture, guint position);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_ensure_param_qp_map (GstVaapiEncoder * encoder,
+    GstVaapiEncPicture * picture, guint block_size, gint qp, gint min_qp,
+    gint max_qp);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_encoder_ensure_num_slices (GstVaapiEncoder * encoder,
@@ -389,6 +461,13 @@ gboolean
 gst_vaapi_encoder_ensure_tile_support (GstVaapiEncoder * encoder,
     GstVaapiProfile profile, GstVaapiEntrypoint entrypoint);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_ensure_intra_refresh (GstVaapiEncoder * encoder,
+    GstVaapiProfile profile, GstVaapiEntrypoint entrypoint,
+    GstVaapiEncoderIntraRefresh mode, guint period, guint block_size,
+    guint width_in_blocks, guint height_in_blocks);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_ENCODER_PRIV_H */
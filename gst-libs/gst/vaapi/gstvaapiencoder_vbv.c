@@ -0,0 +1,147 @@
+/*
+ *  gstvaapiencoder_vbv.c - Video buffering verifier for rate-controlled output
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiencoder_vbv.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Fullness thresholds, in percents of the buffer size, below (resp.
+ * above) which the QP feedback starts pushing the rate control */
+#define VBV_LOW_WATERMARK       20
+#define VBV_CRITICAL_WATERMARK  10
+#define VBV_HIGH_WATERMARK      90
+
+/**
+ * gst_vaapi_encoder_vbv_init:
+ * @vbv: a #GstVaapiEncoderVBV
+ * @size: the buffer size, in bits
+ * @initial_fullness: the buffer fullness at the first frame, in bits
+ * @bitrate: the rate the buffer is filled at, in bits per second
+ * @fps_n: frame rate numerator
+ * @fps_d: frame rate denominator
+ * @constant: %TRUE for constant bitrate, where overflows are errors
+ *
+ * Resets the model for a new HRD configuration.
+ *
+ * Returns: %TRUE if the parameters describe a usable model
+ */
+gboolean
+gst_vaapi_encoder_vbv_init (GstVaapiEncoderVBV * vbv, guint64 size,
+    guint64 initial_fullness, guint64 bitrate, guint fps_n, guint fps_d,
+    gboolean constant)
+{
+  g_return_val_if_fail (vbv != NULL, FALSE);
+
+  memset (vbv, 0, sizeof (*vbv));
+  if (size == 0 || bitrate == 0 || fps_n == 0 || fps_d == 0)
+    return FALSE;
+
+  vbv->size = size;
+  vbv->fullness = MIN (initial_fullness, size);
+  vbv->bitrate = bitrate;
+  vbv->fps_n = fps_n;
+  vbv->fps_d = fps_d;
+  vbv->constant = constant;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_encoder_vbv_add_frame:
+ * @vbv: a #GstVaapiEncoderVBV
+ * @frame_bits: the size of the coded frame, in bits
+ *
+ * Removes the coded frame from the buffer at its decoding time, then
+ * fills the buffer for one frame period. Frames must be added in
+ * decoding order.
+ *
+ * Returns: the #GstVaapiVBVStatus after this frame
+ */
+GstVaapiVBVStatus
+gst_vaapi_encoder_vbv_add_frame (GstVaapiEncoderVBV * vbv, guint64 frame_bits)
+{
+  GstVaapiVBVStatus status = GST_VAAPI_VBV_STATUS_OK;
+  guint64 bits;
+
+  g_return_val_if_fail (vbv != NULL, GST_VAAPI_VBV_STATUS_NONE);
+
+  if (vbv->size == 0)
+    return GST_VAAPI_VBV_STATUS_NONE;
+
+  /* the whole frame shall be in the buffer when it is decoded */
+  if (frame_bits > vbv->fullness) {
+    GST_DEBUG ("VBV underflow: frame of %" G_GUINT64_FORMAT " bits, "
+        "buffer at %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT " bits",
+        frame_bits, vbv->fullness, vbv->size);
+    status = GST_VAAPI_VBV_STATUS_UNDERFLOW;
+    vbv->fullness = 0;
+  } else {
+    vbv->fullness -= frame_bits;
+  }
+
+  /* the bits arriving over one frame period, keeping the remainder
+   * so that the fill rate is exact over time */
+  vbv->remainder += vbv->bitrate * vbv->fps_d;
+  bits = vbv->remainder / vbv->fps_n;
+  vbv->remainder %= vbv->fps_n;
+
+  vbv->fullness += bits;
+  if (vbv->fullness > vbv->size) {
+    /* a VBR stream simply stops the transmission when full */
+    if (vbv->constant && status == GST_VAAPI_VBV_STATUS_OK) {
+      GST_DEBUG ("VBV overflow: %" G_GUINT64_FORMAT " bits in excess",
+          vbv->fullness - vbv->size);
+      status = GST_VAAPI_VBV_STATUS_OVERFLOW;
+    }
+    vbv->fullness = vbv->size;
+  }
+  return status;
+}
+
+/**
+ * gst_vaapi_encoder_vbv_get_qp_offset:
+ * @vbv: a #GstVaapiEncoderVBV
+ *
+ * Computes how much the QP of the next frames should move so that the
+ * buffer fullness gets back into the safe range: a positive offset
+ * when the buffer is about to underflow, a negative one when a CBR
+ * buffer is about to overflow.
+ *
+ * Returns: the corrective QP offset
+ */
+gint
+gst_vaapi_encoder_vbv_get_qp_offset (GstVaapiEncoderVBV * vbv)
+{
+  guint percent;
+
+  g_return_val_if_fail (vbv != NULL, 0);
+
+  if (vbv->size == 0)
+    return 0;
+
+  percent = vbv->fullness * 100 / vbv->size;
+  if (percent < VBV_CRITICAL_WATERMARK)
+    return 4;
+  if (percent < VBV_LOW_WATERMARK)
+    return 2;
+  if (vbv->constant && percent > VBV_HIGH_WATERMARK)
+    return -2;
+  return 0;
+}
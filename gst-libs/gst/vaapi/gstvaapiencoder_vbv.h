@@ -0,0 +1,65 @@
+/*
+ *  gstvaapiencoder_vbv.h - Video buffering verifier for rate-controlled output
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_ENCODER_VBV_H
+#define GST_VAAPI_ENCODER_VBV_H
+
+#include <gst/vaapi/gstvaapicodedbufferproxy.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiEncoderVBV GstVaapiEncoderVBV;
+
+/**
+ * GstVaapiEncoderVBV:
+ *
+ * A leaky bucket model of the decoder coded picture buffer, as
+ * described by the HRD parameters passed to the driver. The buffer
+ * is filled at the target bitrate and each coded frame is removed
+ * from it at its decoding time.
+ */
+struct _GstVaapiEncoderVBV
+{
+  /*< private >*/
+  guint64 size;                 /* bits */
+  guint64 fullness;             /* bits */
+  guint64 bitrate;              /* bits per second */
+  guint64 remainder;
+  guint fps_n;
+  guint fps_d;
+  gboolean constant;            /* CBR, overflows are errors */
+};
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_vbv_init (GstVaapiEncoderVBV * vbv, guint64 size,
+    guint64 initial_fullness, guint64 bitrate, guint fps_n, guint fps_d,
+    gboolean constant);
+
+G_GNUC_INTERNAL
+GstVaapiVBVStatus
+gst_vaapi_encoder_vbv_add_frame (GstVaapiEncoderVBV * vbv, guint64 frame_bits);
+
+G_GNUC_INTERNAL
+gint
+gst_vaapi_encoder_vbv_get_qp_offset (GstVaapiEncoderVBV * vbv);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_ENCODER_VBV_H */
@@ -407,6 +407,19 @@ ensure_picture (GstVaapiEncoderVP9 * encoder, GstVaapiEncPicture * picture,
   return TRUE;
 }
 
+/* Replaces the reference in slot @i, releasing the previous one
+   through the base encoder, since submitted pictures may still
+   reference it */
+static void
+ref_list_replace (GstVaapiEncoderVP9 * encoder, guint i,
+    GstVaapiSurfaceProxy * ref)
+{
+  if (encoder->ref_list[i])
+    gst_vaapi_encoder_release_surface (GST_VAAPI_ENCODER (encoder),
+        encoder->ref_list[i]);
+  encoder->ref_list[i] = gst_vaapi_surface_proxy_ref (ref);
+}
+
 static void
 update_ref_list (GstVaapiEncoderVP9 * encoder, GstVaapiEncPicture * picture,
     GstVaapiSurfaceProxy * ref)
@@ -415,7 +428,7 @@ update_ref_list (GstVaapiEncoderVP9 * encoder, GstVaapiEncPicture * picture,
 
   if (picture->type == GST_VAAPI_PICTURE_TYPE_I) {
     for (i = 0; i < G_N_ELEMENTS (encoder->ref_list); i++)
-      gst_vaapi_surface_proxy_replace (&encoder->ref_list[i], ref);
+      ref_list_replace (encoder, i, ref);
     gst_vaapi_surface_proxy_unref (ref);
     /* set next free slot index */
     encoder->ref_list_idx = 1;
@@ -424,12 +437,12 @@ update_ref_list (GstVaapiEncoderVP9 * encoder, GstVaapiEncPicture * picture,
 
   switch (encoder->ref_pic_mode) {
     case GST_VAAPI_ENCODER_VP9_REF_PIC_MODE_0:
-      gst_vaapi_surface_proxy_replace (&encoder->ref_list[0], ref);
+      ref_list_replace (encoder, 0, ref);
       gst_vaapi_surface_proxy_unref (ref);
       break;
     case GST_VAAPI_ENCODER_VP9_REF_PIC_MODE_1:
       i = encoder->ref_list_idx;
-      gst_vaapi_surface_proxy_replace (&encoder->ref_list[i], ref);
+      ref_list_replace (encoder, i, ref);
       gst_vaapi_surface_proxy_unref (ref);
       encoder->ref_list_idx = (encoder->ref_list_idx + 1) % GST_VP9_REF_FRAMES;
       break;
@@ -29,6 +29,7 @@
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiutils_core.h"
+#include "gstvaapifilter_sw.h"
 
 #define GST_VAAPI_FILTER_CAST(obj) \
     ((GstVaapiFilter *)(obj))
@@ -46,14 +47,33 @@ struct _GstVaapiFilterOpData
   guint va_cap_size;
   VABufferID va_buffer;
   guint va_buffer_size;
+  guint va_num_elements;
+  gpointer va_data;
   guint is_enabled:1;
+  guint is_dirty:1;
 };
 
+/* The display lock is taken first, if the display needs it, to keep
+   the same lock order as the callers holding the display lock */
+#define GST_VAAPI_FILTER_LOCK(filter) G_STMT_START {    \
+    GST_VAAPI_DISPLAY_VA_LOCK ((filter)->display);      \
+    g_rec_mutex_lock (&(filter)->lock);                 \
+  } G_STMT_END
+
+#define GST_VAAPI_FILTER_UNLOCK(filter) G_STMT_START {  \
+    g_rec_mutex_unlock (&(filter)->lock);               \
+    GST_VAAPI_DISPLAY_VA_UNLOCK ((filter)->display);    \
+  } G_STMT_END
+
 struct _GstVaapiFilter
 {
   /*< private > */
   GstObject parent_instance;
 
+  /* protects the filter state and its VA context, so that filters
+     sharing a display do not serialize each other */
+  GRecMutex lock;
+
   GstVaapiDisplay *display;
   VADisplay va_display;
   VAConfigID va_config;
@@ -78,6 +98,22 @@ struct _GstVaapiFilter
 #if VA_CHECK_VERSION(1,4,0)
   VAHdrMetaDataHDR10 hdr_meta;
 #endif
+
+  /* persistent pipeline parameters, only patched between frames */
+  VABufferID pipeline_param_buf_id;
+  VAProcPipelineParameterBuffer pipeline_param;
+  GArray *va_filters;
+  VARectangle va_src_rect;
+  VARectangle va_dst_rect;
+
+  /* VA buffer statistics, reported every second */
+  gint64 stats_time;
+  guint num_buffer_allocs;
+  guint num_buffer_uploads;
+  guint num_hdr_meta_skips;
+
+  /* CPU fallback, for displays without VPP */
+  GstVaapiFilterSw *sw;
 };
 
 typedef struct _GstVaapiFilterClass GstVaapiFilterClass;
@@ -228,9 +264,9 @@ vpp_get_filters (GstVaapiFilter * filter, guint * num_filters_ptr)
 {
   VAProcFilterType *filters;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   filters = vpp_get_filters_unlocked (filter, num_filters_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return filters;
 }
 
@@ -279,9 +315,9 @@ vpp_get_filter_caps (GstVaapiFilter * filter, VAProcFilterType type,
 {
   gpointer caps;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   caps = vpp_get_filter_caps_unlocked (filter, type, cap_size, num_caps_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return caps;
 }
 
@@ -308,9 +344,9 @@ vpp_get_pipeline_caps_unlocked (GstVaapiFilter * filter)
 static void
 vpp_get_pipeline_caps (GstVaapiFilter * filter)
 {
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   vpp_get_pipeline_caps_unlocked (filter);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -536,6 +572,7 @@ static void
 op_data_free (GstVaapiFilterOpData * op_data)
 {
   g_free (op_data->va_caps);
+  g_free (op_data->va_data);
   g_slice_free (GstVaapiFilterOpData, op_data);
 }
 
@@ -827,6 +864,12 @@ get_operations (GstVaapiFilter * filter)
   if (filter && filter->operations)
     return g_ptr_array_ref (filter->operations);
 
+  /* the software fallback only scales and converts */
+  if (filter && filter->sw) {
+    filter->operations = g_ptr_array_new_full (0, op_data_unref);
+    return g_ptr_array_ref (filter->operations);
+  }
+
   ops = get_operations_default ();
   if (!ops)
     return NULL;
@@ -872,16 +915,25 @@ find_operation (GstVaapiFilter * filter, GstVaapiFilterOp op)
   return NULL;
 }
 
-/* Ensure the operation's VA buffer is allocated */
+/* Ensure the operation's VA buffer, and its staging copy, are
+ * allocated */
 static inline gboolean
 op_ensure_n_elements_buffer (GstVaapiFilter * filter,
     GstVaapiFilterOpData * op_data, gint op_num)
 {
   if (G_LIKELY (op_data->va_buffer != VA_INVALID_ID))
     return TRUE;
-  return vaapi_create_n_elements_buffer (filter->va_display, filter->va_context,
-      VAProcFilterParameterBufferType, op_data->va_buffer_size, NULL,
-      &op_data->va_buffer, NULL, op_num);
+
+  op_data->va_num_elements = op_num;
+  op_data->va_data = g_malloc0 (op_data->va_buffer_size * op_num);
+  if (!vaapi_create_n_elements_buffer (filter->va_display, filter->va_context,
+          VAProcFilterParameterBufferType, op_data->va_buffer_size,
+          op_data->va_data, &op_data->va_buffer, NULL, op_num)) {
+    g_clear_pointer (&op_data->va_data, g_free);
+    return FALSE;
+  }
+  filter->num_buffer_allocs++;
+  return TRUE;
 }
 
 static inline gboolean
@@ -890,12 +942,51 @@ op_ensure_buffer (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data)
   return op_ensure_n_elements_buffer (filter, op_data, 1);
 }
 
+/* Stages @size bytes of parameters at @offset of the operation's
+ * buffer. The VA buffer is only uploaded again, on the next process
+ * call, if they differ from the current ones */
+static void
+op_data_update (GstVaapiFilterOpData * op_data, guint offset,
+    gconstpointer data, guint size)
+{
+  guint8 *const va_data = (guint8 *) op_data->va_data + offset;
+
+  g_assert (offset + size <=
+      op_data->va_buffer_size * op_data->va_num_elements);
+
+  if (memcmp (va_data, data, size) == 0)
+    return;
+  memcpy (va_data, data, size);
+  op_data->is_dirty = 1;
+}
+
+/* Uploads the staged parameters, if they changed */
+static gboolean
+op_data_upload (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data)
+{
+  gpointer buf;
+
+  if (!op_data->is_dirty)
+    return TRUE;
+
+  buf = vaapi_map_buffer (filter->va_display, op_data->va_buffer);
+  if (!buf)
+    return FALSE;
+  memcpy (buf, op_data->va_data,
+      op_data->va_buffer_size * op_data->va_num_elements);
+  vaapi_unmap_buffer (filter->va_display, op_data->va_buffer, NULL);
+
+  op_data->is_dirty = 0;
+  filter->num_buffer_uploads++;
+  return TRUE;
+}
+
 /* Update a generic filter (float value) */
 static gboolean
 op_set_generic_unlocked (GstVaapiFilter * filter,
     GstVaapiFilterOpData * op_data, gfloat value)
 {
-  VAProcFilterParameterBuffer *buf;
+  VAProcFilterParameterBuffer buf;
   VAProcFilterCap *filter_cap;
   gfloat va_value;
 
@@ -910,13 +1001,10 @@ op_set_generic_unlocked (GstVaapiFilter * filter,
   if (!op_data_get_value_float (op_data, &filter_cap->range, value, &va_value))
     return FALSE;
 
-  buf = vaapi_map_buffer (filter->va_display, op_data->va_buffer);
-  if (!buf)
-    return FALSE;
-
-  buf->type = op_data->va_type;
-  buf->value = va_value;
-  vaapi_unmap_buffer (filter->va_display, op_data->va_buffer, NULL);
+  memset (&buf, 0, sizeof (buf));
+  buf.type = op_data->va_type;
+  buf.value = va_value;
+  op_data_update (op_data, 0, &buf, sizeof (buf));
   return TRUE;
 }
 
@@ -926,9 +1014,9 @@ op_set_generic (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_generic_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return success;
 }
 
@@ -940,7 +1028,7 @@ static gboolean
 op_set_color_balance_unlocked (GstVaapiFilter * filter,
     GstVaapiFilterOpData * op_data, gfloat value)
 {
-  VAProcFilterParameterBufferColorBalance *buf;
+  VAProcFilterParameterBufferColorBalance buf[COLOR_BALANCE_NUM];
   VAProcFilterCapColorBalance *filter_cap;
   gfloat va_value;
   gint i;
@@ -977,10 +1065,7 @@ op_set_color_balance_unlocked (GstVaapiFilter * filter,
       return FALSE;
 
     enabled_data = op_data;
-
-    buf = vaapi_map_buffer (filter->va_display, enabled_data->va_buffer);
-    if (!buf)
-      return FALSE;
+    memset (buf, 0, sizeof (buf));
 
     /* Write all the color balance operator values in the buffer. --
      * Use the default value for all the operators except the set
@@ -1000,6 +1085,7 @@ op_set_color_balance_unlocked (GstVaapiFilter * filter,
 
       buf[i].value = va_value;
     }
+    op_data_update (enabled_data, 0, buf, sizeof (buf));
 
     enabled_data->is_enabled = 1;
   } else {
@@ -1013,15 +1099,12 @@ op_set_color_balance_unlocked (GstVaapiFilter * filter,
             &va_value))
       return FALSE;
 
-    buf = vaapi_map_buffer (filter->va_display, enabled_data->va_buffer);
-    if (!buf)
-      return FALSE;
-
-    buf[op_data->op - GST_VAAPI_FILTER_OP_HUE].value = va_value;
+    i = op_data->op - GST_VAAPI_FILTER_OP_HUE;
+    op_data_update (enabled_data, i * sizeof (buf[0]) +
+        G_STRUCT_OFFSET (VAProcFilterParameterBufferColorBalance, value),
+        &va_value, sizeof (va_value));
   }
 
-  vaapi_unmap_buffer (filter->va_display, enabled_data->va_buffer, NULL);
-
   return ret;
 }
 
@@ -1031,9 +1114,9 @@ op_set_color_balance (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_color_balance_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return success;
 }
 
@@ -1043,7 +1126,7 @@ op_set_deinterlace_unlocked (GstVaapiFilter * filter,
     GstVaapiFilterOpData * op_data, GstVaapiDeinterlaceMethod method,
     guint flags)
 {
-  VAProcFilterParameterBufferDeinterlacing *buf;
+  VAProcFilterParameterBufferDeinterlacing buf;
   const VAProcFilterCapDeinterlacing *filter_caps;
   VAProcDeinterlacingType algorithm;
   guint i;
@@ -1063,14 +1146,11 @@ op_set_deinterlace_unlocked (GstVaapiFilter * filter,
   if (i == op_data->va_num_caps)
     return FALSE;
 
-  buf = vaapi_map_buffer (filter->va_display, op_data->va_buffer);
-  if (!buf)
-    return FALSE;
-
-  buf->type = op_data->va_type;
-  buf->algorithm = algorithm;
-  buf->flags = from_GstVaapiDeinterlaceFlags (flags);
-  vaapi_unmap_buffer (filter->va_display, op_data->va_buffer, NULL);
+  memset (&buf, 0, sizeof (buf));
+  buf.type = op_data->va_type;
+  buf.algorithm = algorithm;
+  buf.flags = from_GstVaapiDeinterlaceFlags (flags);
+  op_data_update (op_data, 0, &buf, sizeof (buf));
   return TRUE;
 }
 
@@ -1080,9 +1160,9 @@ op_set_deinterlace (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_deinterlace_unlocked (filter, op_data, method, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return success;
 }
 
@@ -1091,19 +1171,17 @@ static gboolean
 op_set_skintone_level_unlocked (GstVaapiFilter * filter,
     GstVaapiFilterOpData * op_data, guint value)
 {
-  VAProcFilterParameterBuffer *buf;
+  VAProcFilterParameterBuffer buf;
 
   if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
   op_data->is_enabled = 1;
 
-  buf = vaapi_map_buffer (filter->va_display, op_data->va_buffer);
-  if (!buf)
-    return FALSE;
-  buf->type = op_data->va_type;
-  buf->value = value;
-  vaapi_unmap_buffer (filter->va_display, op_data->va_buffer, NULL);
+  memset (&buf, 0, sizeof (buf));
+  buf.type = op_data->va_type;
+  buf.value = value;
+  op_data_update (op_data, 0, &buf, sizeof (buf));
   return TRUE;
 }
 
@@ -1113,9 +1191,9 @@ op_set_skintone_level (GstVaapiFilter * filter,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_skintone_level_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return success;
 }
 
@@ -1142,9 +1220,9 @@ op_set_skintone (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_skintone_unlocked (filter, op_data, enhance);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return success;
 }
 #endif
@@ -1189,9 +1267,9 @@ op_set_hdr_tone_map (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
     gboolean value)
 {
   gboolean success = FALSE;
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   success = op_set_hdr_tone_map_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
 
   return success;
 }
@@ -1233,6 +1311,17 @@ ensure_attributes (GstVaapiFilter * filter)
   if (G_LIKELY (filter->attribs))
     return TRUE;
 
+  if (filter->sw) {
+    filter->attribs = g_slice_new0 (GstVaapiConfigSurfaceAttributes);
+    filter->attribs->min_width = 1;
+    filter->attribs->min_height = 1;
+    filter->attribs->max_width = G_MAXINT16;
+    filter->attribs->max_height = G_MAXINT16;
+    filter->attribs->mem_types = VA_SURFACE_ATTRIB_MEM_TYPE_VA;
+    filter->attribs->formats = gst_vaapi_filter_sw_get_formats (filter->sw);
+    return TRUE;
+  }
+
   filter->attribs = gst_vaapi_config_surface_attributes_get (filter->display,
       filter->va_config);
   return (filter->attribs != NULL);
@@ -1269,6 +1358,7 @@ find_format (GstVaapiFilter * filter, GstVideoFormat format)
 static void
 gst_vaapi_filter_init (GstVaapiFilter * filter)
 {
+  g_rec_mutex_init (&filter->lock);
   filter->va_config = VA_INVALID_ID;
   filter->va_context = VA_INVALID_ID;
   filter->format = DEFAULT_FORMAT;
@@ -1278,6 +1368,10 @@ gst_vaapi_filter_init (GstVaapiFilter * filter)
 
   filter->backward_references =
       g_array_sized_new (FALSE, FALSE, sizeof (VASurfaceID), 4);
+
+  filter->pipeline_param_buf_id = VA_INVALID_ID;
+  filter->va_filters =
+      g_array_sized_new (FALSE, FALSE, sizeof (VABufferID), N_PROPERTIES);
 }
 
 static gboolean
@@ -1288,6 +1382,11 @@ gst_vaapi_filter_initialize (GstVaapiFilter * filter)
   if (!filter->display)
     return FALSE;
 
+  if (!GST_VAAPI_DISPLAY_HAS_VPP (filter->display)) {
+    GST_WARNING_OBJECT (filter, "VA display doesn't support VPP");
+    return FALSE;
+  }
+
   va_status = vaCreateConfig (filter->va_display, VAProfileNone,
       VAEntrypointVideoProc, NULL, 0, &filter->va_config);
   if (!vaapi_check_status (va_status, "vaCreateConfig() [VPP]"))
@@ -1313,7 +1412,9 @@ gst_vaapi_filter_finalize (GObject * object)
   if (!filter->display)
     goto bail;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_clear_pointer (&filter->sw, gst_vaapi_filter_sw_free);
+
+  GST_VAAPI_FILTER_LOCK (filter);
   if (filter->operations) {
     for (i = 0; i < filter->operations->len; i++) {
       GstVaapiFilterOpData *const op_data =
@@ -1323,6 +1424,7 @@ gst_vaapi_filter_finalize (GObject * object)
     g_ptr_array_unref (filter->operations);
     filter->operations = NULL;
   }
+  vaapi_destroy_buffer (filter->va_display, &filter->pipeline_param_buf_id);
 
   if (filter->va_context != VA_INVALID_ID) {
     vaDestroyContext (filter->va_display, filter->va_context);
@@ -1333,7 +1435,7 @@ gst_vaapi_filter_finalize (GObject * object)
     vaDestroyConfig (filter->va_display, filter->va_config);
     filter->va_config = VA_INVALID_ID;
   }
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   gst_vaapi_display_replace (&filter->display, NULL);
 
 bail:
@@ -1347,11 +1449,18 @@ bail:
     filter->backward_references = NULL;
   }
 
+  if (filter->va_filters) {
+    g_array_unref (filter->va_filters);
+    filter->va_filters = NULL;
+  }
+
   if (filter->attribs) {
     gst_vaapi_config_surface_attributes_free (filter->attribs);
     filter->attribs = NULL;
   }
 
+  g_rec_mutex_clear (&filter->lock);
+
   G_OBJECT_CLASS (gst_vaapi_filter_parent_class)->finalize (object);
 }
 
@@ -1366,12 +1475,8 @@ gst_vaapi_filter_set_property (GObject * object, guint property_id,
       GstVaapiDisplay *display = g_value_get_object (value);;
 
       if (display) {
-        if (GST_VAAPI_DISPLAY_HAS_VPP (display)) {
-          filter->display = gst_object_ref (display);
-          filter->va_display = GST_VAAPI_DISPLAY_VADISPLAY (filter->display);
-        } else {
-          GST_WARNING_OBJECT (filter, "VA display doesn't support VPP");
-        }
+        filter->display = gst_object_ref (display);
+        filter->va_display = GST_VAAPI_DISPLAY_VADISPLAY (filter->display);
       }
       break;
     }
@@ -1442,6 +1547,52 @@ error:
   }
 }
 
+/**
+ * gst_vaapi_filter_new_software:
+ * @display: a #GstVaapiDisplay
+ *
+ * Creates a new #GstVaapiFilter that performs the scaling, cropping
+ * and color conversion on the CPU, for drivers that lack video
+ * processing. The surfaces are mapped, directly if the driver allows
+ * deriving images from them, and processed by several threads.
+ *
+ * Such a filter has no operation, and doesn't deinterlace, but it can
+ * be used like any other #GstVaapiFilter for format conversion and
+ * scaling.
+ *
+ * Return value: the newly created #GstVaapiFilter object
+ */
+GstVaapiFilter *
+gst_vaapi_filter_new_software (GstVaapiDisplay * display)
+{
+  GstVaapiFilter *filter;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  filter = g_object_new (GST_TYPE_VAAPI_FILTER, "display", display, NULL);
+  filter->sw = gst_vaapi_filter_sw_new (display);
+
+  gst_video_colorimetry_from_string (&filter->input_colorimetry, NULL);
+  gst_video_colorimetry_from_string (&filter->output_colorimetry, NULL);
+
+  return filter;
+}
+
+/**
+ * gst_vaapi_filter_is_software:
+ * @filter: a #GstVaapiFilter
+ *
+ * Return value: %TRUE if @filter was created with
+ *   gst_vaapi_filter_new_software()
+ */
+gboolean
+gst_vaapi_filter_is_software (GstVaapiFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, FALSE);
+
+  return filter->sw != NULL;
+}
+
 /**
  * gst_vaapi_filter_replace:
  * @old_filter_ptr: a pointer to a #GstVaapiFilter
@@ -1664,80 +1815,71 @@ gst_vaapi_filter_fill_color_standards (GstVaapiFilter * filter,
 #endif
 }
 
-/**
- * gst_vaapi_filter_process:
- * @filter: a #GstVaapiFilter
- * @src_surface: the source @GstVaapiSurface
- * @dst_surface: the destination @GstVaapiSurface
- * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
- *
- * Applies the operations currently defined in the @filter to
- * @src_surface and return the output in @dst_surface. The order of
- * operations is determined in a way that suits best the underlying
- * hardware. i.e. the only guarantee held is the generated outcome,
- * not any specific order of operations.
- *
- * Return value: a #GstVaapiFilterStatus
- */
-static GstVaapiFilterStatus
-gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
-    GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags)
+/* Builds the source region from @crop_rect, or the whole surface */
+static gboolean
+get_source_region (GstVaapiSurface * src_surface,
+    const GstVaapiRectangle * crop_rect, VARectangle * src_rect)
 {
-  VAProcPipelineParameterBuffer *pipeline_param = NULL;
-  VABufferID pipeline_param_buf_id = VA_INVALID_ID;
-  VABufferID filters[N_PROPERTIES];
-  VAProcPipelineCaps pipeline_caps;
-  guint i, num_filters = 0;
-  VAStatus va_status;
-  VARectangle src_rect, dst_rect;
-  guint va_mirror = 0, va_rotation = 0;
-
-  if (!ensure_operations (filter))
-    return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
-
-  /* Build surface region (source) */
-  if (filter->use_crop_rect) {
-    const GstVaapiRectangle *const crop_rect = &filter->crop_rect;
-
+  if (crop_rect) {
     if ((crop_rect->x + crop_rect->width >
             GST_VAAPI_SURFACE_WIDTH (src_surface)) ||
         (crop_rect->y + crop_rect->height >
             GST_VAAPI_SURFACE_HEIGHT (src_surface)))
-      goto error;
+      return FALSE;
 
-    src_rect.x = crop_rect->x;
-    src_rect.y = crop_rect->y;
-    src_rect.width = crop_rect->width;
-    src_rect.height = crop_rect->height;
+    src_rect->x = crop_rect->x;
+    src_rect->y = crop_rect->y;
+    src_rect->width = crop_rect->width;
+    src_rect->height = crop_rect->height;
   } else {
-    src_rect.x = 0;
-    src_rect.y = 0;
-    src_rect.width = GST_VAAPI_SURFACE_WIDTH (src_surface);
-    src_rect.height = GST_VAAPI_SURFACE_HEIGHT (src_surface);
+    src_rect->x = 0;
+    src_rect->y = 0;
+    src_rect->width = GST_VAAPI_SURFACE_WIDTH (src_surface);
+    src_rect->height = GST_VAAPI_SURFACE_HEIGHT (src_surface);
   }
+  return TRUE;
+}
 
-  /* Build output region (target) */
-  if (filter->use_target_rect) {
-    const GstVaapiRectangle *const target_rect = &filter->target_rect;
-
+/* Builds the output region from @target_rect, or the whole surface */
+static gboolean
+get_target_region (GstVaapiSurface * dst_surface,
+    const GstVaapiRectangle * target_rect, VARectangle * dst_rect)
+{
+  if (target_rect) {
     if ((target_rect->x + target_rect->width >
             GST_VAAPI_SURFACE_WIDTH (dst_surface)) ||
         (target_rect->y + target_rect->height >
             GST_VAAPI_SURFACE_HEIGHT (dst_surface)))
-      goto error;
+      return FALSE;
 
-    dst_rect.x = target_rect->x;
-    dst_rect.y = target_rect->y;
-    dst_rect.width = target_rect->width;
-    dst_rect.height = target_rect->height;
+    dst_rect->x = target_rect->x;
+    dst_rect->y = target_rect->y;
+    dst_rect->width = target_rect->width;
+    dst_rect->height = target_rect->height;
   } else {
-    dst_rect.x = 0;
-    dst_rect.y = 0;
-    dst_rect.width = GST_VAAPI_SURFACE_WIDTH (dst_surface);
-    dst_rect.height = GST_VAAPI_SURFACE_HEIGHT (dst_surface);
+    dst_rect->x = 0;
+    dst_rect->y = 0;
+    dst_rect->width = GST_VAAPI_SURFACE_WIDTH (dst_surface);
+    dst_rect->height = GST_VAAPI_SURFACE_HEIGHT (dst_surface);
   }
+  return TRUE;
+}
 
-  for (i = 0, num_filters = 0; i < filter->operations->len; i++) {
+/* Fills in the pipeline parameters shared by all the outputs of
+ * @src_surface, i.e. everything but the contents of the source and
+ * output regions */
+static gboolean
+fill_pipeline_param (GstVaapiFilter * filter, GstVaapiSurface * src_surface,
+    guint flags, VAProcPipelineParameterBuffer * pipeline_param)
+{
+  VAProcPipelineCaps pipeline_caps;
+  VABufferID *filters;
+  guint i, num_filters;
+  VAStatus va_status;
+  guint va_mirror = 0, va_rotation = 0;
+
+  g_array_set_size (filter->va_filters, 0);
+  for (i = 0; i < filter->operations->len; i++) {
     GstVaapiFilterOpData *const op_data =
         g_ptr_array_index (filter->operations, i);
     if (!op_data->is_enabled)
@@ -1745,35 +1887,36 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
     if (op_data->va_buffer == VA_INVALID_ID) {
       GST_ERROR ("invalid VA buffer for operation %s",
           g_param_spec_get_name (op_data->pspec));
-      goto error;
+      return FALSE;
     }
-    filters[num_filters++] = op_data->va_buffer;
+    if (!op_data_upload (filter, op_data))
+      return FALSE;
+    g_array_append_val (filter->va_filters, op_data->va_buffer);
   }
+  filters = (VABufferID *) filter->va_filters->data;
+  num_filters = filter->va_filters->len;
 
   /* Validate pipeline caps */
   va_status = vaQueryVideoProcPipelineCaps (filter->va_display,
       filter->va_context, filters, num_filters, &pipeline_caps);
   if (!vaapi_check_status (va_status, "vaQueryVideoProcPipelineCaps()"))
-    goto error;
-
-  if (!vaapi_create_buffer (filter->va_display, filter->va_context,
-          VAProcPipelineParameterBufferType, sizeof (*pipeline_param),
-          NULL, &pipeline_param_buf_id, (gpointer *) & pipeline_param))
-    goto error;
+    return FALSE;
 
   memset (pipeline_param, 0, sizeof (*pipeline_param));
   pipeline_param->surface = GST_VAAPI_SURFACE_ID (src_surface);
-  pipeline_param->surface_region = &src_rect;
 
   gst_vaapi_filter_fill_color_standards (filter, pipeline_param);
 
-  pipeline_param->output_region = &dst_rect;
   pipeline_param->output_background_color = 0xff000000;
   pipeline_param->filter_flags = from_GstVaapiSurfaceRenderFlags (flags) |
       from_GstVaapiScaleMethod (filter->scale_method);
   pipeline_param->filters = filters;
   pipeline_param->num_filters = num_filters;
 
+  /* the regions are updated in place for each output */
+  pipeline_param->surface_region = &filter->va_src_rect;
+  pipeline_param->output_region = &filter->va_dst_rect;
+
   from_GstVideoOrientationMethod (filter->video_direction, &va_mirror,
       &va_rotation);
 
@@ -1804,32 +1947,202 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
     pipeline_param->backward_references = NULL;
     pipeline_param->num_backward_references = 0;
   }
+  return TRUE;
+}
+
+/* Loads @pipeline_param into the persistent parameter buffer. Only
+ * the fields that changed since the previous submission are written,
+ * i.e. the source surface alone in steady state, as the regions and
+ * the filter list are referenced from the GstVaapiFilter */
+static gboolean
+update_pipeline_param (GstVaapiFilter * filter,
+    const VAProcPipelineParameterBuffer * pipeline_param)
+{
+  VAProcPipelineParameterBuffer *const last_param = &filter->pipeline_param;
+  VAProcPipelineParameterBuffer *param, tmp_param;
+
+  if (filter->pipeline_param_buf_id == VA_INVALID_ID) {
+    if (!vaapi_create_buffer (filter->va_display, filter->va_context,
+            VAProcPipelineParameterBufferType, sizeof (*pipeline_param),
+            pipeline_param, &filter->pipeline_param_buf_id, NULL))
+      return FALSE;
+    filter->num_buffer_allocs++;
+    *last_param = *pipeline_param;
+    return TRUE;
+  }
+
+  if (memcmp (last_param, pipeline_param, sizeof (*last_param)) == 0)
+    return TRUE;
+
+  param = vaapi_map_buffer (filter->va_display, filter->pipeline_param_buf_id);
+  if (!param)
+    return FALSE;
+
+  tmp_param = *pipeline_param;
+  tmp_param.surface = last_param->surface;
+  if (memcmp (last_param, &tmp_param, sizeof (*last_param)) == 0)
+    param->surface = pipeline_param->surface;
+  else
+    *param = *pipeline_param;
+  vaapi_unmap_buffer (filter->va_display, filter->pipeline_param_buf_id, NULL);
+
+  *last_param = *pipeline_param;
+  filter->num_buffer_uploads++;
+  return TRUE;
+}
 
-  vaapi_unmap_buffer (filter->va_display, pipeline_param_buf_id, NULL);
+/* Submits one output of the pipeline, whose regions were already
+ * written to the GstVaapiFilter */
+static gboolean
+render_pipeline (GstVaapiFilter * filter,
+    const VAProcPipelineParameterBuffer * pipeline_param,
+    GstVaapiSurface * dst_surface)
+{
+  VAStatus va_status;
+
+  if (!update_pipeline_param (filter, pipeline_param))
+    return FALSE;
 
   va_status = vaBeginPicture (filter->va_display, filter->va_context,
       GST_VAAPI_SURFACE_ID (dst_surface));
   if (!vaapi_check_status (va_status, "vaBeginPicture()"))
-    goto error;
+    return FALSE;
 
   va_status = vaRenderPicture (filter->va_display, filter->va_context,
-      &pipeline_param_buf_id, 1);
+      &filter->pipeline_param_buf_id, 1);
   if (!vaapi_check_status (va_status, "vaRenderPicture()"))
-    goto error;
+    return FALSE;
 
   va_status = vaEndPicture (filter->va_display, filter->va_context);
   if (!vaapi_check_status (va_status, "vaEndPicture()"))
+    return FALSE;
+  return TRUE;
+}
+
+/* Logs the VA buffer allocations and uploads, once per second */
+static void
+report_buffer_stats (GstVaapiFilter * filter)
+{
+  const gint64 now = g_get_monotonic_time ();
+  gdouble elapsed;
+
+  if (filter->stats_time == 0)
+    filter->stats_time = now;
+
+  elapsed = (gdouble) (now - filter->stats_time) / G_USEC_PER_SEC;
+  if (elapsed < 1.0)
+    return;
+
+  GST_DEBUG_OBJECT (filter, "VA buffers: %.1f allocations/s, "
+      "%.1f uploads/s, %u unchanged HDR metadata updates",
+      filter->num_buffer_allocs / elapsed,
+      filter->num_buffer_uploads / elapsed, filter->num_hdr_meta_skips);
+
+  filter->stats_time = now;
+  filter->num_buffer_allocs = 0;
+  filter->num_buffer_uploads = 0;
+  filter->num_hdr_meta_skips = 0;
+}
+
+static GstVaapiFilterStatus
+gst_vaapi_filter_process_sw (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, const GstVaapiFilterTarget * targets,
+    guint num_targets)
+{
+  const GstVaapiRectangle *crop_rect, *target_rect;
+  GstVaapiRectangle src_rect, dst_rect;
+  VARectangle va_rect;
+  guint i;
+
+  for (i = 0; i < num_targets; i++) {
+    const GstVaapiFilterTarget *const target = &targets[i];
+
+    crop_rect = target->crop_rect;
+    if (!crop_rect && filter->use_crop_rect)
+      crop_rect = &filter->crop_rect;
+    if (!get_source_region (src_surface, crop_rect, &va_rect))
+      return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+    src_rect.x = va_rect.x;
+    src_rect.y = va_rect.y;
+    src_rect.width = va_rect.width;
+    src_rect.height = va_rect.height;
+
+    target_rect = target->target_rect;
+    if (!target_rect && filter->use_target_rect)
+      target_rect = &filter->target_rect;
+    if (!get_target_region (target->surface, target_rect, &va_rect))
+      return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+    dst_rect.x = va_rect.x;
+    dst_rect.y = va_rect.y;
+    dst_rect.width = va_rect.width;
+    dst_rect.height = va_rect.height;
+
+    if (!gst_vaapi_filter_sw_process (filter->sw, src_surface, &src_rect,
+            &filter->input_colorimetry, target->surface, &dst_rect,
+            &filter->output_colorimetry, filter->scale_method))
+      return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+  return GST_VAAPI_FILTER_STATUS_SUCCESS;
+}
+
+/**
+ * gst_vaapi_filter_process:
+ * @filter: a #GstVaapiFilter
+ * @src_surface: the source @GstVaapiSurface
+ * @dst_surface: the destination @GstVaapiSurface
+ * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
+ *
+ * Applies the operations currently defined in the @filter to
+ * @src_surface and return the output in @dst_surface. The order of
+ * operations is determined in a way that suits best the underlying
+ * hardware. i.e. the only guarantee held is the generated outcome,
+ * not any specific order of operations.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+static GstVaapiFilterStatus
+gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, const GstVaapiFilterTarget * targets,
+    guint num_targets, guint flags)
+{
+  VAProcPipelineParameterBuffer pipeline_param;
+  const GstVaapiRectangle *crop_rect, *target_rect;
+  guint i;
+
+  if (!ensure_operations (filter))
+    return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
+
+  if (!fill_pipeline_param (filter, src_surface, flags, &pipeline_param))
     goto error;
 
+  for (i = 0; i < num_targets; i++) {
+    const GstVaapiFilterTarget *const target = &targets[i];
+
+    crop_rect = target->crop_rect;
+    if (!crop_rect && filter->use_crop_rect)
+      crop_rect = &filter->crop_rect;
+    if (!get_source_region (src_surface, crop_rect, &filter->va_src_rect))
+      goto error;
+
+    target_rect = target->target_rect;
+    if (!target_rect && filter->use_target_rect)
+      target_rect = &filter->target_rect;
+    if (!get_target_region (target->surface, target_rect,
+            &filter->va_dst_rect))
+      goto error;
+
+    if (!render_pipeline (filter, &pipeline_param, target->surface))
+      goto error;
+  }
+
   deint_refs_clear_all (filter);
-  vaapi_destroy_buffer (filter->va_display, &pipeline_param_buf_id);
+  report_buffer_stats (filter);
   return GST_VAAPI_FILTER_STATUS_SUCCESS;
 
   /* ERRORS */
 error:
   {
     deint_refs_clear_all (filter);
-    vaapi_destroy_buffer (filter->va_display, &pipeline_param_buf_id);
     return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
   }
 }
@@ -1838,6 +2151,7 @@ GstVaapiFilterStatus
 gst_vaapi_filter_process (GstVaapiFilter * filter,
     GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags)
 {
+  GstVaapiFilterTarget target = { dst_surface, NULL, NULL };
   GstVaapiFilterStatus status;
 
   g_return_val_if_fail (filter != NULL,
@@ -1847,10 +2161,175 @@ gst_vaapi_filter_process (GstVaapiFilter * filter,
   g_return_val_if_fail (dst_surface != NULL,
       GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  /* the CPU work must not block the display */
+  if (filter->sw)
+    return gst_vaapi_filter_process_sw (filter, src_surface, &target, 1);
+
+  GST_VAAPI_FILTER_LOCK (filter);
   status = gst_vaapi_filter_process_unlocked (filter,
-      src_surface, dst_surface, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+      src_surface, &target, 1, flags);
+  GST_VAAPI_FILTER_UNLOCK (filter);
+  return status;
+}
+
+/**
+ * gst_vaapi_filter_process_multi:
+ * @filter: a #GstVaapiFilter
+ * @src_surface: the source @GstVaapiSurface
+ * @targets: (array length=num_targets): the #GstVaapiFilterTarget
+ *   outputs
+ * @num_targets: the number of elements in @targets
+ * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
+ *
+ * Applies the operations currently defined in the @filter to
+ * @src_surface once for each of the @targets, e.g. to produce the
+ * renditions of an adaptive bitrate ladder. The pipeline setup, and
+ * its parameter buffer, is shared by all the outputs, which only
+ * differ by their regions and destination surfaces. The output
+ * format of each target is the format of its surface.
+ *
+ * The deinterlacing references, if any, apply to all the outputs.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+GstVaapiFilterStatus
+gst_vaapi_filter_process_multi (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, const GstVaapiFilterTarget * targets,
+    guint num_targets, guint flags)
+{
+  GstVaapiFilterStatus status;
+  guint i;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (src_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (targets != NULL && num_targets > 0,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  for (i = 0; i < num_targets; i++) {
+    if (!targets[i].surface)
+      return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+  }
+
+  if (filter->sw)
+    return gst_vaapi_filter_process_sw (filter, src_surface, targets,
+        num_targets);
+
+  GST_VAAPI_FILTER_LOCK (filter);
+  status = gst_vaapi_filter_process_unlocked (filter,
+      src_surface, targets, num_targets, flags);
+  GST_VAAPI_FILTER_UNLOCK (filter);
+  return status;
+}
+
+/* Renders both fields of @src_surface, in temporal order. Only the
+ * field flag of the deinterlacing parameters differs between the two
+ * submissions, so the pipeline setup is done once */
+static GstVaapiFilterStatus
+gst_vaapi_filter_process_fields_unlocked (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface ** dst_surfaces,
+    guint flags)
+{
+  VAProcPipelineParameterBuffer pipeline_param;
+  VAProcFilterParameterBufferDeinterlacing *deint;
+  const GstVaapiRectangle *crop_rect, *target_rect;
+  GstVaapiFilterOpData *op_data;
+  guint i, va_flags;
+
+  op_data = find_operation (filter, GST_VAAPI_FILTER_OP_DEINTERLACING);
+  if (!op_data || !op_data->is_enabled)
+    return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+
+  deint = op_data->va_data;
+  va_flags = deint->flags & ~VA_DEINTERLACING_BOTTOM_FIELD;
+  if (va_flags & VA_DEINTERLACING_BOTTOM_FIELD_FIRST)
+    va_flags |= VA_DEINTERLACING_BOTTOM_FIELD;
+  op_data_update (op_data,
+      G_STRUCT_OFFSET (VAProcFilterParameterBufferDeinterlacing, flags),
+      &va_flags, sizeof (va_flags));
+
+  if (!fill_pipeline_param (filter, src_surface, flags, &pipeline_param))
+    goto error;
+
+  crop_rect = filter->use_crop_rect ? &filter->crop_rect : NULL;
+  if (!get_source_region (src_surface, crop_rect, &filter->va_src_rect))
+    goto error;
+
+  target_rect = filter->use_target_rect ? &filter->target_rect : NULL;
+  for (i = 0; i < 2; i++) {
+    if (i > 0) {
+      va_flags ^= VA_DEINTERLACING_BOTTOM_FIELD;
+      op_data_update (op_data,
+          G_STRUCT_OFFSET (VAProcFilterParameterBufferDeinterlacing, flags),
+          &va_flags, sizeof (va_flags));
+      if (!op_data_upload (filter, op_data))
+        goto error;
+    }
+
+    if (!get_target_region (dst_surfaces[i], target_rect,
+            &filter->va_dst_rect))
+      goto error;
+    if (!render_pipeline (filter, &pipeline_param, dst_surfaces[i]))
+      goto error;
+  }
+
+  deint_refs_clear_all (filter);
+  report_buffer_stats (filter);
+  return GST_VAAPI_FILTER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error:
+  {
+    deint_refs_clear_all (filter);
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
+/**
+ * gst_vaapi_filter_process_fields:
+ * @filter: a #GstVaapiFilter
+ * @src_surface: the source interlaced @GstVaapiSurface
+ * @first_surface: the destination @GstVaapiSurface of the first field
+ * @second_surface: the destination @GstVaapiSurface of the second field
+ * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
+ *
+ * Deinterlaces @src_surface at field rate, i.e. into one frame per
+ * field, in temporal order as given by the field order set through
+ * gst_vaapi_filter_set_deinterlacing(). The field selection flags of
+ * the latter are ignored.
+ *
+ * This is equivalent to two calls to gst_vaapi_filter_process(), but
+ * the pipeline setup and the deinterlacing references, set through
+ * gst_vaapi_filter_set_deinterlacing_references(), are shared by the
+ * two fields.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+GstVaapiFilterStatus
+gst_vaapi_filter_process_fields (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface * first_surface,
+    GstVaapiSurface * second_surface, guint flags)
+{
+  GstVaapiSurface *dst_surfaces[2] = { first_surface, second_surface };
+  GstVaapiFilterStatus status;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (src_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (first_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (second_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  if (filter->sw)
+    return GST_VAAPI_FILTER_STATUS_ERROR_UNSUPPORTED_OPERATION;
+
+  GST_VAAPI_FILTER_LOCK (filter);
+  status = gst_vaapi_filter_process_fields_unlocked (filter, src_surface,
+      dst_surfaces, flags);
+  GST_VAAPI_FILTER_UNLOCK (filter);
   return status;
 }
 
@@ -2388,6 +2867,10 @@ gst_vaapi_filter_set_colorimetry_unlocked (GstVaapiFilter * filter,
   out_color = gst_video_colorimetry_to_string (&filter->output_colorimetry);
   GST_DEBUG_OBJECT (filter, "output colorimetry '%s'", out_color);
 
+  /* GstVideoConverter handles any colorimetry */
+  if (filter->sw)
+    goto done;
+
   if (!gst_vaapi_display_has_driver_quirks (filter->display,
           GST_VAAPI_DRIVER_QUIRK_NO_CHECK_VPP_COLOR_STD)) {
     VAProcPipelineCaps pipeline_caps = { 0, };
@@ -2425,6 +2908,7 @@ gst_vaapi_filter_set_colorimetry_unlocked (GstVaapiFilter * filter,
         " vpp may fail or produce unexpected results.");
   }
 
+done:
   g_free (in_color);
   g_free (out_color);
 
@@ -2439,9 +2923,9 @@ gst_vaapi_filter_set_colorimetry (GstVaapiFilter * filter,
 
   g_return_val_if_fail (filter != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   result = gst_vaapi_filter_set_colorimetry_unlocked (filter, input, output);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
 
   return result;
 }
@@ -2464,51 +2948,75 @@ gst_vaapi_filter_set_hdr_tone_map (GstVaapiFilter * filter, gboolean value)
       find_operation (filter, GST_VAAPI_FILTER_OP_HDR_TONE_MAP), value);
 }
 
+#if VA_CHECK_VERSION(1,4,0)
+/* Stages @meta for the tone mapping operation. The driver reads the
+ * metadata through the pointer held by the parameter buffer, so the
+ * buffer is only uploaded again when the metadata values change */
 static gboolean
-gst_vaapi_filter_set_hdr_tone_map_meta_unlocked (GstVaapiFilter * filter,
-    GstVideoMasteringDisplayInfo * minfo, GstVideoContentLightLevel * linfo)
+op_set_hdr_tone_map_meta_unlocked (GstVaapiFilter * filter,
+    const VAHdrMetaDataHDR10 * meta)
 {
-#if VA_CHECK_VERSION(1,4,0)
   GstVaapiFilterOpData *op_data;
-  VAProcFilterParameterBufferHDRToneMapping *buf;
-  VAHdrMetaDataHDR10 *meta = &filter->hdr_meta;
+  VAProcFilterParameterBufferHDRToneMapping buf;
 
   op_data = find_operation (filter, GST_VAAPI_FILTER_OP_HDR_TONE_MAP);
 
-  if (!op_data)
+  if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
-  meta->display_primaries_x[0] = minfo->display_primaries[1].x;
-  meta->display_primaries_x[1] = minfo->display_primaries[2].x;
-  meta->display_primaries_x[2] = minfo->display_primaries[0].x;
+  memset (&buf, 0, sizeof (buf));
+  buf.type = op_data->va_type;
+  buf.data.metadata_type = op_data->va_subtype;
+  buf.data.metadata = &filter->hdr_meta;
+  buf.data.metadata_size = sizeof (filter->hdr_meta);
+  op_data_update (op_data, 0, &buf, sizeof (buf));
 
-  meta->display_primaries_y[0] = minfo->display_primaries[1].y;
-  meta->display_primaries_y[1] = minfo->display_primaries[2].y;
-  meta->display_primaries_y[2] = minfo->display_primaries[0].y;
+  if (memcmp (&filter->hdr_meta, meta, sizeof (*meta)) == 0) {
+    filter->num_hdr_meta_skips++;
+    return TRUE;
+  }
 
-  meta->white_point_x = minfo->white_point.x;
-  meta->white_point_y = minfo->white_point.y;
+  GST_DEBUG_OBJECT (filter, "HDR metadata changed: max CLL %u, max FALL %u, "
+      "mastering luminance %u..%u", meta->max_content_light_level,
+      meta->max_pic_average_light_level,
+      meta->min_display_mastering_luminance,
+      meta->max_display_mastering_luminance);
 
-  meta->max_display_mastering_luminance =
-      minfo->max_display_mastering_luminance;
-  meta->min_display_mastering_luminance =
-      minfo->min_display_mastering_luminance;
+  filter->hdr_meta = *meta;
+  op_data->is_dirty = 1;
+  return TRUE;
+}
+#endif
+
+static gboolean
+gst_vaapi_filter_set_hdr_tone_map_meta_unlocked (GstVaapiFilter * filter,
+    GstVideoMasteringDisplayInfo * minfo, GstVideoContentLightLevel * linfo)
+{
+#if VA_CHECK_VERSION(1,4,0)
+  VAHdrMetaDataHDR10 meta;
 
-  meta->max_content_light_level = linfo->max_content_light_level;
-  meta->max_pic_average_light_level = linfo->max_frame_average_light_level;
+  memset (&meta, 0, sizeof (meta));
 
-  buf = vaapi_map_buffer (filter->va_display, op_data->va_buffer);
-  if (!buf)
-    return FALSE;
+  meta.display_primaries_x[0] = minfo->display_primaries[1].x;
+  meta.display_primaries_x[1] = minfo->display_primaries[2].x;
+  meta.display_primaries_x[2] = minfo->display_primaries[0].x;
 
-  buf->type = op_data->va_type;
-  buf->data.metadata_type = op_data->va_subtype;
-  buf->data.metadata = meta;
-  buf->data.metadata_size = sizeof (meta);
+  meta.display_primaries_y[0] = minfo->display_primaries[1].y;
+  meta.display_primaries_y[1] = minfo->display_primaries[2].y;
+  meta.display_primaries_y[2] = minfo->display_primaries[0].y;
 
-  vaapi_unmap_buffer (filter->va_display, op_data->va_buffer, NULL);
+  meta.white_point_x = minfo->white_point.x;
+  meta.white_point_y = minfo->white_point.y;
 
-  return TRUE;
+  meta.max_display_mastering_luminance =
+      minfo->max_display_mastering_luminance;
+  meta.min_display_mastering_luminance =
+      minfo->min_display_mastering_luminance;
+
+  meta.max_content_light_level = linfo->max_content_light_level;
+  meta.max_pic_average_light_level = linfo->max_frame_average_light_level;
+
+  return op_set_hdr_tone_map_meta_unlocked (filter, &meta);
 #else
   return FALSE;
 #endif
@@ -2534,10 +3042,50 @@ gst_vaapi_filter_set_hdr_tone_map_meta (GstVaapiFilter * filter,
   g_return_val_if_fail (minfo != NULL, FALSE);
   g_return_val_if_fail (linfo != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_FILTER_LOCK (filter);
   status =
       gst_vaapi_filter_set_hdr_tone_map_meta_unlocked (filter, minfo, linfo);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_FILTER_UNLOCK (filter);
+
+  return status;
+}
+
+/**
+ * gst_vaapi_filter_set_hdr_tone_map_scene_meta:
+ * @filter: a #GstVaapiFilter
+ * @linfo: a #GstVideoContentLightLevel
+ *
+ * Updates the content light levels of the HDR meta data used for tone
+ * mapping, keeping the mastering display information previously set
+ * with gst_vaapi_filter_set_hdr_tone_map_meta(). This is meant for
+ * streams carrying per-scene light levels, in the way of HDR10+: the
+ * driver only gets new parameters when the levels actually change.
+ * vaapipostproc feeds it from the "GstVaapiHDRSceneMeta" of its input
+ * frames.
+ *
+ * Return value: %TRUE if the operation is supported, %FALSE otherwise.
+ */
+gboolean
+gst_vaapi_filter_set_hdr_tone_map_scene_meta (GstVaapiFilter * filter,
+    GstVideoContentLightLevel * linfo)
+{
+  gboolean status = FALSE;
+
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (linfo != NULL, FALSE);
+
+#if VA_CHECK_VERSION(1,4,0)
+  {
+    VAHdrMetaDataHDR10 meta;
+
+    GST_VAAPI_FILTER_LOCK (filter);
+    meta = filter->hdr_meta;
+    meta.max_content_light_level = linfo->max_content_light_level;
+    meta.max_pic_average_light_level = linfo->max_frame_average_light_level;
+    status = op_set_hdr_tone_map_meta_unlocked (filter, &meta);
+    GST_VAAPI_FILTER_UNLOCK (filter);
+  }
+#endif
 
   return status;
 }
@@ -37,6 +37,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstVaapiFilter                  GstVaapiFilter;
 typedef struct _GstVaapiFilterOpInfo            GstVaapiFilterOpInfo;
+typedef struct _GstVaapiFilterTarget            GstVaapiFilterTarget;
 
 /**
  * @GST_VAAPI_FILTER_OP_FORMAT: Force output pixel format (#GstVideoFormat).
@@ -88,6 +89,23 @@ struct _GstVaapiFilterOpInfo
   GParamSpec *const pspec;
 };
 
+/**
+ * GstVaapiFilterTarget:
+ * @surface: the destination #GstVaapiSurface
+ * @crop_rect: (nullable): the source region, or %NULL to use the
+ *   cropping rectangle of the filter
+ * @target_rect: (nullable): the output region, or %NULL to use the
+ *   target rectangle of the filter
+ *
+ * An output of gst_vaapi_filter_process_multi().
+ */
+struct _GstVaapiFilterTarget
+{
+  GstVaapiSurface *surface;
+  const GstVaapiRectangle *crop_rect;
+  const GstVaapiRectangle *target_rect;
+};
+
 /**
  * GstVaapiFilterStatus:
  * @GST_VAAPI_FILTER_STATUS_SUCCESS: Success.
@@ -189,6 +207,12 @@ gst_vaapi_filter_get_type (void) G_GNUC_CONST;
 GstVaapiFilter *
 gst_vaapi_filter_new (GstVaapiDisplay * display);
 
+GstVaapiFilter *
+gst_vaapi_filter_new_software (GstVaapiDisplay * display);
+
+gboolean
+gst_vaapi_filter_is_software (GstVaapiFilter * filter);
+
 void
 gst_vaapi_filter_replace (GstVaapiFilter ** old_filter_ptr,
     GstVaapiFilter * new_filter);
@@ -210,6 +234,16 @@ GstVaapiFilterStatus
 gst_vaapi_filter_process (GstVaapiFilter * filter,
     GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags);
 
+GstVaapiFilterStatus
+gst_vaapi_filter_process_multi (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, const GstVaapiFilterTarget * targets,
+    guint num_targets, guint flags);
+
+GstVaapiFilterStatus
+gst_vaapi_filter_process_fields (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface * first_surface,
+    GstVaapiSurface * second_surface, guint flags);
+
 GArray *
 gst_vaapi_filter_get_formats (GstVaapiFilter * filter);
 
@@ -275,6 +309,10 @@ gboolean
 gst_vaapi_filter_set_hdr_tone_map_meta (GstVaapiFilter * filter,
     GstVideoMasteringDisplayInfo * minfo, GstVideoContentLightLevel * linfo);
 
+gboolean
+gst_vaapi_filter_set_hdr_tone_map_scene_meta (GstVaapiFilter * filter,
+    GstVideoContentLightLevel * linfo);
+
 #ifndef GST_REMOVE_DEPRECATED
 gboolean
 gst_vaapi_filter_set_skintone (GstVaapiFilter * filter,
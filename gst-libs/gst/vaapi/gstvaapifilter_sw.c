@@ -0,0 +1,307 @@
+/*
+ *  gstvaapifilter_sw.c - Software fallback for video processing
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* Scaling and color conversion between VA surfaces, on the CPU, for
+ * drivers without VPP. The surfaces are accessed through derived
+ * images when the driver allows it, so that the pixels are converted
+ * in place, or else through a copy. The work is done by
+ * GstVideoConverter, whose ORC kernels are vectorized, split into
+ * horizontal stripes over all the CPUs. */
+
+#include "sysdeps.h"
+#include <gst/video/video-converter.h>
+#include "gstvaapifilter_sw.h"
+#include "gstvaapiimage.h"
+#include "gstvaapisurface_priv.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+struct _GstVaapiFilterSw
+{
+  GstVaapiDisplay *display;
+  guint num_threads;
+
+  /* the converter is kept until the geometry changes */
+  GstVideoConverter *converter;
+  GstVideoInfo in_info;
+  GstVideoInfo out_info;
+  GstVaapiRectangle src_rect;
+  GstVaapiRectangle dst_rect;
+  GstVaapiScaleMethod scale_method;
+
+  /* copies of the surfaces that can't be derived */
+  GstVaapiImage *src_image;
+  GstVaapiImage *dst_image;
+};
+
+/* Formats both GstVideoConverter and VA images handle */
+static const GstVideoFormat sw_formats[] = {
+  GST_VIDEO_FORMAT_NV12,
+  GST_VIDEO_FORMAT_P010_10LE,
+  GST_VIDEO_FORMAT_I420,
+  GST_VIDEO_FORMAT_YV12,
+  GST_VIDEO_FORMAT_YUY2,
+  GST_VIDEO_FORMAT_UYVY,
+  GST_VIDEO_FORMAT_BGRA,
+  GST_VIDEO_FORMAT_RGBA,
+  GST_VIDEO_FORMAT_BGRx,
+  GST_VIDEO_FORMAT_RGBx,
+};
+
+GstVaapiFilterSw *
+gst_vaapi_filter_sw_new (GstVaapiDisplay * display)
+{
+  GstVaapiFilterSw *sw;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  sw = g_slice_new0 (GstVaapiFilterSw);
+  sw->display = gst_object_ref (display);
+  sw->num_threads = g_get_num_processors ();
+  return sw;
+}
+
+void
+gst_vaapi_filter_sw_free (GstVaapiFilterSw * sw)
+{
+  if (!sw)
+    return;
+
+  g_clear_pointer (&sw->converter, gst_video_converter_free);
+  gst_mini_object_replace ((GstMiniObject **) & sw->src_image, NULL);
+  gst_mini_object_replace ((GstMiniObject **) & sw->dst_image, NULL);
+  gst_vaapi_display_replace (&sw->display, NULL);
+  g_slice_free (GstVaapiFilterSw, sw);
+}
+
+GArray *
+gst_vaapi_filter_sw_get_formats (GstVaapiFilterSw * sw)
+{
+  GArray *formats;
+  guint i;
+
+  formats = g_array_sized_new (FALSE, FALSE, sizeof (GstVideoFormat),
+      G_N_ELEMENTS (sw_formats));
+  for (i = 0; i < G_N_ELEMENTS (sw_formats); i++) {
+    if (gst_vaapi_display_has_image_format (sw->display, sw_formats[i]))
+      g_array_append_val (formats, sw_formats[i]);
+  }
+  return formats;
+}
+
+/* Returns an image holding the pixels of @surface: derived if
+ * possible, or else @cache, filled from the surface if @read */
+static GstVaapiImage *
+acquire_image (GstVaapiFilterSw * sw, GstVaapiSurface * surface,
+    GstVaapiImage ** cache, gboolean read, gboolean * is_derived)
+{
+  const guint width = GST_VAAPI_SURFACE_WIDTH (surface);
+  const guint height = GST_VAAPI_SURFACE_HEIGHT (surface);
+  GstVaapiImage *image;
+  GstVideoFormat format;
+
+  image = gst_vaapi_surface_derive_image (surface);
+  if (image) {
+    *is_derived = TRUE;
+    return image;
+  }
+  *is_derived = FALSE;
+
+  format = gst_vaapi_surface_get_format (surface);
+  if (format == GST_VIDEO_FORMAT_UNKNOWN || format == GST_VIDEO_FORMAT_ENCODED)
+    format = GST_VIDEO_FORMAT_NV12;
+
+  image = *cache;
+  if (image && (GST_VAAPI_IMAGE_FORMAT (image) != format
+          || GST_VAAPI_IMAGE_WIDTH (image) != width
+          || GST_VAAPI_IMAGE_HEIGHT (image) != height))
+    gst_mini_object_replace ((GstMiniObject **) cache, NULL);
+
+  if (!*cache) {
+    *cache = gst_vaapi_image_new (sw->display, format, width, height);
+    if (!*cache)
+      return NULL;
+  }
+
+  if (read && !gst_vaapi_surface_get_image (surface, *cache))
+    return NULL;
+  return (GstVaapiImage *) gst_mini_object_ref (GST_MINI_OBJECT_CAST (*cache));
+}
+
+/* Overrides the defaults of the format with what @colorimetry
+ * defines. An RGB format keeps its own matrix */
+static void
+set_colorimetry (GstVideoInfo * vip, const GstVideoColorimetry * colorimetry)
+{
+  GstVideoColorimetry *const cinfo = &GST_VIDEO_INFO_COLORIMETRY (vip);
+
+  if (colorimetry->range != GST_VIDEO_COLOR_RANGE_UNKNOWN)
+    cinfo->range = colorimetry->range;
+  if (colorimetry->matrix != GST_VIDEO_COLOR_MATRIX_UNKNOWN
+      && !GST_VIDEO_INFO_IS_RGB (vip))
+    cinfo->matrix = colorimetry->matrix;
+  if (colorimetry->transfer != GST_VIDEO_TRANSFER_UNKNOWN)
+    cinfo->transfer = colorimetry->transfer;
+  if (colorimetry->primaries != GST_VIDEO_COLOR_PRIMARIES_UNKNOWN)
+    cinfo->primaries = colorimetry->primaries;
+}
+
+/* Wraps the mapped @image into @frame, without any GstBuffer */
+static gboolean
+map_frame (GstVaapiImage * image, guint width, guint height,
+    const GstVideoColorimetry * colorimetry, GstVideoFrame * frame)
+{
+  guint i;
+
+  memset (frame, 0, sizeof (*frame));
+  if (!gst_video_info_set_format (&frame->info, GST_VAAPI_IMAGE_FORMAT (image),
+          width, height))
+    return FALSE;
+  set_colorimetry (&frame->info, colorimetry);
+  if (GST_VIDEO_INFO_N_PLANES (&frame->info) >
+      gst_vaapi_image_get_plane_count (image))
+    return FALSE;
+
+  if (!gst_vaapi_image_map (image))
+    return FALSE;
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (&frame->info); i++) {
+    frame->data[i] = gst_vaapi_image_get_plane (image, i);
+    GST_VIDEO_INFO_PLANE_STRIDE (&frame->info, i) =
+        gst_vaapi_image_get_pitch (image, i);
+  }
+  return TRUE;
+}
+
+static gboolean
+ensure_converter (GstVaapiFilterSw * sw, const GstVideoInfo * in_info,
+    const GstVaapiRectangle * src_rect, const GstVideoInfo * out_info,
+    const GstVaapiRectangle * dst_rect, GstVaapiScaleMethod scale_method)
+{
+  GstVideoResamplerMethod method;
+  GstStructure *config;
+
+  if (sw->converter && sw->scale_method == scale_method
+      && gst_video_info_is_equal (&sw->in_info, in_info)
+      && gst_video_info_is_equal (&sw->out_info, out_info)
+      && memcmp (&sw->src_rect, src_rect, sizeof (*src_rect)) == 0
+      && memcmp (&sw->dst_rect, dst_rect, sizeof (*dst_rect)) == 0)
+    return TRUE;
+
+  g_clear_pointer (&sw->converter, gst_video_converter_free);
+
+  method = scale_method == GST_VAAPI_SCALE_METHOD_HQ ?
+      GST_VIDEO_RESAMPLER_METHOD_CUBIC : GST_VIDEO_RESAMPLER_METHOD_LINEAR;
+
+  config = gst_structure_new ("GstVaapiFilterSw",
+      GST_VIDEO_CONVERTER_OPT_SRC_X, G_TYPE_INT, src_rect->x,
+      GST_VIDEO_CONVERTER_OPT_SRC_Y, G_TYPE_INT, src_rect->y,
+      GST_VIDEO_CONVERTER_OPT_SRC_WIDTH, G_TYPE_INT, src_rect->width,
+      GST_VIDEO_CONVERTER_OPT_SRC_HEIGHT, G_TYPE_INT, src_rect->height,
+      GST_VIDEO_CONVERTER_OPT_DEST_X, G_TYPE_INT, dst_rect->x,
+      GST_VIDEO_CONVERTER_OPT_DEST_Y, G_TYPE_INT, dst_rect->y,
+      GST_VIDEO_CONVERTER_OPT_DEST_WIDTH, G_TYPE_INT, dst_rect->width,
+      GST_VIDEO_CONVERTER_OPT_DEST_HEIGHT, G_TYPE_INT, dst_rect->height,
+      GST_VIDEO_CONVERTER_OPT_RESAMPLER_METHOD,
+      GST_TYPE_VIDEO_RESAMPLER_METHOD, method,
+      GST_VIDEO_CONVERTER_OPT_CHROMA_RESAMPLER_METHOD,
+      GST_TYPE_VIDEO_RESAMPLER_METHOD, method,
+      GST_VIDEO_CONVERTER_OPT_THREADS, G_TYPE_UINT, sw->num_threads, NULL);
+
+  sw->converter = gst_video_converter_new ((GstVideoInfo *) in_info,
+      (GstVideoInfo *) out_info, config);
+  if (!sw->converter)
+    return FALSE;
+
+  GST_DEBUG ("converting %s %ux%u -> %s %ux%u with %u threads",
+      GST_VIDEO_INFO_NAME (in_info), src_rect->width, src_rect->height,
+      GST_VIDEO_INFO_NAME (out_info), dst_rect->width, dst_rect->height,
+      sw->num_threads);
+
+  sw->in_info = *in_info;
+  sw->out_info = *out_info;
+  sw->src_rect = *src_rect;
+  sw->dst_rect = *dst_rect;
+  sw->scale_method = scale_method;
+  return TRUE;
+}
+
+/* Scales and converts @src_rect of @src_surface into @dst_rect of
+ * @dst_surface, between the given colorimetries. The rest of
+ * @dst_surface is filled with black, as VPP does */
+gboolean
+gst_vaapi_filter_sw_process (GstVaapiFilterSw * sw,
+    GstVaapiSurface * src_surface, const GstVaapiRectangle * src_rect,
+    const GstVideoColorimetry * src_colorimetry,
+    GstVaapiSurface * dst_surface, const GstVaapiRectangle * dst_rect,
+    const GstVideoColorimetry * dst_colorimetry,
+    GstVaapiScaleMethod scale_method)
+{
+  GstVaapiImage *src_image = NULL, *dst_image = NULL;
+  GstVideoFrame in_frame, out_frame;
+  gboolean src_derived, dst_derived;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (sw != NULL, FALSE);
+
+  /* the surfaces may still be in use by the hardware */
+  if (!gst_vaapi_surface_sync (src_surface))
+    return FALSE;
+  if (!gst_vaapi_surface_sync (dst_surface))
+    return FALSE;
+
+  src_image = acquire_image (sw, src_surface, &sw->src_image, TRUE,
+      &src_derived);
+  if (!src_image)
+    goto bail;
+  dst_image = acquire_image (sw, dst_surface, &sw->dst_image, FALSE,
+      &dst_derived);
+  if (!dst_image)
+    goto bail;
+
+  if (!map_frame (src_image, GST_VAAPI_SURFACE_WIDTH (src_surface),
+          GST_VAAPI_SURFACE_HEIGHT (src_surface), src_colorimetry, &in_frame))
+    goto bail;
+  if (!map_frame (dst_image, GST_VAAPI_SURFACE_WIDTH (dst_surface),
+          GST_VAAPI_SURFACE_HEIGHT (dst_surface), dst_colorimetry,
+          &out_frame)) {
+    gst_vaapi_image_unmap (src_image);
+    goto bail;
+  }
+
+  if (ensure_converter (sw, &in_frame.info, src_rect, &out_frame.info,
+          dst_rect, scale_method)) {
+    gst_video_converter_frame (sw->converter, &in_frame, &out_frame);
+    success = TRUE;
+  }
+
+  gst_vaapi_image_unmap (dst_image);
+  gst_vaapi_image_unmap (src_image);
+
+  if (success && !dst_derived)
+    success = gst_vaapi_surface_put_image (dst_surface, dst_image);
+
+bail:
+  if (dst_image)
+    gst_vaapi_image_unref (dst_image);
+  if (src_image)
+    gst_vaapi_image_unref (src_image);
+  return success;
+}
@@ -0,0 +1,52 @@
+/*
+ *  gstvaapifilter_sw.h - Software fallback for video processing
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_FILTER_SW_H
+#define GST_VAAPI_FILTER_SW_H
+
+#include <gst/vaapi/gstvaapifilter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiFilterSw GstVaapiFilterSw;
+
+G_GNUC_INTERNAL
+GstVaapiFilterSw *
+gst_vaapi_filter_sw_new (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_filter_sw_free (GstVaapiFilterSw * sw);
+
+G_GNUC_INTERNAL
+GArray *
+gst_vaapi_filter_sw_get_formats (GstVaapiFilterSw * sw);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_filter_sw_process (GstVaapiFilterSw * sw,
+    GstVaapiSurface * src_surface, const GstVaapiRectangle * src_rect,
+    const GstVideoColorimetry * src_colorimetry,
+    GstVaapiSurface * dst_surface, const GstVaapiRectangle * dst_rect,
+    const GstVideoColorimetry * dst_colorimetry,
+    GstVaapiScaleMethod scale_method);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_FILTER_SW_H */
@@ -0,0 +1,170 @@
+/*
+ *  gstvaapihdrscenemeta.c - Per-scene HDR light levels meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapihdrscenemeta
+ * @short_description: Per-scene HDR light levels
+ *
+ * The content light levels in the caps hold for the whole stream.
+ * Streams with dynamic metadata, in the way of HDR10+, refine them
+ * for each scene: the parser or the application can then attach the
+ * levels of the current scene to the first frame of the scene, and
+ * vaapipostproc updates its tone mapping with them. The levels hold
+ * until the next frame carrying the meta.
+ *
+ * The levels are a #GstCustomMeta, so that any element can produce
+ * them without linking to this library. Its name, and the name of its
+ * #GstStructure, is "GstVaapiHDRSceneMeta", and the structure holds:
+ *
+ * - "max-content-light-level" (#G_TYPE_UINT): the maximum light
+ *   level of the scene, in cd/m^2
+ * - "max-frame-average-light-level" (#G_TYPE_UINT): the maximum
+ *   average light level of a frame of the scene, in cd/m^2
+ *
+ * The meta is registered when the vaapi plugin is loaded. Producers
+ * can also register it with gst_meta_register_custom() if
+ * gst_meta_get_info() doesn't know it yet.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapihdrscenemeta.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* The light levels don't depend on the frame geometry, so they are
+ * kept when the frame is copied or scaled, but dropped on any other
+ * transform */
+static gboolean
+gst_vaapi_hdr_scene_meta_transform (GstBuffer * dst_buffer,
+    GstCustomMeta * meta, GstBuffer * src_buffer, GQuark type,
+    gpointer data, gpointer user_data)
+{
+  GstVideoContentLightLevel linfo;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type) &&
+      !GST_VIDEO_META_TRANSFORM_IS_SCALE (type))
+    return FALSE;
+
+  if (!gst_buffer_get_vaapi_hdr_scene (src_buffer, &linfo))
+    return FALSE;
+  return gst_buffer_add_vaapi_hdr_scene_meta (dst_buffer, &linfo) != NULL;
+}
+
+/**
+ * gst_vaapi_hdr_scene_meta_register:
+ *
+ * Registers the "GstVaapiHDRSceneMeta" #GstCustomMeta, unless it is
+ * already registered.
+ */
+void
+gst_vaapi_hdr_scene_meta_register (void)
+{
+  static gsize registered = 0;
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR, NULL };
+
+  if (g_once_init_enter (&registered)) {
+    if (!gst_meta_get_info (GST_VAAPI_HDR_SCENE_META_NAME)) {
+      gst_meta_register_custom (GST_VAAPI_HDR_SCENE_META_NAME, tags,
+          gst_vaapi_hdr_scene_meta_transform, NULL, NULL);
+    }
+    g_once_init_leave (&registered, 1);
+  }
+}
+
+/**
+ * gst_buffer_add_vaapi_hdr_scene_meta:
+ * @buffer: a #GstBuffer
+ * @linfo: the #GstVideoContentLightLevel of the scene
+ *
+ * Attaches the light levels of the scene starting with @buffer.
+ *
+ * Returns: (transfer none): the #GstCustomMeta on @buffer, or %NULL
+ *   on error
+ */
+GstCustomMeta *
+gst_buffer_add_vaapi_hdr_scene_meta (GstBuffer * buffer,
+    const GstVideoContentLightLevel * linfo)
+{
+  GstCustomMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (linfo != NULL, NULL);
+
+  gst_vaapi_hdr_scene_meta_register ();
+
+  meta = gst_buffer_add_custom_meta (buffer, GST_VAAPI_HDR_SCENE_META_NAME);
+  if (!meta)
+    return NULL;
+
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "max-content-light-level", G_TYPE_UINT,
+      (guint) linfo->max_content_light_level,
+      "max-frame-average-light-level", G_TYPE_UINT,
+      (guint) linfo->max_frame_average_light_level, NULL);
+  return meta;
+}
+
+/**
+ * gst_buffer_get_vaapi_hdr_scene:
+ * @buffer: a #GstBuffer
+ * @linfo: (out): the #GstVideoContentLightLevel to fill in
+ *
+ * Looks up the light levels of the scene attached to @buffer.
+ *
+ * Returns: %TRUE if @buffer starts a scene with valid light levels
+ */
+gboolean
+gst_buffer_get_vaapi_hdr_scene (GstBuffer * buffer,
+    GstVideoContentLightLevel * linfo)
+{
+  const GstStructure *structure;
+  GstCustomMeta *meta;
+  guint max_cll, max_fall;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (linfo != NULL, FALSE);
+
+  meta = gst_buffer_get_custom_meta (buffer, GST_VAAPI_HDR_SCENE_META_NAME);
+  if (!meta)
+    return FALSE;
+
+  structure = gst_custom_meta_get_structure (meta);
+  if (!gst_structure_get (structure,
+          "max-content-light-level", G_TYPE_UINT, &max_cll,
+          "max-frame-average-light-level", G_TYPE_UINT, &max_fall, NULL))
+    goto error_invalid_levels;
+
+  /* the levels are 16-bit in the SEI and in VA */
+  if (max_cll > G_MAXUINT16 || max_fall > G_MAXUINT16)
+    goto error_invalid_levels;
+
+  gst_video_content_light_level_init (linfo);
+  linfo->max_content_light_level = max_cll;
+  linfo->max_frame_average_light_level = max_fall;
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_levels:
+  {
+    GST_WARNING ("invalid HDR scene light levels %" GST_PTR_FORMAT,
+        structure);
+    return FALSE;
+  }
+}
@@ -0,0 +1,49 @@
+/*
+ *  gstvaapihdrscenemeta.h - Per-scene HDR light levels meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_HDR_SCENE_META_H
+#define GST_VAAPI_HDR_SCENE_META_H
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_HDR_SCENE_META_NAME:
+ *
+ * The name of the #GstCustomMeta carrying the light levels of a
+ * scene, and of its #GstStructure.
+ */
+#define GST_VAAPI_HDR_SCENE_META_NAME "GstVaapiHDRSceneMeta"
+
+void
+gst_vaapi_hdr_scene_meta_register (void);
+
+GstCustomMeta *
+gst_buffer_add_vaapi_hdr_scene_meta (GstBuffer * buffer,
+    const GstVideoContentLightLevel * linfo);
+
+gboolean
+gst_buffer_get_vaapi_hdr_scene (GstBuffer * buffer,
+    GstVideoContentLightLevel * linfo);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_HDR_SCENE_META_H */
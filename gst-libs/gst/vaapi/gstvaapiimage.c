@@ -32,6 +32,7 @@
 #include "gstvaapiutils.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
+#include "gstvaapidisplay_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -126,15 +127,17 @@ gst_vaapi_image_free (GstVaapiImage * image)
   GST_DEBUG ("image %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (image_id));
 
   if (image_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), image_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyImage()"))
       GST_WARNING ("failed to destroy image %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (image_id));
     GST_VAAPI_IMAGE_ID (image) = VA_INVALID_ID;
   }
 
+  if (image->memory_size)
+    gst_vaapi_display_release_memory (display, image->memory_size);
   gst_vaapi_display_replace (&GST_VAAPI_IMAGE_DISPLAY (image), NULL);
 
   g_slice_free1 (sizeof (GstVaapiImage), image);
@@ -154,11 +157,11 @@ _gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format)
   if (!va_format)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       (VAImageFormat *) va_format,
       image->width, image->height, &image->internal_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (status != VA_STATUS_SUCCESS ||
       image->internal_image.format.fourcc != va_format->fourcc)
     return FALSE;
@@ -167,6 +170,25 @@ _gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format)
   return TRUE;
 }
 
+/* Accounts for the image memory before it is allocated. It is
+   released along with the image, even if its creation fails */
+static gboolean
+reserve_image_memory (GstVaapiImage * image, GstVideoFormat format,
+    guint width, guint height)
+{
+  GstVideoInfo vi;
+  guint64 size = 0;
+
+  if (gst_video_info_set_format (&vi, format, width, height))
+    size = GST_VIDEO_INFO_SIZE (&vi);
+
+  if (!gst_vaapi_display_reserve_memory (GST_VAAPI_IMAGE_DISPLAY (image),
+          size))
+    return FALSE;
+  image->memory_size = size;
+  return TRUE;
+}
+
 static gboolean
 gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format,
     guint width, guint height)
@@ -178,6 +200,9 @@ gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format,
   image->width = width;
   image->height = height;
 
+  if (!reserve_image_memory (image, format, width, height))
+    return FALSE;
+
   if (!_gst_vaapi_image_create (image, format)) {
     switch (format) {
       case GST_VIDEO_FORMAT_I420:
@@ -236,6 +261,7 @@ gst_vaapi_image_init (GstVaapiImage * image, GstVaapiDisplay * display)
   image->image_data = NULL;
   image->internal_format = image->format = GST_VIDEO_FORMAT_UNKNOWN;
   image->width = image->height = 0;
+  image->memory_size = 0;
   image->is_linear = FALSE;
 }
 
@@ -584,10 +610,10 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaMapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf, (void **) &image->image_data);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return FALSE;
 
@@ -637,10 +663,10 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaUnmapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return FALSE;
 
@@ -49,6 +49,7 @@ struct _GstVaapiImage {
     GstVideoFormat      format;
     guint               width;
     guint               height;
+    guint64             memory_size;
     guint               is_linear       : 1;
 };
 
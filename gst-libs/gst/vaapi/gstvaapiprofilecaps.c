@@ -30,6 +30,7 @@
 #include "gstvaapicontext.h"
 #include "gstvaapiprofilecaps.h"
 #include "gstvaapiutils.h"
+#include "gstvaapidisplay_priv.h"
 
 static gboolean
 init_context_info (GstVaapiDisplay * display, GstVaapiContextInfo * cip)
@@ -57,38 +58,67 @@ create_context (GstVaapiDisplay * display, GstVaapiContextInfo * cip)
 }
 
 static gboolean
-append_caps (GstVaapiContext * context, GstStructure * structure)
+append_caps (const GstVaapiConfigSurfaceAttributes * attribs,
+    GstStructure * structure)
 {
-  GstVaapiConfigSurfaceAttributes attribs = { 0, };
-
-  if (!gst_vaapi_context_get_surface_attributes (context, &attribs))
+  if (attribs->min_width >= attribs->max_width ||
+      attribs->min_height >= attribs->max_height)
     return FALSE;
 
-  if (attribs.min_width >= attribs.max_width ||
-      attribs.min_height >= attribs.max_height)
-    return FALSE;
-
-  gst_structure_set (structure, "width", GST_TYPE_INT_RANGE, attribs.min_width,
-      attribs.max_width, "height", GST_TYPE_INT_RANGE, attribs.min_height,
-      attribs.max_height, NULL);
+  gst_structure_set (structure, "width", GST_TYPE_INT_RANGE, attribs->min_width,
+      attribs->max_width, "height", GST_TYPE_INT_RANGE, attribs->min_height,
+      attribs->max_height, NULL);
 
   return TRUE;
 }
 
+/* The size limits come from the capability cache when possible, since
+ * reading them requires a throwaway context */
 static gboolean
 append_caps_with_context_info (GstVaapiDisplay * display,
     GstVaapiContextInfo * cip, GstStructure * structure)
 {
+  GstVaapiCapsCache *const cache = GST_VAAPI_DISPLAY_CAPS_CACHE (display);
+  GstVaapiConfigSurfaceAttributes attribs = { 0, };
   GstVaapiContext *context;
+  gchar key[32];
+  gint *values, limits[4];
+  gsize n;
   gboolean ret;
 
+  g_snprintf (key, sizeof (key), "%d:%d",
+      gst_vaapi_profile_get_va_profile (cip->profile),
+      gst_vaapi_entrypoint_get_va_entrypoint (cip->entrypoint));
+  if (gst_vaapi_caps_cache_lookup (cache, "surface-limits", key, &values, &n)) {
+    ret = n == G_N_ELEMENTS (limits);
+    if (ret) {
+      attribs.min_width = values[0];
+      attribs.min_height = values[1];
+      attribs.max_width = values[2];
+      attribs.max_height = values[3];
+    }
+    g_free (values);
+    return ret && append_caps (&attribs, structure);
+  }
+
+  /* Failures are not cached, they may be transient */
   context = create_context (display, cip);
   if (!context)
     return FALSE;
 
-  ret = append_caps (context, structure);
+  ret = gst_vaapi_context_get_surface_attributes (context, &attribs);
   gst_vaapi_context_unref (context);
-  return ret;
+  if (!ret)
+    return FALSE;
+
+  limits[0] = attribs.min_width;
+  limits[1] = attribs.min_height;
+  limits[2] = attribs.max_width;
+  limits[3] = attribs.max_height;
+  gst_vaapi_caps_cache_store (cache, "surface-limits", key, limits,
+      G_N_ELEMENTS (limits));
+
+  return append_caps (&attribs, structure);
 }
 
 /**
@@ -0,0 +1,233 @@
+/*
+ *  gstvaapiqpmapmeta.c - Per-block delta QP map meta for encoders
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiqpmapmeta
+ * @short_description: Per-block delta QP map for encoders
+ *
+ * Upstream content analysis can attach a dense map of quantizer
+ * offsets to a raw frame. The VA-API encoders turn it into a QP
+ * buffer when the driver supports per-block QP and the rate control
+ * is CQP, or else into a list of regions-of-interest.
+ *
+ * The map is a #GstCustomMeta, so that any element can produce it
+ * without linking to this library. Its name, and the name of its
+ * #GstStructure, is "GstVaapiQPMapMeta", and the structure holds:
+ *
+ * - "width" (#G_TYPE_UINT): the number of columns of the map
+ * - "height" (#G_TYPE_UINT): the number of rows of the map
+ * - "delta-qp" (#G_TYPE_BYTES): width x height signed 8-bit delta
+ *   QP values, in raster order. Negative values increase the quality
+ *   of a block.
+ *
+ * The map covers the whole picture, each entry applying to a block
+ * of (frame width / width) x (frame height / height) pixels, so that
+ * a map computed per macroblock (16x16) or per coding tree unit also
+ * fits other encoder block sizes.
+ *
+ * The meta is registered when the vaapi plugin is loaded. Producers
+ * can also register it with gst_meta_register_custom() if
+ * gst_meta_get_info() doesn't know it yet.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiqpmapmeta.h"
+#include <gst/video/video.h>
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+static gboolean
+copy_field (GQuark field_id, const GValue * value, gpointer user_data)
+{
+  gst_structure_id_set_value (user_data, field_id, value);
+  return TRUE;
+}
+
+/* The map is relative to the frame size, so it is kept as-is when the
+ * frame is copied or scaled, but dropped on any other transform */
+static gboolean
+gst_vaapi_qp_map_meta_transform (GstBuffer * dst_buffer,
+    GstCustomMeta * meta, GstBuffer * src_buffer, GQuark type,
+    gpointer data, gpointer user_data)
+{
+  GstCustomMeta *dst_meta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type) &&
+      !GST_VIDEO_META_TRANSFORM_IS_SCALE (type))
+    return FALSE;
+
+  dst_meta = gst_buffer_add_custom_meta (dst_buffer,
+      GST_VAAPI_QP_MAP_META_NAME);
+  if (!dst_meta)
+    return FALSE;
+
+  gst_structure_foreach (gst_custom_meta_get_structure (meta),
+      copy_field, gst_custom_meta_get_structure (dst_meta));
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_qp_map_meta_register:
+ *
+ * Registers the "GstVaapiQPMapMeta" #GstCustomMeta, unless it is
+ * already registered.
+ */
+void
+gst_vaapi_qp_map_meta_register (void)
+{
+  static gsize registered = 0;
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR, NULL };
+
+  if (g_once_init_enter (&registered)) {
+    if (!gst_meta_get_info (GST_VAAPI_QP_MAP_META_NAME)) {
+      gst_meta_register_custom (GST_VAAPI_QP_MAP_META_NAME, tags,
+          gst_vaapi_qp_map_meta_transform, NULL, NULL);
+    }
+    g_once_init_leave (&registered, 1);
+  }
+}
+
+/**
+ * gst_buffer_add_vaapi_qp_map_meta:
+ * @buffer: a #GstBuffer
+ * @width: number of columns of the map
+ * @height: number of rows of the map
+ * @delta_qp: (array): @width x @height delta QP values, in raster order
+ *
+ * Attaches a delta QP map to @buffer. The values are copied.
+ *
+ * Returns: (transfer none): the #GstCustomMeta on @buffer, or %NULL
+ *   on error
+ */
+GstCustomMeta *
+gst_buffer_add_vaapi_qp_map_meta (GstBuffer * buffer, guint width,
+    guint height, const gint8 * delta_qp)
+{
+  GstCustomMeta *meta;
+  GBytes *bytes;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (delta_qp != NULL, NULL);
+
+  gst_vaapi_qp_map_meta_register ();
+
+  meta = gst_buffer_add_custom_meta (buffer, GST_VAAPI_QP_MAP_META_NAME);
+  if (!meta)
+    return NULL;
+
+  bytes = g_bytes_new (delta_qp, width * height);
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "width", G_TYPE_UINT, width, "height", G_TYPE_UINT, height,
+      "delta-qp", G_TYPE_BYTES, bytes, NULL);
+  g_bytes_unref (bytes);
+  return meta;
+}
+
+/**
+ * gst_buffer_get_vaapi_qp_map:
+ * @buffer: a #GstBuffer
+ * @map: (out): the #GstVaapiQPMap to fill in
+ *
+ * Looks up the delta QP map attached to @buffer. The values of @map
+ * are valid as long as the meta is attached to @buffer.
+ *
+ * Returns: %TRUE if @buffer holds a valid map
+ */
+gboolean
+gst_buffer_get_vaapi_qp_map (GstBuffer * buffer, GstVaapiQPMap * map)
+{
+  const GstStructure *structure;
+  GstCustomMeta *meta;
+  GBytes *bytes = NULL;
+  gsize size = 0;
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (map != NULL, FALSE);
+
+  meta = gst_buffer_get_custom_meta (buffer, GST_VAAPI_QP_MAP_META_NAME);
+  if (!meta)
+    return FALSE;
+
+  structure = gst_custom_meta_get_structure (meta);
+  ret = gst_structure_get (structure,
+      "width", G_TYPE_UINT, &map->width, "height", G_TYPE_UINT, &map->height,
+      "delta-qp", G_TYPE_BYTES, &bytes, NULL);
+  if (!ret)
+    goto error_invalid_map;
+
+  /* the structure still holds a reference */
+  map->delta_qp = g_bytes_get_data (bytes, &size);
+  g_bytes_unref (bytes);
+  if (map->width == 0 || map->height == 0 || !map->delta_qp ||
+      size != (gsize) map->width * map->height)
+    goto error_invalid_map;
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_map:
+  {
+    GST_WARNING ("invalid QP map %" GST_PTR_FORMAT, structure);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_qp_map_get_block_delta_qp:
+ * @map: a #GstVaapiQPMap
+ * @frame_width: width of the frame the map applies to
+ * @frame_height: height of the frame the map applies to
+ * @x: horizontal position of the block, in pixels
+ * @y: vertical position of the block, in pixels
+ * @w: width of the block, in pixels
+ * @h: height of the block, in pixels
+ *
+ * Resamples the map on an encoder block, averaging every map entry
+ * overlapping it.
+ *
+ * Returns: the delta QP of the block
+ */
+gint
+gst_vaapi_qp_map_get_block_delta_qp (const GstVaapiQPMap * map,
+    guint frame_width, guint frame_height, guint x, guint y, guint w, guint h)
+{
+  guint x0, x1, y0, y1, i, j;
+  gint sum = 0, count;
+
+  g_return_val_if_fail (map != NULL, 0);
+  g_return_val_if_fail (frame_width > 0 && frame_height > 0, 0);
+
+  x0 = MIN ((guint64) x * map->width / frame_width, map->width - 1);
+  y0 = MIN ((guint64) y * map->height / frame_height, map->height - 1);
+  x1 = ((guint64) (x + w) * map->width + frame_width - 1) / frame_width;
+  y1 = ((guint64) (y + h) * map->height + frame_height - 1) / frame_height;
+  x1 = CLAMP (x1, x0 + 1, map->width);
+  y1 = CLAMP (y1, y0 + 1, map->height);
+
+  for (j = y0; j < y1; j++) {
+    for (i = x0; i < x1; i++)
+      sum += map->delta_qp[j * map->width + i];
+  }
+  count = (x1 - x0) * (y1 - y0);
+
+  /* round to nearest */
+  return sum >= 0 ? (sum + count / 2) / count : -((-sum + count / 2) / count);
+}
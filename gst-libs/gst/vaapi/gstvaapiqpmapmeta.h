@@ -0,0 +1,69 @@
+/*
+ *  gstvaapiqpmapmeta.h - Per-block delta QP map meta for encoders
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_QP_MAP_META_H
+#define GST_VAAPI_QP_MAP_META_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_QP_MAP_META_NAME:
+ *
+ * The name of the #GstCustomMeta carrying a delta QP map, and of its
+ * #GstStructure.
+ */
+#define GST_VAAPI_QP_MAP_META_NAME "GstVaapiQPMapMeta"
+
+typedef struct _GstVaapiQPMap GstVaapiQPMap;
+
+/**
+ * GstVaapiQPMap:
+ * @width: number of columns of the map
+ * @height: number of rows of the map
+ * @delta_qp: @width x @height delta QP values, in raster order
+ *
+ * A delta QP map read from a #GstCustomMeta named
+ * %GST_VAAPI_QP_MAP_META_NAME. The values are owned by the meta.
+ */
+struct _GstVaapiQPMap
+{
+  guint width;
+  guint height;
+  const gint8 *delta_qp;
+};
+
+void
+gst_vaapi_qp_map_meta_register (void);
+
+GstCustomMeta *
+gst_buffer_add_vaapi_qp_map_meta (GstBuffer * buffer, guint width,
+    guint height, const gint8 * delta_qp);
+
+gboolean
+gst_buffer_get_vaapi_qp_map (GstBuffer * buffer, GstVaapiQPMap * map);
+
+gint
+gst_vaapi_qp_map_get_block_delta_qp (const GstVaapiQPMap * map,
+    guint frame_width, guint frame_height, guint x, guint y, guint w, guint h);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_QP_MAP_META_H */
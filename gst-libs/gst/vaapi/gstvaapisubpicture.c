@@ -32,6 +32,7 @@
 #include "gstvaapiutils.h"
 #include "gstvaapisubpicture.h"
 #include "gstvaapiimage_priv.h"
+#include "gstvaapidisplay_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -65,10 +66,10 @@ gst_vaapi_subpicture_free_image (GstVaapiSubpicture * subpicture)
       GST_VAAPI_ID_ARGS (subpicture_id));
 
   if (subpicture_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroySubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
         subpicture_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroySubpicture()"))
       GST_WARNING ("failed to destroy subpicture %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (subpicture_id));
@@ -97,10 +98,10 @@ gst_vaapi_subpicture_bind_image (GstVaapiSubpicture * subpicture,
   VASubpictureID subpicture_id;
   VAStatus status;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_IMAGE_ID (image), &subpicture_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSubpicture()"))
     return FALSE;
 
@@ -364,10 +365,10 @@ gst_vaapi_subpicture_set_global_alpha (GstVaapiSubpicture * subpicture,
 
   display = subpicture->display;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaSetSubpictureGlobalAlpha (GST_VAAPI_DISPLAY_VADISPLAY (display),
       subpicture->object_id, global_alpha);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaSetSubpictureGlobalAlpha()"))
     return FALSE;
 
@@ -36,6 +36,9 @@
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapidisplay_priv.h"
+
+#include <unistd.h>
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -65,6 +68,18 @@ gst_vaapi_surface_destroy_subpictures (GstVaapiSurface * surface)
   }
 }
 
+#if VA_CHECK_VERSION(1,1,0)
+static void
+prime_export_free (GstVaapiSurfacePrimeExport * export)
+{
+  guint i;
+
+  for (i = 0; i < export->desc.num_objects; i++)
+    close (export->desc.objects[i].fd);
+  g_slice_free (GstVaapiSurfacePrimeExport, export);
+}
+#endif
+
 static void
 gst_vaapi_surface_free (GstVaapiSurface * surface)
 {
@@ -77,22 +92,57 @@ gst_vaapi_surface_free (GstVaapiSurface * surface)
 
   gst_vaapi_surface_destroy_subpictures (surface);
 
+#if VA_CHECK_VERSION(1,1,0)
+  g_slist_free_full (surface->prime_exports, (GDestroyNotify) prime_export_free);
+  surface->prime_exports = NULL;
+#endif
+
   if (surface_id != VA_INVALID_SURFACE) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
         &surface_id, 1);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroySurfaces()"))
       GST_WARNING ("failed to destroy surface %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (surface_id));
     GST_VAAPI_SURFACE_ID (surface) = VA_INVALID_SURFACE;
   }
+  if (surface->memory_size)
+    gst_vaapi_display_release_memory (display, surface->memory_size);
   gst_vaapi_buffer_proxy_replace (&surface->extbuf_proxy, NULL);
   gst_vaapi_display_replace (&GST_VAAPI_SURFACE_DISPLAY (surface), NULL);
 
   g_slice_free1 (sizeof (GstVaapiSurface), surface);
 }
 
+/* The driver may pad or tile the surface, so this is a lower bound */
+static guint64
+estimate_surface_size (GstVideoFormat format, guint width, guint height)
+{
+  GstVideoInfo vi;
+
+  if (format == GST_VIDEO_FORMAT_UNKNOWN || format == GST_VIDEO_FORMAT_ENCODED)
+    format = GST_VIDEO_FORMAT_NV12;
+  if (!gst_video_info_set_format (&vi, format, width, height))
+    return 0;
+  return GST_VIDEO_INFO_SIZE (&vi);
+}
+
+/* Accounts for the surface memory before it is allocated. It is
+   released along with the surface, even if its creation fails */
+static gboolean
+reserve_surface_memory (GstVaapiSurface * surface, GstVideoFormat format,
+    guint width, guint height)
+{
+  const guint64 size = estimate_surface_size (format, width, height);
+
+  if (!gst_vaapi_display_reserve_memory (GST_VAAPI_SURFACE_DISPLAY (surface),
+          size))
+    return FALSE;
+  surface->memory_size = size;
+  return TRUE;
+}
+
 static gboolean
 gst_vaapi_surface_init (GstVaapiSurface * surface,
     GstVaapiChromaType chroma_type, guint width, guint height)
@@ -106,10 +156,14 @@ gst_vaapi_surface_init (GstVaapiSurface * surface,
   if (!va_chroma_format)
     goto error_unsupported_chroma_type;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  if (!reserve_surface_memory (surface,
+          gst_vaapi_video_format_from_chroma (chroma_type), width, height))
+    return FALSE;
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       width, height, va_chroma_format, 1, &surface_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -216,11 +270,14 @@ gst_vaapi_surface_init_full (GstVaapiSurface * surface,
     attrib++;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  if (!reserve_surface_memory (surface, format, extbuf.width, extbuf.height))
+    return FALSE;
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, extbuf.width, extbuf.height, &surface_id, 1,
       attribs, attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -301,11 +358,11 @@ gst_vaapi_surface_init_from_buffer_proxy (GstVaapiSurface * surface,
       from_GstVaapiBufferMemoryType (GST_VAAPI_BUFFER_PROXY_TYPE (proxy));
   attrib++;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, width, height, &surface_id, 1, attribs,
       attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -342,6 +399,8 @@ gst_vaapi_surface_create (GstVaapiDisplay * display)
   GST_VAAPI_SURFACE_ID (surface) = VA_INVALID_ID;
   surface->extbuf_proxy = NULL;
   surface->subpictures = NULL;
+  surface->memory_size = 0;
+  surface->prime_exports = NULL;
 
   return surface;
 }
@@ -662,10 +721,10 @@ gst_vaapi_surface_derive_image (GstVaapiSurface * surface)
   va_image.image_id = VA_INVALID_ID;
   va_image.buf = VA_INVALID_ID;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaDeriveImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &va_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaDeriveImage()"))
     return NULL;
   if (va_image.image_id == VA_INVALID_ID || va_image.buf == VA_INVALID_ID)
@@ -712,10 +771,10 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaGetImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), 0, 0, width, height, image_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaGetImage()"))
     return FALSE;
 
@@ -757,11 +816,11 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), image_id, 0, 0, width, height, 0, 0,
       width, height);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaPutImage()"))
     return FALSE;
 
@@ -857,14 +916,14 @@ _gst_vaapi_surface_associate_subpicture (GstVaapiSurface * surface,
     dst_rect_default.height = GST_VAAPI_SURFACE_HEIGHT (surface);
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaAssociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SUBPICTURE_ID (subpicture), &surface_id, 1,
       src_rect->x, src_rect->y, src_rect->width, src_rect->height,
       dst_rect->x, dst_rect->y, dst_rect->width, dst_rect->height,
       from_GstVaapiSubpictureFlags (gst_vaapi_subpicture_get_flags
           (subpicture)));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaAssociateSubpicture()"))
     return FALSE;
 
@@ -922,10 +981,10 @@ _gst_vaapi_surface_deassociate_subpicture (GstVaapiSurface * surface,
   if (surface_id == VA_INVALID_SURFACE)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaDeassociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SUBPICTURE_ID (subpicture), &surface_id, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaDeassociateSubpicture()"))
     return FALSE;
 
@@ -953,10 +1012,10 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaSyncSurface (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaSyncSurface()"))
     return FALSE;
 
@@ -983,10 +1042,10 @@ gst_vaapi_surface_query_status (GstVaapiSurface * surface,
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaQuerySurfaceStatus (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &surface_status);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaQuerySurfaceStatus()"))
     return FALSE;
 
@@ -995,6 +1054,144 @@ gst_vaapi_surface_query_status (GstVaapiSurface * surface,
   return TRUE;
 }
 
+/* A subpicture created from an overlay rectangle, kept on the
+ * rectangle so that it is uploaded once for all the frames the
+ * rectangle is shown on. Changing the render rectangle or the global
+ * alpha of the rectangle bumps its seqnum, which invalidates it */
+typedef struct
+{
+  GstVaapiSubpicture *subpicture;
+  GstVaapiDisplay *display;     /* owned by the subpicture */
+  guint seqnum;
+} CachedSubpicture;
+
+G_LOCK_DEFINE_STATIC (subpicture_cache);
+
+static GQuark
+cached_subpicture_quark (void)
+{
+  static gsize g_quark;
+
+  if (g_once_init_enter (&g_quark)) {
+    gsize quark = (gsize) g_quark_from_static_string ("GstVaapiSubpicture");
+    g_once_init_leave (&g_quark, quark);
+  }
+  return g_quark;
+}
+
+/* A pooled buffer is recycled with its contents changed, while the
+ * rectangle keeps pointing to it */
+static gboolean
+can_cache_subpicture (GstVideoOverlayRectangle * rect)
+{
+  GstBuffer *const pixels = gst_video_overlay_rectangle_get_pixels_unscaled_raw
+      (rect, gst_video_overlay_rectangle_get_flags (rect));
+
+  return pixels && !pixels->pool;
+}
+
+static void
+cached_subpicture_free (CachedSubpicture * cached)
+{
+  gst_vaapi_subpicture_unref (cached->subpicture);
+  g_slice_free (CachedSubpicture, cached);
+}
+
+/* upload statistics, for all the displays */
+G_LOCK_DEFINE_STATIC (subpicture_stats);
+static GstClockTime subpicture_stats_time = GST_CLOCK_TIME_NONE;
+static guint64 subpicture_uploaded_bytes;
+static guint subpicture_cache_hits;
+
+static void
+update_subpicture_stats (GstVaapiSubpicture * subpicture)
+{
+  GstClockTime now = g_get_monotonic_time () * GST_USECOND;
+
+  G_LOCK (subpicture_stats);
+  if (subpicture) {
+    subpicture_uploaded_bytes += gst_vaapi_image_get_data_size
+        (gst_vaapi_subpicture_get_image (subpicture));
+  } else {
+    subpicture_cache_hits++;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (subpicture_stats_time))
+    subpicture_stats_time = now;
+  else if (now - subpicture_stats_time >= GST_SECOND) {
+    GST_DEBUG ("subpictures: %" G_GUINT64_FORMAT " bytes/s uploaded, "
+        "%u reused", gst_util_uint64_scale (subpicture_uploaded_bytes,
+            GST_SECOND, now - subpicture_stats_time), subpicture_cache_hits);
+    subpicture_stats_time = now;
+    subpicture_uploaded_bytes = 0;
+    subpicture_cache_hits = 0;
+  }
+  G_UNLOCK (subpicture_stats);
+}
+
+static GstVaapiSubpicture *
+get_subpicture_from_overlay_rectangle (GstVaapiDisplay * display,
+    GstVideoOverlayRectangle * rect)
+{
+  const guint seqnum = gst_video_overlay_rectangle_get_seqnum (rect);
+  GstVaapiSubpicture *subpicture = NULL;
+  CachedSubpicture *cached;
+  gboolean cacheable;
+
+  cacheable = can_cache_subpicture (rect);
+  if (cacheable) {
+    G_LOCK (subpicture_cache);
+    cached = gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (rect),
+        cached_subpicture_quark ());
+    if (cached && cached->display == display && cached->seqnum == seqnum)
+      subpicture = (GstVaapiSubpicture *)
+          gst_mini_object_ref (GST_MINI_OBJECT_CAST (cached->subpicture));
+    G_UNLOCK (subpicture_cache);
+  }
+  if (subpicture) {
+    update_subpicture_stats (NULL);
+    return subpicture;
+  }
+
+  subpicture = gst_vaapi_subpicture_new_from_overlay_rectangle (display, rect);
+  if (!subpicture)
+    return NULL;
+  update_subpicture_stats (subpicture);
+
+  if (!cacheable)
+    return subpicture;
+
+  cached = g_slice_new (CachedSubpicture);
+  cached->subpicture = (GstVaapiSubpicture *)
+      gst_mini_object_ref (GST_MINI_OBJECT_CAST (subpicture));
+  cached->display = display;
+  cached->seqnum = seqnum;
+
+  G_LOCK (subpicture_cache);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (rect),
+      cached_subpicture_quark (), cached,
+      (GDestroyNotify) cached_subpicture_free);
+  G_UNLOCK (subpicture_cache);
+
+  return subpicture;
+}
+
+static gboolean
+surface_has_subpicture (GstVaapiSurface * surface,
+    GstVaapiSubpicture * subpicture)
+{
+  guint i;
+
+  if (!surface->subpictures)
+    return FALSE;
+
+  for (i = 0; i < surface->subpictures->len; i++) {
+    if (g_ptr_array_index (surface->subpictures, i) == subpicture)
+      return TRUE;
+  }
+  return FALSE;
+}
+
 /**
  * gst_vaapi_surface_set_subpictures_from_composition:
  * @surface: a #GstVaapiSurface
@@ -1004,6 +1201,11 @@ gst_vaapi_surface_query_status (GstVaapiSurface * surface,
  * a NULL composition will clear all the current subpictures. Note that this
  * method will clear existing subpictures.
  *
+ * The subpicture made from a rectangle is kept along with it, so
+ * rectangles that don't change from one frame to the next are only
+ * uploaded once, and just associated with each new @surface. This
+ * does not apply to rectangles with pixels from a buffer pool.
+ *
  * Return value: %TRUE on success
  */
 gboolean
@@ -1034,8 +1236,13 @@ gst_vaapi_surface_set_subpictures_from_composition (GstVaapiSurface * surface,
     GstVaapiSubpicture *subpicture;
 
     rect = gst_video_overlay_composition_get_rectangle (composition, n);
-    subpicture = gst_vaapi_subpicture_new_from_overlay_rectangle (display,
-        rect);
+    subpicture = get_subpicture_from_overlay_rectangle (display, rect);
+    if (subpicture && surface_has_subpicture (surface, subpicture)) {
+      /* same rectangle shown twice: a subpicture is associated only once */
+      gst_vaapi_subpicture_unref (subpicture);
+      subpicture = gst_vaapi_subpicture_new_from_overlay_rectangle (display,
+          rect);
+    }
     if (subpicture == NULL) {
       GST_WARNING ("could not create subpicture for rectangle %p", rect);
       return FALSE;
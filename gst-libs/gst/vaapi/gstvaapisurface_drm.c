@@ -25,6 +25,8 @@
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapidisplay_priv.h"
+#include "gstvaapiutils.h"
 
 static GstVaapiBufferProxy *
 gst_vaapi_surface_get_drm_buf_handle (GstVaapiSurface * surface, guint type)
@@ -124,6 +126,100 @@ gst_vaapi_surface_peek_gem_buf_handle (GstVaapiSurface * surface)
   return buf_proxy;
 }
 
+#if VA_CHECK_VERSION(1,1,0)
+static GstVaapiSurfacePrimeExport *
+find_prime_export (GstVaapiSurface * surface, guint flags)
+{
+  GSList *l;
+
+  for (l = surface->prime_exports; l != NULL; l = l->next) {
+    GstVaapiSurfacePrimeExport *const export = l->data;
+    if (export->flags == flags)
+      return export;
+  }
+  return NULL;
+}
+
+/* Exports the surface, or returns its cached export for @flags. The
+   VA status of the export is stored into @out_status, if not NULL */
+const VADRMPRIMESurfaceDescriptor *
+gst_vaapi_surface_export_drm_prime (GstVaapiSurface * surface, guint flags,
+    VAStatus * out_status)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_SURFACE_DISPLAY (surface);
+  GstVaapiSurfacePrimeExport *export;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  export = find_prime_export (surface, flags);
+  if (export)
+    goto done;
+
+  export = g_slice_new0 (GstVaapiSurfacePrimeExport);
+  export->flags = flags;
+  status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+      flags, &export->desc);
+  /* Try again with composed layers, in case the format is supported there */
+  if (status == VA_STATUS_ERROR_INVALID_SURFACE &&
+      (flags & VA_EXPORT_SURFACE_SEPARATE_LAYERS)) {
+    status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+        (flags & ~VA_EXPORT_SURFACE_SEPARATE_LAYERS) |
+        VA_EXPORT_SURFACE_COMPOSED_LAYERS, &export->desc);
+  }
+  if (!vaapi_check_status (status, "vaExportSurfaceHandle()"))
+    goto error_export;
+
+  GST_DEBUG ("surface %" GST_VAAPI_ID_FORMAT ": %u objects, %u layers",
+      GST_VAAPI_ID_ARGS (GST_VAAPI_SURFACE_ID (surface)),
+      export->desc.num_objects, export->desc.num_layers);
+  surface->prime_exports = g_slist_prepend (surface->prime_exports, export);
+
+done:
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  if (out_status)
+    *out_status = status;
+  return &export->desc;
+
+  /* ERRORS */
+error_export:
+  {
+    GST_VAAPI_DISPLAY_UNLOCK (display);
+    g_slice_free (GstVaapiSurfacePrimeExport, export);
+    if (out_status)
+      *out_status = status;
+    return NULL;
+  }
+}
+
+/**
+ * gst_vaapi_surface_peek_drm_prime_descriptor:
+ * @surface: a #GstVaapiSurface
+ * @flags: the VA_EXPORT_SURFACE_* flags
+ *
+ * Exports @surface as DRM PRIME objects, with their layout and format
+ * modifiers. If @flags asks for separate layers but the driver cannot
+ * export the surface format that way, the layers are composed.
+ *
+ * The export is made once for each @flags value. The descriptor and
+ * its file descriptors are owned by @surface, and remain valid until
+ * it is destroyed, so the caller shall dup() any file descriptor it
+ * needs to keep.
+ *
+ * Return value: (transfer none): the DRM PRIME descriptor of
+ *   @surface, or %NULL if the export failed
+ */
+const VADRMPRIMESurfaceDescriptor *
+gst_vaapi_surface_peek_drm_prime_descriptor (GstVaapiSurface * surface,
+    guint flags)
+{
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  return gst_vaapi_surface_export_drm_prime (surface, flags, NULL);
+}
+#endif
+
 static void
 fill_video_info (GstVideoInfo * vip, GstVideoFormat format, guint width,
     guint height, gsize offset[GST_VIDEO_MAX_PLANES],
@@ -25,6 +25,9 @@
 
 #include <gst/vaapi/gstvaapisurface.h>
 #include <gst/vaapi/gstvaapibufferproxy.h>
+#if VA_CHECK_VERSION(1,1,0)
+#include <va/va_drmcommon.h>
+#endif
 
 G_BEGIN_DECLS
 
@@ -34,6 +37,12 @@ gst_vaapi_surface_peek_dma_buf_handle (GstVaapiSurface * surface);
 GstVaapiBufferProxy *
 gst_vaapi_surface_peek_gem_buf_handle (GstVaapiSurface * surface);
 
+#if VA_CHECK_VERSION(1,1,0)
+const VADRMPRIMESurfaceDescriptor *
+gst_vaapi_surface_peek_drm_prime_descriptor (GstVaapiSurface * surface,
+    guint flags);
+#endif
+
 GstVaapiSurface *
 gst_vaapi_surface_new_with_dma_buf_handle (GstVaapiDisplay * display, gint fd,
     GstVideoInfo * vi);
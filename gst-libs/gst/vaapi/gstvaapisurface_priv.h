@@ -25,8 +25,24 @@
 
 #include <gst/vaapi/gstvaapisurface.h>
 
+#if VA_CHECK_VERSION(1,1,0)
+#include <va/va_drmcommon.h>
+#endif
+
 G_BEGIN_DECLS
 
+#if VA_CHECK_VERSION(1,1,0)
+typedef struct _GstVaapiSurfacePrimeExport GstVaapiSurfacePrimeExport;
+
+/* A DRM PRIME export of the surface, with the VA_EXPORT_SURFACE_*
+   flags it was requested with. The surface owns the file descriptors */
+struct _GstVaapiSurfacePrimeExport
+{
+  guint flags;
+  VADRMPRIMESurfaceDescriptor desc;
+};
+#endif
+
 /**
  * GstVaapiSurface:
  *
@@ -45,6 +61,8 @@ struct _GstVaapiSurface
   guint height;
   GstVaapiChromaType chroma_type;
   GPtrArray *subpictures;
+  guint64 memory_size;
+  GSList *prime_exports;
 };
 
 /**
@@ -119,6 +137,13 @@ struct _GstVaapiSurface
 #define GST_VAAPI_SURFACE_HEIGHT(surface) \
   (GST_VAAPI_SURFACE (surface)->height)
 
+#if VA_CHECK_VERSION(1,1,0)
+G_GNUC_INTERNAL
+const VADRMPRIMESurfaceDescriptor *
+gst_vaapi_surface_export_drm_prime (GstVaapiSurface * surface, guint flags,
+    VAStatus * out_status);
+#endif
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_SURFACE_PRIV_H */
@@ -30,6 +30,7 @@
 #include "sysdeps.h"
 #include "gstvaapisurfacepool.h"
 #include "gstvaapivideopool_priv.h"
+#include "gstvaapidisplay_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -210,3 +211,71 @@ gst_vaapi_surface_pool_new_with_chroma_type (GstVaapiDisplay * display,
 
   return pool;
 }
+
+/* Surfaces of both pools are interchangeable */
+static gboolean
+surface_pool_match (gconstpointer a, gconstpointer b)
+{
+  const GstVaapiSurfacePool *const pool1 = a;
+  const GstVaapiSurfacePool *const pool2 = b;
+  const GstVideoInfo *const vip1 = &pool1->video_info;
+  const GstVideoInfo *const vip2 = &pool2->video_info;
+  guint i;
+
+  if (GST_VAAPI_VIDEO_POOL (pool1)->object_type !=
+      GST_VAAPI_VIDEO_POOL (pool2)->object_type)
+    return FALSE;
+  if (pool1->chroma_type != pool2->chroma_type
+      || pool1->alloc_flags != pool2->alloc_flags)
+    return FALSE;
+  if (GST_VIDEO_INFO_FORMAT (vip1) != GST_VIDEO_INFO_FORMAT (vip2)
+      || GST_VIDEO_INFO_WIDTH (vip1) != GST_VIDEO_INFO_WIDTH (vip2)
+      || GST_VIDEO_INFO_HEIGHT (vip1) != GST_VIDEO_INFO_HEIGHT (vip2))
+    return FALSE;
+
+  /* The layout only matters if it is imposed to the driver */
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip1); i++) {
+    if ((pool1->alloc_flags & GST_VAAPI_SURFACE_ALLOC_FLAG_FIXED_STRIDES)
+        && GST_VIDEO_INFO_PLANE_STRIDE (vip1, i) !=
+        GST_VIDEO_INFO_PLANE_STRIDE (vip2, i))
+      return FALSE;
+    if ((pool1->alloc_flags & GST_VAAPI_SURFACE_ALLOC_FLAG_FIXED_OFFSETS)
+        && GST_VIDEO_INFO_PLANE_OFFSET (vip1, i) !=
+        GST_VIDEO_INFO_PLANE_OFFSET (vip2, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_surface_pool_new_shared:
+ * @display: a #GstVaapiDisplay
+ * @vip: a #GstVideoInfo
+ * @surface_allocation_flags: (optional) allocation flags
+ *
+ * Returns a #GstVaapiVideoPool of #GstVaapiSurface with the specified
+ * format and dimensions in @vip, shared with the other users of
+ * @display that asked for the same allocation parameters. This way,
+ * e.g. a decoder and a postproc of the same size and format recycle
+ * their surfaces through a single free list.
+ *
+ * A shared pool shall not be given a capacity.
+ *
+ * Return value: a new reference to a possibly existing #GstVaapiVideoPool
+ */
+GstVaapiVideoPool *
+gst_vaapi_surface_pool_new_shared (GstVaapiDisplay * display,
+    const GstVideoInfo * vip, guint surface_allocation_flags)
+{
+  GstVaapiVideoPool *pool, *shared_pool;
+
+  pool = gst_vaapi_surface_pool_new_full (display, vip,
+      surface_allocation_flags);
+  if (!pool)
+    return NULL;
+
+  shared_pool = gst_vaapi_display_share_video_pool (display, pool,
+      surface_pool_match);
+  gst_vaapi_video_pool_unref (pool);
+  return shared_pool;
+}
@@ -49,6 +49,10 @@ gst_vaapi_surface_pool_new_with_chroma_type (GstVaapiDisplay * display,
     GstVaapiChromaType chroma_type, guint width, guint height,
     guint surface_allocation_flags);
 
+GstVaapiVideoPool *
+gst_vaapi_surface_pool_new_shared (GstVaapiDisplay * display,
+    const GstVideoInfo * vip, guint surface_allocation_flags);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_SURFACE_POOL_H */
@@ -172,6 +172,30 @@ typedef enum {
 #define GST_VAAPI_RATECONTROL_MASK(RC) \
     (1U << G_PASTE(GST_VAAPI_RATECONTROL_,RC))
 
+/**
+ * GstVaapiPictureType:
+ * @GST_VAAPI_PICTURE_TYPE_NONE: Undefined
+ * @GST_VAAPI_PICTURE_TYPE_I: Intra
+ * @GST_VAAPI_PICTURE_TYPE_P: Predicted
+ * @GST_VAAPI_PICTURE_TYPE_B: Bi-directional predicted
+ * @GST_VAAPI_PICTURE_TYPE_S: S(GMC)-VOP (MPEG-4)
+ * @GST_VAAPI_PICTURE_TYPE_SI: Switching Intra
+ * @GST_VAAPI_PICTURE_TYPE_SP: Switching Predicted
+ * @GST_VAAPI_PICTURE_TYPE_BI: BI type (VC-1)
+ *
+ * The coding type of a picture, for decoders and encoders.
+ */
+typedef enum {
+    GST_VAAPI_PICTURE_TYPE_NONE = 0,
+    GST_VAAPI_PICTURE_TYPE_I,
+    GST_VAAPI_PICTURE_TYPE_P,
+    GST_VAAPI_PICTURE_TYPE_B,
+    GST_VAAPI_PICTURE_TYPE_S,
+    GST_VAAPI_PICTURE_TYPE_SI,
+    GST_VAAPI_PICTURE_TYPE_SP,
+    GST_VAAPI_PICTURE_TYPE_BI,
+} GstVaapiPictureType;
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_TYPES_H */
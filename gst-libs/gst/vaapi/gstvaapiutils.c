@@ -98,7 +98,8 @@ gst_vaapi_log (
 #endif
 
 gboolean
-vaapi_initialize (VADisplay dpy)
+vaapi_initialize (VADisplay dpy, gint * major_version_ptr,
+    gint * minor_version_ptr)
 {
   gint major_version, minor_version;
   VAStatus status;
@@ -120,6 +121,10 @@ vaapi_initialize (VADisplay dpy)
     return FALSE;
 
   GST_INFO ("VA-API version %d.%d", major_version, minor_version);
+  if (major_version_ptr)
+    *major_version_ptr = major_version;
+  if (minor_version_ptr)
+    *minor_version_ptr = minor_version;
   return TRUE;
 }
 
@@ -29,10 +29,12 @@
 #include <gst/video/video.h>
 #include <va/va.h>
 
-/** calls vaInitialize() redirecting the logging mechanism */
+/** calls vaInitialize() redirecting the logging mechanism, and
+ * returns the version of the VA-API implementation */
 G_GNUC_INTERNAL
 gboolean
-vaapi_initialize (VADisplay dpy);
+vaapi_initialize (VADisplay dpy, gint *major_version_ptr,
+    gint *minor_version_ptr);
 
 /** Check VA status for success or print out an error */
 G_GNUC_INTERNAL
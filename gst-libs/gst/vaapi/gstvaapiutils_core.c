@@ -59,16 +59,28 @@ gst_vaapi_get_config_attribute (GstVaapiDisplay * display, VAProfile profile,
 {
   VAConfigAttrib attrib;
   VAStatus status;
+  gchar key[48];
+  gint *values;
+  gsize n;
 
   g_return_val_if_fail (display != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
   attrib.type = type;
-  status = vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      profile, entrypoint, &attrib, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
-  if (!vaapi_check_status (status, "vaGetConfigAttributes()"))
-    return FALSE;
+  g_snprintf (key, sizeof (key), "%d:%d:%d", profile, entrypoint, type);
+  if (gst_vaapi_caps_cache_lookup (GST_VAAPI_DISPLAY_CAPS_CACHE (display),
+          "config-attributes", key, &values, &n)) {
+    attrib.value = n > 0 ? values[0] : VA_ATTRIB_NOT_SUPPORTED;
+    g_free (values);
+  } else {
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
+    status = vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        profile, entrypoint, &attrib, 1);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+    if (!vaapi_check_status (status, "vaGetConfigAttributes()"))
+      return FALSE;
+    gst_vaapi_caps_cache_store (GST_VAAPI_DISPLAY_CAPS_CACHE (display),
+        "config-attributes", key, (gint *) & attrib.value, 1);
+  }
   if (attrib.value == VA_ATTRIB_NOT_SUPPORTED)
     return FALSE;
 
@@ -88,10 +100,10 @@ get_surface_attributes (GstVaapiDisplay * display, VAConfigID config,
   if (config == VA_INVALID_ID)
     goto error;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       config, NULL, &num_surface_attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaQuerySurfaceAttributes()"))
     goto error;
 
@@ -99,10 +111,10 @@ get_surface_attributes (GstVaapiDisplay * display, VAConfigID config,
   if (!surface_attribs)
     goto error;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       config, surface_attribs, &num_surface_attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaQuerySurfaceAttributes()"))
     goto error;
 
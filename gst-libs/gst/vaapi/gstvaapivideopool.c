@@ -30,6 +30,7 @@
 #include "sysdeps.h"
 #include "gstvaapivideopool.h"
 #include "gstvaapivideopool_priv.h"
+#include "gstvaapidisplay_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -58,19 +59,27 @@ gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
   pool->used_objects = NULL;
   pool->used_count = 0;
   pool->capacity = 0;
+  pool->reserved = 0;
+  pool->num_pending = 0;
+  pool->shared = FALSE;
 
   g_queue_init (&pool->free_objects);
   g_mutex_init (&pool->mutex);
+  g_cond_init (&pool->cond);
+
+  gst_vaapi_display_add_video_pool (display, pool);
 }
 
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool)
 {
+  gst_vaapi_display_remove_video_pool (pool->display, pool);
   g_list_free_full (pool->used_objects, (GDestroyNotify) gst_mini_object_unref);
   g_queue_foreach (&pool->free_objects, (GFunc) gst_mini_object_unref, NULL);
   g_queue_clear (&pool->free_objects);
   gst_vaapi_display_replace (&pool->display, NULL);
   g_mutex_clear (&pool->mutex);
+  g_cond_clear (&pool->cond);
 }
 
 /**
@@ -171,7 +180,15 @@ gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
   if (pool->capacity && pool->used_count >= pool->capacity)
     return NULL;
 
+  /* Wait for the objects being pre-allocated, rather than allocating
+     one more */
   object = g_queue_pop_head (&pool->free_objects);
+  while (!object && pool->num_pending > 0) {
+    g_cond_wait (&pool->cond, &pool->mutex);
+    if (pool->capacity && pool->used_count >= pool->capacity)
+      return NULL;
+    object = g_queue_pop_head (&pool->free_objects);
+  }
   if (!object) {
     g_mutex_unlock (&pool->mutex);
     object = gst_vaapi_video_pool_alloc_object (pool);
@@ -242,6 +259,42 @@ gst_vaapi_video_pool_put_object (GstVaapiVideoPool * pool, gpointer object)
   g_mutex_unlock (&pool->mutex);
 }
 
+/**
+ * gst_vaapi_video_pool_remove_object:
+ * @pool: a #GstVaapiVideoPool
+ * @object: the object to remove from the pool
+ *
+ * Releases the @object, obtained through
+ * gst_vaapi_video_pool_get_object(), without pushing it back into the
+ * pool. This is useful for objects that no longer match the pool
+ * parameters, so that a new one is allocated instead.
+ */
+void
+gst_vaapi_video_pool_remove_object (GstVaapiVideoPool * pool, gpointer object)
+{
+  GList *elem;
+  gboolean found;
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (object != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  elem = g_list_find (pool->used_objects, object);
+  found = elem != NULL;
+  if (found) {
+    --pool->used_count;
+    pool->used_objects = g_list_delete_link (pool->used_objects, elem);
+  }
+  g_mutex_unlock (&pool->mutex);
+
+  /* Drop the references held by the pool and handed out by
+     gst_vaapi_video_pool_get_object(), out of the pool lock */
+  if (found) {
+    gst_mini_object_unref (object);
+    gst_mini_object_unref (object);
+  }
+}
+
 /**
  * gst_vaapi_video_pool_add_object:
  * @pool: a #GstVaapiVideoPool
@@ -258,6 +311,7 @@ gst_vaapi_video_pool_add_object_unlocked (GstVaapiVideoPool * pool,
     gpointer object)
 {
   g_queue_push_tail (&pool->free_objects, gst_mini_object_ref (object));
+  pool->reserved++;
   return TRUE;
 }
 
@@ -337,22 +391,23 @@ gst_vaapi_video_pool_get_size (GstVaapiVideoPool * pool)
 static gboolean
 gst_vaapi_video_pool_reserve_unlocked (GstVaapiVideoPool * pool, guint n)
 {
-  guint i, num_allocated;
-
-  num_allocated = g_queue_get_length (&pool->free_objects) + pool->used_count;
-  if (n <= num_allocated)
-    return TRUE;
+  gpointer object;
 
-  n = MIN (n, pool->capacity);
-  for (i = num_allocated; i < n; i++) {
-    gpointer object;
+  pool->reserved = MAX (pool->reserved, n);
 
+  /* Objects being allocated by concurrent reservations count too */
+  while (g_queue_get_length (&pool->free_objects) + pool->used_count +
+      pool->num_pending < n) {
+    pool->num_pending++;
     g_mutex_unlock (&pool->mutex);
     object = gst_vaapi_video_pool_alloc_object (pool);
     g_mutex_lock (&pool->mutex);
+    pool->num_pending--;
+    if (object)
+      g_queue_push_tail (&pool->free_objects, object);
+    g_cond_broadcast (&pool->cond);
     if (!object)
       return FALSE;
-    g_queue_push_tail (&pool->free_objects, object);
   }
   return TRUE;
 }
@@ -377,11 +432,110 @@ gst_vaapi_video_pool_reserve (GstVaapiVideoPool * pool, guint n)
   g_return_val_if_fail (pool != NULL, 0);
 
   g_mutex_lock (&pool->mutex);
-  success = gst_vaapi_video_pool_reserve_unlocked (pool, n);
+  success = gst_vaapi_video_pool_reserve_unlocked (pool,
+      MIN (n, pool->capacity));
   g_mutex_unlock (&pool->mutex);
   return success;
 }
 
+typedef struct
+{
+  GstVaapiVideoPool *pool;
+  guint n;
+} ReserveJob;
+
+static void
+reserve_job_run (gpointer data, gpointer user_data)
+{
+  ReserveJob *const job = data;
+  GstVaapiVideoPool *const pool = job->pool;
+  gboolean success;
+
+  g_mutex_lock (&pool->mutex);
+  if (pool->capacity)
+    job->n = MIN (job->n, pool->capacity);
+  success = gst_vaapi_video_pool_reserve_unlocked (pool, job->n);
+  g_mutex_unlock (&pool->mutex);
+
+  if (!success)
+    GST_WARNING ("failed to pre-allocate %u objects", job->n);
+
+  gst_vaapi_video_pool_unref (job->pool);
+  g_slice_free (ReserveJob, job);
+}
+
+/* The allocations are serialized by the driver anyway */
+static GThreadPool *
+get_reserve_thread_pool (void)
+{
+  static gsize thread_pool = 0;
+
+  if (g_once_init_enter (&thread_pool)) {
+    GThreadPool *const new_thread_pool =
+        g_thread_pool_new (reserve_job_run, NULL, 2, FALSE, NULL);
+    g_once_init_leave (&thread_pool, (gsize) new_thread_pool);
+  }
+  return (GThreadPool *) thread_pool;
+}
+
+/**
+ * gst_vaapi_video_pool_reserve_async:
+ * @pool: a #GstVaapiVideoPool
+ * @n: the number of objects to pre-allocate
+ *
+ * Pre-allocates up to @n objects in the pool, like
+ * gst_vaapi_video_pool_reserve(), but in a background thread. In the
+ * meantime, gst_vaapi_video_pool_get_object() waits for an object
+ * being allocated, if there is no free one, rather than allocating
+ * one more itself.
+ *
+ * Unlike gst_vaapi_video_pool_reserve(), this also pre-allocates
+ * objects in pools without capacity. Such pools still grow beyond @n
+ * on demand: only the pre-allocation is bounded.
+ */
+void
+gst_vaapi_video_pool_reserve_async (GstVaapiVideoPool * pool, guint n)
+{
+  ReserveJob *job;
+
+  g_return_if_fail (pool != NULL);
+
+  job = g_slice_new (ReserveJob);
+  job->pool = gst_vaapi_video_pool_ref (pool);
+  job->n = n;
+  g_thread_pool_push (get_reserve_thread_pool (), job, NULL);
+}
+
+/**
+ * gst_vaapi_video_pool_trim:
+ * @pool: a #GstVaapiVideoPool
+ *
+ * Takes the free objects of the @pool beyond its reserved size,
+ * i.e. the objects pre-allocated through gst_vaapi_video_pool_reserve()
+ * or added through gst_vaapi_video_pool_add_object(). This is used to
+ * reclaim memory when the memory budget of the display is exceeded.
+ *
+ * Return value: (transfer full): the list of objects to unref
+ */
+GList *
+gst_vaapi_video_pool_trim (GstVaapiVideoPool * pool)
+{
+  GList *objects = NULL;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  g_mutex_lock (&pool->mutex);
+  while (g_queue_get_length (&pool->free_objects) + pool->used_count >
+      pool->reserved) {
+    gpointer const object = g_queue_pop_tail (&pool->free_objects);
+    if (!object)
+      break;
+    objects = g_list_prepend (objects, object);
+  }
+  g_mutex_unlock (&pool->mutex);
+  return objects;
+}
+
 /**
  * gst_vaapi_video_pool_get_capacity:
  * @pool: a #GstVaapiVideoPool
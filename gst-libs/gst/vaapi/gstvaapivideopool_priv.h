@@ -52,7 +52,11 @@ struct _GstVaapiVideoPool
   GList *used_objects;
   guint used_count;
   guint capacity;
+  guint reserved;
+  guint num_pending;
+  gboolean shared;
   GMutex mutex;
+  GCond cond;
 };
 
 /**
@@ -79,6 +83,15 @@ G_GNUC_INTERNAL
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool);
 
+G_GNUC_INTERNAL
+GList *
+gst_vaapi_video_pool_trim (GstVaapiVideoPool * pool);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_video_pool_remove_object (GstVaapiVideoPool * pool,
+    gpointer object);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_VIDEO_POOL_PRIV_H */
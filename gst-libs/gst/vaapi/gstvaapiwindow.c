@@ -76,6 +76,10 @@ ensure_filter (GstVaapiWindow * window)
     return TRUE;
 
   window->filter = gst_vaapi_filter_new (display);
+  if (!window->filter) {
+    GST_INFO ("no VPP, converting surfaces on the CPU");
+    window->filter = gst_vaapi_filter_new_software (display);
+  }
   if (!window->filter)
     goto error_create_filter;
   if (!gst_vaapi_filter_set_format (window->filter, GST_VIDEO_FORMAT_NV12))
@@ -174,7 +178,8 @@ gst_vaapi_window_set_property (GObject * object, guint property_id,
       g_assert (window->display == NULL);
       window->display = g_value_dup_object (value);
       g_assert (window->display != NULL);
-      window->has_vpp = GST_VAAPI_DISPLAY_HAS_VPP (window->display);
+      /* VPP, or else its software fallback */
+      window->has_vpp = TRUE;
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -37,8 +37,6 @@
 #include "gstvaapifilter.h"
 #include "gstvaapisurfacepool.h"
 
-#include <unistd.h>
-
 GST_DEBUG_CATEGORY_EXTERN (gst_debug_vaapi_window);
 GST_DEBUG_CATEGORY_EXTERN (gst_debug_vaapi);
 #define GST_CAT_DEFAULT gst_debug_vaapi_window
@@ -701,7 +699,7 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
       GST_VAAPI_DISPLAY_WAYLAND_GET_PRIVATE (display);
   struct zwp_linux_buffer_params_v1 *params;
   struct wl_buffer *buffer = NULL;
-  VADRMPRIMESurfaceDescriptor desc;
+  const VADRMPRIMESurfaceDescriptor *desc;
   VAStatus status;
   GstVaapiDmabufStatus ret;
   guint format, i, j, plane = 0;
@@ -712,30 +710,23 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
   if ((va_flags & (VA_TOP_FIELD | VA_BOTTOM_FIELD)) != VA_FRAME_PICTURE)
     return GST_VAAPI_DMABUF_BAD_FLAGS;
 
-  GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
-  status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
-      VA_EXPORT_SURFACE_SEPARATE_LAYERS | VA_EXPORT_SURFACE_READ_ONLY, &desc);
-  /* Try again with composed layers, in case the format is supported there */
-  if (status == VA_STATUS_ERROR_INVALID_SURFACE)
-    status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
-        VA_EXPORT_SURFACE_COMPOSED_LAYERS | VA_EXPORT_SURFACE_READ_ONLY, &desc);
-  GST_VAAPI_WINDOW_UNLOCK_DISPLAY (window);
-
-  if (!vaapi_check_status (status, "vaExportSurfaceHandle()")) {
+  /* The surfaces are displayed over and over again, so their export
+     is cached, and the file descriptors remain owned by the surface */
+  desc = gst_vaapi_surface_export_drm_prime (surface,
+      VA_EXPORT_SURFACE_SEPARATE_LAYERS | VA_EXPORT_SURFACE_READ_ONLY, &status);
+  if (!desc) {
     if (status == VA_STATUS_ERROR_UNIMPLEMENTED)
       return GST_VAAPI_DMABUF_NOT_SUPPORTED;
     else
       return GST_VAAPI_DMABUF_BAD_FORMAT;
   }
 
-  format = gst_vaapi_drm_format_from_va_fourcc (desc.fourcc);
+  format = gst_vaapi_drm_format_from_va_fourcc (desc->fourcc);
   params = zwp_linux_dmabuf_v1_create_params (priv_display->dmabuf);
-  for (i = 0; i < desc.num_layers; i++) {
-    for (j = 0; j < desc.layers[i].num_planes; ++j) {
-      gint object = desc.layers[i].object_index[j];
-      guint64 modifier = desc.objects[object].drm_format_modifier;
+  for (i = 0; i < desc->num_layers; i++) {
+    for (j = 0; j < desc->layers[i].num_planes; ++j) {
+      gint object = desc->layers[i].object_index[j];
+      guint64 modifier = desc->objects[object].drm_format_modifier;
 
       ret = dmabuf_format_supported (priv_display, format, modifier);
       if (ret != GST_VAAPI_DMABUF_SUCCESS) {
@@ -746,8 +737,8 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
       }
 
       zwp_linux_buffer_params_v1_add (params,
-          desc.objects[object].fd, plane, desc.layers[i].offset[j],
-          desc.layers[i].pitch[j], modifier >> 32,
+          desc->objects[object].fd, plane, desc->layers[i].offset[j],
+          desc->layers[i].pitch[j], modifier >> 32,
           modifier & G_GUINT64_CONSTANT (0xffffffff));
       plane++;
     }
@@ -762,9 +753,6 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
 out:
   zwp_linux_buffer_params_v1_destroy (params);
 
-  for (i = 0; i < desc.num_objects; i++)
-    close (desc.objects[i].fd);
-
   *out_buffer = buffer;
   return ret;
 }
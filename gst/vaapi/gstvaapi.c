@@ -25,9 +25,12 @@
 #include "gstcompat.h"
 #include "gstvaapidecode.h"
 #include "gstvaapioverlay.h"
+#include "gstvaapimosaic.h"
 #include "gstvaapipostproc.h"
+#include "gstvaapiscaleladder.h"
 #include "gstvaapisink.h"
 #include "gstvaapidecodebin.h"
+#include <gst/vaapi/gstvaapihdrscenemeta.h>
 
 #if USE_ENCODERS
 #include "gstvaapiencode_h264.h"
@@ -35,6 +38,7 @@
 #include "gstvaapiencode_jpeg.h"
 #include "gstvaapiencode_vp8.h"
 #include "gstvaapiencode_h265.h"
+#include <gst/vaapi/gstvaapiqpmapmeta.h>
 
 #if USE_VP9_ENCODER
 #include "gstvaapiencode_vp9.h"
@@ -188,6 +192,13 @@ plugin_init (GstPlugin * plugin)
 
   plugin_add_dependencies (plugin);
 
+#if USE_ENCODERS
+  /* upstream elements attach the QP map by name, so it has to be known
+   * as soon as the plugin is loaded */
+  gst_vaapi_qp_map_meta_register ();
+#endif
+  gst_vaapi_hdr_scene_meta_register ();
+
   display = gst_vaapi_create_test_display ();
   if (!display)
     goto error_no_display;
@@ -203,8 +214,14 @@ plugin_init (GstPlugin * plugin)
     g_array_unref (decoders);
   }
 
-  if (_gst_vaapi_has_video_processing)
-    gst_vaapioverlay_register (plugin, display);
+  if (_gst_vaapi_has_video_processing) {
+    if (gst_vaapioverlay_register (plugin, display)) {
+      gst_element_register (plugin, "vaapimosaic",
+          GST_RANK_NONE, GST_TYPE_VAAPI_MOSAIC);
+    }
+    gst_element_register (plugin, "vaapiscaleladder",
+        GST_RANK_NONE, GST_TYPE_VAAPI_SCALE_LADDER);
+  }
 
   gst_element_register (plugin, "vaapipostproc",
       GST_RANK_PRIMARY, GST_TYPE_VAAPIPOSTPROC);
@@ -60,6 +60,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapidecode);
 #define GST_VAAPI_DECODE_PARAMS_QDATA \
   g_quark_from_static_string("vaapidec-params")
 
+/* Common to all the decoders, after the codec specific properties */
+enum
+{
+  PROP_MAX_WIDTH = 0x100,
+  PROP_MAX_HEIGHT,
+};
+
 /* Default templates */
 #define GST_CAPS_CODEC(CODEC) CODEC "; "
 
@@ -875,8 +882,19 @@ gst_vaapidecode_decide_allocation (GstVideoDecoder * vdec, GstQuery * query)
       GST_VAAPI_CAPS_FEATURE_GL_TEXTURE_UPLOAD_META);
 #endif
 
-  return gst_vaapi_plugin_base_decide_allocation (GST_VAAPI_PLUGIN_BASE (vdec),
-      query);
+  if (!gst_vaapi_plugin_base_decide_allocation (GST_VAAPI_PLUGIN_BASE (vdec),
+          query))
+    return FALSE;
+
+  /* Pre-allocate the surfaces downstream holds on to */
+  if (decode->decoder && gst_query_get_n_allocation_pools (query) > 0) {
+    guint min_buffers;
+
+    gst_query_parse_nth_allocation_pool (query, 0, NULL, NULL, &min_buffers,
+        NULL);
+    gst_vaapi_decoder_set_num_extra_surfaces (decode->decoder, min_buffers);
+  }
+  return TRUE;
 
   /* ERRORS */
 error_no_caps:
@@ -986,6 +1004,11 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
   if (!decode->decoder)
     return FALSE;
 
+  if (decode->max_width || decode->max_height) {
+    gst_vaapi_decoder_set_max_resolution (decode->decoder, decode->max_width,
+        decode->max_height);
+  }
+
   gst_vaapi_decoder_set_codec_state_changed_func (decode->decoder,
       gst_vaapi_decoder_state_changed, decode);
 
@@ -1058,6 +1081,62 @@ gst_vaapidecode_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* Handles the properties of all the decoders, for the codec specific
+ * property handlers to chain up */
+gboolean
+gst_vaapidecode_set_common_property (GObject * object, guint prop_id,
+    const GValue * value)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case PROP_MAX_WIDTH:
+      decode->max_width = g_value_get_uint (value);
+      return TRUE;
+    case PROP_MAX_HEIGHT:
+      decode->max_height = g_value_get_uint (value);
+      return TRUE;
+    default:
+      return gst_vaapi_plugin_base_set_property (GST_VAAPI_PLUGIN_BASE
+          (object), prop_id, value);
+  }
+}
+
+gboolean
+gst_vaapidecode_get_common_property (GObject * object, guint prop_id,
+    GValue * value)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case PROP_MAX_WIDTH:
+      g_value_set_uint (value, decode->max_width);
+      return TRUE;
+    case PROP_MAX_HEIGHT:
+      g_value_set_uint (value, decode->max_height);
+      return TRUE;
+    default:
+      return gst_vaapi_plugin_base_get_property (GST_VAAPI_PLUGIN_BASE
+          (object), prop_id, value);
+  }
+}
+
+static void
+gst_vaapidecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  if (!gst_vaapidecode_set_common_property (object, prop_id, value))
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
+static void
+gst_vaapidecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  if (!gst_vaapidecode_get_common_property (object, prop_id, value))
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
 static gboolean
 gst_vaapidecode_open (GstVideoDecoder * vdec)
 {
@@ -1501,6 +1580,8 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
 
   object_class->finalize = gst_vaapidecode_finalize;
+  object_class->set_property = gst_vaapidecode_set_property;
+  object_class->get_property = gst_vaapidecode_get_property;
 
   vdec_class->open = GST_DEBUG_FUNCPTR (gst_vaapidecode_open);
   vdec_class->close = GST_DEBUG_FUNCPTR (gst_vaapidecode_close);
@@ -1544,6 +1625,36 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   g_free (longname);
   g_free (description);
 
+  gst_vaapi_plugin_base_class_install_device_policy (object_class);
+
+  /**
+   * GstVaapiDecode:max-width:
+   *
+   * The largest picture width expected in the stream, e.g. the one of
+   * the highest variant of an adaptive stream. The surfaces are
+   * allocated for it once, and kept across the resolution changes
+   * that fit in them. 0 allocates the surfaces for the current size.
+   */
+  g_object_class_install_property (object_class, PROP_MAX_WIDTH,
+      g_param_spec_uint ("max-width", "Maximum width",
+          "Largest expected picture width, to allocate the surfaces for "
+          "(0: current width)", 0, G_MAXINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstVaapiDecode:max-height:
+   *
+   * The largest picture height expected in the stream. See
+   * #GstVaapiDecode:max-width.
+   */
+  g_object_class_install_property (object_class, PROP_MAX_HEIGHT,
+      g_param_spec_uint ("max-height", "Maximum height",
+          "Largest expected picture height, to allocate the surfaces for "
+          "(0: current height)", 0, G_MAXINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   if (map->install_properties)
     map->install_properties (object_class);
 
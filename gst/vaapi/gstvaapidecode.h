@@ -54,6 +54,9 @@ struct _GstVaapiDecode {
     GstVideoCodecState *input_state;
 
     gboolean            do_renego;
+
+    guint               max_width;
+    guint               max_height;
 };
 
 struct _GstVaapiDecodeClass {
@@ -63,6 +66,12 @@ struct _GstVaapiDecodeClass {
 
 gboolean gst_vaapidecode_register (GstPlugin * plugin, GArray * decoders);
 
+gboolean gst_vaapidecode_set_common_property (GObject * object,
+    guint prop_id, const GValue * value);
+
+gboolean gst_vaapidecode_get_common_property (GObject * object,
+    guint prop_id, GValue * value);
+
 G_END_DECLS
 
 #endif /* GST_VAAPIDECODE_H */
@@ -50,7 +50,8 @@ gst_vaapi_decode_h264_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_vaapidecode_get_common_property (object, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
@@ -78,7 +79,8 @@ gst_vaapi_decode_h264_set_property (GObject * object, guint prop_id,
         gst_vaapi_decoder_h264_set_base_only (decoder, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_vaapidecode_set_common_property (object, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
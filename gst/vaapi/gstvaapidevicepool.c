@@ -0,0 +1,392 @@
+/*
+ *  gstvaapidevicepool.c - Load balancing across DRM render nodes
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* The device pool knows the DRM render nodes of the system, and how
+ * loaded each of them is: the number of elements that opened a
+ * display on it, and the surface memory of their most recent buffer
+ * pools. Elements with a device policy other than "shared" ask the
+ * pool for a device instead of opening the default one. The pool
+ * does not open the devices itself, so that it can be driven with
+ * any list of device names. */
+
+#include "gstcompat.h"
+#include "gstvaapidevicepool.h"
+
+#define GST_CAT_DEFAULT gst_vaapi_device_pool_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define DRI_DIR "/dev/dri"
+#define RENDER_NODE_PREFIX "renderD"
+
+typedef struct
+{
+  gchar *path;
+  guint num_contexts;
+  guint64 memory;
+} GstVaapiDevice;
+
+struct _GstVaapiDevicePool
+{
+  GMutex lock;
+  GArray *devices;
+  guint next_device;
+};
+
+GType
+gst_vaapi_device_policy_get_type (void)
+{
+  static GType device_policy_type = 0;
+
+  static const GEnumValue policy_types[] = {
+    {GST_VAAPI_DEVICE_POLICY_SHARED,
+        "Share the pipeline display", "shared"},
+    {GST_VAAPI_DEVICE_POLICY_LEAST_LOADED,
+        "Least loaded render node", "least-loaded"},
+    {GST_VAAPI_DEVICE_POLICY_ROUND_ROBIN,
+        "Render nodes in turn", "round-robin"},
+    {0, NULL, NULL},
+  };
+
+  if (!device_policy_type) {
+    device_policy_type =
+        g_enum_register_static ("GstVaapiDevicePolicy", policy_types);
+  }
+  return device_policy_type;
+}
+
+static void
+device_clear (GstVaapiDevice * device)
+{
+  g_free (device->path);
+}
+
+static gint
+compare_render_nodes (gconstpointer a, gconstpointer b)
+{
+  const gchar *const name1 = *(const gchar **) a;
+  const gchar *const name2 = *(const gchar **) b;
+
+  return atoi (name1 + strlen (RENDER_NODE_PREFIX)) -
+      atoi (name2 + strlen (RENDER_NODE_PREFIX));
+}
+
+/* Lists the render nodes, in minor number order */
+static gchar **
+enumerate_render_nodes (void)
+{
+  GPtrArray *names;
+  const gchar *name;
+  GDir *dir;
+  guint i;
+
+  names = g_ptr_array_new ();
+
+  dir = g_dir_open (DRI_DIR, 0, NULL);
+  if (dir) {
+    while ((name = g_dir_read_name (dir))) {
+      if (g_str_has_prefix (name, RENDER_NODE_PREFIX))
+        g_ptr_array_add (names, (gpointer) g_strdup (name));
+    }
+    g_dir_close (dir);
+  }
+  g_ptr_array_sort (names, compare_render_nodes);
+
+  for (i = 0; i < names->len; i++) {
+    name = g_ptr_array_index (names, i);
+    g_ptr_array_index (names, i) = g_build_filename (DRI_DIR, name, NULL);
+    g_free ((gpointer) name);
+  }
+  g_ptr_array_add (names, NULL);
+  return (gchar **) g_ptr_array_free (names, FALSE);
+}
+
+static GstVaapiDevice *
+find_device (GstVaapiDevicePool * pool, const gchar * path)
+{
+  GstVaapiDevice *device;
+  guint i;
+
+  for (i = 0; i < pool->devices->len; i++) {
+    device = &g_array_index (pool->devices, GstVaapiDevice, i);
+    if (g_strcmp0 (device->path, path) == 0)
+      return device;
+  }
+  return NULL;
+}
+
+/* Fewest active elements first, then the least surface memory. The
+   first device wins a tie, so that a single pipeline is packed on
+   the first render node */
+static guint
+find_least_loaded_device (GstVaapiDevicePool * pool)
+{
+  GstVaapiDevice *device, *best_device;
+  guint i, best = 0;
+
+  best_device = &g_array_index (pool->devices, GstVaapiDevice, 0);
+  for (i = 1; i < pool->devices->len; i++) {
+    device = &g_array_index (pool->devices, GstVaapiDevice, i);
+    if (device->num_contexts > best_device->num_contexts)
+      continue;
+    if (device->num_contexts == best_device->num_contexts
+        && device->memory >= best_device->memory)
+      continue;
+    best_device = device;
+    best = i;
+  }
+  return best;
+}
+
+/**
+ * gst_vaapi_device_pool_new:
+ * @devices: (array zero-terminated=1) (allow-none): the device names,
+ *   or %NULL for the DRM render nodes of the system
+ *
+ * Creates a device pool over @devices.
+ *
+ * Return value: the newly allocated #GstVaapiDevicePool
+ */
+GstVaapiDevicePool *
+gst_vaapi_device_pool_new (const gchar * const *devices)
+{
+  GstVaapiDevicePool *pool;
+  gchar **render_nodes = NULL;
+  guint i;
+
+  if (!GST_CAT_DEFAULT) {
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "vaapidevicepool", 0,
+        "VA-API device pool");
+  }
+
+  if (!devices) {
+    render_nodes = enumerate_render_nodes ();
+    devices = (const gchar * const *) render_nodes;
+  }
+
+  pool = g_slice_new0 (GstVaapiDevicePool);
+  g_mutex_init (&pool->lock);
+  pool->devices = g_array_new (FALSE, TRUE, sizeof (GstVaapiDevice));
+  g_array_set_clear_func (pool->devices, (GDestroyNotify) device_clear);
+
+  for (i = 0; devices[i]; i++) {
+    GstVaapiDevice device = { 0, };
+
+    device.path = g_strdup (devices[i]);
+    g_array_append_val (pool->devices, device);
+    GST_INFO ("device %u: %s", i, devices[i]);
+  }
+
+  g_strfreev (render_nodes);
+  return pool;
+}
+
+/**
+ * gst_vaapi_device_pool_free:
+ * @pool: a #GstVaapiDevicePool
+ *
+ * Frees @pool.
+ */
+void
+gst_vaapi_device_pool_free (GstVaapiDevicePool * pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_array_unref (pool->devices);
+  g_mutex_clear (&pool->lock);
+  g_slice_free (GstVaapiDevicePool, pool);
+}
+
+/**
+ * gst_vaapi_device_pool_get_default:
+ *
+ * Returns the device pool of the process, over the DRM render nodes
+ * of the system. It is created on first use and never freed.
+ *
+ * Return value: (transfer none): the default #GstVaapiDevicePool
+ */
+GstVaapiDevicePool *
+gst_vaapi_device_pool_get_default (void)
+{
+  static gsize pool = 0;
+
+  if (g_once_init_enter (&pool)) {
+    GstVaapiDevicePool *const new_pool = gst_vaapi_device_pool_new (NULL);
+    g_once_init_leave (&pool, (gsize) new_pool);
+  }
+  return (GstVaapiDevicePool *) pool;
+}
+
+/**
+ * gst_vaapi_device_pool_get_num_devices:
+ * @pool: a #GstVaapiDevicePool
+ *
+ * Return value: the number of devices in @pool
+ */
+guint
+gst_vaapi_device_pool_get_num_devices (GstVaapiDevicePool * pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->devices->len;
+}
+
+/**
+ * gst_vaapi_device_pool_acquire:
+ * @pool: a #GstVaapiDevicePool
+ * @policy: a #GstVaapiDevicePolicy, other than
+ *   %GST_VAAPI_DEVICE_POLICY_SHARED
+ *
+ * Chooses a device of @pool according to @policy, and counts one
+ * more active element on it, until gst_vaapi_device_pool_release().
+ *
+ * Return value: (transfer none): the name of the device, valid as
+ *   long as @pool, or %NULL if @pool is empty
+ */
+const gchar *
+gst_vaapi_device_pool_acquire (GstVaapiDevicePool * pool,
+    GstVaapiDevicePolicy policy)
+{
+  GstVaapiDevice *device;
+  guint index;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (policy != GST_VAAPI_DEVICE_POLICY_SHARED, NULL);
+
+  if (pool->devices->len == 0)
+    return NULL;
+
+  g_mutex_lock (&pool->lock);
+  switch (policy) {
+    case GST_VAAPI_DEVICE_POLICY_ROUND_ROBIN:
+      index = pool->next_device;
+      break;
+    default:
+      index = find_least_loaded_device (pool);
+      break;
+  }
+  pool->next_device = (index + 1) % pool->devices->len;
+
+  device = &g_array_index (pool->devices, GstVaapiDevice, index);
+  device->num_contexts++;
+  GST_DEBUG ("assigned %s (%u active, %" G_GUINT64_FORMAT " bytes)",
+      device->path, device->num_contexts, device->memory);
+  g_mutex_unlock (&pool->lock);
+
+  return device->path;
+}
+
+/**
+ * gst_vaapi_device_pool_release:
+ * @pool: a #GstVaapiDevicePool
+ * @device: the device name returned by gst_vaapi_device_pool_acquire()
+ *
+ * Counts one less active element on @device.
+ */
+void
+gst_vaapi_device_pool_release (GstVaapiDevicePool * pool,
+    const gchar * device)
+{
+  GstVaapiDevice *dev;
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (device != NULL);
+
+  g_mutex_lock (&pool->lock);
+  dev = find_device (pool, device);
+  if (dev && dev->num_contexts > 0)
+    dev->num_contexts--;
+  g_mutex_unlock (&pool->lock);
+}
+
+/**
+ * gst_vaapi_device_pool_update_memory:
+ * @pool: a #GstVaapiDevicePool
+ * @device: the device name
+ * @delta: the change of the surface memory used on @device, in bytes
+ *
+ * Accounts for the surface memory allocated, or freed if @delta is
+ * negative, on @device.
+ */
+void
+gst_vaapi_device_pool_update_memory (GstVaapiDevicePool * pool,
+    const gchar * device, gint64 delta)
+{
+  GstVaapiDevice *dev;
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (device != NULL);
+
+  g_mutex_lock (&pool->lock);
+  dev = find_device (pool, device);
+  if (dev) {
+    if (delta < 0 && dev->memory < (guint64) - delta)
+      dev->memory = 0;
+    else
+      dev->memory += delta;
+  }
+  g_mutex_unlock (&pool->lock);
+}
+
+/**
+ * gst_vaapi_device_pool_get_num_contexts:
+ * @pool: a #GstVaapiDevicePool
+ * @device: the device name
+ *
+ * Return value: the number of active elements on @device
+ */
+guint
+gst_vaapi_device_pool_get_num_contexts (GstVaapiDevicePool * pool,
+    const gchar * device)
+{
+  GstVaapiDevice *dev;
+  guint num_contexts = 0;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&pool->lock);
+  dev = find_device (pool, device);
+  if (dev)
+    num_contexts = dev->num_contexts;
+  g_mutex_unlock (&pool->lock);
+  return num_contexts;
+}
+
+/**
+ * gst_vaapi_device_pool_get_memory:
+ * @pool: a #GstVaapiDevicePool
+ * @device: the device name
+ *
+ * Return value: the surface memory accounted on @device, in bytes
+ */
+guint64
+gst_vaapi_device_pool_get_memory (GstVaapiDevicePool * pool,
+    const gchar * device)
+{
+  GstVaapiDevice *dev;
+  guint64 memory = 0;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&pool->lock);
+  dev = find_device (pool, device);
+  if (dev)
+    memory = dev->memory;
+  g_mutex_unlock (&pool->lock);
+  return memory;
+}
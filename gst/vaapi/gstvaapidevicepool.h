@@ -0,0 +1,96 @@
+/*
+ *  gstvaapidevicepool.h - Load balancing across DRM render nodes
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DEVICE_POOL_H
+#define GST_VAAPI_DEVICE_POOL_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiDevicePolicy:
+ * @GST_VAAPI_DEVICE_POLICY_SHARED: share the display of the pipeline,
+ *   on the default device
+ * @GST_VAAPI_DEVICE_POLICY_LEAST_LOADED: open the render node with
+ *   the fewest active elements, then the least surface memory
+ * @GST_VAAPI_DEVICE_POLICY_ROUND_ROBIN: open the render nodes in turn
+ *
+ * How an element chooses the device of a display it opens by itself.
+ */
+typedef enum
+{
+  GST_VAAPI_DEVICE_POLICY_SHARED = 0,
+  GST_VAAPI_DEVICE_POLICY_LEAST_LOADED,
+  GST_VAAPI_DEVICE_POLICY_ROUND_ROBIN,
+} GstVaapiDevicePolicy;
+
+#define GST_VAAPI_TYPE_DEVICE_POLICY \
+  (gst_vaapi_device_policy_get_type ())
+
+typedef struct _GstVaapiDevicePool GstVaapiDevicePool;
+
+G_GNUC_INTERNAL
+GType
+gst_vaapi_device_policy_get_type (void) G_GNUC_CONST;
+
+G_GNUC_INTERNAL
+GstVaapiDevicePool *
+gst_vaapi_device_pool_new (const gchar * const *devices);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_device_pool_free (GstVaapiDevicePool * pool);
+
+G_GNUC_INTERNAL
+GstVaapiDevicePool *
+gst_vaapi_device_pool_get_default (void);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_device_pool_get_num_devices (GstVaapiDevicePool * pool);
+
+G_GNUC_INTERNAL
+const gchar *
+gst_vaapi_device_pool_acquire (GstVaapiDevicePool * pool,
+    GstVaapiDevicePolicy policy);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_device_pool_release (GstVaapiDevicePool * pool,
+    const gchar * device);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_device_pool_update_memory (GstVaapiDevicePool * pool,
+    const gchar * device, gint64 delta);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_device_pool_get_num_contexts (GstVaapiDevicePool * pool,
+    const gchar * device);
+
+G_GNUC_INTERNAL
+guint64
+gst_vaapi_device_pool_get_memory (GstVaapiDevicePool * pool,
+    const gchar * device);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DEVICE_POOL_H */
@@ -26,6 +26,7 @@
 #include <gst/vaapi/gstvaapidisplay.h>
 #include <gst/vaapi/gstvaapiprofilecaps.h>
 #include "gstvaapiencode.h"
+#include "gstvaapiencodestatsmeta.h"
 #include "gstvaapipluginutil.h"
 #include "gstvaapivideometa.h"
 #include "gstvaapivideomemory.h"
@@ -55,6 +56,8 @@ enum
 {
   PROP_0,
 
+  PROP_STATS,
+
   PROP_BASE,
 };
 
@@ -243,6 +246,130 @@ ensure_output_state (GstVaapiEncode * encode)
   return TRUE;
 }
 
+static void
+gst_vaapiencode_update_stats (GstVaapiEncode * encode,
+    const GstVaapiCodedBufferStats * frame_stats)
+{
+  GstVaapiEncodeStats *const stats = &encode->stats;
+  guint64 memory_saved;
+
+  memory_saved =
+      gst_vaapi_encoder_get_coded_buffer_memory_saved (encode->encoder);
+
+  GST_OBJECT_LOCK (encode);
+  stats->num_frames++;
+  switch (frame_stats->picture_type) {
+    case GST_VAAPI_PICTURE_TYPE_I:
+      stats->num_i_frames++;
+      break;
+    case GST_VAAPI_PICTURE_TYPE_P:
+      stats->num_p_frames++;
+      break;
+    case GST_VAAPI_PICTURE_TYPE_B:
+      stats->num_b_frames++;
+      break;
+    default:
+      break;
+  }
+  stats->coded_bytes += frame_stats->coded_size;
+  if (frame_stats->average_qp >= 0) {
+    stats->qp_sum += frame_stats->average_qp;
+    stats->num_qp_frames++;
+  }
+  if (GST_CLOCK_TIME_IS_VALID (frame_stats->encode_time)) {
+    stats->encode_time_sum += frame_stats->encode_time;
+    stats->encode_time_max =
+        MAX (stats->encode_time_max, frame_stats->encode_time);
+  }
+  if (GST_CLOCK_TIME_IS_VALID (frame_stats->sync_time)) {
+    stats->sync_time_sum += frame_stats->sync_time;
+    stats->sync_time_max = MAX (stats->sync_time_max, frame_stats->sync_time);
+  }
+  if (GST_CLOCK_TIME_IS_VALID (frame_stats->reorder_delay)) {
+    stats->reorder_delay_sum += frame_stats->reorder_delay;
+    stats->reorder_delay_max =
+        MAX (stats->reorder_delay_max, frame_stats->reorder_delay);
+  }
+  if (frame_stats->vbv_status != GST_VAAPI_VBV_STATUS_NONE) {
+    if (frame_stats->vbv_status == GST_VAAPI_VBV_STATUS_UNDERFLOW)
+      stats->num_vbv_underflows++;
+    else if (frame_stats->vbv_status == GST_VAAPI_VBV_STATUS_OVERFLOW)
+      stats->num_vbv_overflows++;
+    stats->vbv_fullness = frame_stats->vbv_fullness;
+    stats->vbv_size = frame_stats->vbv_size;
+  }
+  if (frame_stats->overflow || frame_stats->reencoded)
+    stats->num_codedbuf_overflows++;
+  stats->codedbuf_memory_saved = memory_saved;
+  GST_OBJECT_UNLOCK (encode);
+}
+
+/* Reports the frames breaking the HRD buffering model */
+static void
+gst_vaapiencode_post_vbv_message (GstVaapiEncode * encode,
+    GstVideoCodecFrame * frame, const GstVaapiCodedBufferStats * frame_stats)
+{
+  const gchar *status;
+
+  switch (frame_stats->vbv_status) {
+    case GST_VAAPI_VBV_STATUS_UNDERFLOW:
+      status = "underflow";
+      break;
+    case GST_VAAPI_VBV_STATUS_OVERFLOW:
+      status = "overflow";
+      break;
+    default:
+      return;
+  }
+
+  GST_WARNING_OBJECT (encode, "VBV %s at %" GST_TIME_FORMAT ", frame size %"
+      G_GSIZE_FORMAT " bytes", status, GST_TIME_ARGS (frame->pts),
+      frame_stats->coded_size);
+
+  gst_element_post_message (GST_ELEMENT_CAST (encode),
+      gst_message_new_element (GST_OBJECT_CAST (encode),
+          gst_structure_new ("GstVaapiEncodeVBV",
+              "status", G_TYPE_STRING, status,
+              "pts", G_TYPE_UINT64, frame->pts,
+              "frame-size", G_TYPE_UINT64, (guint64) frame_stats->coded_size,
+              "fullness", G_TYPE_UINT64, frame_stats->vbv_fullness,
+              "size", G_TYPE_UINT64, frame_stats->vbv_size, NULL)));
+}
+
+static GstStructure *
+gst_vaapiencode_get_stats (GstVaapiEncode * encode)
+{
+  GstVaapiEncodeStats stats;
+  guint64 n;
+
+  GST_OBJECT_LOCK (encode);
+  stats = encode->stats;
+  GST_OBJECT_UNLOCK (encode);
+
+  n = MAX (stats.num_frames, 1);
+  return gst_structure_new ("GstVaapiEncodeStats",
+      "frames", G_TYPE_UINT64, stats.num_frames,
+      "i-frames", G_TYPE_UINT64, stats.num_i_frames,
+      "p-frames", G_TYPE_UINT64, stats.num_p_frames,
+      "b-frames", G_TYPE_UINT64, stats.num_b_frames,
+      "coded-bytes", G_TYPE_UINT64, stats.coded_bytes,
+      "average-qp", G_TYPE_DOUBLE, stats.num_qp_frames > 0 ?
+      (gdouble) stats.qp_sum / stats.num_qp_frames : -1.0,
+      "average-encode-time", G_TYPE_UINT64, stats.encode_time_sum / n,
+      "max-encode-time", G_TYPE_UINT64, stats.encode_time_max,
+      "average-sync-time", G_TYPE_UINT64, stats.sync_time_sum / n,
+      "max-sync-time", G_TYPE_UINT64, stats.sync_time_max,
+      "average-reorder-delay", G_TYPE_UINT64, stats.reorder_delay_sum / n,
+      "max-reorder-delay", G_TYPE_UINT64, stats.reorder_delay_max,
+      "vbv-underflows", G_TYPE_UINT64, stats.num_vbv_underflows,
+      "vbv-overflows", G_TYPE_UINT64, stats.num_vbv_overflows,
+      "vbv-fullness", G_TYPE_UINT64, stats.vbv_fullness,
+      "vbv-size", G_TYPE_UINT64, stats.vbv_size,
+      "coded-buffer-overflows", G_TYPE_UINT64, stats.num_codedbuf_overflows,
+      "coded-buffer-memory-saved", G_TYPE_UINT64,
+      stats.codedbuf_memory_saved, NULL);
+}
+
 static GstFlowReturn
 gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
 {
@@ -250,6 +377,7 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   GstVaapiEncodeClass *const klass = GST_VAAPIENCODE_GET_CLASS (encode);
   GstVideoCodecFrame *out_frame;
   GstVaapiCodedBufferProxy *codedbuf_proxy = NULL;
+  GstVaapiCodedBufferStats frame_stats;
   GstVaapiEncoderStatus status;
   GstBuffer *out_buffer;
   GstFlowReturn ret;
@@ -278,10 +406,24 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   ret = klass->alloc_buffer (encode,
       GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
 
+  frame_stats = *gst_vaapi_coded_buffer_proxy_get_stats (codedbuf_proxy);
   gst_vaapi_coded_buffer_proxy_replace (&codedbuf_proxy, NULL);
   if (ret != GST_FLOW_OK)
     goto error_allocate_buffer;
 
+  gst_buffer_add_vaapi_encode_stats_meta (out_buffer, &frame_stats);
+  gst_vaapiencode_update_stats (encode, &frame_stats);
+  gst_vaapiencode_post_vbv_message (encode, out_frame, &frame_stats);
+
+  /* The encoder re-encodes the frames overflowing the coded buffer,
+     so this only happens when even the largest one is too small */
+  if (frame_stats.overflow) {
+    GST_ELEMENT_WARNING (encode, STREAM, ENCODE,
+        ("Encoded frame did not fit in the coded buffer"),
+        ("frame of %" G_GSIZE_FORMAT " bytes truncated, the stream recovers "
+            "from the next keyframe", frame_stats.coded_size));
+  }
+
   gst_buffer_replace (&out_frame->output_buffer, out_buffer);
   gst_buffer_unref (out_buffer);
 
@@ -435,6 +577,37 @@ gst_vaapiencode_get_caps (GstVideoEncoder * venc, GstCaps * filter)
   return result;
 }
 
+/* Takes ownership of @encoder. The object lock guards the pointer for
+ * gst_vaapiencode_get_encoder() callers outside the streaming thread */
+static void
+gst_vaapiencode_set_encoder (GstVaapiEncode * encode,
+    GstVaapiEncoder * encoder)
+{
+  GstVaapiEncoder *old_encoder;
+
+  GST_OBJECT_LOCK (encode);
+  old_encoder = encode->encoder;
+  encode->encoder = encoder;
+  GST_OBJECT_UNLOCK (encode);
+
+  if (old_encoder)
+    gst_object_unref (old_encoder);
+}
+
+/* Returns a new reference to the current encoder, or NULL, for the
+ * derived classes code not serialized with the streaming thread */
+GstVaapiEncoder *
+gst_vaapiencode_get_encoder (GstVaapiEncode * encode)
+{
+  GstVaapiEncoder *encoder = NULL;
+
+  GST_OBJECT_LOCK (encode);
+  if (encode->encoder)
+    encoder = gst_object_ref (encode->encoder);
+  GST_OBJECT_UNLOCK (encode);
+  return encoder;
+}
+
 static gboolean
 gst_vaapiencode_destroy (GstVaapiEncode * encode)
 {
@@ -449,7 +622,7 @@ gst_vaapiencode_destroy (GstVaapiEncode * encode)
   }
 
   gst_caps_replace (&encode->allowed_sinkpad_caps, NULL);
-  gst_vaapi_encoder_replace (&encode->encoder, NULL);
+  gst_vaapiencode_set_encoder (encode, NULL);
   return TRUE;
 }
 
@@ -477,6 +650,7 @@ static gboolean
 ensure_encoder (GstVaapiEncode * encode)
 {
   GstVaapiEncodeClass *klass = GST_VAAPIENCODE_GET_CLASS (encode);
+  GstVaapiEncoder *encoder;
   guint i;
 
   g_return_val_if_fail (klass->alloc_encoder, FALSE);
@@ -484,15 +658,15 @@ ensure_encoder (GstVaapiEncode * encode)
   if (encode->encoder)
     return FALSE;
 
-  encode->encoder = klass->alloc_encoder (encode,
+  encoder = klass->alloc_encoder (encode,
       GST_VAAPI_PLUGIN_BASE_DISPLAY (encode));
-  if (!encode->encoder)
+  if (!encoder)
     return FALSE;
 
   if (encode->prop_values && encode->prop_values->len) {
     for (i = 0; i < encode->prop_values->len; i++) {
       PropValue *const prop_value = g_ptr_array_index (encode->prop_values, i);
-      g_object_set_property ((GObject *) encode->encoder,
+      g_object_set_property ((GObject *) encoder,
           g_param_spec_get_name (prop_value->pspec), &prop_value->value);
     }
     /* clear alll the cache */
@@ -500,6 +674,7 @@ ensure_encoder (GstVaapiEncode * encode)
     encode->prop_values = NULL;
   }
 
+  gst_vaapiencode_set_encoder (encode, encoder);
   return TRUE;
 }
 
@@ -523,7 +698,13 @@ gst_vaapiencode_open (GstVideoEncoder * venc)
 static gboolean
 gst_vaapiencode_start (GstVideoEncoder * venc)
 {
-  return ensure_encoder (GST_VAAPIENCODE_CAST (venc));
+  GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (venc);
+
+  GST_OBJECT_LOCK (encode);
+  memset (&encode->stats, 0, sizeof (encode->stats));
+  GST_OBJECT_UNLOCK (encode);
+
+  return ensure_encoder (encode);
 }
 
 static gboolean
@@ -812,7 +993,7 @@ gst_vaapiencode_flush (GstVideoEncoder * venc)
   if (!gst_vaapiencode_drain (encode))
     return FALSE;
 
-  gst_vaapi_encoder_replace (&encode->encoder, NULL);
+  gst_vaapiencode_set_encoder (encode, NULL);
   if (!ensure_encoder (encode))
     return FALSE;
   if (!set_codec_state (encode, encode->input_state))
@@ -837,6 +1018,33 @@ gst_vaapiencode_finalize (GObject * object)
   G_OBJECT_CLASS (gst_vaapiencode_parent_class)->finalize (object);
 }
 
+static void
+gst_vaapiencode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (object);
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vaapiencode_get_stats (encode));
+      break;
+    default:
+      if (!gst_vaapi_plugin_base_get_property (GST_VAAPI_PLUGIN_BASE (encode),
+              prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapiencode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  if (!gst_vaapi_plugin_base_set_property (GST_VAAPI_PLUGIN_BASE (object),
+          prop_id, value))
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
 static void
 gst_vaapiencode_init (GstVaapiEncode * encode)
 {
@@ -859,6 +1067,8 @@ gst_vaapiencode_class_init (GstVaapiEncodeClass * klass)
   gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
 
   object_class->finalize = gst_vaapiencode_finalize;
+  object_class->set_property = gst_vaapiencode_set_property;
+  object_class->get_property = gst_vaapiencode_get_property;
 
   element_class->set_context = gst_vaapi_base_set_context;
   element_class->change_state =
@@ -882,6 +1092,28 @@ gst_vaapiencode_class_init (GstVaapiEncodeClass * klass)
   venc_class->src_query = GST_DEBUG_FUNCPTR (gst_vaapiencode_src_query);
   venc_class->sink_query = GST_DEBUG_FUNCPTR (gst_vaapiencode_sink_query);
 
+  /**
+   * GstVaapiEncode:stats:
+   *
+   * Aggregated statistics of the frames encoded since the element was
+   * started: number of frames (per picture type), coded bytes,
+   * average QP (-1 if not reported by the driver), and the average
+   * and maximum encoding time, hardware wait time and reordering
+   * delay, in nanoseconds. When vbv-check is enabled, it also has the
+   * number of VBV underflows and overflows and the last buffer
+   * fullness and size, in bits. Finally, it has the number of frames
+   * that did not fit in their coded buffer, re-encoded or truncated,
+   * and the memory saved by sizing the coded buffers from the actual
+   * frame sizes, in bytes. Each output buffer also carries the
+   * statistics of its frame in a #GstVaapiEncodeStatsMeta.
+   */
+  g_object_class_install_property (object_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Aggregated encoding statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_vaapi_plugin_base_class_install_device_policy (object_class);
+
   gst_type_mark_as_plugin_api (GST_TYPE_VAAPIENCODE, 0);
 }
 
@@ -894,6 +1126,10 @@ gst_vaapiencode_set_property_subclass (GObject * object,
   GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (object);
   PropValue *prop_value;
 
+  if (gst_vaapi_plugin_base_set_property (GST_VAAPI_PLUGIN_BASE (encode),
+          prop_id, value))
+    return;
+
   if (prop_id <= PROP_BASE || prop_id >= encode_class->prop_num) {
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     return;
@@ -930,6 +1166,10 @@ gst_vaapiencode_get_property_subclass (GObject * object, guint prop_id,
   GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (object);
   PropValue *prop_value = NULL;
 
+  if (gst_vaapi_plugin_base_get_property (GST_VAAPI_PLUGIN_BASE (encode),
+          prop_id, value))
+    return;
+
   if (prop_id <= PROP_BASE || prop_id >= encode_class->prop_num) {
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     return;
@@ -954,9 +1194,10 @@ gst_vaapiencode_get_property_subclass (GObject * object, guint prop_id,
   }
 }
 
-/* Called by drived class to install all properties. The encode base class
-   does not have any property, all the properties of the according encoderXXX
-   class are installed to encodeXXX class. */
+/* Called by drived class to install all properties. Apart from the
+   read-only statistics, the encode base class does not have any
+   property, all the properties of the according encoderXXX class are
+   installed to encodeXXX class. */
 gboolean
 gst_vaapiencode_class_install_properties (GstVaapiEncodeClass * klass,
     GObjectClass * encoder_class)
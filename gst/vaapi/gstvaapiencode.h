@@ -160,12 +160,38 @@ struct _GstVaapiEncodeInitData
 
 typedef struct _GstVaapiEncode GstVaapiEncode;
 typedef struct _GstVaapiEncodeClass GstVaapiEncodeClass;
+typedef struct _GstVaapiEncodeStats GstVaapiEncodeStats;
+
+/* Aggregate of the per-frame #GstVaapiCodedBufferStats */
+struct _GstVaapiEncodeStats
+{
+  guint64 num_frames;
+  guint64 num_i_frames;
+  guint64 num_p_frames;
+  guint64 num_b_frames;
+  guint64 coded_bytes;
+  guint64 qp_sum;
+  guint64 num_qp_frames;
+  GstClockTime encode_time_sum;
+  GstClockTime encode_time_max;
+  GstClockTime sync_time_sum;
+  GstClockTime sync_time_max;
+  GstClockTime reorder_delay_sum;
+  GstClockTime reorder_delay_max;
+  guint64 num_vbv_underflows;
+  guint64 num_vbv_overflows;
+  guint64 vbv_fullness;
+  guint64 vbv_size;
+  guint64 num_codedbuf_overflows;
+  guint64 codedbuf_memory_saved;
+};
 
 struct _GstVaapiEncode
 {
   /*< private >*/
   GstVaapiPluginBase parent_instance;
 
+  /* only changed under the object lock */
   GstVaapiEncoder *encoder;
   GstVideoCodecState *input_state;
   gboolean input_state_changed;
@@ -174,6 +200,9 @@ struct _GstVaapiEncode
   GstVideoCodecState *output_state;
   GPtrArray *prop_values;
   GstCaps *allowed_sinkpad_caps;
+
+  /* protected by the object lock */
+  GstVaapiEncodeStats stats;
 };
 
 struct _GstVaapiEncodeClass
@@ -207,6 +236,10 @@ void
 gst_vaapiencode_get_property_subclass (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
+G_GNUC_INTERNAL
+GstVaapiEncoder *
+gst_vaapiencode_get_encoder (GstVaapiEncode * encode);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapiencode_class_install_properties (GstVaapiEncodeClass * klass,
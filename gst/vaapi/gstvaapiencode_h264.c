@@ -52,6 +52,14 @@
  * you can set #GstVaapiEncodeH264:tune, if your backend supports it,
  * for low-power mode or high compression.
  *
+ * For real-time communication, #GstVaapiEncodeH264:long-term-refs
+ * enables long-term reference frames. They are driven by a custom
+ * upstream event carrying a "GstVaapiH264LongTermRef" structure with
+ * an "action" string field, either "mark" (the next frame becomes a
+ * long-term reference) or "use" (the next frame is predicted from a
+ * long-term reference only, e.g. after a packet loss report), and an
+ * "index" unsigned integer field selecting the long-term reference.
+ *
  * ## Example launch line
  *
  * |[
@@ -499,6 +507,71 @@ error:
   }
 }
 
+static gboolean
+gst_vaapiencode_h264_src_event (GstVideoEncoder * venc, GstEvent * event)
+{
+  GstVaapiEncode *const base_encode = GST_VAAPIENCODE_CAST (venc);
+  GstVaapiEncoder *encoder;
+  const GstStructure *structure;
+  const gchar *action;
+  guint index;
+  gboolean ret;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CUSTOM_UPSTREAM)
+    goto chain_up;
+
+  structure = gst_event_get_structure (event);
+  if (!gst_structure_has_name (structure, "GstVaapiH264LongTermRef"))
+    goto chain_up;
+
+  action = gst_structure_get_string (structure, "action");
+  if (!action || !gst_structure_get_uint (structure, "index", &index))
+    goto error_invalid_event;
+  if (g_strcmp0 (action, "mark") != 0 && g_strcmp0 (action, "use") != 0)
+    goto error_invalid_event;
+
+  /* upstream events are not serialized with the encoder restarts */
+  encoder = gst_vaapiencode_get_encoder (base_encode);
+  if (!encoder)
+    goto error_no_encoder;
+
+  GST_DEBUG_OBJECT (venc, "long-term reference %s, index %u", action, index);
+
+  if (g_strcmp0 (action, "mark") == 0) {
+    ret = gst_vaapi_encoder_h264_mark_long_term_ref (GST_VAAPI_ENCODER_H264
+        (encoder), index);
+  } else {
+    ret = gst_vaapi_encoder_h264_use_long_term_ref (GST_VAAPI_ENCODER_H264
+        (encoder), index);
+  }
+  gst_object_unref (encoder);
+
+  if (!ret)
+    GST_WARNING_OBJECT (venc, "failed to %s long-term reference %u", action,
+        index);
+  gst_event_unref (event);
+  return ret;
+
+chain_up:
+  return GST_VIDEO_ENCODER_CLASS (gst_vaapiencode_h264_parent_class)->src_event
+      (venc, event);
+
+  /* ERRORS */
+error_invalid_event:
+  {
+    GST_WARNING_OBJECT (venc, "invalid long-term reference event");
+    gst_event_unref (event);
+    return FALSE;
+  }
+error_no_encoder:
+  {
+    GST_DEBUG_OBJECT (venc, "no encoder yet, dropping long-term reference "
+        "event");
+    gst_event_unref (event);
+    return FALSE;
+  }
+}
+
 static GstFlowReturn
 gst_vaapiencode_h264_alloc_buffer (GstVaapiEncode * base_encode,
     GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
@@ -538,6 +611,7 @@ gst_vaapiencode_h264_class_init (GstVaapiEncodeH264Class * klass, gpointer data)
 {
   GObjectClass *const object_class = G_OBJECT_CLASS (klass);
   GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstVideoEncoderClass *const venc_class = GST_VIDEO_ENCODER_CLASS (klass);
   GstVaapiEncodeClass *const encode_class = GST_VAAPIENCODE_CLASS (klass);
   GstCaps *sink_caps = ((GstVaapiEncodeInitData *) data)->sink_caps;
   GstCaps *src_caps = ((GstVaapiEncodeInitData *) data)->src_caps;
@@ -556,6 +630,8 @@ gst_vaapiencode_h264_class_init (GstVaapiEncodeH264Class * klass, gpointer data)
   encode_class->alloc_encoder = gst_vaapiencode_h264_alloc_encoder;
   encode_class->alloc_buffer = gst_vaapiencode_h264_alloc_buffer;
 
+  venc_class->src_event = GST_DEBUG_FUNCPTR (gst_vaapiencode_h264_src_event);
+
   gst_element_class_set_static_metadata (element_class,
       "VA-API H264 encoder",
       "Codec/Encoder/Video/Hardware",
@@ -0,0 +1,116 @@
+/*
+ *  gstvaapiencodestatsmeta.c - Per-frame VA encoder statistics meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiencodestatsmeta
+ * @short_description: Per-frame VA encoder statistics
+ *
+ * #GstVaapiEncodeStatsMeta reports, for every coded frame, the
+ * picture type, the average QP (if the driver provides it), the
+ * coded size and the time spent in the different encoding stages,
+ * so that applications do not need to parse the bitstream back.
+ */
+
+#include "gstcompat.h"
+#include "gstvaapiencodestatsmeta.h"
+
+static gboolean
+gst_vaapi_encode_stats_meta_init (GstVaapiEncodeStatsMeta * meta,
+    gpointer params, GstBuffer * buffer)
+{
+  memset (&meta->stats, 0, sizeof (meta->stats));
+  meta->stats.average_qp = -1;
+  meta->stats.encode_time = GST_CLOCK_TIME_NONE;
+  meta->stats.sync_time = GST_CLOCK_TIME_NONE;
+  meta->stats.reorder_delay = GST_CLOCK_TIME_NONE;
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_encode_stats_meta_transform (GstBuffer * dst_buffer, GstMeta * meta,
+    GstBuffer * src_buffer, GQuark type, gpointer data)
+{
+  GstVaapiEncodeStatsMeta *const src_meta = (GstVaapiEncodeStatsMeta *) meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    return gst_buffer_add_vaapi_encode_stats_meta (dst_buffer,
+        &src_meta->stats) != NULL;
+  }
+  return FALSE;
+}
+
+GType
+gst_vaapi_encode_stats_meta_api_get_type (void)
+{
+  static gsize g_type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&g_type)) {
+    GType type =
+        gst_meta_api_type_register ("GstVaapiEncodeStatsMetaAPI", tags);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
+
+const GstMetaInfo *
+gst_vaapi_encode_stats_meta_get_info (void)
+{
+  static gsize g_meta_info;
+
+  if (g_once_init_enter (&g_meta_info)) {
+    gsize meta_info =
+        GPOINTER_TO_SIZE (gst_meta_register
+        (GST_VAAPI_ENCODE_STATS_META_API_TYPE, "GstVaapiEncodeStatsMeta",
+            sizeof (GstVaapiEncodeStatsMeta),
+            (GstMetaInitFunction) gst_vaapi_encode_stats_meta_init,
+            (GstMetaFreeFunction) NULL,
+            (GstMetaTransformFunction) gst_vaapi_encode_stats_meta_transform));
+    g_once_init_leave (&g_meta_info, meta_info);
+  }
+  return GSIZE_TO_POINTER (g_meta_info);
+}
+
+/**
+ * gst_buffer_add_vaapi_encode_stats_meta:
+ * @buffer: a #GstBuffer
+ * @stats: the #GstVaapiCodedBufferStats to attach
+ *
+ * Attaches a copy of @stats to @buffer.
+ *
+ * Returns: (transfer none): the #GstVaapiEncodeStatsMeta on @buffer,
+ *   or %NULL on error
+ */
+GstVaapiEncodeStatsMeta *
+gst_buffer_add_vaapi_encode_stats_meta (GstBuffer * buffer,
+    const GstVaapiCodedBufferStats * stats)
+{
+  GstVaapiEncodeStatsMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  meta = (GstVaapiEncodeStatsMeta *) gst_buffer_add_meta (buffer,
+      GST_VAAPI_ENCODE_STATS_META_INFO, NULL);
+  if (!meta)
+    return NULL;
+
+  meta->stats = *stats;
+  return meta;
+}
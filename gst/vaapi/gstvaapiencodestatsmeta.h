@@ -0,0 +1,69 @@
+/*
+ *  gstvaapiencodestatsmeta.h - Per-frame VA encoder statistics meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_ENCODE_STATS_META_H
+#define GST_VAAPI_ENCODE_STATS_META_H
+
+#include <gst/vaapi/gstvaapicodedbufferproxy.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiEncodeStatsMeta GstVaapiEncodeStatsMeta;
+
+#define GST_VAAPI_ENCODE_STATS_META_API_TYPE \
+  gst_vaapi_encode_stats_meta_api_get_type ()
+
+#define GST_VAAPI_ENCODE_STATS_META_INFO \
+  gst_vaapi_encode_stats_meta_get_info ()
+
+/**
+ * GstVaapiEncodeStatsMeta:
+ * @meta: parent #GstMeta
+ * @stats: the #GstVaapiCodedBufferStats of the frame
+ *
+ * Extra buffer metadata attached by the VA-API encoders to each
+ * output buffer, describing how the frame was encoded.
+ */
+struct _GstVaapiEncodeStatsMeta
+{
+  GstMeta meta;
+
+  GstVaapiCodedBufferStats stats;
+};
+
+G_GNUC_INTERNAL
+GType
+gst_vaapi_encode_stats_meta_api_get_type (void);
+
+G_GNUC_INTERNAL
+const GstMetaInfo *
+gst_vaapi_encode_stats_meta_get_info (void);
+
+G_GNUC_INTERNAL
+GstVaapiEncodeStatsMeta *
+gst_buffer_add_vaapi_encode_stats_meta (GstBuffer * buffer,
+    const GstVaapiCodedBufferStats * stats);
+
+#define gst_buffer_get_vaapi_encode_stats_meta(buffer) \
+  ((GstVaapiEncodeStatsMeta *) gst_buffer_get_meta ((buffer), \
+      GST_VAAPI_ENCODE_STATS_META_API_TYPE))
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_ENCODE_STATS_META_H */
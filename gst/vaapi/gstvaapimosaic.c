@@ -0,0 +1,658 @@
+/*
+ *  gstvaapimosaic.c - VA-API video wall compositor
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+/**
+ * SECTION:element-vaapimosaic
+ * @title: vaapimosaic
+ * @short_description: a VA-API video wall
+ *
+ * vaapimosaic lays out all its inputs on a grid, in the order the sink
+ * pads were requested. The number of columns is either set with the
+ * #GstVaapiMosaic:columns property or chosen to make the grid as
+ * square as possible, and every tile gets an equal share of the
+ * output frame.
+ *
+ * Each input is scaled to its tile only when it delivers a new frame;
+ * the scaled tile is kept and composed again into the following
+ * output frames. An input that is slower than the output, or that
+ * stalls, keeps showing its last frame while the other tiles go on.
+ *
+ * The xpos and ypos pad properties are ignored, alpha is honoured.
+ *
+ * ## Example launch line
+ *
+ * |[
+ *   gst-launch-1.0 vaapimosaic name=wall ! vaapisink \
+ *     videotestsrc pattern=ball ! vaapipostproc ! wall. \
+ *     videotestsrc pattern=snow ! vaapipostproc ! wall. \
+ *     videotestsrc pattern=smpte ! vaapipostproc ! wall. \
+ *     videotestsrc pattern=pinwheel ! vaapipostproc ! wall.
+ * ]|
+ */
+
+#include "gstvaapimosaic.h"
+#include "gstvaapipluginutil.h"
+
+#define GST_PLUGIN_NAME "vaapimosaic"
+#define GST_PLUGIN_DESC "A VA-API video wall"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapi_mosaic);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapi_mosaic
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+/* *INDENT-OFF* */
+static const char gst_vaapi_mosaic_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ";"
+  GST_VIDEO_CAPS_MAKE (GST_VAAPI_FORMATS_ALL);
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_mosaic_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapi_mosaic_sink_caps_str));
+/* *INDENT-ON* */
+
+G_DEFINE_TYPE (GstVaapiMosaicSinkPad, gst_vaapi_mosaic_sink_pad,
+    GST_TYPE_VAAPI_OVERLAY_SINK_PAD);
+
+G_DEFINE_TYPE (GstVaapiMosaic, gst_vaapi_mosaic, GST_TYPE_VAAPI_OVERLAY);
+
+#define DEFAULT_COLUMNS 0
+
+enum
+{
+  PROP_0,
+  PROP_COLUMNS,
+  PROP_SCALED_TILES,
+};
+
+/* Iterates over the tiles of the output frame */
+typedef struct _GstVaapiMosaicSurfaceGenerator GstVaapiMosaicSurfaceGenerator;
+struct _GstVaapiMosaicSurfaceGenerator
+{
+  GList *current;
+  GstVaapiBlendSurface blend_surface;
+};
+
+/* Returns a single input frame, to be scaled to its tile */
+typedef struct _GstVaapiMosaicTileGenerator GstVaapiMosaicTileGenerator;
+struct _GstVaapiMosaicTileGenerator
+{
+  GstVaapiBlendSurface blend_surface;
+  gboolean done;
+};
+
+static void
+gst_vaapi_mosaic_sink_pad_reset (GstVaapiMosaicSinkPad * pad)
+{
+  gst_buffer_replace (&pad->tile_buffer, NULL);
+  gst_vaapi_surface_proxy_replace (&pad->tile_proxy, NULL);
+}
+
+static void
+gst_vaapi_mosaic_sink_pad_finalize (GObject * object)
+{
+  gst_vaapi_mosaic_sink_pad_reset (GST_VAAPI_MOSAIC_SINK_PAD (object));
+
+  G_OBJECT_CLASS (gst_vaapi_mosaic_sink_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_mosaic_sink_pad_class_init (GstVaapiMosaicSinkPadClass * klass)
+{
+  GObjectClass *const gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_vaapi_mosaic_sink_pad_finalize;
+}
+
+static void
+gst_vaapi_mosaic_sink_pad_init (GstVaapiMosaicSinkPad * pad)
+{
+}
+
+static void
+get_grid_size (guint num_tiles, guint columns, guint * columns_ptr,
+    guint * rows_ptr)
+{
+  if (num_tiles == 0) {
+    *columns_ptr = *rows_ptr = 1;
+    return;
+  }
+
+  if (columns == 0) {
+    /* as square as possible */
+    columns = 1;
+    while (columns * columns < num_tiles)
+      columns++;
+  }
+  columns = MIN (columns, num_tiles);
+
+  *columns_ptr = columns;
+  *rows_ptr = (num_tiles + columns - 1) / columns;
+}
+
+static gboolean
+_collect_sinkpad (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  GList **const pads_ptr = user_data;
+
+  *pads_ptr = g_list_prepend (*pads_ptr, gst_object_ref (pad));
+  return TRUE;
+}
+
+/* Returns a reference to every sink pad, in request order, so they can
+ * be walked without holding the object lock while blending */
+static GList *
+gst_vaapi_mosaic_get_sinkpads (GstVaapiMosaic * mosaic)
+{
+  GList *pads = NULL;
+
+  gst_element_foreach_sink_pad (GST_ELEMENT (mosaic), _collect_sinkpad, &pads);
+  return g_list_reverse (pads);
+}
+
+/* Places every sink pad on the grid matching the current output size.
+ * The scaled tiles are dropped when the grid changes */
+static gboolean
+gst_vaapi_mosaic_ensure_layout (GstVaapiMosaic * mosaic, GList * pads,
+    gboolean * changed)
+{
+  const GstVideoInfo *const vinfo = GST_VAAPI_PLUGIN_BASE_SRC_PAD_INFO (mosaic);
+  GstVaapiVideoPool *pool;
+  GstVideoInfo tile_info;
+  guint num_tiles, columns, rows, tile_width, tile_height, i;
+  GList *l;
+
+  num_tiles = g_list_length (pads);
+  GST_OBJECT_LOCK (mosaic);
+  get_grid_size (num_tiles, mosaic->columns, &columns, &rows);
+  GST_OBJECT_UNLOCK (mosaic);
+
+  /* even sizes, for subsampled formats */
+  tile_width = (GST_VIDEO_INFO_WIDTH (vinfo) / columns) & ~1U;
+  tile_height = (GST_VIDEO_INFO_HEIGHT (vinfo) / rows) & ~1U;
+
+  if (num_tiles == mosaic->num_tiles && columns == mosaic->tile_columns
+      && tile_width == mosaic->tile_width
+      && tile_height == mosaic->tile_height && mosaic->tile_pool)
+    return TRUE;
+
+  for (l = pads, i = 0; l; l = l->next, i++) {
+    GstVaapiMosaicSinkPad *const pad = GST_VAAPI_MOSAIC_SINK_PAD (l->data);
+
+    pad->tile_rect.x = (i % columns) * tile_width;
+    pad->tile_rect.y = (i / columns) * tile_height;
+    pad->tile_rect.width = tile_width;
+    pad->tile_rect.height = tile_height;
+    gst_vaapi_mosaic_sink_pad_reset (pad);
+  }
+
+  gst_vaapi_video_pool_replace (&mosaic->tile_pool, NULL);
+  mosaic->num_tiles = 0;
+  *changed = TRUE;
+
+  if (num_tiles == 0)
+    return TRUE;
+  if (tile_width == 0 || tile_height == 0)
+    goto error_invalid_size;
+
+  GST_INFO_OBJECT (mosaic, "%ux%u grid of %ux%u tiles", columns, rows,
+      tile_width, tile_height);
+
+  gst_video_info_set_format (&tile_info, GST_VIDEO_INFO_FORMAT (vinfo),
+      tile_width, tile_height);
+  pool = gst_vaapi_surface_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY
+      (mosaic), &tile_info, 0);
+  if (!pool)
+    return FALSE;
+
+  /* one scaled frame per tile, plus the one being scaled */
+  gst_vaapi_video_pool_set_capacity (pool, 2 * num_tiles);
+  gst_vaapi_video_pool_replace (&mosaic->tile_pool, pool);
+  gst_vaapi_video_pool_unref (pool);
+
+  mosaic->num_tiles = num_tiles;
+  mosaic->tile_columns = columns;
+  mosaic->tile_width = tile_width;
+  mosaic->tile_height = tile_height;
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_size:
+  {
+    GST_ERROR_OBJECT (mosaic, "output too small for %u tiles", num_tiles);
+    return FALSE;
+  }
+}
+
+static GstVaapiBlendSurface *
+gst_vaapi_mosaic_tile_next (gpointer data)
+{
+  GstVaapiMosaicTileGenerator *const generator = data;
+
+  if (generator->done)
+    return NULL;
+  generator->done = TRUE;
+  return &generator->blend_surface;
+}
+
+static gboolean
+gst_vaapi_mosaic_scale_tile (GstVaapiMosaic * mosaic,
+    GstVaapiMosaicSinkPad * pad, GstBuffer * buf)
+{
+  GstVaapiOverlay *const overlay = GST_VAAPI_OVERLAY (mosaic);
+  GstVaapiMosaicTileGenerator generator;
+  GstVaapiVideoMeta *meta;
+  GstVaapiSurfaceProxy *proxy;
+  GstBuffer *inbuf;
+  gboolean success = FALSE;
+
+  if (gst_vaapi_plugin_base_pad_get_input_buffer (GST_VAAPI_PLUGIN_BASE
+          (mosaic), GST_PAD (pad), buf, &inbuf) != GST_FLOW_OK)
+    return FALSE;
+
+  meta = gst_buffer_get_vaapi_video_meta (inbuf);
+  if (!meta)
+    goto bail;
+
+  proxy = gst_vaapi_surface_proxy_new_from_pool
+      (GST_VAAPI_SURFACE_POOL (mosaic->tile_pool));
+  if (!proxy) {
+    GST_ERROR_OBJECT (pad, "no free tile surface");
+    goto bail;
+  }
+
+  generator.blend_surface.surface = gst_vaapi_video_meta_get_surface (meta);
+  generator.blend_surface.crop = gst_vaapi_video_meta_get_render_rect (meta);
+  generator.blend_surface.target.x = 0;
+  generator.blend_surface.target.y = 0;
+  generator.blend_surface.target.width = mosaic->tile_width;
+  generator.blend_surface.target.height = mosaic->tile_height;
+  generator.blend_surface.alpha = 1.0;
+  generator.done = FALSE;
+
+  success = gst_vaapi_blend_process (overlay->blend,
+      GST_VAAPI_SURFACE_PROXY_SURFACE (proxy), gst_vaapi_mosaic_tile_next,
+      &generator);
+  if (success) {
+    gst_vaapi_surface_proxy_replace (&pad->tile_proxy, proxy);
+    gst_buffer_replace (&pad->tile_buffer, buf);
+
+    GST_OBJECT_LOCK (mosaic);
+    mosaic->scaled_tiles++;
+    GST_OBJECT_UNLOCK (mosaic);
+  }
+  gst_vaapi_surface_proxy_unref (proxy);
+
+bail:
+  gst_buffer_unref (inbuf);
+  return success;
+}
+
+/* Scales the tiles whose input has a new frame. The others keep their
+ * last scaled frame, so a slow input doesn't cost anything */
+static gboolean
+gst_vaapi_mosaic_update_tiles (GstVaapiMosaic * mosaic, GList * pads,
+    gboolean * changed)
+{
+  GstVaapiOverlay *const overlay = GST_VAAPI_OVERLAY (mosaic);
+  guint num_layers = 0;
+  GList *l;
+
+  for (l = pads; l; l = l->next) {
+    GstVideoAggregatorPad *const vagg_pad = l->data;
+    GstVaapiMosaicSinkPad *const pad = GST_VAAPI_MOSAIC_SINK_PAD (vagg_pad);
+    GstVaapiOverlaySinkPad *const overlay_pad =
+        GST_VAAPI_OVERLAY_SINK_PAD (vagg_pad);
+    GstBuffer *buf;
+
+    buf = gst_video_aggregator_pad_get_current_buffer (vagg_pad);
+    if (!buf) {
+      /* not started yet, or EOS */
+      if (pad->tile_proxy) {
+        gst_vaapi_mosaic_sink_pad_reset (pad);
+        *changed = TRUE;
+      }
+      continue;
+    }
+
+    if (buf != pad->tile_buffer) {
+      if (!gst_vaapi_mosaic_scale_tile (mosaic, pad, buf))
+        return FALSE;
+      *changed = TRUE;
+    }
+
+    if (overlay_pad->alpha != overlay_pad->blended_alpha) {
+      overlay_pad->blended_alpha = overlay_pad->alpha;
+      *changed = TRUE;
+    }
+    num_layers++;
+  }
+
+  if (num_layers != overlay->num_blended_layers)
+    *changed = TRUE;
+  overlay->num_blended_layers = num_layers;
+
+  return TRUE;
+}
+
+static GstVaapiBlendSurface *
+gst_vaapi_mosaic_surface_next (gpointer data)
+{
+  GstVaapiMosaicSurfaceGenerator *const generator = data;
+  GstVaapiBlendSurface *const blend_surface = &generator->blend_surface;
+
+  while (generator->current) {
+    GstVaapiMosaicSinkPad *const pad =
+        GST_VAAPI_MOSAIC_SINK_PAD (generator->current->data);
+
+    generator->current = generator->current->next;
+
+    if (!pad->tile_proxy)
+      continue;
+
+    blend_surface->surface = GST_VAAPI_SURFACE_PROXY_SURFACE (pad->tile_proxy);
+    blend_surface->crop = NULL;
+    blend_surface->target = pad->tile_rect;
+    blend_surface->alpha = GST_VAAPI_OVERLAY_SINK_PAD (pad)->alpha;
+    return blend_surface;
+  }
+
+  return NULL;
+}
+
+static GstFlowReturn
+gst_vaapi_mosaic_aggregate_frames (GstVideoAggregator * vagg,
+    GstBuffer * outbuf)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (vagg);
+  GstVaapiOverlay *const overlay = GST_VAAPI_OVERLAY (vagg);
+  GstVaapiVideoMeta *outbuf_meta;
+  GstVaapiSurface *outbuf_surface;
+  GstVaapiSurfaceProxy *proxy;
+  GstVaapiMosaicSurfaceGenerator generator;
+  GList *pads;
+  gboolean changed = FALSE;
+
+  if (!overlay->blend_pool) {
+    GstVaapiVideoPool *pool =
+        gst_vaapi_surface_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY
+        (mosaic),
+        GST_VAAPI_PLUGIN_BASE_SRC_PAD_INFO (mosaic), 0);
+    if (!pool)
+      return GST_FLOW_ERROR;
+    gst_vaapi_video_pool_replace (&overlay->blend_pool, pool);
+    gst_vaapi_video_pool_unref (pool);
+  }
+
+  outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  if (!outbuf_meta)
+    return GST_FLOW_ERROR;
+
+  pads = gst_vaapi_mosaic_get_sinkpads (mosaic);
+  if (!gst_vaapi_mosaic_ensure_layout (mosaic, pads, &changed))
+    goto error_blend;
+  if (!gst_vaapi_mosaic_update_tiles (mosaic, pads, &changed))
+    goto error_blend;
+
+  proxy = gst_vaapi_video_meta_get_surface_proxy (outbuf_meta);
+  if (!proxy) {
+    /* no new frame on any input: output the last wall again */
+    if (!changed && overlay->blend_proxy) {
+      gst_vaapi_video_meta_set_surface_proxy (outbuf_meta,
+          overlay->blend_proxy);
+      GST_OBJECT_LOCK (overlay);
+      overlay->skipped_blends++;
+      GST_OBJECT_UNLOCK (overlay);
+      g_list_free_full (pads, gst_object_unref);
+      return GST_FLOW_OK;
+    }
+
+    proxy = gst_vaapi_surface_proxy_new_from_pool
+        (GST_VAAPI_SURFACE_POOL (overlay->blend_pool));
+    if (!proxy)
+      goto error_blend;
+    gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, proxy);
+    gst_vaapi_surface_proxy_unref (proxy);
+  } else {
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, NULL);
+  }
+
+  outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
+
+  /* the tiles are opaque and disjoint, unless alpha was changed, so
+   * this is usually a batch of plain copies */
+  generator.current = pads;
+
+  if (!gst_vaapi_blend_process (overlay->blend, outbuf_surface,
+          gst_vaapi_mosaic_surface_next, &generator))
+    goto error_blend;
+
+  g_list_free_full (pads, gst_object_unref);
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+error_blend:
+  {
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, NULL);
+    g_list_free_full (pads, gst_object_unref);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static gboolean
+_reset_sinkpad_tile (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  gst_vaapi_mosaic_sink_pad_reset (GST_VAAPI_MOSAIC_SINK_PAD (pad));
+
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_mosaic_stop (GstAggregator * agg)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (agg);
+
+  gst_element_foreach_sink_pad (GST_ELEMENT (mosaic), _reset_sinkpad_tile,
+      NULL);
+  gst_vaapi_video_pool_replace (&mosaic->tile_pool, NULL);
+  mosaic->num_tiles = 0;
+
+  return GST_AGGREGATOR_CLASS (gst_vaapi_mosaic_parent_class)->stop (agg);
+}
+
+static GstCaps *
+gst_vaapi_mosaic_fixate_src_caps (GstAggregator * agg, GstCaps * caps)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (agg);
+  GList *l;
+  gint best_width = -1, best_height = -1;
+  gint best_fps_n = -1, best_fps_d = -1;
+  gdouble best_fps = 0.;
+  guint columns, rows;
+  GstCaps *ret = NULL;
+  GstStructure *s;
+
+  ret = gst_caps_make_writable (caps);
+
+  /* every tile as large as the largest input */
+  GST_OBJECT_LOCK (mosaic);
+  for (l = GST_ELEMENT (mosaic)->sinkpads; l; l = l->next) {
+    GstVideoAggregatorPad *vaggpad = l->data;
+    gint fps_n, fps_d;
+    gdouble cur_fps;
+
+    fps_n = GST_VIDEO_INFO_FPS_N (&vaggpad->info);
+    fps_d = GST_VIDEO_INFO_FPS_D (&vaggpad->info);
+
+    best_width = MAX (best_width, GST_VIDEO_INFO_WIDTH (&vaggpad->info));
+    best_height = MAX (best_height, GST_VIDEO_INFO_HEIGHT (&vaggpad->info));
+
+    if (fps_d == 0)
+      cur_fps = 0.0;
+    else
+      gst_util_fraction_to_double (fps_n, fps_d, &cur_fps);
+
+    if (best_fps < cur_fps) {
+      best_fps = cur_fps;
+      best_fps_n = fps_n;
+      best_fps_d = fps_d;
+    }
+  }
+  get_grid_size (GST_ELEMENT (mosaic)->numsinkpads, mosaic->columns,
+      &columns, &rows);
+  GST_OBJECT_UNLOCK (mosaic);
+
+  if (best_fps_n <= 0 || best_fps_d <= 0 || best_fps == 0.0) {
+    best_fps_n = 25;
+    best_fps_d = 1;
+    best_fps = 25.0;
+  }
+
+  s = gst_caps_get_structure (ret, 0);
+  if (best_width > 0 && best_height > 0) {
+    gst_structure_fixate_field_nearest_int (s, "width", best_width * columns);
+    gst_structure_fixate_field_nearest_int (s, "height", best_height * rows);
+  }
+  gst_structure_fixate_field_nearest_fraction (s, "framerate", best_fps_n,
+      best_fps_d);
+
+  return gst_caps_fixate (ret);
+}
+
+static void
+gst_vaapi_mosaic_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (object);
+
+  switch (prop_id) {
+    case PROP_COLUMNS:
+      GST_OBJECT_LOCK (mosaic);
+      mosaic->columns = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (mosaic);
+      gst_pad_mark_reconfigure (GST_AGGREGATOR_SRC_PAD (mosaic));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_mosaic_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (object);
+
+  switch (prop_id) {
+    case PROP_COLUMNS:
+      GST_OBJECT_LOCK (mosaic);
+      g_value_set_uint (value, mosaic->columns);
+      GST_OBJECT_UNLOCK (mosaic);
+      break;
+    case PROP_SCALED_TILES:
+      GST_OBJECT_LOCK (mosaic);
+      g_value_set_uint64 (value, mosaic->scaled_tiles);
+      GST_OBJECT_UNLOCK (mosaic);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_mosaic_finalize (GObject * object)
+{
+  GstVaapiMosaic *const mosaic = GST_VAAPI_MOSAIC (object);
+
+  gst_vaapi_video_pool_replace (&mosaic->tile_pool, NULL);
+
+  G_OBJECT_CLASS (gst_vaapi_mosaic_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_mosaic_class_init (GstVaapiMosaicClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstAggregatorClass *const agg_class = GST_AGGREGATOR_CLASS (klass);
+  GstVideoAggregatorClass *const vagg_class =
+      GST_VIDEO_AGGREGATOR_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi_mosaic,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  object_class->finalize = GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_finalize);
+  object_class->set_property =
+      GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_set_property);
+  object_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_get_property);
+
+  /**
+   * GstVaapiMosaic:columns:
+   *
+   * The number of columns of the grid. With 0, the grid is made as
+   * square as possible.
+   */
+  g_object_class_install_property (object_class, PROP_COLUMNS,
+      g_param_spec_uint ("columns", "Columns",
+          "Number of columns of the grid (0 = automatic)", 0, G_MAXUINT16,
+          DEFAULT_COLUMNS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiMosaic:scaled-tiles:
+   *
+   * The number of input frames scaled to their tile so far.
+   */
+  g_object_class_install_property (object_class, PROP_SCALED_TILES,
+      g_param_spec_uint64 ("scaled-tiles", "Scaled tiles",
+          "Number of input frames scaled to their tile",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  agg_class->fixate_src_caps =
+      GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_fixate_src_caps);
+  agg_class->stop = GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_stop);
+
+  vagg_class->aggregate_frames =
+      GST_DEBUG_FUNCPTR (gst_vaapi_mosaic_aggregate_frames);
+
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &gst_vaapi_mosaic_sink_factory, GST_TYPE_VAAPI_MOSAIC_SINK_PAD);
+
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API mosaic",
+      "Filter/Editor/Video/Compositor/Hardware",
+      GST_PLUGIN_DESC, "The GStreamer VA-API developers");
+}
+
+static void
+gst_vaapi_mosaic_init (GstVaapiMosaic * mosaic)
+{
+  mosaic->columns = DEFAULT_COLUMNS;
+}
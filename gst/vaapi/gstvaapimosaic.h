@@ -0,0 +1,102 @@
+/*
+ *  gstvaapimosaic.h - VA-API video wall compositor
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#ifndef GST_VAAPI_MOSAIC_H
+#define GST_VAAPI_MOSAIC_H
+
+#include "gstvaapioverlay.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAAPI_MOSAIC (gst_vaapi_mosaic_get_type ())
+#define GST_VAAPI_MOSAIC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_MOSAIC, GstVaapiMosaic))
+#define GST_VAAPI_MOSAIC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VAAPI_MOSAIC, \
+      GstVaapiMosaicClass))
+#define GST_IS_VAAPI_MOSAIC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_MOSAIC))
+#define GST_IS_VAAPI_MOSAIC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VAAPI_MOSAIC))
+#define GST_VAAPI_MOSAIC_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VAAPI_MOSAIC, \
+      GstVaapiMosaicClass))
+
+#define GST_TYPE_VAAPI_MOSAIC_SINK_PAD (gst_vaapi_mosaic_sink_pad_get_type())
+#define GST_VAAPI_MOSAIC_SINK_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_MOSAIC_SINK_PAD, \
+      GstVaapiMosaicSinkPad))
+#define GST_IS_VAAPI_MOSAIC_SINK_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_MOSAIC_SINK_PAD))
+
+typedef struct _GstVaapiMosaic GstVaapiMosaic;
+typedef struct _GstVaapiMosaicClass GstVaapiMosaicClass;
+
+typedef struct _GstVaapiMosaicSinkPad GstVaapiMosaicSinkPad;
+typedef struct _GstVaapiMosaicSinkPadClass GstVaapiMosaicSinkPadClass;
+
+struct _GstVaapiMosaic
+{
+  GstVaapiOverlay parent_instance;
+
+  guint columns;
+
+  /* current grid */
+  guint num_tiles;
+  guint tile_columns;
+  guint tile_width;
+  guint tile_height;
+
+  /* scaled tiles, at most two per tile */
+  GstVaapiVideoPool *tile_pool;
+
+  guint64 scaled_tiles;
+};
+
+struct _GstVaapiMosaicClass
+{
+  GstVaapiOverlayClass parent_class;
+};
+
+struct _GstVaapiMosaicSinkPad
+{
+  GstVaapiOverlaySinkPad parent_instance;
+
+  /* position of the tile in the output */
+  GstVaapiRectangle tile_rect;
+
+  /* last input frame, and its scaled copy */
+  GstBuffer *tile_buffer;
+  GstVaapiSurfaceProxy *tile_proxy;
+};
+
+struct _GstVaapiMosaicSinkPadClass
+{
+  GstVaapiOverlaySinkPadClass parent_class;
+};
+
+GType
+gst_vaapi_mosaic_get_type (void) G_GNUC_CONST;
+
+GType
+gst_vaapi_mosaic_sink_pad_get_type (void) G_GNUC_CONST;
+
+G_END_DECLS
+
+#endif
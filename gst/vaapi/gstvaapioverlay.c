@@ -154,7 +154,10 @@ gst_vaapi_overlay_sink_pad_set_property (GObject * object, guint prop_id,
 static void
 gst_vaapi_overlay_sink_pad_finalize (GObject * object)
 {
-  gst_vaapi_pad_private_finalize (GST_VAAPI_OVERLAY_SINK_PAD (object)->priv);
+  GstVaapiOverlaySinkPad *pad = GST_VAAPI_OVERLAY_SINK_PAD (object);
+
+  gst_buffer_replace (&pad->blended_buffer, NULL);
+  gst_vaapi_pad_private_finalize (pad->priv);
 
   G_OBJECT_CLASS (gst_vaapi_overlay_sink_pad_parent_class)->finalize (object);
 }
@@ -199,6 +202,12 @@ G_DEFINE_TYPE_WITH_CODE (GstVaapiOverlay, gst_vaapi_overlay,
     G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
         gst_vaapi_overlay_child_proxy_init));
 
+enum
+{
+  PROP_0,
+  PROP_SKIPPED_BLENDS,
+};
+
 GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapi_overlay_parent_class);
 
 static GstPad *
@@ -304,7 +313,10 @@ gst_vaapi_overlay_start (GstAggregator * agg)
 static gboolean
 _reset_sinkpad_private (GstElement * element, GstPad * pad, gpointer user_data)
 {
-  gst_vaapi_pad_private_reset (GST_VAAPI_OVERLAY_SINK_PAD (pad)->priv);
+  GstVaapiOverlaySinkPad *const sinkpad = GST_VAAPI_OVERLAY_SINK_PAD (pad);
+
+  gst_buffer_replace (&sinkpad->blended_buffer, NULL);
+  gst_vaapi_pad_private_reset (sinkpad->priv);
 
   return TRUE;
 }
@@ -314,6 +326,7 @@ gst_vaapi_overlay_stop (GstAggregator * agg)
 {
   GstVaapiOverlay *const overlay = GST_VAAPI_OVERLAY (agg);
 
+  gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, NULL);
   gst_vaapi_video_pool_replace (&overlay->blend_pool, NULL);
   gst_vaapi_blend_replace (&overlay->blend, NULL);
 
@@ -416,6 +429,64 @@ gst_vaapi_overlay_surface_next (gpointer data)
   return NULL;
 }
 
+/* Records the layers about to be blended. Returns %FALSE if they are
+ * the same as in the last composited surface: same buffers, and same
+ * position, size, alpha and crop */
+static gboolean
+gst_vaapi_overlay_update_layers (GstVaapiOverlay * overlay)
+{
+  GstVaapiVideoMeta *meta;
+  GstBuffer *buf;
+  GstVaapiRectangle crop, target;
+  gboolean changed = FALSE;
+  guint num_layers = 0;
+  GList *l;
+
+  GST_OBJECT_LOCK (overlay);
+  for (l = GST_ELEMENT (overlay)->sinkpads; l; l = l->next) {
+    GstVideoAggregatorPad *const vagg_pad = l->data;
+    GstVaapiOverlaySinkPad *const pad = GST_VAAPI_OVERLAY_SINK_PAD (vagg_pad);
+    const GstVaapiRectangle *render_rect = NULL;
+
+    buf = gst_video_aggregator_pad_get_current_buffer (vagg_pad);
+    if (buf) {
+      num_layers++;
+      meta = gst_buffer_get_vaapi_video_meta (buf);
+      if (meta)
+        render_rect = gst_vaapi_video_meta_get_render_rect (meta);
+    }
+
+    memset (&crop, 0, sizeof (crop));
+    if (render_rect)
+      crop = *render_rect;
+
+    target.x = pad->xpos;
+    target.y = pad->ypos;
+    target.width = GST_VIDEO_INFO_WIDTH (&vagg_pad->info);
+    target.height = GST_VIDEO_INFO_HEIGHT (&vagg_pad->info);
+
+    if (buf != pad->blended_buffer
+        || memcmp (&crop, &pad->blended_crop, sizeof (crop)) != 0
+        || memcmp (&target, &pad->blended_target, sizeof (target)) != 0
+        || pad->alpha != pad->blended_alpha)
+      changed = TRUE;
+
+    /* keeping a reference makes sure the buffer can't be recycled, with
+     * new contents, by its pool */
+    gst_buffer_replace (&pad->blended_buffer, buf);
+    pad->blended_crop = crop;
+    pad->blended_target = target;
+    pad->blended_alpha = pad->alpha;
+  }
+  GST_OBJECT_UNLOCK (overlay);
+
+  if (num_layers != overlay->num_blended_layers)
+    changed = TRUE;
+  overlay->num_blended_layers = num_layers;
+
+  return changed;
+}
+
 static GstFlowReturn
 gst_vaapi_overlay_aggregate_frames (GstVideoAggregator * vagg,
     GstBuffer * outbuf)
@@ -425,6 +496,7 @@ gst_vaapi_overlay_aggregate_frames (GstVideoAggregator * vagg,
   GstVaapiSurface *outbuf_surface;
   GstVaapiSurfaceProxy *proxy;
   GstVaapiOverlaySurfaceGenerator generator;
+  gboolean changed;
 
   if (!overlay->blend_pool) {
     GstVaapiVideoPool *pool =
@@ -441,13 +513,32 @@ gst_vaapi_overlay_aggregate_frames (GstVideoAggregator * vagg,
   if (!outbuf_meta)
     return GST_FLOW_ERROR;
 
-  if (!gst_vaapi_video_meta_get_surface_proxy (outbuf_meta)) {
+  changed = gst_vaapi_overlay_update_layers (overlay);
+
+  proxy = gst_vaapi_video_meta_get_surface_proxy (outbuf_meta);
+  if (!proxy) {
+    /* nothing changed: the last composited surface is still valid, and
+     * it is never blended into again, so it can be shared */
+    if (!changed && overlay->blend_proxy) {
+      gst_vaapi_video_meta_set_surface_proxy (outbuf_meta,
+          overlay->blend_proxy);
+      GST_OBJECT_LOCK (overlay);
+      overlay->skipped_blends++;
+      GST_OBJECT_UNLOCK (overlay);
+      return GST_FLOW_OK;
+    }
+
     proxy = gst_vaapi_surface_proxy_new_from_pool
         (GST_VAAPI_SURFACE_POOL (overlay->blend_pool));
     if (!proxy)
-      return GST_FLOW_ERROR;
+      goto error_blend;
     gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, proxy);
     gst_vaapi_surface_proxy_unref (proxy);
+  } else {
+    /* the output surface is bound to the buffer, e.g. with DMABuf
+     * memory, so the composition can't be shared */
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, NULL);
   }
 
   outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
@@ -458,9 +549,16 @@ gst_vaapi_overlay_aggregate_frames (GstVideoAggregator * vagg,
 
   if (!gst_vaapi_blend_process (overlay->blend, outbuf_surface,
           gst_vaapi_overlay_surface_next, &generator))
-    return GST_FLOW_ERROR;
+    goto error_blend;
 
   return GST_FLOW_OK;
+
+  /* ERRORS */
+error_blend:
+  {
+    gst_vaapi_surface_proxy_replace (&overlay->blend_proxy, NULL);
+    return GST_FLOW_ERROR;
+  }
 }
 
 static GstFlowReturn
@@ -560,6 +658,24 @@ gst_vaapi_overlay_fixate_src_caps (GstAggregator * agg, GstCaps * caps)
   return gst_caps_fixate (ret);
 }
 
+static void
+gst_vaapi_overlay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiOverlay *const overlay = GST_VAAPI_OVERLAY (object);
+
+  switch (prop_id) {
+    case PROP_SKIPPED_BLENDS:
+      GST_OBJECT_LOCK (overlay);
+      g_value_set_uint64 (value, overlay->skipped_blends);
+      GST_OBJECT_UNLOCK (overlay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static GstVaapiPadPrivate *
 gst_vaapi_overlay_get_vaapi_pad_private (GstVaapiPluginBase * plugin,
     GstPad * pad)
@@ -589,6 +705,19 @@ gst_vaapi_overlay_class_init (GstVaapiOverlayClass * klass)
       GST_DEBUG_FUNCPTR (gst_vaapi_overlay_get_vaapi_pad_private);
 
   object_class->finalize = GST_DEBUG_FUNCPTR (gst_vaapi_overlay_finalize);
+  object_class->get_property =
+      GST_DEBUG_FUNCPTR (gst_vaapi_overlay_get_property);
+
+  /**
+   * GstVaapiOverlay:skipped-blends:
+   *
+   * The number of output frames for which no layer changed, so the
+   * previous composition was output again instead of blending.
+   */
+  g_object_class_install_property (object_class, PROP_SKIPPED_BLENDS,
+      g_param_spec_uint64 ("skipped-blends", "Skipped blends",
+          "Number of output frames that reused the previous composition",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   agg_class->sink_query = GST_DEBUG_FUNCPTR (gst_vaapi_overlay_sink_query);
   agg_class->src_query = GST_DEBUG_FUNCPTR (gst_vaapi_overlay_src_query);
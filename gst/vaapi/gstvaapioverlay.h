@@ -67,6 +67,11 @@ struct _GstVaapiOverlay
 
   GstVaapiBlend *blend;
   GstVaapiVideoPool *blend_pool;
+
+  /* last composited surface, reused while no layer changes */
+  GstVaapiSurfaceProxy *blend_proxy;
+  guint num_blended_layers;
+  guint64 skipped_blends;
 };
 
 struct _GstVaapiOverlayClass
@@ -82,6 +87,12 @@ struct _GstVaapiOverlaySinkPad
   gdouble alpha;
 
   GstVaapiPadPrivate *priv;
+
+  /* layer state in the last composited surface */
+  GstBuffer *blended_buffer;
+  GstVaapiRectangle blended_crop;
+  GstVaapiRectangle blended_target;
+  gdouble blended_alpha;
 };
 
 struct _GstVaapiOverlaySinkPadClass
@@ -87,7 +87,9 @@ plugin_set_display (GstVaapiPluginBase * plugin, GstVaapiDisplay * display)
   if (plugin->display_name && g_strcmp0 (plugin->display_name, display_name)) {
     GST_DEBUG_OBJECT (plugin, "incompatible display name '%s', requested '%s'",
         display_name, plugin->display_name);
-    gst_vaapi_display_replace (&plugin->display, NULL);
+    /* a display opened from the device pool is kept */
+    if (!plugin->pool_device)
+      gst_vaapi_display_replace (&plugin->display, NULL);
   } else {
     GST_INFO_OBJECT (plugin, "set display %" GST_PTR_FORMAT, display);
     gst_vaapi_display_replace (&plugin->display, display);
@@ -285,6 +287,35 @@ gst_vaapi_plugin_base_class_init (GstVaapiPluginBaseClass * klass)
   klass->get_vaapi_pad_private = default_get_vaapi_pad_private;
 }
 
+/**
+ * gst_vaapi_plugin_base_class_install_device_policy:
+ * @klass: the #GObjectClass of the element
+ *
+ * Installs the "device-policy" property, to be handled with
+ * gst_vaapi_plugin_base_set_property() and
+ * gst_vaapi_plugin_base_get_property().
+ */
+void
+gst_vaapi_plugin_base_class_install_device_policy (GObjectClass * klass)
+{
+  /**
+   * GstVaapiPluginBase:device-policy:
+   *
+   * How the element chooses the DRM render node of the display it
+   * opens by itself. With "least-loaded" or "round-robin", a display
+   * found in a neighbour element is still shared, but a new one is
+   * only offered to the neighbours, so that the other elements of
+   * the pipeline are spread over the render nodes.
+   */
+  g_object_class_install_property (klass,
+      GST_VAAPI_PLUGIN_BASE_PROP_DEVICE_POLICY,
+      g_param_spec_enum ("device-policy", "Device policy",
+          "How to choose the render node of a new display",
+          GST_VAAPI_TYPE_DEVICE_POLICY, GST_VAAPI_DEVICE_POLICY_SHARED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+}
+
 void
 gst_vaapi_plugin_base_init (GstVaapiPluginBase * plugin,
     GstDebugCategory * debug_category)
@@ -310,11 +341,48 @@ gst_vaapi_plugin_base_init (GstVaapiPluginBase * plugin,
       (g_getenv ("GST_VAAPI_ENABLE_DIRECT_RENDERING") != NULL);
 }
 
+/* Returns the device of the display to the device pool */
+static void
+plugin_release_pool_device (GstVaapiPluginBase * plugin)
+{
+  GstVaapiDevicePool *pool;
+
+  if (!plugin->pool_device)
+    return;
+
+  pool = gst_vaapi_device_pool_get_default ();
+  gst_vaapi_device_pool_update_memory (pool, plugin->pool_device,
+      -(gint64) plugin->pool_memory);
+  gst_vaapi_device_pool_release (pool, plugin->pool_device);
+
+  if (g_strcmp0 (plugin->display_name, plugin->pool_device) == 0)
+    gst_vaapi_plugin_base_set_display_name (plugin, NULL);
+  plugin->pool_device = NULL;
+  plugin->pool_memory = 0;
+}
+
+/* Accounts for the surface memory of the most recent buffer pool on
+ * the device of the display */
+static void
+plugin_update_pool_memory (GstVaapiPluginBase * plugin, gsize size,
+    guint min_buffers)
+{
+  const guint64 memory = (guint64) size * MAX (min_buffers, 1);
+
+  if (!plugin->pool_device)
+    return;
+
+  gst_vaapi_device_pool_update_memory (gst_vaapi_device_pool_get_default (),
+      plugin->pool_device, (gint64) memory - (gint64) plugin->pool_memory);
+  plugin->pool_memory = memory;
+}
+
 void
 gst_vaapi_plugin_base_finalize (GstVaapiPluginBase * plugin)
 {
   gst_vaapi_plugin_base_close (plugin);
   gst_vaapi_display_replace (&plugin->display, NULL);
+  plugin_release_pool_device (plugin);
   g_free (plugin->display_name);
 
   if (plugin->sinkpriv)
@@ -429,6 +497,23 @@ gst_vaapi_plugin_base_set_display_name (GstVaapiPluginBase * plugin,
   plugin->display_name = g_strdup (display_name);
 }
 
+/**
+ * gst_vaapi_plugin_base_set_pool_device:
+ * @plugin: a #GstVaapiPluginBase
+ * @device: the device acquired from the default #GstVaapiDevicePool
+ *
+ * Records that the display of @plugin was opened on @device, which
+ * is returned to the device pool along with the display.
+ */
+void
+gst_vaapi_plugin_base_set_pool_device (GstVaapiPluginBase * plugin,
+    const gchar * device)
+{
+  plugin_release_pool_device (plugin);
+  plugin->pool_device = device;
+  gst_vaapi_plugin_base_set_display_name (plugin, device);
+}
+
 /**
  * gst_vaapi_plugin_base_ensure_display:
  * @plugin: a #GstVaapiPluginBase
@@ -445,6 +530,7 @@ gst_vaapi_plugin_base_ensure_display (GstVaapiPluginBase * plugin)
   if (gst_vaapi_plugin_base_has_display_type (plugin, plugin->display_type_req))
     return TRUE;
   gst_vaapi_display_replace (&plugin->display, NULL);
+  plugin_release_pool_device (plugin);
 
   if (!gst_vaapi_ensure_display (GST_ELEMENT (plugin),
           plugin->display_type_req))
@@ -455,6 +541,53 @@ gst_vaapi_plugin_base_ensure_display (GstVaapiPluginBase * plugin)
   return TRUE;
 }
 
+/**
+ * gst_vaapi_plugin_base_set_property:
+ * @plugin: a #GstVaapiPluginBase
+ * @prop_id: the property id
+ * @value: the new value
+ *
+ * Sets the properties common to the elements, installed with
+ * gst_vaapi_plugin_base_class_install_device_policy().
+ *
+ * Returns: %TRUE if @prop_id is a common property
+ */
+gboolean
+gst_vaapi_plugin_base_set_property (GstVaapiPluginBase * plugin,
+    guint prop_id, const GValue * value)
+{
+  switch (prop_id) {
+    case GST_VAAPI_PLUGIN_BASE_PROP_DEVICE_POLICY:
+      plugin->device_policy = g_value_get_enum (value);
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_plugin_base_get_property:
+ * @plugin: a #GstVaapiPluginBase
+ * @prop_id: the property id
+ * @value: return location for the value
+ *
+ * Gets the properties common to the elements.
+ *
+ * Returns: %TRUE if @prop_id is a common property
+ */
+gboolean
+gst_vaapi_plugin_base_get_property (GstVaapiPluginBase * plugin,
+    guint prop_id, GValue * value)
+{
+  switch (prop_id) {
+    case GST_VAAPI_PLUGIN_BASE_PROP_DEVICE_POLICY:
+      g_value_set_enum (value, plugin->device_policy);
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
 static gboolean
 gst_vaapi_buffer_pool_caps_is_equal (GstBufferPool * pool, GstCaps * newcaps)
 {
@@ -684,6 +817,7 @@ gst_vaapi_plugin_base_create_pool (GstVaapiPluginBase * plugin, GstCaps * caps,
 
   if (!(pool = gst_vaapi_video_buffer_pool_new (plugin->display)))
     goto error_create_pool;
+  plugin_update_pool_memory (plugin, size, min_buffers);
 
   config = gst_buffer_pool_get_config (pool);
   gst_buffer_pool_config_set_params (config, caps, size, min_buffers,
@@ -30,6 +30,7 @@
 #include <gst/video/gstvideoencoder.h>
 #include <gst/video/gstvideosink.h>
 #include <gst/vaapi/gstvaapidisplay.h>
+#include "gstvaapidevicepool.h"
 
 G_BEGIN_DECLS
 
@@ -113,6 +114,9 @@ typedef struct _GstVaapiPadPrivate GstVaapiPadPrivate;
   (gst_vaapi_display_replace(&GST_VAAPI_PLUGIN_BASE_DISPLAY(plugin), \
        (new_display)))
 
+/* Well above the property ids of the elements */
+#define GST_VAAPI_PLUGIN_BASE_PROP_DEVICE_POLICY 0x1000
+
 #define GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT(parent_class) \
   static void \
   gst_vaapi_base_set_context (GstElement * element, GstContext * context) \
@@ -176,6 +180,10 @@ struct _GstVaapiPluginBase
   GstVaapiDisplayType display_type_req;
   gchar *display_name;
 
+  GstVaapiDevicePolicy device_policy;
+  const gchar *pool_device;
+  guint64 pool_memory;
+
   GstObject *gl_context;
   GstObject *gl_display;
   GstObject *gl_other_context;
@@ -212,6 +220,10 @@ G_GNUC_INTERNAL
 void
 gst_vaapi_plugin_base_class_init (GstVaapiPluginBaseClass * klass);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_plugin_base_class_install_device_policy (GObjectClass * klass);
+
 G_GNUC_INTERNAL
 void
 gst_vaapi_plugin_base_init (GstVaapiPluginBase * plugin,
@@ -244,10 +256,25 @@ void
 gst_vaapi_plugin_base_set_display_name (GstVaapiPluginBase * plugin,
     const gchar * display_name);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_plugin_base_set_pool_device (GstVaapiPluginBase * plugin,
+    const gchar * device);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_plugin_base_ensure_display (GstVaapiPluginBase * plugin);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_plugin_base_set_property (GstVaapiPluginBase * plugin,
+    guint prop_id, const GValue * value);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_plugin_base_get_property (GstVaapiPluginBase * plugin,
+    guint prop_id, GValue * value);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_plugin_base_set_caps (GstVaapiPluginBase * plugin, GstCaps * incaps,
@@ -371,6 +371,32 @@ no_valid_gl_display:
 #endif
 }
 
+#if USE_DRM
+/* Opens a DRM display on the render node chosen by the device pool */
+static GstVaapiDisplay *
+gst_vaapi_create_display_from_device_pool (GstVaapiPluginBase * plugin)
+{
+  GstVaapiDevicePool *const pool = gst_vaapi_device_pool_get_default ();
+  GstVaapiDisplay *display;
+  const gchar *device;
+
+  device = gst_vaapi_device_pool_acquire (pool, plugin->device_policy);
+  if (!device)
+    return NULL;
+
+  display = gst_vaapi_display_drm_new (device);
+  if (!display) {
+    GST_WARNING_OBJECT (plugin, "failed to open %s", device);
+    gst_vaapi_device_pool_release (pool, device);
+    return NULL;
+  }
+
+  GST_INFO_OBJECT (plugin, "using %s from the device pool", device);
+  gst_vaapi_plugin_base_set_pool_device (plugin, device);
+  return display;
+}
+#endif
+
 gboolean
 gst_vaapi_ensure_display (GstElement * element, GstVaapiDisplayType type)
 {
@@ -399,6 +425,20 @@ gst_vaapi_ensure_display (GstElement * element, GstVaapiDisplayType type)
       gst_vaapi_plugin_base_set_display_type (plugin,
           GST_VAAPI_DISPLAY_TYPE_ANY);
   }
+#if USE_DRM
+  if (!display && plugin->device_policy != GST_VAAPI_DEVICE_POLICY_SHARED
+      && (type == GST_VAAPI_DISPLAY_TYPE_ANY
+          || type == GST_VAAPI_DISPLAY_TYPE_DRM)) {
+    display = gst_vaapi_create_display_from_device_pool (plugin);
+    if (display) {
+      /* Not posted on the bus, so that the other elements of the
+       * pipeline choose their own device */
+      gst_vaapi_video_context_set_local (element, display);
+      gst_object_unref (display);
+      return TRUE;
+    }
+  }
+#endif
   if (!display)
     display = gst_vaapi_create_display (type, plugin->display_name);
   if (!display)
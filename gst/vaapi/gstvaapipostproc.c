@@ -27,6 +27,9 @@
  * vaapipostproc consists in various postprocessing algorithms to be
  * applied to VA surfaces.
  *
+ * When the driver lacks video processing, vaapipostproc still scales,
+ * crops and converts formats, on the CPU.
+ *
  * ## Example launch line
  *
  * |[
@@ -38,6 +41,7 @@
 #include <gst/video/video.h>
 
 #include <gst/vaapi/gstvaapivalue.h>
+#include <gst/vaapi/gstvaapihdrscenemeta.h>
 
 #include "gstvaapipostproc.h"
 #include "gstvaapipostprocutil.h"
@@ -130,6 +134,7 @@ enum
   PROP_CROP_TOP,
   PROP_CROP_BOTTOM,
   PROP_HDR_TONE_MAP,
+  PROP_ASYNC_DEPTH,
 #ifndef GST_REMOVE_DEPRECATED
   PROP_SKIN_TONE_ENHANCEMENT,
 #endif
@@ -193,16 +198,30 @@ ds_reset (GstVaapiDeinterlaceState * ds)
   for (i = 0; i < G_N_ELEMENTS (ds->buffers); i++)
     gst_buffer_replace (&ds->buffers[i], NULL);
   ds->buffers_index = 0;
+  ds->surfaces_index = 0;
   ds->num_surfaces = 0;
   ds->deint = FALSE;
   ds->tff = FALSE;
 }
 
+/* @surface is the surface of @buf, recorded along with it so that the
+ * references don't need to be looked up again for each frame */
 static void
-ds_add_buffer (GstVaapiDeinterlaceState * ds, GstBuffer * buf)
+ds_add_buffer (GstVaapiDeinterlaceState * ds, GstBuffer * buf,
+    GstVaapiSurface * surface)
 {
+  const guint n = G_N_ELEMENTS (ds->buffers);
+
   gst_buffer_replace (&ds->buffers[ds->buffers_index], buf);
-  ds->buffers_index = (ds->buffers_index + 1) % G_N_ELEMENTS (ds->buffers);
+  ds->buffers_index = (ds->buffers_index + 1) % n;
+
+  /* The surfaces are stored from the most recent to the oldest one,
+     and mirrored so that any n consecutive slots are valid */
+  ds->surfaces_index = (ds->surfaces_index + n - 1) % n;
+  ds->surfaces[ds->surfaces_index] = surface;
+  ds->surfaces[ds->surfaces_index + n] = surface;
+  if (ds->num_surfaces < n)
+    ds->num_surfaces++;
 }
 
 static inline GstBuffer *
@@ -216,21 +235,112 @@ ds_get_buffer (GstVaapiDeinterlaceState * ds, guint index)
   return ds->buffers[n % G_N_ELEMENTS (ds->buffers)];
 }
 
-static void
-ds_set_surfaces (GstVaapiDeinterlaceState * ds)
+/* Returns the reference surfaces, from the most recent to the oldest
+ * one. There are ds->num_surfaces of them */
+static inline GstVaapiSurface **
+ds_get_surfaces (GstVaapiDeinterlaceState * ds)
 {
-  GstVaapiVideoMeta *meta;
+  return &ds->surfaces[ds->surfaces_index];
+}
+
+static gboolean
+ds_set_surfaces (GstVaapiDeinterlaceState * ds, GstVaapiFilter * filter)
+{
+  return gst_vaapi_filter_set_deinterlacing_references (filter,
+      ds_get_surfaces (ds), ds->num_surfaces, NULL, 0);
+}
+
+/* How long to wait for downstream to give surfaces back, when the
+ * memory budget of the display is exhausted */
+#define OUTPUT_SURFACE_WAIT_INTERVAL (100 * GST_MSECOND)
+#define OUTPUT_SURFACE_WAIT_RETRIES 20
+
+/* Makes sure the @meta has a surface to render into. Over the memory
+ * budget, this waits for surfaces to be released, either back to the
+ * pool or to the driver */
+static gboolean
+ensure_output_surface_proxy (GstVaapiPostproc * postproc,
+    GstVaapiVideoMeta * meta)
+{
+  GstVaapiSurfaceProxy *proxy;
+  GError *error;
   guint i;
 
-  ds->num_surfaces = 0;
-  for (i = 0; i < G_N_ELEMENTS (ds->buffers); i++) {
-    GstBuffer *const buf = ds_get_buffer (ds, i);
-    if (!buf)
+  if (gst_vaapi_video_meta_get_surface_proxy (meta))
+    return TRUE;
+
+  for (i = 0;; i++) {
+    /* the pool may fail before it gets to reserve any memory */
+    error = gst_vaapi_display_take_allocation_error ();
+    g_clear_error (&error);
+
+    proxy = gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+        (postproc->filter_pool));
+    if (proxy)
       break;
 
-    meta = gst_buffer_get_vaapi_video_meta (buf);
-    ds->surfaces[ds->num_surfaces++] = gst_vaapi_video_meta_get_surface (meta);
+    error = gst_vaapi_display_take_allocation_error ();
+    if (!g_error_matches (error, GST_VAAPI_DISPLAY_ERROR,
+            GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED)
+        || i == OUTPUT_SURFACE_WAIT_RETRIES) {
+      if (error)
+        GST_ERROR_OBJECT (postproc, "%s", error->message);
+      g_clear_error (&error);
+      return FALSE;
+    }
+    g_error_free (error);
+
+    GST_DEBUG_OBJECT (postproc, "waiting for surface memory");
+    gst_vaapi_display_wait_for_memory (GST_VAAPI_PLUGIN_BASE_DISPLAY
+        (postproc), GST_VIDEO_INFO_SIZE (&postproc->filter_pool_info),
+        OUTPUT_SURFACE_WAIT_INTERVAL);
   }
+  gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+  return TRUE;
+}
+
+/* Releases the in-flight VPP jobs, without waiting for them */
+static void
+pending_jobs_clear (GstVaapiPostproc * postproc)
+{
+  g_queue_clear_full (&postproc->pending_jobs,
+      (GDestroyNotify) gst_vaapi_surface_proxy_unref);
+}
+
+/* Records the VPP job just submitted to the surface of @buf. In async
+ * mode, the job is left running and only the oldest one is waited
+ * for once more than async-depth jobs are in flight. Consumers get
+ * their own VA work on the surface ordered by the driver, and CPU
+ * mappings wait for it through vaGetImage() */
+static gboolean
+track_vpp_job (GstVaapiPostproc * postproc, GstBuffer * buf)
+{
+  GstVaapiVideoMeta *const meta = gst_buffer_get_vaapi_video_meta (buf);
+  GstVaapiSurfaceProxy *proxy;
+
+  if (postproc->async_depth == 0 || !meta)
+    return TRUE;
+
+  proxy = gst_vaapi_video_meta_get_surface_proxy (meta);
+  if (!proxy)
+    return TRUE;
+
+  g_queue_push_tail (&postproc->pending_jobs,
+      gst_vaapi_surface_proxy_ref (proxy));
+
+  while (g_queue_get_length (&postproc->pending_jobs) >
+      postproc->async_depth) {
+    GstVaapiSurfaceProxy *const oldest =
+        g_queue_pop_head (&postproc->pending_jobs);
+    gboolean success;
+
+    success = gst_vaapi_surface_sync (GST_VAAPI_SURFACE_PROXY_SURFACE (oldest));
+    gst_vaapi_surface_proxy_unref (oldest);
+    if (!success)
+      return FALSE;
+  }
+  return TRUE;
 }
 
 static GstVaapiFilterOpInfo *
@@ -258,17 +368,26 @@ gst_vaapipostproc_ensure_display (GstVaapiPostproc * postproc)
 static gboolean
 gst_vaapipostproc_ensure_filter (GstVaapiPostproc * postproc)
 {
+  GstVaapiDisplay *display;
+
   if (postproc->filter)
     return TRUE;
 
   if (!gst_vaapipostproc_ensure_display (postproc))
     return FALSE;
+  display = GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc);
 
   gst_caps_replace (&postproc->allowed_srcpad_caps, NULL);
   gst_caps_replace (&postproc->allowed_sinkpad_caps, NULL);
 
-  postproc->filter =
-      gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc));
+  postproc->filter = gst_vaapi_filter_new (display);
+
+  /* Without VPP, scale and convert formats on the CPU. The other
+   * filters are not available */
+  if (!postproc->filter && !gst_vaapi_display_has_video_processing (display)) {
+    GST_INFO_OBJECT (postproc, "no VPP, using the software fallback");
+    postproc->filter = gst_vaapi_filter_new_software (display);
+  }
   if (!postproc->filter)
     return FALSE;
   return TRUE;
@@ -331,6 +450,7 @@ static void
 gst_vaapipostproc_destroy (GstVaapiPostproc * postproc)
 {
   ds_reset (&postproc->deinterlace_state);
+  pending_jobs_clear (postproc);
   gst_vaapipostproc_destroy_filter (postproc);
 
   gst_caps_replace (&postproc->allowed_sinkpad_caps, NULL);
@@ -360,6 +480,7 @@ gst_vaapipostproc_stop (GstBaseTransform * trans)
 
   g_mutex_lock (&postproc->postproc_lock);
   ds_reset (&postproc->deinterlace_state);
+  pending_jobs_clear (postproc);
   gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (postproc));
 
   postproc->field_duration = GST_CLOCK_TIME_NONE;
@@ -595,6 +716,22 @@ fail_configure_hdr_tone_map:
   }
 }
 
+/* Applies the light levels of the scene starting with @buf, if any.
+ * The filter only uploads them when they changed */
+static void
+update_hdr_tone_map_scene (GstVaapiPostproc * postproc, GstBuffer * buf)
+{
+  GstVideoContentLightLevel linfo;
+
+  if (!(postproc->flags & GST_VAAPI_POSTPROC_FLAG_HDR_TONE_MAP))
+    return;
+  if (!gst_buffer_get_vaapi_hdr_scene (buf, &linfo))
+    return;
+
+  if (!gst_vaapi_filter_set_hdr_tone_map_scene_meta (postproc->filter, &linfo))
+    GST_WARNING_OBJECT (postproc, "failed to update HDR scene light levels");
+}
+
 static gboolean
 check_filter_update (GstVaapiPostproc * postproc)
 {
@@ -853,15 +990,14 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
   GstVaapiVideoMeta *inbuf_meta, *outbuf_meta;
-  GstVaapiSurface *inbuf_surface, *outbuf_surface;
-  GstVaapiSurfaceProxy *proxy;
+  GstVaapiSurface *inbuf_surface, *outbuf_surface, *field_surface;
   GstVaapiFilterStatus status;
   GstClockTime timestamp;
   GstFlowReturn ret;
   GstBuffer *fieldbuf;
   GstVaapiDeinterlaceMethod deint_method;
   guint flags, deint_flags;
-  gboolean tff, deint, deint_refs, deint_changed, discont;
+  gboolean tff, deint, deint_refs, deint_changed, discont, done = FALSE;
   const GstVideoCropMeta *crop_meta;
   GstVaapiRectangle *crop_rect = NULL;
   GstVaapiRectangle tmp_rect;
@@ -871,6 +1007,8 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     goto error_invalid_buffer;
   inbuf_surface = gst_vaapi_video_meta_get_surface (inbuf_meta);
 
+  update_hdr_tone_map_scene (postproc, inbuf);
+
   if (use_vpp_crop (postproc)) {
     crop_rect = &tmp_rect;
     crop_rect->x = postproc->crop_left;
@@ -930,16 +1068,9 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     outbuf_meta = gst_buffer_get_vaapi_video_meta (fieldbuf);
     if (!outbuf_meta)
       goto error_create_meta;
-
-    if (!gst_vaapi_video_meta_get_surface_proxy (outbuf_meta)) {
-      proxy =
-          gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
-          (postproc->filter_pool));
-      if (!proxy)
-        goto error_create_proxy;
-      gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
-      gst_vaapi_surface_proxy_unref (proxy);
-    }
+    if (!ensure_output_surface_proxy (postproc, outbuf_meta))
+      goto error_create_proxy;
+    field_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
 
     if (deint) {
       deint_flags = (tff ? GST_VAAPI_DEINTERLACE_FLAG_TOPFIELD : 0);
@@ -955,12 +1086,8 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
         deint_refs = deint_method_is_advanced (deint_method);
       }
 
-      if (deint_refs) {
-        ds_set_surfaces (ds);
-        if (!gst_vaapi_filter_set_deinterlacing_references (postproc->filter,
-                ds->surfaces, ds->num_surfaces, NULL, 0))
-          goto error_op_deinterlace;
-      }
+      if (deint_refs && !ds_set_surfaces (ds, postproc->filter))
+        goto error_op_deinterlace;
     } else if (deint_changed) {
       // Reset internal filter to non-deinterlacing mode
       deint_method = GST_VAAPI_DEINTERLACE_METHOD_NONE;
@@ -969,12 +1096,27 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
         goto error_op_deinterlace;
     }
 
-    outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
     gst_vaapi_filter_set_cropping_rectangle (postproc->filter, crop_rect);
-    status = gst_vaapi_filter_process (postproc->filter, inbuf_surface,
-        outbuf_surface, flags);
+    if (deint) {
+      /* Both fields are rendered at once, the second one into outbuf */
+      outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+      if (!outbuf_meta)
+        goto error_create_meta;
+      if (!ensure_output_surface_proxy (postproc, outbuf_meta))
+        goto error_create_proxy;
+
+      outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
+      status = gst_vaapi_filter_process_fields (postproc->filter,
+          inbuf_surface, field_surface, outbuf_surface, flags);
+      done = TRUE;
+    } else {
+      status = gst_vaapi_filter_process (postproc->filter, inbuf_surface,
+          field_surface, flags);
+    }
     if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
       goto error_process_vpp;
+    if (!track_vpp_job (postproc, fieldbuf))
+      goto error_sync_vpp;
 
     copy_metadata (postproc, fieldbuf, inbuf);
     GST_BUFFER_TIMESTAMP (fieldbuf) = timestamp;
@@ -994,43 +1136,37 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
   fieldbuf = NULL;
 
   /* Second field */
-  outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
-  if (!outbuf_meta)
-    goto error_create_meta;
-
-  if (!gst_vaapi_video_meta_get_surface_proxy (outbuf_meta)) {
-    proxy =
-        gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
-        (postproc->filter_pool));
-    if (!proxy)
+  if (!done) {
+    outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+    if (!outbuf_meta)
+      goto error_create_meta;
+    if (!ensure_output_surface_proxy (postproc, outbuf_meta))
       goto error_create_proxy;
-    gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
-    gst_vaapi_surface_proxy_unref (proxy);
-  }
 
-  if (deint) {
-    deint_flags = (tff ? 0 : GST_VAAPI_DEINTERLACE_FLAG_TOPFIELD);
-    if (tff)
-      deint_flags |= GST_VAAPI_DEINTERLACE_FLAG_TFF;
-    if (!gst_vaapi_filter_set_deinterlacing (postproc->filter,
-            deint_method, deint_flags))
-      goto error_op_deinterlace;
+    if (deint) {
+      deint_flags = (tff ? 0 : GST_VAAPI_DEINTERLACE_FLAG_TOPFIELD);
+      if (tff)
+        deint_flags |= GST_VAAPI_DEINTERLACE_FLAG_TFF;
+      if (!gst_vaapi_filter_set_deinterlacing (postproc->filter,
+              deint_method, deint_flags))
+        goto error_op_deinterlace;
 
-    if (deint_refs
-        && !gst_vaapi_filter_set_deinterlacing_references (postproc->filter,
-            ds->surfaces, ds->num_surfaces, NULL, 0))
+      if (deint_refs && !ds_set_surfaces (ds, postproc->filter))
+        goto error_op_deinterlace;
+    } else if (deint_changed
+        && !gst_vaapi_filter_set_deinterlacing (postproc->filter, deint_method,
+            0))
       goto error_op_deinterlace;
-  } else if (deint_changed
-      && !gst_vaapi_filter_set_deinterlacing (postproc->filter, deint_method,
-          0))
-    goto error_op_deinterlace;
-
-  outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
-  gst_vaapi_filter_set_cropping_rectangle (postproc->filter, crop_rect);
-  status = gst_vaapi_filter_process (postproc->filter, inbuf_surface,
-      outbuf_surface, flags);
-  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
-    goto error_process_vpp;
+
+    outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
+    gst_vaapi_filter_set_cropping_rectangle (postproc->filter, crop_rect);
+    status = gst_vaapi_filter_process (postproc->filter, inbuf_surface,
+        outbuf_surface, flags);
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+      goto error_process_vpp;
+  }
+  if (!track_vpp_job (postproc, outbuf))
+    goto error_sync_vpp;
 
   if (!(postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE))
     gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
@@ -1049,7 +1185,7 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
       gst_buffer_get_video_crop_meta (outbuf));
 
   if (deint && deint_refs)
-    ds_add_buffer (ds, inbuf);
+    ds_add_buffer (ds, inbuf, inbuf_surface);
   postproc->use_vpp = TRUE;
   return GST_FLOW_OK;
 
@@ -1089,6 +1225,12 @@ error_process_vpp:
     gst_buffer_replace (&fieldbuf, NULL);
     return GST_FLOW_ERROR;
   }
+error_sync_vpp:
+  {
+    GST_ERROR_OBJECT (postproc, "failed to wait for VPP completion");
+    gst_buffer_replace (&fieldbuf, NULL);
+    return GST_FLOW_ERROR;
+  }
 error_copy_buffer:
   {
     GST_ERROR_OBJECT (postproc, "failed to copy field buffer to dumb buffer");
@@ -1608,8 +1750,8 @@ ensure_buffer_pool (GstVaapiPostproc * postproc, GstVideoInfo * vi)
   postproc->filter_pool_info = *vi;
 
   pool =
-      gst_vaapi_surface_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc),
-      &postproc->filter_pool_info, 0);
+      gst_vaapi_surface_pool_new_shared (GST_VAAPI_PLUGIN_BASE_DISPLAY
+      (postproc), &postproc->filter_pool_info, 0);
   if (!pool)
     return FALSE;
 
@@ -2147,8 +2289,13 @@ gst_vaapipostproc_set_property (GObject * object,
     case PROP_HDR_TONE_MAP:
       postproc->hdr_tone_map = g_value_get_enum (value);
       break;
+    case PROP_ASYNC_DEPTH:
+      postproc->async_depth = g_value_get_uint (value);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_vaapi_plugin_base_set_property (GST_VAAPI_PLUGIN_BASE (object),
+              prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
   g_mutex_unlock (&postproc->postproc_lock);
@@ -2232,8 +2379,13 @@ gst_vaapipostproc_get_property (GObject * object,
     case PROP_HDR_TONE_MAP:
       g_value_set_enum (value, postproc->hdr_tone_map);
       break;
+    case PROP_ASYNC_DEPTH:
+      g_value_set_uint (value, postproc->async_depth);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_vaapi_plugin_base_get_property (GST_VAAPI_PLUGIN_BASE (object),
+              prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
   g_mutex_unlock (&postproc->postproc_lock);
@@ -2302,6 +2454,27 @@ gst_vaapipostproc_class_init (GstVaapiPostprocClass * klass)
           GST_VAAPI_HDR_TONE_MAP_AUTO,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstVaapiPostproc:async-depth:
+   *
+   * Maximum number of VPP jobs left running after their output buffer
+   * is pushed. Once more are in flight, the oldest one is waited for.
+   * Consumers submitting more VA work on the surface, such as the
+   * encoders, get it ordered by the driver, while mapping the buffer
+   * waits for the job. Zero waits for no job at all, so the jobs in
+   * flight are only bounded by the output buffer pool.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_ASYNC_DEPTH,
+      g_param_spec_uint ("async-depth",
+          "Async depth",
+          "Maximum number of VPP jobs in flight (0 = unbounded)",
+          0, 16, DEFAULT_ASYNC_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_vaapi_plugin_base_class_install_device_policy (object_class);
+
   /**
    * GstVaapiPostproc:deinterlace-mode:
    *
@@ -2618,6 +2791,8 @@ gst_vaapipostproc_init (GstVaapiPostproc * postproc)
   g_mutex_init (&postproc->postproc_lock);
   postproc->format = DEFAULT_FORMAT;
   postproc->hdr_tone_map = GST_VAAPI_HDR_TONE_MAP_AUTO;
+  postproc->async_depth = DEFAULT_ASYNC_DEPTH;
+  g_queue_init (&postproc->pending_jobs);
   postproc->deinterlace_mode = DEFAULT_DEINTERLACE_MODE;
   postproc->deinterlace_method = DEFAULT_DEINTERLACE_METHOD;
   postproc->field_duration = GST_CLOCK_TIME_NONE;
@@ -134,8 +134,10 @@ typedef enum
  * GstVaapiDeinterlaceState:
  * @buffers: history buffer, maintained as a cyclic array
  * @buffers_index: next free slot in the history buffer
- * @surfaces: array of surfaces used as references
- * @num_surfaces: number of active surfaces in that array
+ * @surfaces: surfaces of the history buffers, maintained as a cyclic
+ *   array stored twice so that the references are always contiguous
+ * @surfaces_index: slot of the most recent surface
+ * @num_surfaces: number of surfaces used as references
  * @deint: flag: previous buffers were interlaced?
  * @tff: flag: previous buffers were organized as top-field-first?
  *
@@ -145,7 +147,8 @@ struct _GstVaapiDeinterlaceState
 {
   GstBuffer *buffers[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
   guint buffers_index;
-  GstVaapiSurface *surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  GstVaapiSurface *surfaces[2 * GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  guint surfaces_index;
   guint num_surfaces;
   guint deint:1;
   guint tff:1;
@@ -214,6 +217,10 @@ struct _GstVaapiPostproc
   /* color balance's channel list */
   GList *cb_channels;
   gboolean same_caps;
+
+  /* VPP jobs submitted but not waited for, oldest first */
+  guint async_depth;
+  GQueue pending_jobs;
 };
 
 struct _GstVaapiPostprocClass
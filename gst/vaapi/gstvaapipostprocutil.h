@@ -31,6 +31,7 @@ G_BEGIN_DECLS
 #define DEFAULT_FORMAT                  GST_VIDEO_FORMAT_ENCODED
 #define DEFAULT_DEINTERLACE_MODE        GST_VAAPI_DEINTERLACE_MODE_AUTO
 #define DEFAULT_DEINTERLACE_METHOD      GST_VAAPI_DEINTERLACE_METHOD_BOB
+#define DEFAULT_ASYNC_DEPTH             0
 
 GstCaps *gst_vaapipostproc_transform_srccaps (GstVaapiPostproc * postproc);
 
@@ -0,0 +1,775 @@
+/*
+ *  gstvaapiscaleladder.c - VA-API one-input, many-outputs scaler
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+/**
+ * SECTION:element-vaapiscaleladder
+ * @title: vaapiscaleladder
+ * @short_description: A VA-API based scaler with many outputs
+ *
+ * vaapiscaleladder produces several renditions of the same input,
+ * one per requested src pad, e.g. for the encodings of an adaptive
+ * bitrate ladder. It replaces a tee followed by one vaapipostproc
+ * per output: the input surface is processed once for all the
+ * renditions, in a single video processing submission.
+ *
+ * The size of each output is negotiated with its downstream
+ * element. The outputs are always VA surfaces, and they keep the
+ * format and the colorimetry of the input when downstream accepts
+ * them.
+ *
+ * ## Example launch line
+ *
+ * |[
+ *   gst-launch-1.0 filesrc location=input.mp4 ! parsebin ! vaapih264dec \
+ *     ! vaapiscaleladder name=ladder \
+ *     ladder. ! video/x-raw(memory:VASurface),width=1920,height=1080 \
+ *       ! queue ! vaapih264enc bitrate=6000 ! fakesink \
+ *     ladder. ! video/x-raw(memory:VASurface),width=1280,height=720 \
+ *       ! queue ! vaapih264enc bitrate=3000 ! fakesink \
+ *     ladder. ! video/x-raw(memory:VASurface),width=640,height=360 \
+ *       ! queue ! vaapih264enc bitrate=800 ! fakesink
+ * ]|
+ */
+
+#include "gstcompat.h"
+#include "gstvaapiscaleladder.h"
+#include "gstvaapipluginutil.h"
+#include "gstvaapivideobufferpool.h"
+#include "gstvaapivideometa.h"
+
+#define GST_PLUGIN_NAME "vaapiscaleladder"
+#define GST_PLUGIN_DESC "A VA-API scaler with many outputs"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapi_scale_ladder);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapi_scale_ladder
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+/* Default templates */
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ";"
+  GST_VIDEO_CAPS_MAKE (GST_VAAPI_FORMATS_ALL);
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_src_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_sink_caps_str));
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_src_caps_str));
+/* *INDENT-ON* */
+
+G_DEFINE_TYPE (GstVaapiScaleLadderSrcPad, gst_vaapi_scale_ladder_src_pad,
+    GST_TYPE_PAD);
+
+static void
+gst_vaapi_scale_ladder_src_pad_finalize (GObject * object)
+{
+  gst_vaapi_pad_private_finalize (GST_VAAPI_SCALE_LADDER_SRC_PAD
+      (object)->priv);
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_src_pad_parent_class)->finalize
+      (object);
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_class_init (GstVaapiScaleLadderSrcPadClass *
+    klass)
+{
+  GObjectClass *const gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_vaapi_scale_ladder_src_pad_finalize;
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_init (GstVaapiScaleLadderSrcPad * pad)
+{
+  pad->priv = gst_vaapi_pad_private_new ();
+}
+
+G_DEFINE_TYPE_WITH_CODE (GstVaapiScaleLadder, gst_vaapi_scale_ladder,
+    GST_TYPE_ELEMENT, GST_VAAPI_PLUGIN_BASE_INIT_INTERFACES);
+
+GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapi_scale_ladder_parent_class);
+
+static void
+reset_src_pad_private (GstVaapiPadPrivate * priv)
+{
+  if (priv->buffer_pool)
+    gst_buffer_pool_set_active (priv->buffer_pool, FALSE);
+  gst_vaapi_pad_private_reset (priv);
+}
+
+static gboolean
+_reset_srcpad_private (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  reset_src_pad_private (GST_VAAPI_SCALE_LADDER_SRC_PAD (pad)->priv);
+
+  return TRUE;
+}
+
+/* Picks the output caps of @srcpad among those accepted downstream,
+ * as close as possible to the input caps */
+static GstCaps *
+gst_vaapi_scale_ladder_fixate_src_caps (GstVaapiScaleLadder * ladder,
+    GstPad * srcpad)
+{
+  GstVideoInfo *const vip = GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder);
+  GstCaps *templ, *caps;
+  GstStructure *s;
+  gchar *colorimetry;
+  gint width, height, par_n, par_d;
+
+  templ = gst_pad_get_pad_template_caps (srcpad);
+  caps = gst_pad_peer_query_caps (srcpad, templ);
+  gst_caps_unref (templ);
+
+  if (gst_caps_is_empty (caps)) {
+    gst_caps_unref (caps);
+    return NULL;
+  }
+
+  caps = gst_caps_truncate (gst_caps_make_writable (caps));
+  s = gst_caps_get_structure (caps, 0);
+
+  gst_structure_fixate_field_string (s, "format",
+      gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (vip)));
+
+  /* the filter has a single output colorimetry for all the outputs,
+   * which is the input one: scaling doesn't convert it */
+  colorimetry =
+      gst_video_colorimetry_to_string (&GST_VIDEO_INFO_COLORIMETRY (vip));
+  if (colorimetry) {
+    if (gst_structure_has_field (s, "colorimetry"))
+      gst_structure_fixate_field_string (s, "colorimetry", colorimetry);
+    else
+      gst_structure_set (s, "colorimetry", G_TYPE_STRING, colorimetry, NULL);
+    g_free (colorimetry);
+  }
+
+  /* keep the input aspect ratio when downstream only constrains one
+   * dimension */
+  if (gst_structure_get_int (s, "height", &height)
+      && !gst_structure_get_int (s, "width", &width)) {
+    gst_structure_fixate_field_nearest_int (s, "width",
+        gst_util_uint64_scale_int (height, GST_VIDEO_INFO_WIDTH (vip),
+            GST_VIDEO_INFO_HEIGHT (vip)));
+  } else {
+    gst_structure_fixate_field_nearest_int (s, "width",
+        GST_VIDEO_INFO_WIDTH (vip));
+    gst_structure_get_int (s, "width", &width);
+    gst_structure_fixate_field_nearest_int (s, "height",
+        gst_util_uint64_scale_int (width, GST_VIDEO_INFO_HEIGHT (vip),
+            GST_VIDEO_INFO_WIDTH (vip)));
+  }
+  gst_structure_get_int (s, "width", &width);
+  gst_structure_get_int (s, "height", &height);
+
+  if (GST_VIDEO_INFO_FPS_N (vip) > 0) {
+    gst_structure_fixate_field_nearest_fraction (s, "framerate",
+        GST_VIDEO_INFO_FPS_N (vip), GST_VIDEO_INFO_FPS_D (vip));
+  }
+
+  /* preserve the display aspect ratio */
+  if (gst_util_fraction_multiply (GST_VIDEO_INFO_PAR_N (vip),
+          GST_VIDEO_INFO_PAR_D (vip),
+          GST_VIDEO_INFO_WIDTH (vip) * height,
+          GST_VIDEO_INFO_HEIGHT (vip) * width, &par_n, &par_d)) {
+    if (gst_structure_has_field (s, "pixel-aspect-ratio")) {
+      gst_structure_fixate_field_nearest_fraction (s, "pixel-aspect-ratio",
+          par_n, par_d);
+    } else {
+      gst_structure_set (s, "pixel-aspect-ratio", GST_TYPE_FRACTION, par_n,
+          par_d, NULL);
+    }
+  }
+
+  return gst_caps_fixate (caps);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_ensure_src_pool (GstVaapiScaleLadder * ladder,
+    GstVaapiPadPrivate * srcpriv)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  if (srcpriv->buffer_pool)
+    return TRUE;
+
+  pool = gst_vaapi_video_buffer_pool_new (GST_VAAPI_PLUGIN_BASE_DISPLAY
+      (ladder));
+  if (!pool)
+    goto error_create_pool;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, srcpriv->caps,
+      GST_VIDEO_INFO_SIZE (&srcpriv->info), 0, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VAAPI_VIDEO_META);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error_pool_config;
+  if (!gst_buffer_pool_set_active (pool, TRUE))
+    goto error_pool_config;
+
+  srcpriv->buffer_pool = pool;
+  return TRUE;
+
+  /* ERRORS */
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to create buffer pool");
+    return FALSE;
+  }
+error_pool_config:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to configure buffer pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_vaapi_scale_ladder_negotiate_src_pad (GstVaapiScaleLadder * ladder,
+    GstPad * srcpad)
+{
+  GstVaapiPadPrivate *const srcpriv =
+      GST_VAAPI_SCALE_LADDER_SRC_PAD (srcpad)->priv;
+  GstCaps *caps;
+
+  caps = gst_vaapi_scale_ladder_fixate_src_caps (ladder, srcpad);
+  if (!caps)
+    goto error_no_caps;
+
+  if (srcpriv->caps && gst_caps_is_equal (caps, srcpriv->caps)) {
+    gst_caps_unref (caps);
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT (srcpad, "output caps %" GST_PTR_FORMAT, caps);
+
+  reset_src_pad_private (srcpriv);
+  if (!gst_video_info_from_caps (&srcpriv->info, caps))
+    goto error_invalid_caps;
+  gst_caps_replace (&srcpriv->caps, caps);
+
+  if (!gst_video_colorimetry_is_equal (&GST_VIDEO_INFO_COLORIMETRY
+          (&srcpriv->info),
+          &GST_VIDEO_INFO_COLORIMETRY (GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO
+              (ladder)))) {
+    GST_WARNING_OBJECT (srcpad, "downstream colorimetry differs from the "
+        "input one, which is kept");
+  }
+
+  if (!gst_pad_push_event (srcpad, gst_event_new_caps (caps)))
+    goto error_not_negotiated;
+  gst_caps_unref (caps);
+
+  return gst_vaapi_scale_ladder_ensure_src_pool (ladder, srcpriv);
+
+  /* ERRORS */
+error_no_caps:
+  {
+    GST_WARNING_OBJECT (srcpad, "no output caps accepted downstream");
+    return FALSE;
+  }
+error_invalid_caps:
+  {
+    GST_WARNING_OBJECT (srcpad, "invalid output caps %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+error_not_negotiated:
+  {
+    GST_WARNING_OBJECT (srcpad, "downstream refused caps %" GST_PTR_FORMAT,
+        caps);
+    gst_caps_unref (caps);
+    reset_src_pad_private (srcpriv);
+    return FALSE;
+  }
+}
+
+static GstFlowReturn
+gst_vaapi_scale_ladder_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * inbuf)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstVaapiFilterTarget *targets = NULL;
+  GstVaapiRectangle crop_rect;
+  GstVideoCropMeta *crop_meta;
+  GstVaapiVideoMeta *inbuf_meta;
+  GstVaapiFilterStatus status;
+  GstBuffer *buf, **outbufs = NULL;
+  GstPad **srcpads = NULL;
+  GstFlowReturn ret, pad_ret;
+  guint i, num_pads = 0, num_targets = 0;
+  GList *l;
+
+  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, inbuf, &buf);
+  gst_buffer_unref (inbuf);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  inbuf_meta = gst_buffer_get_vaapi_video_meta (buf);
+  if (!inbuf_meta)
+    goto error_invalid_buffer;
+
+  GST_OBJECT_LOCK (ladder);
+  num_pads = GST_ELEMENT (ladder)->numsrcpads;
+  srcpads = g_new (GstPad *, num_pads);
+  for (i = 0, l = GST_ELEMENT (ladder)->srcpads; l; i++, l = l->next)
+    srcpads[i] = gst_object_ref (l->data);
+  GST_OBJECT_UNLOCK (ladder);
+
+  if (num_pads == 0) {
+    ret = GST_FLOW_NOT_LINKED;
+    goto done;
+  }
+
+  crop_meta = gst_buffer_get_video_crop_meta (buf);
+  if (crop_meta) {
+    crop_rect.x = crop_meta->x;
+    crop_rect.y = crop_meta->y;
+    crop_rect.width = crop_meta->width;
+    crop_rect.height = crop_meta->height;
+  }
+
+  outbufs = g_new0 (GstBuffer *, num_pads);
+  targets = g_new0 (GstVaapiFilterTarget, num_pads);
+
+  for (i = 0; i < num_pads; i++) {
+    GstPad *const srcpad = srcpads[i];
+    GstVaapiPadPrivate *const srcpriv =
+        GST_VAAPI_SCALE_LADDER_SRC_PAD (srcpad)->priv;
+    GstVaapiVideoMeta *outbuf_meta;
+
+    /* don't spend any processing time on unlinked outputs */
+    if (!gst_pad_is_linked (srcpad))
+      continue;
+
+    if (ladder->renegotiate || gst_pad_check_reconfigure (srcpad)
+        || !srcpriv->buffer_pool) {
+      if (!gst_vaapi_scale_ladder_negotiate_src_pad (ladder, srcpad)) {
+        gst_pad_mark_reconfigure (srcpad);
+        if (GST_PAD_IS_FLUSHING (srcpad))
+          continue;
+        ret = GST_FLOW_NOT_NEGOTIATED;
+        goto done;
+      }
+    }
+
+    ret = gst_buffer_pool_acquire_buffer (srcpriv->buffer_pool, &outbufs[i],
+        NULL);
+    if (ret != GST_FLOW_OK)
+      goto error_create_buffer;
+
+    outbuf_meta = gst_buffer_get_vaapi_video_meta (outbufs[i]);
+    if (!outbuf_meta)
+      goto error_create_buffer;
+
+    targets[num_targets].surface =
+        gst_vaapi_video_meta_get_surface (outbuf_meta);
+    targets[num_targets].crop_rect = crop_meta ? &crop_rect : NULL;
+    targets[num_targets].target_rect = NULL;
+    num_targets++;
+  }
+  ladder->renegotiate = FALSE;
+
+  if (num_targets == 0) {
+    ret = GST_FLOW_NOT_LINKED;
+    goto done;
+  }
+
+  status = gst_vaapi_filter_process_multi (ladder->filter,
+      gst_vaapi_video_meta_get_surface (inbuf_meta), targets, num_targets,
+      gst_vaapi_video_meta_get_render_flags (inbuf_meta));
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_process_vpp;
+
+  for (i = 0; i < num_pads; i++) {
+    if (!outbufs[i])
+      continue;
+
+    gst_buffer_copy_into (outbufs[i], buf,
+        GST_BUFFER_COPY_TIMESTAMPS | GST_BUFFER_COPY_FLAGS, 0, -1);
+    pad_ret = gst_pad_push (srcpads[i], outbufs[i]);
+    outbufs[i] = NULL;
+
+    GST_OBJECT_LOCK (ladder);
+    ret = gst_flow_combiner_update_pad_flow (ladder->flow_combiner,
+        srcpads[i], pad_ret);
+    GST_OBJECT_UNLOCK (ladder);
+  }
+
+done:
+  for (i = 0; i < num_pads; i++) {
+    if (outbufs)
+      gst_buffer_replace (&outbufs[i], NULL);
+    gst_object_unref (srcpads[i]);
+  }
+  g_free (outbufs);
+  g_free (targets);
+  g_free (srcpads);
+  gst_buffer_unref (buf);
+  return ret;
+
+  /* ERRORS */
+error_invalid_buffer:
+  {
+    GST_ELEMENT_ERROR (ladder, STREAM, FAILED,
+        ("failed to validate source buffer"), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_create_buffer:
+  {
+    GST_ELEMENT_ERROR (ladder, STREAM, FAILED,
+        ("failed to create output buffer"), (NULL));
+    if (ret == GST_FLOW_OK)
+      ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_process_vpp:
+  {
+    GST_ELEMENT_ERROR (ladder, STREAM, FAILED,
+        ("failed to apply VPP filters (error %d)", status), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:{
+      GstVideoColorimetry *colorimetry;
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      GST_DEBUG_OBJECT (ladder, "input caps %" GST_PTR_FORMAT, caps);
+
+      if (!gst_vaapi_plugin_base_set_caps (GST_VAAPI_PLUGIN_BASE (ladder),
+              caps, NULL)) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+
+      colorimetry = &GST_VIDEO_INFO_COLORIMETRY
+          (GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder));
+      if (!gst_vaapi_filter_set_colorimetry (ladder->filter, colorimetry,
+              colorimetry)) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+
+      /* each output gets its own caps, on the next buffer */
+      ladder->renegotiate = TRUE;
+      gst_event_unref (event);
+      return TRUE;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (ladder);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      GST_OBJECT_UNLOCK (ladder);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+        GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+            GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+        return TRUE;
+      }
+      break;
+    case GST_QUERY_ALLOCATION:
+      return gst_vaapi_plugin_base_pad_propose_allocation
+          (GST_VAAPI_PLUGIN_BASE (ladder), pad, query);
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONTEXT) {
+    if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+      GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+          GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+      return TRUE;
+    }
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+copy_sticky_event (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  GstPad *const srcpad = GST_PAD (user_data);
+
+  /* the caps of each output are negotiated separately */
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (srcpad, *event);
+
+  return TRUE;
+}
+
+static GstPad *
+gst_vaapi_scale_ladder_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstPad *srcpad;
+  gchar *name;
+
+  GST_OBJECT_LOCK (ladder);
+  if (req_name)
+    name = g_strdup (req_name);
+  else
+    name = g_strdup_printf ("src_%u", ladder->next_pad_id++);
+  GST_OBJECT_UNLOCK (ladder);
+
+  srcpad = g_object_new (GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD, "name", name,
+      "direction", templ->direction, "template", templ, NULL);
+  g_free (name);
+
+  gst_pad_set_query_function (srcpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_src_query));
+  gst_pad_use_fixed_caps (srcpad);
+
+  if (!gst_element_add_pad (element, srcpad)) {
+    GST_DEBUG_OBJECT (ladder, "could not add pad");
+    gst_object_unref (srcpad);
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_add_pad (ladder->flow_combiner, srcpad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  /* a rendition added while streaming needs the stream-start and
+   * segment events already seen by the others */
+  gst_pad_sticky_events_foreach (GST_VAAPI_PLUGIN_BASE_SINK_PAD (ladder),
+      copy_sticky_event, srcpad);
+
+  return srcpad;
+}
+
+static void
+gst_vaapi_scale_ladder_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_remove_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_pad_set_active (pad, FALSE);
+  reset_src_pad_private (GST_VAAPI_SCALE_LADDER_SRC_PAD (pad)->priv);
+  gst_element_remove_pad (element, pad);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_start (GstVaapiScaleLadder * ladder)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+
+  if (!gst_vaapi_plugin_base_open (plugin))
+    return FALSE;
+  if (!gst_vaapi_plugin_base_ensure_display (plugin))
+    return FALSE;
+
+  ladder->filter = gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY
+      (ladder));
+  if (!ladder->filter)
+    return FALSE;
+
+  ladder->renegotiate = TRUE;
+  gst_flow_combiner_reset (ladder->flow_combiner);
+  return TRUE;
+}
+
+static void
+gst_vaapi_scale_ladder_stop (GstVaapiScaleLadder * ladder)
+{
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+
+  gst_element_foreach_src_pad (GST_ELEMENT (ladder), _reset_srcpad_private,
+      NULL);
+  gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (ladder));
+}
+
+static GstStateChangeReturn
+gst_vaapi_scale_ladder_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_vaapi_scale_ladder_start (ladder))
+        goto error_start;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaapi_scale_ladder_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_vaapi_scale_ladder_stop (ladder);
+      break;
+    default:
+      break;
+  }
+  return ret;
+
+  /* ERRORS */
+error_start:
+  {
+    GST_ELEMENT_ERROR (ladder, RESOURCE, FAILED,
+        ("failed to initialize video processing"), (NULL));
+    gst_vaapi_scale_ladder_stop (ladder);
+    return GST_STATE_CHANGE_FAILURE;
+  }
+}
+
+static GstVaapiPadPrivate *
+gst_vaapi_scale_ladder_get_vaapi_pad_private (GstVaapiPluginBase * plugin,
+    GstPad * pad)
+{
+  if (GST_IS_VAAPI_SCALE_LADDER_SRC_PAD (pad))
+    return GST_VAAPI_SCALE_LADDER_SRC_PAD (pad)->priv;
+
+  g_assert (GST_VAAPI_PLUGIN_BASE_SINK_PAD (plugin) == pad);
+  return GST_VAAPI_PLUGIN_BASE_SINK_PAD_PRIVATE (plugin);
+}
+
+static void
+gst_vaapi_scale_ladder_finalize (GObject * object)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+  gst_flow_combiner_free (ladder->flow_combiner);
+  gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (ladder));
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_scale_ladder_class_init (GstVaapiScaleLadderClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstVaapiPluginBaseClass *plugin_class = GST_VAAPI_PLUGIN_BASE_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi_scale_ladder,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_vaapi_plugin_base_class_init (plugin_class);
+  plugin_class->get_vaapi_pad_private =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_get_vaapi_pad_private);
+
+  object_class->finalize = GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_finalize);
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_change_state);
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_release_pad);
+  element_class->set_context = GST_DEBUG_FUNCPTR (gst_vaapi_base_set_context);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapi_scale_ladder_sink_factory);
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &gst_vaapi_scale_ladder_src_factory,
+      GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD);
+
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API scale ladder",
+      "Filter/Converter/Video/Scaler/Hardware",
+      GST_PLUGIN_DESC, "The GStreamer VA-API developers");
+}
+
+static void
+gst_vaapi_scale_ladder_init (GstVaapiScaleLadder * ladder)
+{
+  GstPad *sinkpad;
+
+  /* the sink pad must exist before the plugin base looks it up */
+  sinkpad = gst_pad_new_from_static_template
+      (&gst_vaapi_scale_ladder_sink_factory, "sink");
+  gst_pad_set_chain_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_chain));
+  gst_pad_set_event_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_event));
+  gst_pad_set_query_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_query));
+  gst_element_add_pad (GST_ELEMENT (ladder), sinkpad);
+
+  ladder->flow_combiner = gst_flow_combiner_new ();
+
+  gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (ladder), GST_CAT_DEFAULT);
+}
@@ -316,6 +316,24 @@ gst_vaapi_video_context_propagate (GstElement * element,
     GST_CAT_INFO_OBJECT (GST_CAT_CONTEXT, element, "No bus attached");
 }
 
+/* Like gst_vaapi_video_context_propagate(), but without posting the
+   context on the bus: the display is only handed to the neighbours
+   querying for a context */
+void
+gst_vaapi_video_context_set_local (GstElement * element,
+    GstVaapiDisplay * display)
+{
+  GstContext *context;
+
+  context = gst_vaapi_video_context_new_with_display (display, FALSE);
+  gst_element_set_context (element, context);
+
+  _init_context_debug ();
+  GST_CAT_INFO_OBJECT (GST_CAT_CONTEXT, element,
+      "set local context (%p) with display %" GST_PTR_FORMAT, context, display);
+  gst_context_unref (context);
+}
+
 /**
  * gst_vaapi_find_gl_local_context:
  * @element: the #GstElement where the search begins
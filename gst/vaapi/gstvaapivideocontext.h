@@ -57,6 +57,11 @@ void
 gst_vaapi_video_context_propagate (GstElement * element,
     GstVaapiDisplay * display);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_video_context_set_local (GstElement * element,
+    GstVaapiDisplay * display);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_find_gl_local_context (GstElement * element,
@@ -941,7 +941,7 @@ allocator_params_init (GstVaapiVideoAllocator * allocator,
   if (!allocator_configure_surface_info (display, allocator, req_usage_flag,
           surface_alloc_flags))
     return FALSE;
-  allocator->surface_pool = gst_vaapi_surface_pool_new_full (display,
+  allocator->surface_pool = gst_vaapi_surface_pool_new_shared (display,
       &allocator->surface_info, surface_alloc_flags);
   if (!allocator->surface_pool)
     goto error_create_surface_pool;
@@ -0,0 +1,241 @@
+/*
+ *  vaapicodedbufferpool.c - GStreamer unit test for the coded buffer pool
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/vaapi/gstvaapidisplay_drm.h>
+#include <gst/vaapi/gstvaapiencoder_h264.h>
+#include <gst/vaapi/gstvaapicodedbufferpool.h>
+
+/* The worst case size the pool is created with. The buffers get no
+ * smaller than an eighth of it, and are rounded up to 4 KiB */
+#define BUF_SIZE (1024 * 1024)
+#define BUF_SIZE_FLOOR (BUF_SIZE / 8)
+
+/* Coded sizes recorded before the buffers are first resized */
+#define MIN_HISTORY 64
+
+typedef struct
+{
+  GstVaapiEncoder *encoder;
+  GstVaapiCodedBufferPool *pool;
+} PoolTestContext;
+
+static gboolean
+pool_test_context_init (PoolTestContext * ctx)
+{
+  GstVaapiDisplay *display;
+  GstVideoCodecState state = { 0, };
+  GstVaapiEncoderStatus status;
+
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display)
+    return FALSE;
+
+  ctx->encoder = gst_vaapi_encoder_h264_new (display);
+  gst_object_unref (display);
+  if (!ctx->encoder)
+    return FALSE;
+
+  /* The pool allocates its buffers from the encoder context */
+  state.ref_count = 1;
+  gst_video_info_set_format (&state.info, GST_VIDEO_FORMAT_ENCODED, 320, 240);
+  state.info.fps_n = 30;
+  state.info.fps_d = 1;
+  status = gst_vaapi_encoder_set_codec_state (ctx->encoder, &state);
+  if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+    gst_object_unref (ctx->encoder);
+    return FALSE;
+  }
+
+  ctx->pool = GST_VAAPI_CODED_BUFFER_POOL (gst_vaapi_coded_buffer_pool_new
+      (ctx->encoder, BUF_SIZE));
+  fail_unless (ctx->pool != NULL);
+  return TRUE;
+}
+
+static void
+pool_test_context_deinit (PoolTestContext * ctx)
+{
+  gst_vaapi_video_pool_unref (GST_VAAPI_VIDEO_POOL (ctx->pool));
+  gst_object_unref (ctx->encoder);
+}
+
+static void
+add_coded_sizes (PoolTestContext * ctx, guint count, gsize size,
+    gboolean is_intra)
+{
+  guint i;
+
+  for (i = 0; i < count; i++)
+    gst_vaapi_coded_buffer_pool_add_coded_size (ctx->pool, size, is_intra);
+}
+
+/* Determines the size of the buffers allocated from now on, through
+ * the memory saved by the only buffer the pool then holds */
+static gsize
+get_allocation_size (PoolTestContext * ctx)
+{
+  GstVaapiCodedBuffer *buf;
+  gsize size;
+
+  buf = gst_vaapi_video_pool_get_object (GST_VAAPI_VIDEO_POOL (ctx->pool));
+  fail_unless (buf != NULL);
+  size = BUF_SIZE - gst_vaapi_coded_buffer_pool_get_memory_saved (ctx->pool);
+  gst_vaapi_coded_buffer_pool_put_buffer (ctx->pool, buf);
+  return size;
+}
+
+/* The buffers fit the 99th percentile of the inter frames, with a
+ * 50% margin, once enough frames were coded */
+GST_START_TEST (test_coded_size_percentile)
+{
+  PoolTestContext ctx;
+
+  if (!pool_test_context_init (&ctx))
+    return;
+
+  fail_unless_equals_int (gst_vaapi_coded_buffer_pool_get_buffer_size
+      (ctx.pool), BUF_SIZE);
+  fail_unless_equals_int (get_allocation_size (&ctx), BUF_SIZE);
+
+  add_coded_sizes (&ctx, MIN_HISTORY - 1, 200000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx), BUF_SIZE);
+
+  /* A single outlier is above the percentile */
+  add_coded_sizes (&ctx, 1, 900000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx),
+      GST_ROUND_UP_N (300000, 4096));
+
+  pool_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* Small frames do not get the buffers below the floor, and an intra
+ * frame raises it */
+GST_START_TEST (test_coded_size_floor)
+{
+  PoolTestContext ctx;
+
+  if (!pool_test_context_init (&ctx))
+    return;
+
+  add_coded_sizes (&ctx, MIN_HISTORY, 10000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx), BUF_SIZE_FLOOR);
+
+  /* The buffers are resized every 16 frames */
+  add_coded_sizes (&ctx, 1, 200000, TRUE);
+  add_coded_sizes (&ctx, 15, 10000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx),
+      GST_ROUND_UP_N (300000, 4096));
+
+  pool_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* An overflow gets the buffers back to the maximum size, restarts
+ * the history, and the overflowed size is never used again */
+GST_START_TEST (test_coded_size_overflow)
+{
+  PoolTestContext ctx;
+  gsize size;
+
+  if (!pool_test_context_init (&ctx))
+    return;
+
+  add_coded_sizes (&ctx, MIN_HISTORY, 200000, FALSE);
+  size = get_allocation_size (&ctx);
+  fail_unless_equals_int (size, GST_ROUND_UP_N (300000, 4096));
+
+  gst_vaapi_coded_buffer_pool_add_overflow (ctx.pool, size);
+  fail_unless_equals_int (get_allocation_size (&ctx), BUF_SIZE);
+
+  add_coded_sizes (&ctx, MIN_HISTORY - 1, 200000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx), BUF_SIZE);
+
+  add_coded_sizes (&ctx, 1, 200000, FALSE);
+  fail_unless_equals_int (get_allocation_size (&ctx), size + 4096);
+
+  pool_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* Only the buffers allocated after a resize save memory, and the
+ * stale ones are released as they are pushed back */
+GST_START_TEST (test_memory_saved)
+{
+  GstVaapiVideoPool *pool;
+  PoolTestContext ctx;
+  GstVaapiCodedBuffer *bufs[3];
+  const gsize size = GST_ROUND_UP_N (300000, 4096);
+
+  if (!pool_test_context_init (&ctx))
+    return;
+  pool = GST_VAAPI_VIDEO_POOL (ctx.pool);
+
+  bufs[0] = gst_vaapi_video_pool_get_object (pool);
+  bufs[1] = gst_vaapi_video_pool_get_object (pool);
+  fail_unless (bufs[0] != NULL && bufs[1] != NULL);
+  fail_unless_equals_uint64 (gst_vaapi_coded_buffer_pool_get_memory_saved
+      (ctx.pool), 0);
+
+  add_coded_sizes (&ctx, MIN_HISTORY, 200000, FALSE);
+  fail_unless_equals_uint64 (gst_vaapi_coded_buffer_pool_get_memory_saved
+      (ctx.pool), 0);
+
+  bufs[2] = gst_vaapi_video_pool_get_object (pool);
+  fail_unless (bufs[2] != NULL);
+  fail_unless_equals_uint64 (gst_vaapi_coded_buffer_pool_get_memory_saved
+      (ctx.pool), BUF_SIZE - size);
+
+  gst_vaapi_coded_buffer_pool_put_buffer (ctx.pool, bufs[0]);
+  gst_vaapi_coded_buffer_pool_put_buffer (ctx.pool, bufs[1]);
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool), 0);
+  gst_vaapi_coded_buffer_pool_put_buffer (ctx.pool, bufs[2]);
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool), 1);
+  fail_unless_equals_uint64 (gst_vaapi_coded_buffer_pool_get_memory_saved
+      (ctx.pool), BUF_SIZE - size);
+
+  pool_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapicodedbufferpool_suite (void)
+{
+  Suite *s = suite_create ("vaapicodedbufferpool");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_coded_size_percentile);
+  tcase_add_test (tc_chain, test_coded_size_floor);
+  tcase_add_test (tc_chain, test_coded_size_overflow);
+  tcase_add_test (tc_chain, test_memory_saved);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapicodedbufferpool);
@@ -0,0 +1,193 @@
+/*
+ *  vaapidecoder.c - GStreamer unit test for the decoder max-resolution
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/vaapi/gstvaapidisplay_drm.h>
+#include <gst/vaapi/gstvaapidecoder_h264.h>
+#include <gst/vaapi/gstvaapidecoder_priv.h>
+#include <gst/vaapi/gstvaapidecoder_objects.h>
+#include <va/va.h>
+
+#define MAX_WIDTH 1280
+#define MAX_HEIGHT 720
+
+static GstVaapiDecoder *
+create_decoder (void)
+{
+  GstVaapiDisplay *display;
+  GstVaapiDecoder *decoder;
+  GstCaps *caps;
+
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display) {
+    GST_WARNING ("no VA display available");
+    return NULL;
+  }
+
+  if (!gst_vaapi_display_has_decoder (display, GST_VAAPI_PROFILE_H264_MAIN,
+          GST_VAAPI_ENTRYPOINT_VLD)) {
+    GST_WARNING ("no H.264 decoder available");
+    gst_object_unref (display);
+    return NULL;
+  }
+
+  caps = gst_caps_new_empty_simple ("video/x-h264");
+  decoder = gst_vaapi_decoder_h264_new (display, caps);
+  gst_caps_unref (caps);
+  gst_object_unref (display);
+  fail_unless (decoder != NULL);
+  return decoder;
+}
+
+static void
+context_info_init (GstVaapiContextInfo * cip, guint width, guint height)
+{
+  memset (cip, 0, sizeof (*cip));
+  cip->profile = GST_VAAPI_PROFILE_H264_MAIN;
+  cip->entrypoint = GST_VAAPI_ENTRYPOINT_VLD;
+  cip->chroma_type = GST_VAAPI_CHROMA_TYPE_YUV420;
+  cip->width = width;
+  cip->height = height;
+  cip->ref_frames = 4;
+}
+
+/* Creates a picture the way the codecs do, for the frame being
+   decoded */
+static GstVaapiPicture *
+create_picture (GstVaapiDecoder * decoder)
+{
+  VAPictureParameterBufferH264 pic_param = { 0, };
+  GstVideoCodecFrame *frame;
+  GstVaapiPicture *picture;
+
+  frame = g_slice_new0 (GstVideoCodecFrame);
+  frame->ref_count = 1;
+  GST_VAAPI_DECODER_CODEC_FRAME (decoder) = frame;
+
+  picture = gst_vaapi_picture_new (decoder, &pic_param, sizeof (pic_param));
+
+  GST_VAAPI_DECODER_CODEC_FRAME (decoder) = NULL;
+  gst_video_codec_frame_unref (frame);
+  fail_unless (picture != NULL);
+  return picture;
+}
+
+static void
+check_picture (GstVaapiDecoder * decoder, guint width, guint height)
+{
+  GstVaapiPicture *picture;
+  guint surface_width, surface_height;
+
+  picture = create_picture (decoder);
+  gst_vaapi_surface_get_size (picture->surface, &surface_width,
+      &surface_height);
+  fail_unless_equals_int (surface_width, MAX_WIDTH);
+  fail_unless_equals_int (surface_height, MAX_HEIGHT);
+
+  fail_unless (picture->has_crop_rect);
+  fail_unless_equals_int (picture->crop_rect.x, 0);
+  fail_unless_equals_int (picture->crop_rect.y, 0);
+  fail_unless_equals_int (picture->crop_rect.width, width);
+  fail_unless_equals_int (picture->crop_rect.height, height);
+  gst_vaapi_picture_unref (picture);
+}
+
+/* A resolution change within max-width x max-height keeps the context
+   and its surfaces, and the pictures get cropped */
+GST_START_TEST (test_max_resolution_change)
+{
+  GstVaapiDecoder *decoder;
+  GstVaapiContextInfo info;
+  GstVaapiContext *context;
+  VAContextID va_context;
+
+  decoder = create_decoder ();
+  if (!decoder)
+    return;
+
+  gst_vaapi_decoder_set_max_resolution (decoder, MAX_WIDTH, MAX_HEIGHT);
+
+  context_info_init (&info, 640, 360);
+  fail_unless (gst_vaapi_decoder_ensure_context (decoder, &info));
+  context = GST_VAAPI_DECODER_CONTEXT (decoder);
+  fail_unless (context != NULL);
+  va_context = decoder->va_context;
+  check_picture (decoder, 640, 360);
+
+  context_info_init (&info, 960, 540);
+  fail_unless (gst_vaapi_decoder_ensure_context (decoder, &info));
+  fail_unless (GST_VAAPI_DECODER_CONTEXT (decoder) == context);
+  fail_unless_equals_int (decoder->va_context, va_context);
+  check_picture (decoder, 960, 540);
+
+  gst_object_unref (decoder);
+}
+
+GST_END_TEST;
+
+/* A max-resolution beyond the driver limits is lowered to them */
+GST_START_TEST (test_max_resolution_clamp)
+{
+  GstVaapiDecoder *decoder;
+  GstVaapiContextInfo info;
+  gint max_width = 0, max_height = 0;
+  GArray *formats;
+
+  decoder = create_decoder ();
+  if (!decoder)
+    return;
+
+  gst_vaapi_decoder_set_max_resolution (decoder, G_MAXINT16, G_MAXINT16);
+
+  context_info_init (&info, 640, 360);
+  fail_unless (gst_vaapi_decoder_ensure_context (decoder, &info));
+
+  formats = gst_vaapi_decoder_get_surface_attributes (decoder, NULL, NULL,
+      &max_width, &max_height, NULL);
+  fail_unless (formats != NULL);
+  g_array_unref (formats);
+
+  if (max_width > 0)
+    fail_unless (decoder->max_width <= (guint) max_width);
+  if (max_height > 0)
+    fail_unless (decoder->max_height <= (guint) max_height);
+
+  gst_object_unref (decoder);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapidecoder_suite (void)
+{
+  Suite *s = suite_create ("vaapidecoder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_max_resolution_change);
+  tcase_add_test (tc_chain, test_max_resolution_clamp);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapidecoder);
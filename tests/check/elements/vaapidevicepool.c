@@ -0,0 +1,180 @@
+/*
+ *  vaapidevicepool.c - GStreamer unit test for the device pool
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include "gstvaapidevicepool.h"
+
+/* The pool never opens its devices, so any names stand in for the
+ * render nodes of a multi-GPU system */
+static const gchar *const devices[] = {
+  "/dev/dri/renderD128", "/dev/dri/renderD129", "/dev/dri/renderD130", NULL
+};
+
+#define MB (1024 * 1024)
+
+GST_START_TEST (test_least_loaded_spreads)
+{
+  GstVaapiDevicePool *pool;
+  const gchar *device;
+  guint i;
+
+  pool = gst_vaapi_device_pool_new (devices);
+  fail_unless_equals_int (gst_vaapi_device_pool_get_num_devices (pool), 3);
+
+  /* Six instances end up two per device, in device order */
+  for (i = 0; i < 6; i++) {
+    device = gst_vaapi_device_pool_acquire (pool,
+        GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+    fail_unless_equals_string (device, devices[i % 3]);
+  }
+  for (i = 0; i < 3; i++) {
+    fail_unless_equals_int (gst_vaapi_device_pool_get_num_contexts (pool,
+            devices[i]), 2);
+  }
+
+  gst_vaapi_device_pool_free (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_least_loaded_release)
+{
+  GstVaapiDevicePool *pool;
+  const gchar *device;
+  guint i;
+
+  pool = gst_vaapi_device_pool_new (devices);
+  for (i = 0; i < 6; i++)
+    gst_vaapi_device_pool_acquire (pool, GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+
+  /* The instance going away frees a slot for the next one */
+  gst_vaapi_device_pool_release (pool, devices[1]);
+  fail_unless_equals_int (gst_vaapi_device_pool_get_num_contexts (pool,
+          devices[1]), 1);
+
+  device = gst_vaapi_device_pool_acquire (pool,
+      GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+  fail_unless_equals_string (device, devices[1]);
+
+  /* Releasing an idle or unknown device is harmless */
+  gst_vaapi_device_pool_release (pool, "/dev/dri/renderD200");
+  for (i = 0; i < 3; i++)
+    gst_vaapi_device_pool_release (pool, devices[2]);
+  fail_unless_equals_int (gst_vaapi_device_pool_get_num_contexts (pool,
+          devices[2]), 0);
+
+  gst_vaapi_device_pool_free (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_least_loaded_memory)
+{
+  GstVaapiDevicePool *pool;
+  const gchar *device;
+
+  pool = gst_vaapi_device_pool_new (devices);
+  gst_vaapi_device_pool_acquire (pool, GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+  gst_vaapi_device_pool_acquire (pool, GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+  gst_vaapi_device_pool_acquire (pool, GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+
+  /* A 4K stream on the first device, 1080p on the second one */
+  gst_vaapi_device_pool_update_memory (pool, devices[0], 200 * MB);
+  gst_vaapi_device_pool_update_memory (pool, devices[1], 50 * MB);
+  gst_vaapi_device_pool_update_memory (pool, devices[2], 100 * MB);
+
+  /* Same number of instances: the least memory wins */
+  device = gst_vaapi_device_pool_acquire (pool,
+      GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+  fail_unless_equals_string (device, devices[1]);
+
+  /* The number of instances comes first */
+  gst_vaapi_device_pool_update_memory (pool, devices[1], -50 * MB);
+  fail_unless (gst_vaapi_device_pool_get_memory (pool, devices[1]) == 0);
+  device = gst_vaapi_device_pool_acquire (pool,
+      GST_VAAPI_DEVICE_POLICY_LEAST_LOADED);
+  fail_unless_equals_string (device, devices[2]);
+
+  /* Never below zero */
+  gst_vaapi_device_pool_update_memory (pool, devices[2], -500 * MB);
+  fail_unless (gst_vaapi_device_pool_get_memory (pool, devices[2]) == 0);
+
+  gst_vaapi_device_pool_free (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_round_robin)
+{
+  GstVaapiDevicePool *pool;
+  const gchar *device;
+  guint i;
+
+  pool = gst_vaapi_device_pool_new (devices);
+
+  /* Memory and instance count are ignored */
+  gst_vaapi_device_pool_update_memory (pool, devices[1], 500 * MB);
+  for (i = 0; i < 7; i++) {
+    device = gst_vaapi_device_pool_acquire (pool,
+        GST_VAAPI_DEVICE_POLICY_ROUND_ROBIN);
+    fail_unless_equals_string (device, devices[i % 3]);
+  }
+  fail_unless_equals_int (gst_vaapi_device_pool_get_num_contexts (pool,
+          devices[0]), 3);
+
+  gst_vaapi_device_pool_free (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_empty)
+{
+  static const gchar *const no_devices[] = { NULL };
+  GstVaapiDevicePool *pool;
+
+  pool = gst_vaapi_device_pool_new (no_devices);
+  fail_unless_equals_int (gst_vaapi_device_pool_get_num_devices (pool), 0);
+  fail_unless (gst_vaapi_device_pool_acquire (pool,
+          GST_VAAPI_DEVICE_POLICY_LEAST_LOADED) == NULL);
+  gst_vaapi_device_pool_free (pool);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapidevicepool_suite (void)
+{
+  Suite *s = suite_create ("vaapidevicepool");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_least_loaded_spreads);
+  tcase_add_test (tc_chain, test_least_loaded_release);
+  tcase_add_test (tc_chain, test_least_loaded_memory);
+  tcase_add_test (tc_chain, test_round_robin);
+  tcase_add_test (tc_chain, test_empty);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapidevicepool);
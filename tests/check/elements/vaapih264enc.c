@@ -0,0 +1,257 @@
+/*
+ *  vaapih264enc.c - GStreamer unit test for the vaapih264enc element
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+
+#define NUM_BUFFERS 30
+#define TEST_PATTERN_SNOW 1
+
+typedef struct
+{
+  GstElement *pipeline;
+  GstElement *encoder;
+  guint num_underflows;
+  guint num_overflows;
+} VbvTestContext;
+
+static gboolean
+vbv_test_context_init (VbvTestContext * ctx, gboolean vbv_check,
+    guint bitrate, guint cpb_length)
+{
+  GstElement *src, *filter, *sink;
+  GstCaps *caps;
+
+  /* vaapih264enc is only registered if the driver can encode H.264 */
+  ctx->encoder = gst_element_factory_make ("vaapih264enc", "encoder");
+  if (!ctx->encoder)
+    return FALSE;
+
+  gst_util_set_object_arg (G_OBJECT (ctx->encoder), "rate-control", "cbr");
+  g_object_set (ctx->encoder, "bitrate", bitrate, "cpb-length", cpb_length,
+      "vbv-check", vbv_check, NULL);
+
+  src = gst_element_factory_make ("videotestsrc", "src");
+  g_object_set (src, "num-buffers", NUM_BUFFERS, "pattern",
+      TEST_PATTERN_SNOW, NULL);
+  filter = gst_element_factory_make ("capsfilter", "filter");
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "NV12",
+      "width", G_TYPE_INT, 320, "height", G_TYPE_INT, 240,
+      "framerate", GST_TYPE_FRACTION, 25, 1, NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  sink = gst_element_factory_make ("fakesink", "sink");
+
+  ctx->pipeline = gst_pipeline_new ("pipeline");
+  gst_bin_add_many (GST_BIN (ctx->pipeline), src, filter, ctx->encoder, sink,
+      NULL);
+  fail_unless (gst_element_link_many (src, filter, ctx->encoder, sink, NULL));
+
+  ctx->num_underflows = 0;
+  ctx->num_overflows = 0;
+  return TRUE;
+}
+
+static void
+vbv_test_context_deinit (VbvTestContext * ctx)
+{
+  gst_element_set_state (ctx->pipeline, GST_STATE_NULL);
+  gst_object_unref (ctx->pipeline);
+}
+
+/* Runs the pipeline to EOS, counting the VBV violations reported on
+ * the bus */
+static void
+vbv_test_context_run (VbvTestContext * ctx)
+{
+  GstBus *bus;
+  GstMessage *msg;
+  gboolean done = FALSE;
+
+  bus = gst_element_get_bus (ctx->pipeline);
+  fail_unless (gst_element_set_state (ctx->pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  while (!done) {
+    const GstStructure *s;
+    const gchar *status;
+    guint64 fullness, size;
+
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT);
+
+    switch (GST_MESSAGE_TYPE (msg)) {
+      case GST_MESSAGE_EOS:
+        done = TRUE;
+        break;
+      case GST_MESSAGE_ERROR:
+        fail ("unexpected error: %" GST_PTR_FORMAT, msg);
+        break;
+      case GST_MESSAGE_ELEMENT:
+        s = gst_message_get_structure (msg);
+        if (!gst_structure_has_name (s, "GstVaapiEncodeVBV"))
+          break;
+        fail_unless (GST_MESSAGE_SRC (msg) == GST_OBJECT (ctx->encoder));
+
+        status = gst_structure_get_string (s, "status");
+        fail_unless (gst_structure_get_uint64 (s, "fullness", &fullness));
+        fail_unless (gst_structure_get_uint64 (s, "size", &size));
+        fail_unless (fullness <= size);
+
+        if (g_strcmp0 (status, "underflow") == 0)
+          ctx->num_underflows++;
+        else if (g_strcmp0 (status, "overflow") == 0)
+          ctx->num_overflows++;
+        else
+          fail ("unknown VBV status %s", status);
+        break;
+      default:
+        break;
+    }
+    gst_message_unref (msg);
+  }
+
+  gst_object_unref (bus);
+}
+
+static guint64
+get_stat (GstElement * encoder, const gchar * name)
+{
+  GstStructure *stats;
+  guint64 value = 0;
+
+  g_object_get (encoder, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  fail_unless (gst_structure_get_uint64 (stats, name, &value));
+  gst_structure_free (stats);
+  return value;
+}
+
+GST_START_TEST (test_vbv_properties)
+{
+  GstElement *encoder;
+  gboolean vbv_check, vbv_qp_feedback;
+
+  encoder = gst_element_factory_make ("vaapih264enc", "encoder");
+  if (!encoder)
+    return;
+
+  g_object_get (encoder, "vbv-check", &vbv_check, "vbv-qp-feedback",
+      &vbv_qp_feedback, NULL);
+  fail_if (vbv_check);
+  fail_if (vbv_qp_feedback);
+
+  g_object_set (encoder, "vbv-check", TRUE, "vbv-qp-feedback", TRUE, NULL);
+  g_object_get (encoder, "vbv-check", &vbv_check, "vbv-qp-feedback",
+      &vbv_qp_feedback, NULL);
+  fail_unless (vbv_check);
+  fail_unless (vbv_qp_feedback);
+
+  gst_object_unref (encoder);
+}
+
+GST_END_TEST;
+
+/* Without vbv-check, nothing is modelled nor reported */
+GST_START_TEST (test_vbv_disabled)
+{
+  VbvTestContext ctx;
+
+  if (!vbv_test_context_init (&ctx, FALSE, 64, 100))
+    return;
+
+  vbv_test_context_run (&ctx);
+  fail_unless_equals_int (ctx.num_underflows, 0);
+  fail_unless_equals_int (ctx.num_overflows, 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-underflows"), 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-overflows"), 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-size"), 0);
+
+  vbv_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* Noise at 64 kbps with a 100 ms CPB cannot fit: every violation is
+ * both posted and counted in the statistics */
+GST_START_TEST (test_vbv_underflow)
+{
+  VbvTestContext ctx;
+  guint64 fullness, size;
+
+  if (!vbv_test_context_init (&ctx, TRUE, 64, 100))
+    return;
+
+  vbv_test_context_run (&ctx);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "frames"), NUM_BUFFERS);
+  fail_unless (ctx.num_underflows > 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-underflows"),
+      ctx.num_underflows);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-overflows"),
+      ctx.num_overflows);
+
+  size = get_stat (ctx.encoder, "vbv-size");
+  fullness = get_stat (ctx.encoder, "vbv-fullness");
+  fail_unless (size > 0);
+  fail_unless (fullness <= size);
+
+  vbv_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* A CPB large enough for the stream never underflows */
+GST_START_TEST (test_vbv_conforming)
+{
+  VbvTestContext ctx;
+
+  if (!vbv_test_context_init (&ctx, TRUE, 50000, 10000))
+    return;
+
+  vbv_test_context_run (&ctx);
+  fail_unless_equals_int (ctx.num_underflows, 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-underflows"), 0);
+  fail_unless_equals_uint64 (get_stat (ctx.encoder, "vbv-overflows"),
+      ctx.num_overflows);
+  fail_unless (get_stat (ctx.encoder, "vbv-size") > 0);
+
+  vbv_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapih264enc_suite (void)
+{
+  Suite *s = suite_create ("vaapih264enc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_vbv_properties);
+  tcase_add_test (tc_chain, test_vbv_disabled);
+  tcase_add_test (tc_chain, test_vbv_underflow);
+  tcase_add_test (tc_chain, test_vbv_conforming);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapih264enc);
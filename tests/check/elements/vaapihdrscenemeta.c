@@ -0,0 +1,138 @@
+/*
+ *  vaapihdrscenemeta.c - GStreamer unit test for the HDR scene meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapihdrscenemeta.h>
+
+/* Attaches the levels the way an upstream element not linking to the
+ * library would */
+static GstBuffer *
+create_buffer_with_levels (guint max_cll, guint max_fall)
+{
+  GstBuffer *buffer;
+  GstCustomMeta *meta;
+
+  buffer = gst_buffer_new ();
+  meta = gst_buffer_add_custom_meta (buffer, "GstVaapiHDRSceneMeta");
+  fail_unless (meta != NULL);
+
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "max-content-light-level", G_TYPE_UINT, max_cll,
+      "max-frame-average-light-level", G_TYPE_UINT, max_fall, NULL);
+  return buffer;
+}
+
+static void
+check_levels (GstBuffer * buffer, guint max_cll, guint max_fall)
+{
+  GstVideoContentLightLevel linfo;
+
+  fail_unless (gst_buffer_get_vaapi_hdr_scene (buffer, &linfo));
+  fail_unless_equals_int (linfo.max_content_light_level, max_cll);
+  fail_unless_equals_int (linfo.max_frame_average_light_level, max_fall);
+}
+
+GST_START_TEST (test_hdr_scene_contract)
+{
+  GstVideoContentLightLevel linfo;
+  GstBuffer *buffer;
+
+  gst_vaapi_hdr_scene_meta_register ();
+  fail_unless (gst_meta_get_info (GST_VAAPI_HDR_SCENE_META_NAME) != NULL);
+
+  buffer = create_buffer_with_levels (1000, 400);
+  check_levels (buffer, 1000, 400);
+  gst_buffer_unref (buffer);
+
+  /* The levels are 16-bit */
+  buffer = create_buffer_with_levels (G_MAXUINT16 + 1, 400);
+  fail_if (gst_buffer_get_vaapi_hdr_scene (buffer, &linfo));
+  gst_buffer_unref (buffer);
+
+  buffer = gst_buffer_new ();
+  fail_if (gst_buffer_get_vaapi_hdr_scene (buffer, &linfo));
+  gst_video_content_light_level_init (&linfo);
+  linfo.max_content_light_level = 800;
+  linfo.max_frame_average_light_level = 200;
+  fail_unless (gst_buffer_add_vaapi_hdr_scene_meta (buffer, &linfo) != NULL);
+  check_levels (buffer, 800, 200);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_hdr_scene_transform)
+{
+  GstBuffer *buffer, *copy;
+  GstVideoInfo in_info, out_info;
+  GstVideoMetaTransform trans = { &in_info, &out_info };
+  GstVideoContentLightLevel linfo;
+  GstMeta *meta;
+
+  gst_vaapi_hdr_scene_meta_register ();
+  buffer = create_buffer_with_levels (1000, 400);
+  meta = (GstMeta *) gst_buffer_get_custom_meta (buffer,
+      GST_VAAPI_HDR_SCENE_META_NAME);
+  fail_unless (meta != NULL);
+
+  /* Copies keep the levels, as decoders do for their output frames */
+  copy = gst_buffer_copy (buffer);
+  check_levels (copy, 1000, 400);
+  gst_buffer_unref (copy);
+
+  /* So does scaling */
+  gst_video_info_set_format (&in_info, GST_VIDEO_FORMAT_P010_10LE, 64, 64);
+  gst_video_info_set_format (&out_info, GST_VIDEO_FORMAT_NV12, 32, 32);
+  copy = gst_buffer_new ();
+  fail_unless (meta->info->transform_func (copy, meta, buffer,
+          gst_video_meta_transform_scale_get_quark (), &trans));
+  check_levels (copy, 1000, 400);
+  gst_buffer_unref (copy);
+
+  /* Other transforms drop them */
+  copy = gst_buffer_new ();
+  fail_if (meta->info->transform_func (copy, meta, buffer,
+          g_quark_from_static_string ("vaapi-test-transform"), NULL));
+  fail_if (gst_buffer_get_vaapi_hdr_scene (copy, &linfo));
+  gst_buffer_unref (copy);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapihdrscenemeta_suite (void)
+{
+  Suite *s = suite_create ("vaapihdrscenemeta");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_hdr_scene_contract);
+  tcase_add_test (tc_chain, test_hdr_scene_transform);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapihdrscenemeta);
@@ -0,0 +1,273 @@
+/*
+ *  vaapimosaic.c - GStreamer unit test for the vaapimosaic element
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define TEST_PATTERN_RED 4
+#define TEST_PATTERN_GREEN 5
+
+typedef struct
+{
+  GstElement *pipeline;
+  GstElement *mosaic;
+  GstElement *sink;
+  GstBuffer *handoff_buffer;
+} MosaicTestContext;
+
+static void
+on_handoff (GstElement * element, GstBuffer * buffer, GstPad * pad,
+    gpointer data)
+{
+  MosaicTestContext *const ctx = data;
+
+  gst_buffer_replace (&ctx->handoff_buffer, buffer);
+}
+
+static GstCaps *
+create_input_caps (gint width, gint height, gint fps_n)
+{
+  return gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "NV12",
+      "width", G_TYPE_INT, width, "height", G_TYPE_INT, height,
+      "framerate", GST_TYPE_FRACTION, fps_n, 1, NULL);
+}
+
+static void
+add_input (MosaicTestContext * ctx, gint pattern, guint num_buffers,
+    GstCaps * caps)
+{
+  GstElement *src, *filter;
+  GstPad *srcpad, *sinkpad;
+
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  g_object_set (src, "num-buffers", num_buffers, "pattern", pattern, NULL);
+  filter = gst_element_factory_make ("capsfilter", NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (ctx->pipeline), src, filter, NULL);
+  fail_unless (gst_element_link (src, filter));
+
+  srcpad = gst_element_get_static_pad (filter, "src");
+  sinkpad = gst_element_get_request_pad (ctx->mosaic, "sink_%u");
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_object_unref (srcpad);
+}
+
+static gboolean
+mosaic_test_context_init (MosaicTestContext * ctx, GstCaps * outcaps)
+{
+  GstElement *filter;
+
+  /* vaapimosaic needs the same VPP support as vaapioverlay, which is
+   * only available for the iHD driver */
+  ctx->mosaic = gst_element_factory_make ("vaapimosaic", "mosaic");
+  if (!ctx->mosaic) {
+    if (outcaps)
+      gst_caps_unref (outcaps);
+    return FALSE;
+  }
+
+  ctx->pipeline = gst_pipeline_new ("pipeline");
+  ctx->handoff_buffer = NULL;
+
+  filter = gst_element_factory_make ("capsfilter", "outfilter");
+  if (outcaps) {
+    g_object_set (filter, "caps", outcaps, NULL);
+    gst_caps_unref (outcaps);
+  }
+
+  ctx->sink = gst_element_factory_make ("vaapisink", "sink");
+  g_object_set (ctx->sink, "display", 4, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (ctx->sink, "handoff", G_CALLBACK (on_handoff), ctx);
+
+  gst_bin_add_many (GST_BIN (ctx->pipeline), ctx->mosaic, filter, ctx->sink,
+      NULL);
+  fail_unless (gst_element_link_many (ctx->mosaic, filter, ctx->sink, NULL));
+  return TRUE;
+}
+
+static void
+mosaic_test_context_deinit (MosaicTestContext * ctx)
+{
+  gst_buffer_replace (&ctx->handoff_buffer, NULL);
+  gst_element_set_state (ctx->pipeline, GST_STATE_NULL);
+  gst_object_unref (ctx->pipeline);
+}
+
+static void
+mosaic_test_context_run (MosaicTestContext * ctx)
+{
+  GstBus *bus;
+  GstMessage *msg;
+
+  bus = gst_element_get_bus (ctx->pipeline);
+  fail_unless (gst_element_set_state (ctx->pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS,
+      "unexpected message: %" GST_PTR_FORMAT, msg);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+static void
+get_output_info (MosaicTestContext * ctx, GstVideoInfo * vinfo)
+{
+  GstPad *pad;
+  GstCaps *caps;
+
+  pad = gst_element_get_static_pad (ctx->sink, "sink");
+  caps = gst_pad_get_current_caps (pad);
+  fail_unless (caps != NULL);
+  fail_unless (gst_video_info_from_caps (vinfo, caps));
+  gst_caps_unref (caps);
+  gst_object_unref (pad);
+}
+
+/* Two inputs of the same size get a 2x1 grid: green on the left, red
+ * on the right */
+GST_START_TEST (test_mosaic_grid)
+{
+  MosaicTestContext ctx;
+  GstVideoFrame frame;
+  GstVideoInfo vinfo;
+  guint i, j, plane;
+
+  if (!mosaic_test_context_init (&ctx, NULL))
+    return;
+
+  add_input (&ctx, TEST_PATTERN_GREEN, 1, create_input_caps (32, 32, 25));
+  add_input (&ctx, TEST_PATTERN_RED, 1, create_input_caps (32, 32, 25));
+  mosaic_test_context_run (&ctx);
+
+  fail_unless (ctx.handoff_buffer != NULL);
+  get_output_info (&ctx, &vinfo);
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&vinfo), 64);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&vinfo), 32);
+
+  fail_unless (gst_video_frame_map (&frame, &vinfo, ctx.handoff_buffer,
+          GST_MAP_READ));
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame); plane++) {
+    guint8 *pd = GST_VIDEO_FRAME_PLANE_DATA (&frame, plane);
+    gint w = GST_VIDEO_FRAME_COMP_WIDTH (&frame, plane)
+        * GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, plane);
+    gint h = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, plane);
+    gint ps = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, plane);
+
+    for (j = 0; j < h; ++j) {
+      for (i = 0; i < w; ++i) {
+        guint8 actual = GST_READ_UINT8 (pd + i);
+        guint8 expect;
+
+        /* the tile boundary is at byte 32 in both planes */
+        if (plane == 0)
+          expect = i < 32 ? 0x91 : 0x51;
+        else if (i < 32)
+          expect = (i % 2) ? 0x22 : 0x36;
+        else
+          expect = (i % 2) ? 0xf0 : 0x5a;
+
+        fail_unless (actual == expect,
+            "Expected 0x%02x but got 0x%02x at (%u,%u,%u)", expect, actual,
+            plane, i, j);
+      }
+      pd += ps;
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  mosaic_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* The output fits one tile of the largest input per grid cell, at the
+ * highest input frame rate */
+GST_START_TEST (test_mosaic_caps_fixation)
+{
+  MosaicTestContext ctx;
+  GstVideoInfo vinfo;
+
+  if (!mosaic_test_context_init (&ctx, NULL))
+    return;
+
+  g_object_set (ctx.mosaic, "columns", 1, NULL);
+  add_input (&ctx, TEST_PATTERN_GREEN, 1, create_input_caps (32, 32, 10));
+  add_input (&ctx, TEST_PATTERN_RED, 1, create_input_caps (16, 16, 30));
+  mosaic_test_context_run (&ctx);
+
+  get_output_info (&ctx, &vinfo);
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&vinfo), 32);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&vinfo), 64);
+  fail_unless_equals_int (GST_VIDEO_INFO_FPS_N (&vinfo), 30);
+  fail_unless_equals_int (GST_VIDEO_INFO_FPS_D (&vinfo), 1);
+
+  mosaic_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* With inputs slower than the output, every input frame is scaled only
+ * once, and the output frames without any new input are not blended */
+GST_START_TEST (test_mosaic_skipped_blends)
+{
+  MosaicTestContext ctx;
+  guint64 scaled_tiles, skipped_blends;
+
+  if (!mosaic_test_context_init (&ctx,
+          gst_caps_from_string ("video/x-raw(ANY), framerate=30/1")))
+    return;
+
+  add_input (&ctx, TEST_PATTERN_GREEN, 3, create_input_caps (32, 32, 10));
+  add_input (&ctx, TEST_PATTERN_RED, 3, create_input_caps (32, 32, 10));
+  mosaic_test_context_run (&ctx);
+
+  g_object_get (ctx.mosaic, "scaled-tiles", &scaled_tiles,
+      "skipped-blends", &skipped_blends, NULL);
+  fail_unless_equals_uint64 (scaled_tiles, 6);
+  fail_unless (skipped_blends > 0);
+
+  mosaic_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapimosaic_suite (void)
+{
+  Suite *s = suite_create ("vaapimosaic");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_mosaic_grid);
+  tcase_add_test (tc_chain, test_mosaic_caps_fixation);
+  tcase_add_test (tc_chain, test_mosaic_skipped_blends);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapimosaic);
@@ -376,6 +376,104 @@ GST_START_TEST (test_orientation_mouse_events)
 
 GST_END_TEST;
 
+#define ASYNC_NUM_BUFFERS 8
+#define WHITE_LUMA 0xeb
+
+/* Checks every frame reads back as the source white once mapped,
+ * whether its VPP job is still running or not */
+static void
+cb_async_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer data)
+{
+  guint *const num_buffers = data;
+  GstVideoFrame frame;
+  GstVideoInfo vinfo;
+  GstCaps *caps;
+  guint8 *pixels;
+
+  caps = gst_pad_get_current_caps (pad);
+  fail_unless (gst_video_info_from_caps (&vinfo, caps));
+  gst_caps_unref (caps);
+
+  fail_unless (gst_video_frame_map (&frame, &vinfo, buffer, GST_MAP_READ));
+  pixels = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+  fail_unless_equals_int (pixels[0], WHITE_LUMA);
+  gst_video_frame_unmap (&frame);
+
+  (*num_buffers)++;
+}
+
+static void
+vpp_test_async_depth (guint async_depth)
+{
+  GstElement *pipeline, *src, *infilter, *vpp, *outfilter, *sink;
+  GstBus *bus;
+  GstCaps *caps;
+  GstMessage *msg;
+  guint depth, num_buffers = 0;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("videotestsrc", "src");
+  g_object_set (src, "pattern", 3 /* white */ ,
+      "num-buffers", ASYNC_NUM_BUFFERS, NULL);
+
+  infilter = gst_element_factory_make ("capsfilter", "infilter");
+  caps = gst_caps_from_string ("video/x-raw, format=NV12, "
+      "width=320, height=240, framerate=25/1");
+  g_object_set (infilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  vpp = gst_element_factory_make ("vaapipostproc", "vpp");
+  fail_unless (vpp != NULL, "Failed to create vaapipostproc element");
+  g_object_set (vpp, "async-depth", async_depth, NULL);
+  g_object_get (vpp, "async-depth", &depth, NULL);
+  fail_unless_equals_int (depth, async_depth);
+
+  /* Scaling gets every frame through a VPP job */
+  outfilter = gst_element_factory_make ("capsfilter", "outfilter");
+  caps = gst_caps_from_string ("video/x-raw(memory:VASurface), "
+      "format=NV12, width=160, height=120");
+  g_object_set (outfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  sink = gst_element_factory_make ("fakesink", "sink");
+  g_object_set (sink, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (cb_async_handoff),
+      &num_buffers);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, infilter, vpp, outfilter, sink,
+      NULL);
+  fail_unless (gst_element_link_many (src, infilter, vpp, outfilter, sink,
+          NULL));
+
+  bus = gst_element_get_bus (pipeline);
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS,
+      "unexpected message: %" GST_PTR_FORMAT, msg);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (num_buffers, ASYNC_NUM_BUFFERS);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+/* Every frame gets out, whatever the number of VPP jobs left in
+ * flight, including more than the frames of the stream */
+GST_START_TEST (test_async_depth)
+{
+  vpp_test_async_depth (0);
+  vpp_test_async_depth (1);
+  vpp_test_async_depth (2);
+  vpp_test_async_depth (16);
+}
+
+GST_END_TEST;
+
 static Suite *
 vaapipostproc_suite (void)
 {
@@ -386,6 +484,7 @@ vaapipostproc_suite (void)
   tcase_add_test (tc_chain, test_make);
   tcase_add_test (tc_chain, test_crop_mouse_events);
   tcase_add_test (tc_chain, test_orientation_mouse_events);
+  tcase_add_test (tc_chain, test_async_depth);
 
   return s;
 }
@@ -0,0 +1,168 @@
+/*
+ *  vaapiqpmapmeta.c - GStreamer unit test for the delta QP map meta
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapiqpmapmeta.h>
+
+static const gint8 delta_qp[] = {
+  -4, -2,
+  0, 6,
+};
+
+/* Attaches the map the way an upstream element not linking to the
+ * library would */
+static GstBuffer *
+create_buffer_with_map (guint width, guint height, const gint8 * values,
+    gsize size)
+{
+  GstBuffer *buffer;
+  GstCustomMeta *meta;
+  GBytes *bytes;
+
+  buffer = gst_buffer_new ();
+  meta = gst_buffer_add_custom_meta (buffer, "GstVaapiQPMapMeta");
+  fail_unless (meta != NULL);
+
+  bytes = g_bytes_new (values, size);
+  gst_structure_set (gst_custom_meta_get_structure (meta),
+      "width", G_TYPE_UINT, width, "height", G_TYPE_UINT, height,
+      "delta-qp", G_TYPE_BYTES, bytes, NULL);
+  g_bytes_unref (bytes);
+  return buffer;
+}
+
+static void
+check_map (GstBuffer * buffer)
+{
+  GstVaapiQPMap map;
+
+  fail_unless (gst_buffer_get_vaapi_qp_map (buffer, &map));
+  fail_unless_equals_int (map.width, 2);
+  fail_unless_equals_int (map.height, 2);
+  fail_unless (memcmp (map.delta_qp, delta_qp, sizeof (delta_qp)) == 0);
+}
+
+GST_START_TEST (test_qp_map_contract)
+{
+  GstBuffer *buffer;
+  GstVaapiQPMap map;
+
+  gst_vaapi_qp_map_meta_register ();
+  fail_unless (gst_meta_get_info (GST_VAAPI_QP_MAP_META_NAME) != NULL);
+
+  buffer = create_buffer_with_map (2, 2, delta_qp, sizeof (delta_qp));
+  check_map (buffer);
+  gst_buffer_unref (buffer);
+
+  /* The number of values has to match the size of the map */
+  buffer = create_buffer_with_map (3, 2, delta_qp, sizeof (delta_qp));
+  fail_if (gst_buffer_get_vaapi_qp_map (buffer, &map));
+  gst_buffer_unref (buffer);
+
+  buffer = gst_buffer_new ();
+  fail_if (gst_buffer_get_vaapi_qp_map (buffer, &map));
+  fail_unless (gst_buffer_add_vaapi_qp_map_meta (buffer, 2, 2,
+          delta_qp) != NULL);
+  check_map (buffer);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_qp_map_transform)
+{
+  GstBuffer *buffer, *copy;
+  GstVideoInfo in_info, out_info;
+  GstVideoMetaTransform trans = { &in_info, &out_info };
+  GstMeta *meta;
+  GstVaapiQPMap map;
+
+  buffer = gst_buffer_new_allocate (NULL, 16, NULL);
+  gst_buffer_add_vaapi_qp_map_meta (buffer, 2, 2, delta_qp);
+  meta = (GstMeta *) gst_buffer_get_custom_meta (buffer,
+      GST_VAAPI_QP_MAP_META_NAME);
+  fail_unless (meta != NULL);
+
+  /* Copies keep the map */
+  copy = gst_buffer_copy (buffer);
+  check_map (copy);
+  gst_buffer_unref (copy);
+
+  /* So does scaling, since the map is relative to the frame size */
+  gst_video_info_set_format (&in_info, GST_VIDEO_FORMAT_NV12, 64, 64);
+  gst_video_info_set_format (&out_info, GST_VIDEO_FORMAT_NV12, 32, 32);
+  copy = gst_buffer_new ();
+  fail_unless (meta->info->transform_func (copy, meta, buffer,
+          gst_video_meta_transform_scale_get_quark (), &trans));
+  check_map (copy);
+  gst_buffer_unref (copy);
+
+  /* Other transforms drop it */
+  copy = gst_buffer_new ();
+  fail_if (meta->info->transform_func (copy, meta, buffer,
+          g_quark_from_static_string ("vaapi-test-transform"), NULL));
+  fail_if (gst_buffer_get_vaapi_qp_map (copy, &map));
+  gst_buffer_unref (copy);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_qp_map_resample)
+{
+  GstVaapiQPMap map = { 2, 2, delta_qp };
+
+  /* Blocks within a single entry of the map */
+  fail_unless_equals_int (gst_vaapi_qp_map_get_block_delta_qp (&map,
+          64, 64, 0, 0, 16, 16), -4);
+  fail_unless_equals_int (gst_vaapi_qp_map_get_block_delta_qp (&map,
+          64, 64, 48, 48, 16, 16), 6);
+
+  /* Blocks overlapping several entries get their rounded average */
+  fail_unless_equals_int (gst_vaapi_qp_map_get_block_delta_qp (&map,
+          64, 64, 0, 0, 64, 32), -3);
+  fail_unless_equals_int (gst_vaapi_qp_map_get_block_delta_qp (&map,
+          64, 64, 0, 0, 64, 64), 0);
+  fail_unless_equals_int (gst_vaapi_qp_map_get_block_delta_qp (&map,
+          64, 64, 32, 0, 32, 64), 2);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapiqpmapmeta_suite (void)
+{
+  Suite *s = suite_create ("vaapiqpmapmeta");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_qp_map_contract);
+  tcase_add_test (tc_chain, test_qp_map_transform);
+  tcase_add_test (tc_chain, test_qp_map_resample);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapiqpmapmeta);
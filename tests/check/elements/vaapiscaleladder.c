@@ -0,0 +1,198 @@
+/*
+ *  vaapiscaleladder.c - GStreamer unit test for the vaapiscaleladder element
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define NUM_OUTPUTS 2
+
+typedef struct
+{
+  GstElement *pipeline;
+  GstElement *sinks[NUM_OUTPUTS];
+} LadderTestContext;
+
+/* Builds videotestsrc ! vaapiscaleladder, with one fakesink per
+ * output, each behind a capsfilter set to @outcaps */
+static gboolean
+ladder_test_context_init (LadderTestContext * ctx, const gchar * incaps,
+    const gchar * outcaps[NUM_OUTPUTS])
+{
+  GstElement *src, *filter, *ladder;
+  GstCaps *caps;
+  guint i;
+
+  ladder = gst_element_factory_make ("vaapiscaleladder", "ladder");
+  if (!ladder)
+    return FALSE;
+
+  ctx->pipeline = gst_pipeline_new ("pipeline");
+
+  src = gst_element_factory_make ("videotestsrc", "src");
+  g_object_set (src, "num-buffers", 1, NULL);
+  filter = gst_element_factory_make ("capsfilter", "infilter");
+  caps = gst_caps_from_string (incaps);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (ctx->pipeline), src, filter, ladder, NULL);
+  fail_unless (gst_element_link_many (src, filter, ladder, NULL));
+
+  for (i = 0; i < NUM_OUTPUTS; i++) {
+    GstElement *outfilter;
+    GstPad *srcpad, *sinkpad;
+
+    outfilter = gst_element_factory_make ("capsfilter", NULL);
+    caps = gst_caps_from_string (outcaps[i]);
+    g_object_set (outfilter, "caps", caps, NULL);
+    gst_caps_unref (caps);
+    ctx->sinks[i] = gst_element_factory_make ("fakesink", NULL);
+
+    gst_bin_add_many (GST_BIN (ctx->pipeline), outfilter, ctx->sinks[i], NULL);
+    fail_unless (gst_element_link (outfilter, ctx->sinks[i]));
+
+    srcpad = gst_element_get_request_pad (ladder, "src_%u");
+    sinkpad = gst_element_get_static_pad (outfilter, "sink");
+    fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+    gst_object_unref (sinkpad);
+    gst_object_unref (srcpad);
+  }
+
+  return TRUE;
+}
+
+static void
+ladder_test_context_deinit (LadderTestContext * ctx)
+{
+  gst_element_set_state (ctx->pipeline, GST_STATE_NULL);
+  gst_object_unref (ctx->pipeline);
+}
+
+static void
+ladder_test_context_run (LadderTestContext * ctx)
+{
+  GstBus *bus;
+  GstMessage *msg;
+
+  bus = gst_element_get_bus (ctx->pipeline);
+  fail_unless (gst_element_set_state (ctx->pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS,
+      "unexpected message: %" GST_PTR_FORMAT, msg);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+static void
+get_output_info (LadderTestContext * ctx, guint index, GstVideoInfo * vinfo)
+{
+  GstPad *pad;
+  GstCaps *caps;
+
+  pad = gst_element_get_static_pad (ctx->sinks[index], "sink");
+  caps = gst_pad_get_current_caps (pad);
+  fail_unless (caps != NULL);
+  fail_unless (gst_video_info_from_caps (vinfo, caps));
+  gst_caps_unref (caps);
+  gst_object_unref (pad);
+}
+
+/* Each output gets its own size, and a missing dimension follows the
+ * input aspect ratio */
+GST_START_TEST (test_ladder_sizes)
+{
+  static const gchar *outcaps[NUM_OUTPUTS] = {
+    "video/x-raw(memory:VASurface), width=160, height=120",
+    "video/x-raw(memory:VASurface), height=60",
+  };
+  LadderTestContext ctx;
+  GstVideoInfo vinfo;
+
+  if (!ladder_test_context_init (&ctx, "video/x-raw, format=NV12, "
+          "width=320, height=240, framerate=25/1", outcaps))
+    return;
+
+  ladder_test_context_run (&ctx);
+
+  get_output_info (&ctx, 0, &vinfo);
+  fail_unless_equals_int (GST_VIDEO_INFO_FORMAT (&vinfo),
+      GST_VIDEO_FORMAT_NV12);
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&vinfo), 160);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&vinfo), 120);
+
+  get_output_info (&ctx, 1, &vinfo);
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&vinfo), 80);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&vinfo), 60);
+
+  ladder_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+/* The input colorimetry goes through to every output */
+GST_START_TEST (test_ladder_colorimetry)
+{
+  static const gchar *outcaps[NUM_OUTPUTS] = {
+    "video/x-raw(memory:VASurface), width=160, height=120",
+    "video/x-raw(memory:VASurface), width=64, height=48",
+  };
+  LadderTestContext ctx;
+  GstVideoColorimetry bt601;
+  GstVideoInfo vinfo;
+  guint i;
+
+  if (!ladder_test_context_init (&ctx, "video/x-raw, format=NV12, "
+          "width=320, height=240, framerate=25/1, colorimetry=bt601", outcaps))
+    return;
+
+  ladder_test_context_run (&ctx);
+
+  fail_unless (gst_video_colorimetry_from_string (&bt601, "bt601"));
+  for (i = 0; i < NUM_OUTPUTS; i++) {
+    get_output_info (&ctx, i, &vinfo);
+    fail_unless (gst_video_colorimetry_is_equal
+        (&GST_VIDEO_INFO_COLORIMETRY (&vinfo), &bt601));
+  }
+
+  ladder_test_context_deinit (&ctx);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapiscaleladder_suite (void)
+{
+  Suite *s = suite_create ("vaapiscaleladder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_ladder_sizes);
+  tcase_add_test (tc_chain, test_ladder_colorimetry);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapiscaleladder);
@@ -0,0 +1,281 @@
+/*
+ *  vaapivideopool.c - GStreamer unit test for the video pool
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/vaapi/gstvaapidisplay_drm.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+
+#define POOL_CAPACITY 4
+
+static GstVaapiVideoPool *
+create_pool (guint capacity)
+{
+  GstVaapiDisplay *display;
+  GstVaapiVideoPool *pool;
+
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display) {
+    GST_WARNING ("no VA display available");
+    return NULL;
+  }
+
+  pool = gst_vaapi_surface_pool_new (display, GST_VIDEO_FORMAT_NV12,
+      64, 64, 0);
+  gst_object_unref (display);
+  fail_unless (pool != NULL);
+
+  gst_vaapi_video_pool_set_capacity (pool, capacity);
+  return pool;
+}
+
+/* Waits for the background reservation to fill the pool */
+static gboolean
+wait_for_pool_size (GstVaapiVideoPool * pool, guint size)
+{
+  const gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  while (gst_vaapi_video_pool_get_size (pool) < size) {
+    if (g_get_monotonic_time () > end_time)
+      return FALSE;
+    g_usleep (1000);
+  }
+  return TRUE;
+}
+
+GST_START_TEST (test_reserve_no_capacity)
+{
+  GstVaapiVideoPool *pool;
+
+  pool = create_pool (0);
+  if (!pool)
+    return;
+
+  /* A pool without capacity reserves nothing */
+  fail_unless (gst_vaapi_video_pool_reserve (pool, 3));
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool), 0);
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reserve_async_bounded)
+{
+  GstVaapiVideoPool *pool;
+  gpointer objects[POOL_CAPACITY];
+  guint i;
+
+  pool = create_pool (POOL_CAPACITY);
+  if (!pool)
+    return;
+
+  /* The reservation is clamped to the capacity of the pool */
+  gst_vaapi_video_pool_reserve_async (pool, 2 * POOL_CAPACITY);
+  fail_unless (wait_for_pool_size (pool, POOL_CAPACITY));
+
+  for (i = 0; i < POOL_CAPACITY; i++) {
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+    fail_unless (objects[i] != NULL);
+  }
+
+  /* Still bounded: the caller has to wait for an object to be
+   * released */
+  fail_unless (gst_vaapi_video_pool_get_object (pool) == NULL);
+
+  gst_vaapi_video_pool_put_object (pool, objects[0]);
+  objects[0] = gst_vaapi_video_pool_get_object (pool);
+  fail_unless (objects[0] != NULL);
+
+  for (i = 0; i < POOL_CAPACITY; i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool),
+      POOL_CAPACITY);
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+GST_END_TEST;
+
+/* Without capacity, the background reservation only bounds the
+ * pre-allocation: more objects are still handed out on demand, as
+ * decoders need when downstream holds many surfaces */
+GST_START_TEST (test_reserve_async_unbounded)
+{
+  GstVaapiVideoPool *pool;
+  gpointer objects[2 * POOL_CAPACITY];
+  guint i;
+
+  pool = create_pool (0);
+  if (!pool)
+    return;
+
+  gst_vaapi_video_pool_reserve_async (pool, POOL_CAPACITY);
+  fail_unless (wait_for_pool_size (pool, POOL_CAPACITY));
+
+  for (i = 0; i < G_N_ELEMENTS (objects); i++) {
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+    fail_unless (objects[i] != NULL);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (objects); i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool),
+      G_N_ELEMENTS (objects));
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_get_object_waits_for_reserve)
+{
+  GstVaapiVideoPool *pool;
+  gpointer objects[POOL_CAPACITY];
+  guint i;
+
+  pool = create_pool (POOL_CAPACITY);
+  if (!pool)
+    return;
+
+  /* Objects are requested while they are still being allocated in
+   * the background: the callers either wait for them or allocate the
+   * missing ones, but never more than the reservation */
+  gst_vaapi_video_pool_reserve_async (pool, POOL_CAPACITY);
+  for (i = 0; i < POOL_CAPACITY; i++) {
+    objects[i] = gst_vaapi_video_pool_get_object (pool);
+    fail_unless (objects[i] != NULL);
+  }
+  fail_unless (gst_vaapi_video_pool_get_object (pool) == NULL);
+
+  for (i = 0; i < POOL_CAPACITY; i++)
+    gst_vaapi_video_pool_put_object (pool, objects[i]);
+  fail_unless_equals_int (gst_vaapi_video_pool_get_size (pool),
+      POOL_CAPACITY);
+
+  gst_vaapi_video_pool_unref (pool);
+}
+
+GST_END_TEST;
+
+/* The budget error of a failed allocation does not outlive the next
+ * allocation attempt */
+GST_START_TEST (test_allocation_error_reset)
+{
+  GstVaapiDisplay *display;
+  GstVaapiSurface *surface;
+  GError *error;
+
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display)
+    return;
+
+  gst_vaapi_display_set_memory_budget (display, 1024);
+  surface = gst_vaapi_surface_new (display, GST_VAAPI_CHROMA_TYPE_YUV420,
+      64, 64);
+  fail_unless (surface == NULL);
+
+  gst_vaapi_display_set_memory_budget (display, 0);
+  surface = gst_vaapi_surface_new (display, GST_VAAPI_CHROMA_TYPE_YUV420,
+      64, 64);
+  fail_unless (surface != NULL);
+  fail_unless (gst_vaapi_display_take_allocation_error () == NULL);
+  gst_vaapi_surface_unref (surface);
+
+  gst_vaapi_display_set_memory_budget (display, 1024);
+  surface = gst_vaapi_surface_new (display, GST_VAAPI_CHROMA_TYPE_YUV420,
+      64, 64);
+  fail_unless (surface == NULL);
+  error = gst_vaapi_display_take_allocation_error ();
+  fail_unless (g_error_matches (error, GST_VAAPI_DISPLAY_ERROR,
+          GST_VAAPI_DISPLAY_ERROR_BUDGET_EXCEEDED));
+  g_error_free (error);
+  fail_unless (gst_vaapi_display_take_allocation_error () == NULL);
+
+  gst_object_unref (display);
+}
+
+GST_END_TEST;
+
+/* Pools with the same allocation parameters are shared through the
+ * display, as long as one of their users holds them */
+GST_START_TEST (test_shared_pool)
+{
+  GstVaapiDisplay *display;
+  GstVaapiVideoPool *pool, *other;
+  GstVideoInfo vinfo;
+  const guint flags = GST_VAAPI_SURFACE_ALLOC_FLAG_HINT_DECODER;
+
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display)
+    return;
+
+  gst_video_info_set_format (&vinfo, GST_VIDEO_FORMAT_NV12, 64, 64);
+  pool = gst_vaapi_surface_pool_new_shared (display, &vinfo, flags);
+  fail_unless (pool != NULL);
+
+  other = gst_vaapi_surface_pool_new_shared (display, &vinfo, flags);
+  fail_unless (other == pool);
+  gst_vaapi_video_pool_unref (other);
+
+  /* Different allocation flags, or size, get a pool of their own */
+  other = gst_vaapi_surface_pool_new_shared (display, &vinfo,
+      flags | GST_VAAPI_SURFACE_ALLOC_FLAG_LINEAR_STORAGE);
+  fail_unless (other != NULL);
+  fail_unless (other != pool);
+  gst_vaapi_video_pool_unref (other);
+
+  other = gst_vaapi_surface_pool_new_shared (display, &vinfo, 0);
+  fail_unless (other != NULL);
+  fail_unless (other != pool);
+  gst_vaapi_video_pool_unref (other);
+
+  gst_video_info_set_format (&vinfo, GST_VIDEO_FORMAT_NV12, 128, 64);
+  other = gst_vaapi_surface_pool_new_shared (display, &vinfo, flags);
+  fail_unless (other != NULL);
+  fail_unless (other != pool);
+  gst_vaapi_video_pool_unref (other);
+
+  gst_vaapi_video_pool_unref (pool);
+  gst_object_unref (display);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapivideopool_suite (void)
+{
+  Suite *s = suite_create ("vaapivideopool");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_reserve_no_capacity);
+  tcase_add_test (tc_chain, test_reserve_async_bounded);
+  tcase_add_test (tc_chain, test_reserve_async_unbounded);
+  tcase_add_test (tc_chain, test_get_object_waits_for_reserve);
+  tcase_add_test (tc_chain, test_allocation_error_reset);
+  tcase_add_test (tc_chain, test_shared_pool);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapivideopool);
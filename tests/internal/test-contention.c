@@ -0,0 +1,133 @@
+/*
+ *  test-contention.c - Measure the display lock contention
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* N threads share one display, each one with its own surface and
+ * image, and loop over the VA calls of the decoding and upload hot
+ * paths. Run it with GST_VAAPI_DISPLAY_SERIALIZE=1 to compare with
+ * every VA call taking the display lock. */
+
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include "output.h"
+
+static gint g_num_threads = 4;
+static gint g_num_iterations = 500;
+
+static GOptionEntry g_options[] = {
+  {"threads", 't',
+        0,
+        G_OPTION_ARG_INT, &g_num_threads,
+      "number of threads sharing the display", NULL},
+  {"iterations", 'n',
+        0,
+        G_OPTION_ARG_INT, &g_num_iterations,
+      "number of iterations per thread", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  GstVaapiDisplay *display;
+  GThread *thread;
+  guint num_calls;
+} Worker;
+
+static gpointer
+worker_run (gpointer data)
+{
+  Worker *const worker = data;
+  GstVaapiSurface *surface;
+  GstVaapiImage *image;
+  GstVaapiSurfaceStatus status;
+  gint i;
+
+  static const guint width = 320;
+  static const guint height = 240;
+
+  surface = gst_vaapi_surface_new (worker->display,
+      GST_VAAPI_CHROMA_TYPE_YUV420, width, height);
+  if (!surface)
+    g_error ("could not create Gst/VA surface");
+
+  image = gst_vaapi_image_new (worker->display, GST_VIDEO_FORMAT_NV12,
+      width, height);
+  if (!image)
+    g_error ("could not create Gst/VA image");
+
+  for (i = 0; i < g_num_iterations; i++) {
+    if (!gst_vaapi_surface_put_image (surface, image))
+      g_error ("could not upload image");
+    if (!gst_vaapi_surface_sync (surface))
+      g_error ("could not sync surface");
+    if (!gst_vaapi_surface_query_status (surface, &status))
+      g_error ("could not query surface status");
+    if (!gst_vaapi_surface_get_image (surface, image))
+      g_error ("could not download image");
+    if (!gst_vaapi_image_map (image))
+      g_error ("could not map image");
+    gst_vaapi_image_unmap (image);
+    worker->num_calls += 6;
+  }
+
+  gst_vaapi_image_unref (image);
+  gst_vaapi_surface_unref (surface);
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiDisplay *display;
+  Worker *workers;
+  gint64 start_time, elapsed;
+  guint num_calls = 0;
+  gint i;
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  if (g_num_threads < 1 || g_num_iterations < 1)
+    g_error ("invalid number of threads or iterations");
+
+  display = video_output_create_display (NULL);
+  if (!display)
+    g_error ("could not create Gst/VA display");
+
+  workers = g_new0 (Worker, g_num_threads);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < g_num_threads; i++) {
+    workers[i].display = display;
+    workers[i].thread = g_thread_new ("worker", worker_run, &workers[i]);
+  }
+  for (i = 0; i < g_num_threads; i++) {
+    g_thread_join (workers[i].thread);
+    num_calls += workers[i].num_calls;
+  }
+  elapsed = MAX (g_get_monotonic_time () - start_time, 1);
+
+  g_print ("%d threads: %u VA calls in %.3f ms, %.0f calls/s\n",
+      g_num_threads, num_calls, elapsed / 1000.0,
+      num_calls * (gdouble) G_USEC_PER_SEC / elapsed);
+
+  g_free (workers);
+  gst_object_unref (display);
+  video_output_exit ();
+  return 0;
+}
@@ -201,6 +201,51 @@ dump_info (GstVaapiDisplay * display)
   dump_properties (display);
 }
 
+#if USE_DRM
+static gdouble
+elapsed_ms (gint64 start_time)
+{
+  return (g_get_monotonic_time () - start_time) / 1000.0;
+}
+
+/* Time the display creation and the first capability lookups, which
+ * only probe what they need. Set GST_VAAPI_DISABLE_CAPS_CACHE to time
+ * the driver queries rather than the capability cache */
+static void
+dump_startup_time (void)
+{
+  GstVaapiDisplay *display;
+  GArray *profiles;
+  gint64 start_time;
+
+  start_time = g_get_monotonic_time ();
+  display = gst_vaapi_display_drm_new (NULL);
+  if (!display)
+    g_error ("could not create Gst/VA display");
+  g_print ("display created in %.3f ms\n", elapsed_ms (start_time));
+
+  start_time = g_get_monotonic_time ();
+  gst_vaapi_display_has_decoder (display, GST_VAAPI_PROFILE_H264_HIGH,
+      GST_VAAPI_ENTRYPOINT_VLD);
+  g_print ("first decoder lookup in %.3f ms\n", elapsed_ms (start_time));
+
+  start_time = g_get_monotonic_time ();
+  gst_vaapi_display_has_video_processing (display);
+  g_print ("video processing lookup in %.3f ms\n", elapsed_ms (start_time));
+
+  start_time = g_get_monotonic_time ();
+  profiles = gst_vaapi_display_get_decode_profiles (display);
+  if (profiles)
+    g_array_unref (profiles);
+  profiles = gst_vaapi_display_get_encode_profiles (display);
+  if (profiles)
+    g_array_unref (profiles);
+  g_print ("all profiles probed in %.3f ms\n", elapsed_ms (start_time));
+
+  gst_object_unref (display);
+}
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -226,6 +271,12 @@ main (int argc, char *argv[])
   }
   g_print ("\n");
 
+  g_print ("#\n");
+  g_print ("# Measure display startup time\n");
+  g_print ("#\n");
+  dump_startup_time ();
+  g_print ("\n");
+
   g_print ("#\n");
   g_print ("# Create display with gst_vaapi_display_drm_new_with_device()\n");
   g_print ("#\n");
@@ -36,6 +36,9 @@ static gchar *g_denoise_str;
 static gchar *g_sharpen_str;
 static gchar *g_deinterlace_str;
 static gchar *g_deinterlace_flags_str;
+static gboolean g_hdr_tone_map;
+static gint g_benchmark_frames;
+static gint g_scene_length;
 
 static GOptionEntry g_options[] = {
   {"src-format", 's',
@@ -62,6 +65,18 @@ static GOptionEntry g_options[] = {
         0,
         G_OPTION_ARG_STRING, &g_deinterlace_flags_str,
       "deinterlacing flags", NULL},
+  {"hdr-tone-map", 0,
+        0,
+        G_OPTION_ARG_NONE, &g_hdr_tone_map,
+      "enable HDR10 tone mapping", NULL},
+  {"benchmark", 0,
+        0,
+        G_OPTION_ARG_INT, &g_benchmark_frames,
+      "measure the throughput over that many frames", NULL},
+  {"scene-length", 0,
+        0,
+        G_OPTION_ARG_INT, &g_scene_length,
+      "change the HDR content light levels every that many frames", NULL},
   {NULL,}
 };
 
@@ -315,6 +330,59 @@ parse_deinterlace_flags (const gchar * str, guint * deinterlace_flags_ptr)
       deinterlace_flags_ptr);
 }
 
+static void
+set_hdr_tone_map (GstVaapiFilter * filter)
+{
+  GstVideoMasteringDisplayInfo minfo;
+  GstVideoContentLightLevel linfo;
+
+  /* BT.2020 primaries, D65 white point, 1000 nits mastering display */
+  if (!gst_video_mastering_display_info_from_string (&minfo,
+          "35400:14600:8500:39850:6550:2300:15635:16450:10000000:50"))
+    g_error ("failed to parse mastering display info");
+  if (!gst_video_content_light_level_from_string (&linfo, "1000:400"))
+    g_error ("failed to parse content light level");
+
+  if (!gst_vaapi_filter_set_hdr_tone_map (filter, TRUE))
+    g_error ("failed to enable HDR tone mapping");
+  if (!gst_vaapi_filter_set_hdr_tone_map_meta (filter, &minfo, &linfo))
+    g_error ("failed to set HDR meta data");
+}
+
+static void
+benchmark (GstVaapiFilter * filter, GstVaapiSurface * src_surface,
+    GstVaapiSurface * dst_surface, guint filter_flags)
+{
+  GstVaapiFilterStatus status;
+  GstVideoContentLightLevel linfo;
+  gint64 start, elapsed;
+  gint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < g_benchmark_frames; i++) {
+    if (g_hdr_tone_map && g_scene_length > 0 && i % g_scene_length == 0) {
+      /* fake a new scene, in the way of HDR10+ dynamic metadata */
+      linfo.max_content_light_level = 1000 - (i / g_scene_length) % 8 * 100;
+      linfo.max_frame_average_light_level = 400;
+      if (!gst_vaapi_filter_set_hdr_tone_map_scene_meta (filter, &linfo))
+        g_error ("failed to set scene HDR meta data");
+    }
+
+    status = gst_vaapi_filter_process (filter, src_surface, dst_surface,
+        filter_flags);
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+      g_error ("failed to process video filters");
+  }
+  if (!gst_vaapi_surface_sync (dst_surface))
+    g_error ("failed to sync target VA surface");
+  elapsed = g_get_monotonic_time () - start;
+
+  printf ("Processed %d frames in %.3f s: %.1f fps\n", g_benchmark_frames,
+      (gdouble) elapsed / G_USEC_PER_SEC,
+      elapsed > 0 ? (gdouble) g_benchmark_frames * G_USEC_PER_SEC / elapsed :
+      0.0);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -394,6 +462,11 @@ main (int argc, char *argv[])
       g_error ("failed to set sharpening level");
   }
 
+  if (g_hdr_tone_map) {
+    printf ("Enable HDR tone mapping\n");
+    set_hdr_tone_map (filter);
+  }
+
   if (deinterlace_method != GST_VAAPI_DEINTERLACE_METHOD_NONE) {
     printf ("Enable deinterlacing: %s\n", g_deinterlace_str);
 
@@ -433,6 +506,9 @@ main (int argc, char *argv[])
   if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
     g_error ("failed to process video filters");
 
+  if (g_benchmark_frames > 0)
+    benchmark (filter, src_surface, dst_surface, filter_flags);
+
   gst_vaapi_window_show (window);
 
   if (!gst_vaapi_window_put_surface (window, dst_surface, NULL, NULL,